@@ -0,0 +1 @@
+./Urho3D Scripts/AnimationBenchmark.as $@
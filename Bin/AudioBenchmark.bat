@@ -0,0 +1 @@
+Urho3D.exe Scripts/AudioBenchmark.as -headless %1 %2 %3 %4 %5 %6 %7 %8
\ No newline at end of file
@@ -0,0 +1 @@
+./Urho3D Scripts/AudioBenchmark.as -headless $@
@@ -0,0 +1,107 @@
+// Skeletal animation benchmark: measures the frame time of animating and skinning a crowd of characters, first with the
+// animation applied to the bone nodes, then blended into the bone pose without touching the bone nodes, and finally in the
+// bone pose mode with bone LOD and pose interpolation between animation LOD updates.
+// Run with: Urho3D Scripts/AnimationBenchmark.as
+// Animation is updated by the renderer, so the benchmark can not be run headless. Compare against a run with the -nothreads
+// option to see the effect of updating the animations in worker threads.
+
+const uint NUM_CHARACTERS = 1000;
+const uint NUM_WARMUP_FRAMES = 30;
+const uint NUM_FRAMES = 300;
+
+Scene@ benchmarkScene;
+Array<AnimatedModel@> models;
+Array<String> modes = { "Bone node animation", "Bone pose animation", "Bone pose animation with LOD" };
+uint modeIndex = 0;
+uint frameNumber = 0;
+uint startTime = 0;
+
+void Start()
+{
+    if (engine.headless)
+    {
+        Print("Animation benchmark can not be run headless");
+        engine.Exit();
+        return;
+    }
+
+    OpenConsoleWindow();
+    engine.maxFps = 0;
+
+    CreateBenchmarkScene();
+    SetMode(modeIndex);
+
+    Print("Animation benchmark: " + NUM_CHARACTERS + " characters, " + NUM_FRAMES + " frames");
+
+    SubscribeToEvent("Update", "HandleUpdate");
+}
+
+void CreateBenchmarkScene()
+{
+    benchmarkScene = Scene("AnimationBenchmark");
+    benchmarkScene.CreateComponent("Octree");
+
+    Node@ lightNode = benchmarkScene.CreateChild("Light");
+    lightNode.direction = Vector3(0.5, -1.0, 0.5);
+    Light@ light = lightNode.CreateComponent("Light");
+    light.lightType = LIGHT_DIRECTIONAL;
+
+    // Place the characters on a grid, with varying animation time positions and speeds
+    uint gridSize = uint(Sqrt(NUM_CHARACTERS)) + 1;
+    for (uint i = 0; i < NUM_CHARACTERS; ++i)
+    {
+        Node@ objectNode = benchmarkScene.CreateChild("Jack");
+        objectNode.position = Vector3((i % gridSize) * 2.0 - gridSize, 0, (i / gridSize) * 2.0);
+        objectNode.rotation = Quaternion(0, Random() * 360, 0);
+
+        AnimatedModel@ object = objectNode.CreateComponent("AnimatedModel");
+        object.model = cache.GetResource("Model", "Models/Jack.mdl");
+        object.material = cache.GetResource("Material", "Materials/Jack.xml");
+        models.Push(object);
+
+        AnimationController@ ctrl = objectNode.CreateComponent("AnimationController");
+        ctrl.Play("Models/Jack_Walk.ani", 0, true, 0.0);
+        ctrl.SetTime("Models/Jack_Walk.ani", Random(1.0));
+        ctrl.SetSpeed("Models/Jack_Walk.ani", 0.8 + Random(0.4));
+    }
+
+    // View the whole crowd so that all characters are animated and skinned
+    Node@ cameraNode = benchmarkScene.CreateChild("Camera");
+    Camera@ camera = cameraNode.CreateComponent("Camera");
+    camera.farClip = 1000.0;
+    cameraNode.position = Vector3(0, gridSize * 1.5, -gridSize * 0.5);
+    cameraNode.LookAt(Vector3(0, 0, gridSize));
+
+    renderer.viewports[0] = Viewport(benchmarkScene, camera);
+}
+
+void SetMode(uint index)
+{
+    for (uint i = 0; i < models.length; ++i)
+    {
+        models[i].animateBoneNodes = index == 0;
+        models[i].boneLodDistance = index == 2 ? 50.0 : 0.0;
+        models[i].animationLodInterpolation = index == 2;
+    }
+}
+
+void HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    ++frameNumber;
+    if (frameNumber == NUM_WARMUP_FRAMES)
+        startTime = time.systemTime;
+    else if (frameNumber == NUM_WARMUP_FRAMES + NUM_FRAMES)
+    {
+        uint elapsed = time.systemTime - startTime;
+        Print(modes[modeIndex] + ": " + (float(elapsed) / NUM_FRAMES) + " ms per frame");
+
+        if (++modeIndex >= modes.length)
+        {
+            engine.Exit();
+            return;
+        }
+
+        SetMode(modeIndex);
+        frameNumber = 0;
+    }
+}
@@ -0,0 +1,104 @@
+// Headless audio mixing benchmark: measures the time to mix a large number of simultaneously playing sound sources,
+// and to update thousands of 3D emitters with and without the voice limit.
+// Run with: Urho3D Scripts/AudioBenchmark.as -headless
+
+const uint NUM_SOURCES = 256;
+const int MIX_RATE = 44100;
+const uint MIX_SECONDS = 10;
+const uint MIX_BLOCK_SIZE = 1024;
+const uint NUM_EMITTERS = 4096;
+
+Array<String> soundNames = {
+    "Sounds/BigExplosion.wav",
+    "Sounds/NutThrow.wav",
+    "Sounds/PlayerFist.wav",
+    "Sounds/PlayerFistHit.wav",
+    "Sounds/PlayerLand.wav",
+    "Sounds/Powerup.wav",
+    "Sounds/SmallExplosion.wav"
+};
+
+void Start()
+{
+    OpenConsoleWindow();
+
+    Print("Audio benchmark: " + NUM_SOURCES + " sources, " + MIX_SECONDS + " seconds of audio at " + MIX_RATE + " Hz");
+
+    RunBenchmark("Stereo, interpolated", true, true, false);
+    RunBenchmark("Stereo", true, false, false);
+    RunBenchmark("Mono, interpolated", false, true, false);
+    RunBenchmark("Stereo, interpolated, resampled", true, true, true);
+    RunBenchmark("Stereo, resampled", true, false, true);
+
+    RunVoiceBenchmark(0);
+    RunVoiceBenchmark(64);
+
+    engine.Exit();
+}
+
+void RunBenchmark(const String&in name, bool stereo, bool interpolation, bool resample)
+{
+    audio.SetOfflineMode(MIX_RATE, stereo, interpolation);
+
+    Scene@ benchmarkScene = Scene("AudioBenchmark");
+    for (uint i = 0; i < NUM_SOURCES; ++i)
+    {
+        Sound@ sound = cache.GetResource("Sound", soundNames[i % soundNames.length]);
+        sound.looped = true;
+
+        // Sounds played at their own frequency can be mixed without resampling
+        float frequency = sound.frequency;
+        if (resample)
+            frequency *= 0.5 + (i % 16) * 0.1;
+
+        Node@ sourceNode = benchmarkScene.CreateChild("Source");
+        SoundSource@ source = sourceNode.CreateComponent("SoundSource");
+        source.Play(sound, frequency, 0.1, (i % 21) * 0.1 - 1.0);
+    }
+
+    uint totalSamples = uint(MIX_RATE) * MIX_SECONDS;
+    uint startTime = time.systemTime;
+    for (uint i = 0; i < totalSamples; i += MIX_BLOCK_SIZE)
+        audio.MixOutput(MIX_BLOCK_SIZE);
+    uint elapsed = time.systemTime - startTime;
+
+    Print(name + ": " + elapsed + " ms total, " + (float(elapsed) / MIX_SECONDS) + " ms per second of audio");
+}
+
+void RunVoiceBenchmark(uint maxVoices)
+{
+    audio.SetOfflineMode(MIX_RATE, true, true);
+    audio.maxVoices = maxVoices;
+
+    // Scatter 3D emitters around the listener, so that most of them are audible
+    Scene@ benchmarkScene = Scene("VoiceBenchmark");
+    Node@ listenerNode = benchmarkScene.CreateChild("Listener");
+    audio.listener = listenerNode.CreateComponent("SoundListener");
+    for (uint i = 0; i < NUM_EMITTERS; ++i)
+    {
+        Sound@ sound = cache.GetResource("Sound", soundNames[i % soundNames.length]);
+        sound.looped = true;
+
+        Node@ sourceNode = benchmarkScene.CreateChild("Emitter");
+        sourceNode.position = Vector3(Random(200.0) - 100.0, 0.0, Random(200.0) - 100.0);
+        SoundSource3D@ source = sourceNode.CreateComponent("SoundSource3D");
+        source.soundType = SOUND_AMBIENT;
+        source.Play(sound, sound.frequency, 0.1);
+    }
+
+    // Update the sources once per mixed block, as the render update would do
+    uint totalSamples = uint(MIX_RATE) * MIX_SECONDS;
+    uint startTime = time.systemTime;
+    for (uint i = 0; i < totalSamples; i += MIX_BLOCK_SIZE)
+    {
+        audio.Update(float(MIX_BLOCK_SIZE) / MIX_RATE);
+        audio.MixOutput(MIX_BLOCK_SIZE);
+    }
+    uint elapsed = time.systemTime - startTime;
+
+    String limit = maxVoices > 0 ? String(maxVoices) : "unlimited";
+    Print(NUM_EMITTERS + " emitters, voice limit " + limit + ": " + audio.numVoices + " mixed, " + audio.numVirtualVoices +
+        " virtual, " + elapsed + " ms total, " + (float(elapsed) / MIX_SECONDS) + " ms per second of audio");
+
+    audio.listener = null;
+}
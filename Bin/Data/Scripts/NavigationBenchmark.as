@@ -0,0 +1,178 @@
+// Headless navigation mesh benchmark: measures the time to build the navigation mesh for a generated terrain scene.
+// Run with: Urho3D Scripts/NavigationBenchmark.as -headless
+// Compare against a run with the -nothreads option to see the effect of building tiles in worker threads.
+// Afterward checks that paths keep the agent radius away from a rotated box obstacle, and that an off-mesh connection
+// survives rebuilding its tile from the tile cache when an obstacle moves.
+
+const uint NUM_OBSTACLES = 400;
+const uint NUM_BUILDS = 2;
+
+void Start()
+{
+    OpenConsoleWindow();
+
+    Scene@ benchmarkScene = CreateBenchmarkScene();
+    NavigationMesh@ navMesh = benchmarkScene.GetComponent("NavigationMesh");
+
+    uint totalTime = 0;
+    for (uint i = 0; i < NUM_BUILDS; ++i)
+    {
+        uint startTime = time.systemTime;
+        navMesh.Build();
+        totalTime += time.systemTime - startTime;
+    }
+
+    Print("Navigation benchmark: " + navMesh.numTiles.x + "x" + navMesh.numTiles.y + " tiles, " + NUM_OBSTACLES +
+        " obstacles, " + (float(totalTime) / NUM_BUILDS) + " ms per build");
+
+    CheckObstacleClearance();
+    CheckOffMeshConnection();
+
+    engine.Exit();
+}
+
+void CheckObstacleClearance()
+{
+    Scene@ checkScene = Scene("ObstacleCheck");
+    checkScene.CreateComponent("Octree");
+
+    Node@ floorNode = checkScene.CreateChild("Floor");
+    floorNode.position = Vector3(0, -0.5, 0);
+    floorNode.scale = Vector3(40, 1, 40);
+    StaticModel@ floorObject = floorNode.CreateComponent("StaticModel");
+    floorObject.model = cache.GetResource("Model", "Models/Box.mdl");
+
+    checkScene.CreateComponent("Navigable");
+    NavigationMesh@ navMesh = checkScene.CreateComponent("NavigationMesh");
+    navMesh.cellSize = 0.1;
+
+    // Rotate the box and flip it over so that both corner windings are exercised
+    Vector3 obstacleSize(4, 2, 8);
+    Array<Quaternion> obstacleRotations;
+    obstacleRotations.Push(Quaternion(0, 30, 0));
+    obstacleRotations.Push(Quaternion(180, 30, 0));
+    Node@ obstacleNode = checkScene.CreateChild("Obstacle");
+    Obstacle@ obstacle = obstacleNode.CreateComponent("Obstacle");
+    obstacle.shape = OBSTACLE_BOX;
+    obstacle.size = obstacleSize;
+
+    // Allow for the voxelization and contour simplification error
+    float minClearance = navMesh.agentRadius - 2.0 * navMesh.cellSize;
+
+    for (uint i = 0; i < obstacleRotations.length; ++i)
+    {
+        obstacleNode.rotation = obstacleRotations[i];
+        navMesh.Build();
+
+        Vector3[]@ path = navMesh.FindPath(Vector3(-10, 0, 0), Vector3(10, 0, 0));
+        if (path.empty)
+        {
+            Print("Obstacle check FAILED: no path around the obstacle");
+            continue;
+        }
+
+        // Measure the path distance from the box footprint in the box's local space
+        Quaternion inverse = obstacleNode.worldRotation.Inverse();
+        Vector3 halfSize = obstacleSize * 0.5;
+        float clearance = M_INFINITY;
+        for (uint j = 1; j < path.length; ++j)
+        {
+            for (uint k = 0; k <= 20; ++k)
+            {
+                Vector3 point = inverse * path[j - 1].Lerp(path[j], k / 20.0);
+                float dx = Max(Abs(point.x) - halfSize.x, 0.0);
+                float dz = Max(Abs(point.z) - halfSize.z, 0.0);
+                clearance = Min(clearance, Sqrt(dx * dx + dz * dz));
+            }
+        }
+
+        Print("Obstacle check " + (clearance >= minClearance ? "passed" : "FAILED") + ": clearance " + clearance +
+            ", agent radius " + navMesh.agentRadius);
+    }
+}
+
+void CheckOffMeshConnection()
+{
+    Scene@ checkScene = Scene("OffMeshConnectionCheck");
+    checkScene.CreateComponent("Octree");
+
+    // Two floors separated by a gap, which can only be crossed using the off-mesh connection
+    for (int i = -1; i <= 1; i += 2)
+    {
+        Node@ floorNode = checkScene.CreateChild("Floor");
+        floorNode.position = Vector3(i * 6.0, -0.5, 0);
+        floorNode.scale = Vector3(10, 1, 20);
+        StaticModel@ floorObject = floorNode.CreateComponent("StaticModel");
+        floorObject.model = cache.GetResource("Model", "Models/Box.mdl");
+    }
+
+    Node@ connectionNode = checkScene.CreateChild("Connection");
+    connectionNode.position = Vector3(-1.5, 0, 0);
+    Node@ endNode = checkScene.CreateChild("ConnectionEnd");
+    endNode.position = Vector3(1.5, 0, 0);
+    OffMeshConnection@ connection = connectionNode.CreateComponent("OffMeshConnection");
+    connection.endPoint = endNode;
+
+    // The obstacle is in the same tile as the connection start
+    Node@ obstacleNode = checkScene.CreateChild("Obstacle");
+    obstacleNode.position = Vector3(-3, 0, 4);
+    Obstacle@ obstacle = obstacleNode.CreateComponent("Obstacle");
+    obstacle.radius = 1.0;
+
+    checkScene.CreateComponent("Navigable");
+    NavigationMesh@ navMesh = checkScene.CreateComponent("NavigationMesh");
+    navMesh.tileSize = 32;
+    navMesh.tileCacheEnabled = true;
+    navMesh.Build();
+
+    Vector3 start(-6, 0, 0);
+    Vector3 end(6, 0, 0);
+    bool reachedBefore = ReachesPoint(navMesh, start, end);
+
+    obstacleNode.position = Vector3(-3, 0, -4);
+    uint dirtyTiles = navMesh.numDirtyTiles;
+    navMesh.UpdateObstacles();
+    bool reachedAfter = ReachesPoint(navMesh, start, end);
+
+    Print("Off-mesh connection check " + (reachedBefore && reachedAfter ? "passed" : "FAILED") + ": path across the gap " +
+        (reachedBefore ? "found" : "not found") + " before and " + (reachedAfter ? "found" : "not found") + " after rebuilding " +
+        dirtyTiles + " tiles from the tile cache");
+}
+
+bool ReachesPoint(NavigationMesh@ navMesh, const Vector3&in start, const Vector3&in end)
+{
+    Vector3[]@ path = navMesh.FindPath(start, end);
+    return !path.empty && (path[path.length - 1] - end).length < 0.5;
+}
+
+Scene@ CreateBenchmarkScene()
+{
+    Scene@ newScene = Scene("NavigationBenchmark");
+    newScene.CreateComponent("Octree");
+    newScene.CreateComponent("PhysicsWorld");
+
+    Node@ terrainNode = newScene.CreateChild("Terrain");
+    Terrain@ terrain = terrainNode.CreateComponent("Terrain");
+    terrain.patchSize = 64;
+    terrain.spacing = Vector3(2, 0.5, 2);
+    terrain.heightMap = cache.GetResource("Image", "Textures/HeightMap.png");
+
+    // Scatter box obstacles on the terrain
+    for (uint i = 0; i < NUM_OBSTACLES; ++i)
+    {
+        Node@ objectNode = newScene.CreateChild("Box");
+        Vector3 position(Random(2000.0) - 1000.0, 0.0, Random(2000.0) - 1000.0);
+        position.y = terrain.GetHeight(position);
+        objectNode.position = position;
+        objectNode.rotation = Quaternion(0, Random(360.0), 0);
+        objectNode.scale = Vector3(2.0 + Random(4.0), 4.0, 2.0 + Random(4.0));
+        objectNode.CreateComponent("RigidBody");
+        CollisionShape@ shape = objectNode.CreateComponent("CollisionShape");
+        shape.SetBox(Vector3(1, 1, 1));
+    }
+
+    newScene.CreateComponent("Navigable");
+    newScene.CreateComponent("NavigationMesh");
+
+    return newScene;
+}
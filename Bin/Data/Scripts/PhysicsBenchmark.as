@@ -0,0 +1,71 @@
+// Headless physics benchmark: measures the average simulation step time with different threading settings.
+// Run with: Urho3D Scripts/PhysicsBenchmark.as -headless
+// Give -threads<n> to set the worker thread count; PhysicsBenchmarkSweep.sh / .bat runs the benchmark with 0 to 7 threads
+
+const uint NUM_PILES = 20;
+const uint PILE_HEIGHT = 5;
+const uint NUM_STEPS = 600;
+
+void Start()
+{
+    OpenConsoleWindow();
+
+    Print("Physics benchmark: " + NUM_PILES * NUM_PILES * PILE_HEIGHT + " bodies, " + NUM_STEPS + " steps");
+
+    RunBenchmark("Single-threaded", false, false);
+    RunBenchmark("Multithreaded, deterministic", true, true);
+    RunBenchmark("Multithreaded", true, false);
+
+    engine.Exit();
+}
+
+void RunBenchmark(const String&in name, bool multithreaded, bool deterministic)
+{
+    Scene@ benchmarkScene = CreateBenchmarkScene();
+    PhysicsWorld@ world = benchmarkScene.physicsWorld;
+    world.multithreaded = multithreaded;
+    world.deterministic = deterministic;
+
+    uint startTime = time.systemTime;
+    for (uint i = 0; i < NUM_STEPS; ++i)
+        world.Update(1.0 / world.fps);
+    uint elapsed = time.systemTime - startTime;
+
+    Print(name + ": " + elapsed + " ms total, " + (float(elapsed) / NUM_STEPS) + " ms per step");
+}
+
+Scene@ CreateBenchmarkScene()
+{
+    Scene@ newScene = Scene("PhysicsBenchmark");
+    newScene.CreateComponent("PhysicsWorld");
+
+    Node@ floorNode = newScene.CreateChild("Floor");
+    floorNode.position = Vector3(0, -0.5, 0);
+    floorNode.scale = Vector3(500, 1, 500);
+    floorNode.CreateComponent("RigidBody");
+    CollisionShape@ floorShape = floorNode.CreateComponent("CollisionShape");
+    floorShape.SetBox(Vector3(1, 1, 1));
+
+    // Separate piles of boxes form independent simulation islands
+    for (uint x = 0; x < NUM_PILES; ++x)
+    {
+        for (uint z = 0; z < NUM_PILES; ++z)
+        {
+            for (uint y = 0; y < PILE_HEIGHT; ++y)
+            {
+                Node@ objectNode = newScene.CreateChild("Box");
+                objectNode.position = Vector3(x * 3.0 - NUM_PILES * 1.5, y * 1.05 + 0.5, z * 3.0 - NUM_PILES * 1.5);
+                objectNode.rotation = Quaternion(0, y * 10.0, 0);
+
+                RigidBody@ body = objectNode.CreateComponent("RigidBody");
+                body.mass = 1.0;
+                body.friction = 0.75;
+                body.collisionEventMode = COLLISION_NEVER;
+                CollisionShape@ shape = objectNode.CreateComponent("CollisionShape");
+                shape.SetBox(Vector3(1, 1, 1));
+            }
+        }
+    }
+
+    return newScene;
+}
@@ -0,0 +1,86 @@
+// Headless scene load benchmark: measures the load time of a large scene in the binary and XML formats.
+// Run with: Urho3D Scripts/SceneLoadBenchmark.as -headless
+
+const uint NUM_NODES = 100000;
+const uint NUM_LOADS = 3;
+
+void Start()
+{
+    OpenConsoleWindow();
+
+    Print("Scene load benchmark: " + NUM_NODES + " nodes, best of " + NUM_LOADS + " loads");
+
+    Scene@ sourceScene = CreateBenchmarkScene();
+    String baseName = fileSystem.programDir + "SceneLoadBenchmark";
+
+    File@ binaryFile = File(baseName + ".bin", FILE_WRITE);
+    sourceScene.Save(binaryFile);
+    binaryFile.Close();
+    File@ xmlFile = File(baseName + ".xml", FILE_WRITE);
+    sourceScene.SaveXML(xmlFile);
+    xmlFile.Close();
+
+    RunBenchmark("Binary", baseName + ".bin", false);
+    RunBenchmark("XML", baseName + ".xml", true);
+
+    fileSystem.Delete(baseName + ".bin");
+    fileSystem.Delete(baseName + ".xml");
+
+    engine.Exit();
+}
+
+void RunBenchmark(const String&in name, const String&in fileName, bool xml)
+{
+    Scene@ loadScene = Scene();
+    uint bestTime = M_MAX_UNSIGNED;
+    uint fileSize = 0;
+
+    for (uint i = 0; i < NUM_LOADS; ++i)
+    {
+        File@ file = File(fileName, FILE_READ);
+        fileSize = file.size;
+
+        uint startTime = time.systemTime;
+        bool success = xml ? loadScene.LoadXML(file) : loadScene.Load(file);
+        uint elapsed = time.systemTime - startTime;
+        file.Close();
+
+        if (!success)
+        {
+            Print(name + ": load failed");
+            return;
+        }
+        if (elapsed < bestTime)
+            bestTime = elapsed;
+    }
+
+    Print(name + ": " + fileSize + " bytes, " + bestTime + " ms, " + loadScene.numChildren + " child nodes");
+}
+
+Scene@ CreateBenchmarkScene()
+{
+    Scene@ newScene = Scene("SceneLoadBenchmark");
+    newScene.CreateComponent("Octree");
+
+    // Typical static scenery: each node has a model, and every tenth node also has a light
+    for (uint i = 0; i < NUM_NODES; ++i)
+    {
+        Node@ objectNode = newScene.CreateChild("Object" + i % 100);
+        objectNode.position = Vector3(i % 317 * 2.0, 0, i / 317 * 2.0);
+        objectNode.rotation = Quaternion(0, i % 360, 0);
+
+        StaticModel@ object = objectNode.CreateComponent("StaticModel");
+        object.model = cache.GetResource("Model", "Models/Box.mdl");
+        object.material = cache.GetResource("Material", "Materials/Stone.xml");
+        object.castShadows = true;
+
+        if (i % 10 == 0)
+        {
+            Light@ light = objectNode.CreateComponent("Light");
+            light.lightType = LIGHT_POINT;
+            light.range = 5.0;
+        }
+    }
+
+    return newScene;
+}
@@ -0,0 +1 @@
+./Urho3D Scripts/NavigationBenchmark.as -headless $@
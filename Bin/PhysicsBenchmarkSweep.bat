@@ -0,0 +1 @@
+for %%t in (0 1 2 3 4 5 6 7) do Urho3D.exe Scripts/PhysicsBenchmark.as -headless -threads%%t %1 %2 %3 %4 %5 %6 %7 %8
\ No newline at end of file
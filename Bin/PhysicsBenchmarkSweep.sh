@@ -0,0 +1 @@
+for threads in 0 1 2 3 4 5 6 7; do ./Urho3D Scripts/PhysicsBenchmark.as -headless -threads$threads $@; done
@@ -0,0 +1 @@
+./Urho3D Scripts/SceneLoadBenchmark.as -headless $@
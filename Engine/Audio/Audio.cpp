@@ -30,10 +30,21 @@
 #include "Profiler.h"
 #include "Sound.h"
 #include "SoundListener.h"
+#include "Sort.h"
 #include "SoundSource3D.h"
+#include "SoundStream.h"
+#include "Thread.h"
+#include "Timer.h"
 
 #include <SDL.h>
 
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+
 #include "DebugNew.h"
 
 namespace Urho3D
@@ -44,16 +55,96 @@ const char* AUDIO_CATEGORY = "Audio";
 static const int MIN_BUFFERLENGTH = 20;
 static const int MIN_MIXRATE = 11025;
 static const int MAX_MIXRATE = 48000;
+static const unsigned OFFLINE_FRAGMENTSIZE = 1024;
+static const unsigned STREAM_UPDATE_INTERVAL = 10;
+static const unsigned DEFAULT_MAX_VOICES = 64;
+/// Audible gain below which a sound source is always virtualized. Corresponds to half of the smallest 8-bit step.
+static const float MIN_AUDIBLE_GAIN = 0.5f / 256.0f;
 
 static void SDLAudioCallback(void *userdata, Uint8 *stream, int len);
 
+/// Convert floating point mixing buffer samples to 16-bit with saturation. Rounds half away from zero on all code paths,
+/// like the sound stream decoding: adds 0.5 with the sample's sign, then truncates.
+static void ClipSamples(short* dest, const float* src, unsigned count)
+{
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 minValue = _mm_set1_ps(-32768.0f);
+    __m128 maxValue = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 low = _mm_loadu_ps(src + i);
+        __m128 high = _mm_loadu_ps(src + i + 4);
+        low = _mm_add_ps(low, _mm_or_ps(_mm_and_ps(low, signMask), half));
+        high = _mm_add_ps(high, _mm_or_ps(_mm_and_ps(high, signMask), half));
+        // Clamp before the conversion, as out of range floats would convert to the integer minimum
+        __m128i lowInt = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(low, minValue), maxValue));
+        __m128i highInt = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(high, minValue), maxValue));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_packs_epi32(lowInt, highInt));
+    }
+#elif defined(USE_NEON)
+    uint32x4_t signMask = vdupq_n_u32(0x80000000);
+    uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+    for (; i + 8 <= count; i += 8)
+    {
+        float32x4_t low = vld1q_f32(src + i);
+        float32x4_t high = vld1q_f32(src + i + 4);
+        low = vaddq_f32(low, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(low), signMask), half)));
+        high = vaddq_f32(high, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(high), signMask), half)));
+        // The conversion truncates and saturates, and the narrowing saturates to 16 bits
+        int16x4_t lowShort = vqmovn_s32(vcvtq_s32_f32(low));
+        int16x4_t highShort = vqmovn_s32(vcvtq_s32_f32(high));
+        vst1q_s16(dest + i, vcombine_s16(lowShort, highShort));
+    }
+#endif
+    for (; i < count; ++i)
+        dest[i] = (short)(int)Clamp(src[i] + (src[i] >= 0.0f ? 0.5f : -0.5f), -32768.0f, 32767.0f);
+}
+
+/// Thread that decodes sound streams ahead of mixing.
+class StreamThread : public Thread
+{
+public:
+    /// Construct.
+    StreamThread(Audio* owner) :
+        owner_(owner)
+    {
+    }
+    
+    /// Decode the sound streams periodically.
+    virtual void ThreadFunction()
+    {
+        while (shouldRun_)
+        {
+            owner_->UpdateSoundStreams();
+            Time::Sleep(STREAM_UPDATE_INTERVAL);
+        }
+    }
+    
+private:
+    /// Audio subsystem.
+    Audio* owner_;
+};
+
+/// Compare sound sources for mixing order: louder and higher priority first.
+static bool CompareVoices(SoundSource* lhs, SoundSource* rhs)
+{
+    return lhs->GetAudibleGain() * lhs->GetPriority() > rhs->GetAudibleGain() * rhs->GetPriority();
+}
+
 OBJECTTYPESTATIC(Audio);
 
 Audio::Audio(Context* context) :
     Object(context),
     deviceID_(0),
     sampleSize_(0),
-    playing_(false)
+    playing_(false),
+    maxVoices_(DEFAULT_MAX_VOICES),
+    numVoices_(0),
+    numVirtualVoices_(0),
+    streamThread_(0)
 {
     SubscribeToEvent(E_RENDERUPDATE, HANDLER(Audio, HandleRenderUpdate));
     
@@ -64,6 +155,10 @@ Audio::Audio(Context* context) :
 Audio::~Audio()
 {
     Release();
+    
+    // Stop the stream thread before the stream list is destroyed
+    delete streamThread_;
+    streamThread_ = 0;
 }
 
 bool Audio::SetMode(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation)
@@ -120,7 +215,7 @@ bool Audio::SetMode(int bufferLengthMSec, int mixRate, bool stereo, bool interpo
     fragmentSize_ = obtained.samples;
     mixRate_ = mixRate;
     interpolation_ = interpolation;
-    clipBuffer_ = new int[stereo ? fragmentSize_ << 1 : fragmentSize_];
+    clipBuffer_ = new float[stereo ? fragmentSize_ << 1 : fragmentSize_];
     
     LOGINFO("Set audio mode " + String(mixRate_) + " Hz " + (stereo_ ? "stereo" : "mono") + " " +
         (interpolation_ ? "interpolated" : ""));
@@ -128,6 +223,23 @@ bool Audio::SetMode(int bufferLengthMSec, int mixRate, bool stereo, bool interpo
     return Play();
 }
 
+void Audio::SetOfflineMode(int mixRate, bool stereo, bool interpolation)
+{
+    Release();
+    
+    stereo_ = stereo;
+    sampleSize_ = stereo_ ? sizeof(int) : sizeof(short);
+    fragmentSize_ = OFFLINE_FRAGMENTSIZE;
+    mixRate_ = Clamp(mixRate, MIN_MIXRATE, MAX_MIXRATE);
+    interpolation_ = interpolation;
+    clipBuffer_ = new float[stereo ? fragmentSize_ << 1 : fragmentSize_];
+    
+    LOGINFO("Set offline audio mode " + String(mixRate_) + " Hz " + (stereo_ ? "stereo" : "mono") + " " +
+        (interpolation_ ? "interpolated" : ""));
+    
+    Play();
+}
+
 void Audio::Update(float timeStep)
 {
     PROFILE(UpdateAudio);
@@ -135,6 +247,8 @@ void Audio::Update(float timeStep)
     // Update in reverse order, because sound sources might remove themselves
     for (unsigned i = soundSources_.Size() - 1; i < soundSources_.Size(); --i)
         soundSources_[i]->Update(timeStep);
+    
+    UpdateVoices();
 }
 
 bool Audio::Play()
@@ -142,13 +256,14 @@ bool Audio::Play()
     if (playing_)
         return true;
     
-    if (!deviceID_)
+    if (!clipBuffer_)
     {
         LOGERROR("No audio mode set, can not start playback");
         return false;
     }
     
-    SDL_PauseAudioDevice(deviceID_, 0);
+    if (deviceID_)
+        SDL_PauseAudioDevice(deviceID_, 0);
     
     playing_ = true;
     return true;
@@ -181,6 +296,11 @@ void Audio::StopSound(Sound* soundClip)
     }
 }
 
+void Audio::SetMaxVoices(unsigned num)
+{
+    maxVoices_ = num;
+}
+
 float Audio::GetMasterGain(SoundType type) const
 {
     if (type >= MAX_SOUND_TYPES)
@@ -210,6 +330,35 @@ void Audio::RemoveSoundSource(SoundSource* channel)
     }
 }
 
+void Audio::AddSoundStream(SoundStream* stream)
+{
+    {
+        MutexLock lock(streamMutex_);
+        soundStreams_.Push(stream);
+    }
+    
+    // Start the stream thread on first use
+    if (!streamThread_)
+    {
+        streamThread_ = new StreamThread(this);
+        streamThread_->Start();
+    }
+}
+
+void Audio::RemoveSoundStream(SoundStream* stream)
+{
+    MutexLock lock(streamMutex_);
+    soundStreams_.Remove(stream);
+}
+
+void Audio::UpdateSoundStreams()
+{
+    MutexLock lock(streamMutex_);
+    
+    for (PODVector<SoundStream*>::Iterator i = soundStreams_.Begin(); i != soundStreams_.End(); ++i)
+        (*i)->Update();
+}
+
 void SDLAudioCallback(void *userdata, Uint8* stream, int len)
 {
     Audio* audio = static_cast<Audio*>(userdata);
@@ -230,6 +379,10 @@ void Audio::MixOutput(void *dest, unsigned samples)
     
     while (samples)
     {
+        // Without an output device mixing may run faster than realtime, so make sure the streams have been decoded ahead
+        if (!deviceID_)
+            UpdateSoundStreams();
+        
         // If sample count exceeds the fragment (clip buffer) size, split the work
         unsigned workSamples = Min((int)samples, (int)fragmentSize_);
         unsigned clipSamples = workSamples;
@@ -237,20 +390,18 @@ void Audio::MixOutput(void *dest, unsigned samples)
             clipSamples <<= 1;
         
         // Clear clip buffer
-        int* clipPtr = clipBuffer_.Get();
-        memset(clipPtr, 0, clipSamples * sizeof(int));
+        float* clipPtr = clipBuffer_.Get();
+        memset(clipPtr, 0, clipSamples * sizeof(float));
         
         // Mix samples to clip buffer
         for (PODVector<SoundSource*>::Iterator i = soundSources_.Begin(); i != soundSources_.End(); ++i)
             (*i)->Mix(clipPtr, workSamples, mixRate_, stereo_, interpolation_);
         
         // Copy output from clip buffer to destination
-        short* destPtr = (short*)dest;
-        while (clipSamples--)
-            *destPtr++ = Clamp(*clipPtr++, -32768, 32767);
+        ClipSamples((short*)dest, clipPtr, clipSamples);
         
         samples -= workSamples;
-        ((unsigned char*&)destPtr) += sampleSize_ * workSamples;
+        dest = (unsigned char*)dest + sampleSize_ * workSamples;
     }
 }
 
@@ -261,6 +412,52 @@ void Audio::HandleRenderUpdate(StringHash eventType, VariantMap& eventData)
     Update(eventData[P_TIMESTEP].GetFloat());
 }
 
+void Audio::UpdateVoices()
+{
+    PROFILE(UpdateVoices);
+    
+    // Copy the sources, then choose the voices without holding the audio mutex, so that the mixing thread is not
+    // blocked by the sort
+    {
+        MutexLock lock(audioMutex_);
+        voices_ = soundSources_;
+    }
+    
+    // Move the audible playing sources to the front. Inaudible sources are always virtualized
+    unsigned numAudible = 0;
+    for (unsigned i = 0; i < voices_.Size(); ++i)
+    {
+        SoundSource* source = voices_[i];
+        if (source->IsPlaying() && source->GetAudibleGain() >= MIN_AUDIBLE_GAIN)
+            Swap(voices_[i], voices_[numAudible++]);
+    }
+    
+    // If over the voice limit, mix only the loudest and highest priority sources
+    unsigned numMixed = numAudible;
+    if (maxVoices_ && numAudible > maxVoices_)
+    {
+        Sort(voices_.Begin(), voices_.Begin() + numAudible, CompareVoices);
+        numMixed = maxVoices_;
+    }
+    
+    // The mixing thread reads the virtualized flags, so assign them under the audio mutex. Sources that start playing
+    // before the next update are mixed, so that new sounds are not delayed
+    MutexLock lock(audioMutex_);
+    
+    numVirtualVoices_ = 0;
+    for (unsigned i = 0; i < voices_.Size(); ++i)
+    {
+        SoundSource* source = voices_[i];
+        bool virtualize = i >= numMixed && source->IsPlaying();
+        source->SetVirtual(virtualize);
+        if (virtualize)
+            ++numVirtualVoices_;
+    }
+    
+    voices_.Resize(numMixed);
+    numVoices_ = numMixed;
+}
+
 void Audio::Release()
 {
     Stop();
@@ -271,8 +468,9 @@ void Audio::Release()
         
         SDL_CloseAudioDevice(deviceID_);
         deviceID_ = 0;
-        clipBuffer_.Reset();
     }
+    
+    clipBuffer_.Reset();
 }
 
 void RegisterAudioLibrary(Context* context)
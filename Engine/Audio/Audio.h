@@ -34,6 +34,8 @@ class AudioImpl;
 class Sound;
 class SoundListener;
 class SoundSource;
+class SoundStream;
+class StreamThread;
 
 /// %Audio subsystem.
 class Audio : public Object
@@ -48,6 +50,8 @@ public:
 
     /// Initialize sound output with specified buffer length and output mode.
     bool SetMode(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation = true);
+    /// Initialize mixing without an output device. MixOutput() must then be called manually, for example to render audio offline or to measure mixing performance.
+    void SetOfflineMode(int mixRate, bool stereo, bool interpolation = true);
     /// Run update on sound sources. Not required for continued playback, but frees unused sound sources & sounds and updates 3D positions.
     void Update(float timeStep);
     /// Restart sound output.
@@ -60,6 +64,8 @@ public:
     void SetListener(SoundListener* listener);
     /// Stop any sound source playing a certain sound clip.
     void StopSound(Sound* sound);
+    /// Set maximum number of sound sources mixed at once. The rest of the playing sources are virtualized, meaning their playback advances without being mixed. Zero is unlimited.
+    void SetMaxVoices(unsigned num);
 
     /// Return byte size of one sample.
     unsigned GetSampleSize() const { return sampleSize_; }
@@ -71,19 +77,31 @@ public:
     bool IsStereo() const { return stereo_; }
     /// Return whether audio is being output.
     bool IsPlaying() const { return playing_; }
-    /// Return whether an audio stream has been reserved.
-    bool IsInitialized() const { return deviceID_ != 0; }
+    /// Return whether an audio stream has been reserved or offline mixing has been initialized.
+    bool IsInitialized() const { return clipBuffer_.NotNull(); }
     /// Return master gain for a specific sound source type.
     float GetMasterGain(SoundType type) const;
     /// Return active sound listener.
     SoundListener* GetListener() const;
     /// Return all sound sources.
     const PODVector<SoundSource*>& GetSoundSources() const { return soundSources_; }
+    /// Return maximum number of sound sources mixed at once.
+    unsigned GetMaxVoices() const { return maxVoices_; }
+    /// Return number of sound sources chosen for mixing in the last update.
+    unsigned GetNumVoices() const { return numVoices_; }
+    /// Return number of playing sound sources virtualized in the last update.
+    unsigned GetNumVirtualVoices() const { return numVirtualVoices_; }
 
     /// Add a sound source to keep track of. Called by SoundSource.
     void AddSoundSource(SoundSource* soundSource);
     /// Remove a sound source. Called by SoundSource.
     void RemoveSoundSource(SoundSource* soundSource);
+    /// Add a sound stream to be decoded ahead in the stream thread. Called by SoundSource.
+    void AddSoundStream(SoundStream* stream);
+    /// Remove a sound stream. Waits for the stream thread to finish an ongoing update. Called by SoundSource.
+    void RemoveSoundStream(SoundStream* stream);
+    /// Decode ahead all sound streams. Called from the stream thread, and also before mixing in offline mode.
+    void UpdateSoundStreams();
     /// Return audio thread mutex.
     Mutex& GetMutex() { return audioMutex_; }
     /// Return sound type specific gain multiplied by master gain.
@@ -97,9 +115,11 @@ private:
     void HandleRenderUpdate(StringHash eventType, VariantMap& eventData);
     /// Stop sound output and release the sound buffer.
     void Release();
+    /// Choose the sound sources to mix by audible gain and priority, and virtualize the rest.
+    void UpdateVoices();
 
-    /// Clipping buffer for mixing.
-    SharedArrayPtr<int> clipBuffer_;
+    /// Floating point clipping buffer for mixing.
+    SharedArrayPtr<float> clipBuffer_;
     /// Audio thread mutex.
     Mutex audioMutex_;
     /// SDL audio device ID.
@@ -120,6 +140,20 @@ private:
     float masterGain_[MAX_SOUND_TYPES];
     /// Sound sources.
     PODVector<SoundSource*> soundSources_;
+    /// Sound sources chosen for mixing.
+    PODVector<SoundSource*> voices_;
+    /// Maximum number of mixed sound sources.
+    unsigned maxVoices_;
+    /// Number of mixed sound sources in the last update.
+    unsigned numVoices_;
+    /// Number of virtualized sound sources in the last update.
+    unsigned numVirtualVoices_;
+    /// Sound streams being decoded.
+    PODVector<SoundStream*> soundStreams_;
+    /// Sound stream mutex.
+    Mutex streamMutex_;
+    /// Sound stream decoding thread.
+    StreamThread* streamThread_;
     /// Sound listener.
     WeakPtr<SoundListener> listener_;
 };
@@ -27,6 +27,7 @@
 #include "Profiler.h"
 #include "ResourceCache.h"
 #include "Sound.h"
+#include "SoundStream.h"
 #include "XMLFile.h"
 
 #include <cstring>
@@ -56,6 +57,35 @@ struct WavHeader
 };
 
 static const unsigned IP_SAFETY = 4;
+static const unsigned OGG_MAX_PAGE_SIZE = 65307;
+
+/// Return Ogg Vorbis stream length in seconds from the granule position of the last Ogg page.
+static float GetOggVorbisLength(Deserializer& source, unsigned sampleRate)
+{
+    unsigned size = source.GetSize();
+    unsigned start = size > OGG_MAX_PAGE_SIZE ? size - OGG_MAX_PAGE_SIZE : 0;
+    PODVector<unsigned char> tail(size - start);
+    if (tail.Empty() || !sampleRate)
+        return 0.0f;
+    
+    source.Seek(start);
+    source.Read(&tail[0], tail.Size());
+    
+    // Search backwards for a page header with a valid granule position, which is a 64-bit little-endian sample count
+    for (int i = (int)tail.Size() - 14; i >= 0; --i)
+    {
+        if (tail[i] == 'O' && tail[i + 1] == 'g' && tail[i + 2] == 'g' && tail[i + 3] == 'S')
+        {
+            unsigned long long granule = 0;
+            for (int j = 7; j >= 0; --j)
+                granule = (granule << 8) | tail[i + 6 + j];
+            if (granule != (unsigned long long)-1)
+                return (float)((double)granule / sampleRate);
+        }
+    }
+    
+    return 0.0f;
+}
 
 OBJECTTYPESTATIC(Sound);
 
@@ -68,6 +98,7 @@ Sound::Sound(Context* context) :
     sixteenBit_(false),
     stereo_(false),
     compressed_(false),
+    streaming_(false),
     compressedLength_(0.0f)
 {
 }
@@ -87,7 +118,12 @@ bool Sound::Load(Deserializer& source)
     
     bool success = false;
     if (GetExtension(source.GetName()) == ".ogg")
+    {
+        // Check first whether the sound should be streamed from disk, as then only the headers are read now
+        XMLFile* file = GetParametersFile();
+        streaming_ = file && file->GetRoot().GetChild("stream").GetBool("enable");
         success = LoadOggVorbis(source);
+    }
     else if (GetExtension(source.GetName()) == ".wav")
         success = LoadWav(source);
     else
@@ -102,6 +138,43 @@ bool Sound::Load(Deserializer& source)
 
 bool Sound::LoadOggVorbis(Deserializer& source)
 {
+    if (streaming_)
+    {
+        // Read until the headers can be parsed. The sound data will be read in chunks during playback
+        PODVector<unsigned char> header;
+        stb_vorbis* vorbis = 0;
+        int used;
+        int error = VORBIS_need_more_data;
+        while (!vorbis && error == VORBIS_need_more_data && !source.IsEof())
+        {
+            unsigned oldSize = header.Size();
+            header.Resize(oldSize + STREAM_READ_SIZE);
+            header.Resize(oldSize + source.Read(&header[oldSize], STREAM_READ_SIZE));
+            if (header.Empty())
+                break;
+            vorbis = stb_vorbis_open_pushdata(&header[0], header.Size(), &used, &error, 0);
+        }
+        if (!vorbis)
+        {
+            LOGERROR("Could not read Ogg Vorbis data from " + source.GetName());
+            return false;
+        }
+        
+        stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+        frequency_ = info.sample_rate;
+        stereo_ = info.channels > 1;
+        compressedLength_ = GetOggVorbisLength(source, frequency_);
+        stb_vorbis_close(vorbis);
+        
+        data_.Reset();
+        dataSize_ = 0;
+        sixteenBit_ = true;
+        compressed_ = true;
+        
+        SetMemoryUse(header.Size());
+        return true;
+    }
+    
     unsigned dataSize = source.GetSize();
     SharedArrayPtr<signed char> data(new signed char[dataSize]);
     source.Read(data.Get(), dataSize);
@@ -228,6 +301,7 @@ void Sound::SetSize(unsigned dataSize)
     data_ = new signed char[dataSize + IP_SAFETY];
     dataSize_ = dataSize;
     compressed_ = false;
+    streaming_ = false;
     SetLooped(false);
     
     SetMemoryUse(dataSize + IP_SAFETY);
@@ -312,7 +386,7 @@ void Sound::FixInterpolation()
 
 void* Sound::AllocateDecoder()
 {
-    if (!compressed_)
+    if (!compressed_ || !data_)
         return 0;
     
     int error;
@@ -372,15 +446,20 @@ unsigned Sound::GetSampleSize() const
     return size;
 }
 
-void Sound::LoadParameters()
+XMLFile* Sound::GetParametersFile()
 {
     ResourceCache* cache = GetSubsystem<ResourceCache>();
     String xmlName = ReplaceExtension(GetName(), ".xml");
     
     if (!cache->Exists(xmlName))
-        return;
+        return 0;
     
-    XMLFile* file = cache->GetResource<XMLFile>(xmlName);
+    return cache->GetResource<XMLFile>(xmlName);
+}
+
+void Sound::LoadParameters()
+{
+    XMLFile* file = GetParametersFile();
     if (!file)
         return;
     
@@ -28,6 +28,8 @@
 namespace Urho3D
 {
 
+class XMLFile;
+
 /// %Sound resource.
 class Sound : public Resource
 {
@@ -48,7 +50,7 @@ public:
     bool LoadRaw(Deserializer& source);
     /// Load WAV format sound data.
     bool LoadWav(Deserializer& source);
-    /// Load Ogg Vorbis format sound data. Does not decode at load, but will rather be decoded while playing.
+    /// Load Ogg Vorbis format sound data. Does not decode at load, but will rather be decoded while playing. If streaming, reads only the headers.
     bool LoadOggVorbis(Deserializer& source);
     /// Set sound size in bytes. Also resets the sound to be uncompressed and one-shot.
     void SetSize(unsigned dataSize);
@@ -96,8 +98,12 @@ public:
     bool IsStereo() const { return stereo_; }
     /// Return whether is compressed in Ogg Vorbis format.
     bool IsCompressed() const { return compressed_; }
+    /// Return whether is streamed from disk during playback instead of being held in memory.
+    bool IsStreaming() const { return streaming_; }
     
 private:
+    /// Return the optional parameter XML file, or null if does not exist.
+    XMLFile* GetParametersFile();
     /// Load optional parameters from an XML file.
     void LoadParameters();
     
@@ -119,6 +125,8 @@ private:
     bool stereo_;
     /// Compressed flag.
     bool compressed_;
+    /// Streaming flag.
+    bool streaming_;
     /// Compressed sound length.
     float compressedLength_;
 };
@@ -26,69 +26,246 @@
 #include "ResourceCache.h"
 #include "Sound.h"
 #include "SoundSource.h"
+#include "SoundStream.h"
 
 #include <cstring>
 
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+
 #include "DebugNew.h"
 
 namespace Urho3D
 {
 
-#define INC_POS_LOOPED() \
-    pos += intAdd; \
-    fractPos += fractAdd; \
-    if (fractPos > 65535) \
-    { \
-        fractPos &= 65535; \
-        ++pos; \
-    } \
-    while (pos >= end) \
-        pos -= (end - repeat); \
-
-#define INC_POS_ONESHOT() \
-    pos += intAdd; \
-    fractPos += fractAdd; \
-    if (fractPos > 65535) \
-    { \
-        fractPos &= 65535; \
-        ++pos; \
-    } \
-    if (pos >= end) \
-    { \
-        pos = 0; \
-        break; \
-    } \
-
-#define INC_POS_STEREO_LOOPED() \
-    pos += (intAdd << 1); \
-    fractPos += fractAdd; \
-    if (fractPos > 65535) \
-    { \
-        fractPos &= 65535; \
-        pos += 2; \
-    } \
-    while (pos >= end) \
-        pos -= (end - repeat); \
-
-#define INC_POS_STEREO_ONESHOT() \
-    pos += (intAdd << 1); \
-    fractPos += fractAdd; \
-    if (fractPos > 65535) \
-    { \
-        fractPos &= 65535; \
-        pos += 2; \
-    } \
-    if (pos >= end) \
-    { \
-        pos = 0; \
-        break; \
-    } \
-
-#define GET_IP_SAMPLE() (((((int)pos[1] - (int)pos[0]) * fractPos) / 65536) + (int)pos[0])
-
-#define GET_IP_SAMPLE_LEFT() (((((int)pos[2] - (int)pos[0]) * fractPos) / 65536) + (int)pos[0])
-
-#define GET_IP_SAMPLE_RIGHT() (((((int)pos[3] - (int)pos[1]) * fractPos) / 65536) + (int)pos[1])
+/// Number of output frames fetched from a sound at a time for mixing.
+static const unsigned MIX_CHUNK_FRAMES = 256;
+
+/// Convert contiguous 16-bit samples to float.
+static void ConvertSamples(float* dest, const short* src, unsigned count)
+{
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        // Sign-extend by unpacking to the high half of each 32-bit lane and shifting back down
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(dest + i, _mm_cvtepi32_ps(low));
+        _mm_storeu_ps(dest + i + 4, _mm_cvtepi32_ps(high));
+    }
+#elif defined(USE_NEON)
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t s = vld1q_s16(src + i);
+        vst1q_f32(dest + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))));
+        vst1q_f32(dest + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))));
+    }
+#endif
+    for (; i < count; ++i)
+        dest[i] = (float)src[i];
+}
+
+/// Convert contiguous 8-bit samples to float.
+static void ConvertSamples(float* dest, const signed char* src, unsigned count)
+{
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i low = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+        __m128i high = _mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8);
+        _mm_storeu_ps(dest + i, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(low, low), 16)));
+        _mm_storeu_ps(dest + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(low, low), 16)));
+        _mm_storeu_ps(dest + i + 8, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(high, high), 16)));
+        _mm_storeu_ps(dest + i + 12, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(high, high), 16)));
+    }
+#elif defined(USE_NEON)
+    for (; i + 16 <= count; i += 16)
+    {
+        int8x16_t s = vld1q_s8(src + i);
+        int16x8_t low = vmovl_s8(vget_low_s8(s));
+        int16x8_t high = vmovl_s8(vget_high_s8(s));
+        vst1q_f32(dest + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(low))));
+        vst1q_f32(dest + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(low))));
+        vst1q_f32(dest + i + 8, vcvtq_f32_s32(vmovl_s16(vget_low_s16(high))));
+        vst1q_f32(dest + i + 12, vcvtq_f32_s32(vmovl_s16(vget_high_s16(high))));
+    }
+#endif
+    for (; i < count; ++i)
+        dest[i] = (float)src[i];
+}
+
+/// Fetch resampled mono frames as float, stepping the 16.16 fixed point position.
+template <class T> static void FetchMonoSamples(float* dest, const T* src, unsigned fractPos, unsigned step, unsigned count,
+    bool interpolation)
+{
+    if (interpolation)
+    {
+        unsigned i = 0;
+#if defined(USE_SSE2)
+        // Gather four frames at a time, then interpolate them together
+        __m128i fract = _mm_setr_epi32(fractPos, fractPos + step, fractPos + 2 * step, fractPos + 3 * step);
+        __m128i fractAdd = _mm_set1_epi32(step * 4);
+        __m128i fractMask = _mm_set1_epi32(65535);
+        __m128 fractScale = _mm_set1_ps(1.0f / 65536.0f);
+        for (; i + 4 <= count; i += 4)
+        {
+            const T* p0 = src + (fractPos >> 16);
+            const T* p1 = src + ((fractPos + step) >> 16);
+            const T* p2 = src + ((fractPos + 2 * step) >> 16);
+            const T* p3 = src + ((fractPos + 3 * step) >> 16);
+            __m128 s0 = _mm_cvtepi32_ps(_mm_setr_epi32(p0[0], p1[0], p2[0], p3[0]));
+            __m128 s1 = _mm_cvtepi32_ps(_mm_setr_epi32(p0[1], p1[1], p2[1], p3[1]));
+            __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(fract, fractMask)), fractScale);
+            _mm_storeu_ps(dest + i, _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), t)));
+            fract = _mm_add_epi32(fract, fractAdd);
+            fractPos += step * 4;
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            const T* pos = src + (fractPos >> 16);
+            float t = (float)(fractPos & 65535) * (1.0f / 65536.0f);
+            dest[i] = (float)pos[0] + (float)(pos[1] - pos[0]) * t;
+            fractPos += step;
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            dest[i] = (float)src[fractPos >> 16];
+            fractPos += step;
+        }
+    }
+}
+
+/// Fetch resampled stereo frames as interleaved float, stepping the 16.16 fixed point position.
+template <class T> static void FetchStereoSamples(float* dest, const T* src, unsigned fractPos, unsigned step, unsigned count,
+    bool interpolation)
+{
+    if (interpolation)
+    {
+        unsigned i = 0;
+#if defined(USE_SSE2)
+        // Gather two interleaved frames at a time, then interpolate them together
+        __m128 fractScale = _mm_set1_ps(1.0f / 65536.0f);
+        for (; i + 2 <= count; i += 2)
+        {
+            unsigned fractNext = fractPos + step;
+            const T* p0 = src + ((fractPos >> 16) << 1);
+            const T* p1 = src + ((fractNext >> 16) << 1);
+            __m128 s0 = _mm_cvtepi32_ps(_mm_setr_epi32(p0[0], p0[1], p1[0], p1[1]));
+            __m128 s1 = _mm_cvtepi32_ps(_mm_setr_epi32(p0[2], p0[3], p1[2], p1[3]));
+            int t0 = fractPos & 65535;
+            int t1 = fractNext & 65535;
+            __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(t0, t0, t1, t1)), fractScale);
+            _mm_storeu_ps(dest + (i << 1), _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), t)));
+            fractPos = fractNext + step;
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            const T* pos = src + ((fractPos >> 16) << 1);
+            float t = (float)(fractPos & 65535) * (1.0f / 65536.0f);
+            dest[i << 1] = (float)pos[0] + (float)(pos[2] - pos[0]) * t;
+            dest[(i << 1) + 1] = (float)pos[1] + (float)(pos[3] - pos[1]) * t;
+            fractPos += step;
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            const T* pos = src + ((fractPos >> 16) << 1);
+            dest[i << 1] = (float)pos[0];
+            dest[(i << 1) + 1] = (float)pos[1];
+            fractPos += step;
+        }
+    }
+}
+
+/// Scale samples and add them to the same number of mixing buffer samples.
+static void MixMonoToMono(float* dest, const float* src, unsigned count, float gain)
+{
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+#elif defined(USE_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dest + i, vmlaq_f32(vld1q_f32(dest + i), vld1q_f32(src + i), g));
+#endif
+    for (; i < count; ++i)
+        dest[i] += src[i] * gain;
+}
+
+/// Scale mono samples with separate left and right gains and add them to a stereo mixing buffer.
+static void MixMonoToStereo(float* dest, const float* src, unsigned count, float leftGain, float rightGain)
+{
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    __m128 g = _mm_setr_ps(leftGain, rightGain, leftGain, rightGain);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 s = _mm_loadu_ps(src + i);
+        float* d = dest + (i << 1);
+        _mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d), _mm_mul_ps(_mm_unpacklo_ps(s, s), g)));
+        _mm_storeu_ps(d + 4, _mm_add_ps(_mm_loadu_ps(d + 4), _mm_mul_ps(_mm_unpackhi_ps(s, s), g)));
+    }
+#elif defined(USE_NEON)
+    float32x4_t lg = vdupq_n_f32(leftGain);
+    float32x4_t rg = vdupq_n_f32(rightGain);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t s = vld1q_f32(src + i);
+        float32x4x2_t d = vld2q_f32(dest + (i << 1));
+        d.val[0] = vmlaq_f32(d.val[0], s, lg);
+        d.val[1] = vmlaq_f32(d.val[1], s, rg);
+        vst2q_f32(dest + (i << 1), d);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        dest[i << 1] += src[i] * leftGain;
+        dest[(i << 1) + 1] += src[i] * rightGain;
+    }
+}
+
+/// Average interleaved stereo frames, scale them and add them to a mono mixing buffer.
+static void MixStereoToMono(float* dest, const float* src, unsigned count, float gain)
+{
+    gain *= 0.5f;
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(src + (i << 1));
+        __m128 b = _mm_loadu_ps(src + (i << 1) + 4);
+        __m128 sum = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(sum, g)));
+    }
+#elif defined(USE_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4x2_t s = vld2q_f32(src + (i << 1));
+        vst1q_f32(dest + i, vmlaq_f32(vld1q_f32(dest + i), vaddq_f32(s.val[0], s.val[1]), g));
+    }
+#endif
+    for (; i < count; ++i)
+        dest[i] += (src[i << 1] + src[(i << 1) + 1]) * gain;
+}
 
 static const char* typeNames[] =
 {
@@ -112,13 +289,15 @@ SoundSource::SoundSource(Context* context) :
     gain_(1.0f),
     attenuation_(1.0f),
     panning_(0.0f),
+    priority_(1.0f),
     autoRemoveTimer_(0.0f),
     autoRemove_(false),
     position_(0),
     fractPosition_(0),
     timePosition_(0.0f),
-    decoder_(0),
-    decodePosition_(0)
+    virtual_(false),
+    decodePosition_(0),
+    decodeEndPosition_(M_MAX_UNSIGNED)
 {
     audio_ = GetSubsystem<Audio>();
 
@@ -144,6 +323,7 @@ void SoundSource::RegisterObject(Context* context)
     ATTRIBUTE(SoundSource, VAR_FLOAT, "Gain", gain_, 1.0f, AM_DEFAULT);
     ATTRIBUTE(SoundSource, VAR_FLOAT, "Attenuation", attenuation_, 1.0f, AM_DEFAULT);
     ATTRIBUTE(SoundSource, VAR_FLOAT, "Panning", panning_, 0.0f, AM_DEFAULT);
+    ATTRIBUTE(SoundSource, VAR_FLOAT, "Priority", priority_, 1.0f, AM_DEFAULT);
     ATTRIBUTE(SoundSource, VAR_BOOL, "Autoremove on Stop", autoRemove_, false, AM_FILE);
     ACCESSOR_ATTRIBUTE(SoundSource, VAR_RESOURCEREF, "Sound", GetSoundAttr, SetSoundAttr, ResourceRef, ResourceRef(Sound::GetTypeStatic()), AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(SoundSource, VAR_INT, "Play Position", GetPositionAttr, SetPositionAttr, int, 0, AM_FILE);
@@ -158,6 +338,9 @@ void SoundSource::Play(Sound* sound)
     if (frequency_ == 0.0f && sound)
         SetFrequency(sound->GetFrequency());
 
+    if (sound)
+        OnPlay();
+
     // If sound source is currently playing, have to lock the audio mutex
     if (position_)
     {
@@ -243,6 +426,12 @@ void SoundSource::SetPanning(float panning)
     MarkNetworkUpdate();
 }
 
+void SoundSource::SetPriority(float priority)
+{
+    priority_ = Max(priority, 0.0f);
+    MarkNetworkUpdate();
+}
+
 void SoundSource::SetAutoRemove(bool enable)
 {
     autoRemove_ = enable;
@@ -253,6 +442,11 @@ bool SoundSource::IsPlaying() const
     return sound_.Get() != 0;
 }
 
+float SoundSource::GetAudibleGain() const
+{
+    return audio_ ? audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_ : 0.0f;
+}
+
 void SoundSource::SetPlayPosition(signed char* pos)
 {
     if (!audio_ || !sound_)
@@ -286,20 +480,25 @@ void SoundSource::PlayLockless(Sound* sound)
         else
         {
             // Compressed sound start
-            if (sound == sound_)
+            if (sound == sound_ && stream_)
             {
-                // If same compressed sound is already playing, rewind the Decoder
-                sound_->RewindDecoder(decoder_);
-                return;
+                // If same compressed sound is already playing, rewind the stream
+                stream_->Rewind();
             }
             else
             {
-                // Else just set the new sound with a dummy start position. The mixing routine will allocate the new Decoder
+                // Else set up a new stream, which will be decoded ahead in the audio subsystem's stream thread
                 FreeDecoder();
                 sound_ = sound;
-                position_ = sound->GetStart();
-                return;
+                AllocateDecoder();
             }
+
+            // Play the decode buffer, which the mixing routine fills once the stream has been decoded
+            decodePosition_ = M_MAX_UNSIGNED;
+            decodeEndPosition_ = M_MAX_UNSIGNED;
+            position_ = decodeBuffer_->GetStart();
+            fractPosition_ = 0;
+            return;
         }
     }
 
@@ -368,44 +567,41 @@ void SoundSource::Update(float timeStep)
     }
 }
 
-void SoundSource::Mix(int* dest, unsigned samples, int mixRate, bool stereo, bool interpolation)
+void SoundSource::Mix(float* dest, unsigned samples, int mixRate, bool stereo, bool interpolation)
 {
     if (!position_ || !sound_ || !IsEnabledEffective())
         return;
 
     if (sound_->IsCompressed())
     {
-        if (decoder_)
+        if (!decodeBuffer_)
+            return;
+
+        if (decodePosition_ == M_MAX_UNSIGNED)
         {
-            // If Decoder already exists, decode new compressed audio
-            bool eof = false;
+            // Wait until the stream thread has decoded enough audio to fill the decode buffer, then start playback
+            if (stream_->GetAvailableSize() < decodeBuffer_->GetDataSize() && !stream_->IsEof())
+                return;
+
+            ReadDecodeBuffer(0, decodeBuffer_->GetDataSize());
+            decodeBuffer_->FixInterpolation();
+            decodePosition_ = 0;
+        }
+        else
+        {
+            // Read new decoded audio from the stream up to the current play position
             unsigned currentPos = position_ - decodeBuffer_->GetStart();
             if (currentPos != decodePosition_)
             {
-                // If buffer has wrapped, decode first to the end
+                // If buffer has wrapped, read first to the end
                 if (currentPos < decodePosition_)
                 {
-                    unsigned bytes = decodeBuffer_->GetDataSize() - decodePosition_;
-                    unsigned outBytes = sound_->Decode(decoder_, decodeBuffer_->GetStart() + decodePosition_, bytes);
-                    // If produced less output, end of sound encountered. Fill rest with zero
-                    if (outBytes < bytes)
-                    {
-                        memset(decodeBuffer_->GetStart() + decodePosition_ + outBytes, 0, bytes - outBytes);
-                        eof = true;
-                    }
+                    ReadDecodeBuffer(decodePosition_, decodeBuffer_->GetDataSize() - decodePosition_);
                     decodePosition_ = 0;
                 }
                 if (currentPos > decodePosition_)
                 {
-                    unsigned bytes = currentPos - decodePosition_;
-                    unsigned outBytes = sound_->Decode(decoder_, decodeBuffer_->GetStart() + decodePosition_, bytes);
-                    // If produced less output, end of sound encountered. Fill rest with zero
-                    if (outBytes < bytes)
-                    {
-                        memset(decodeBuffer_->GetStart() + decodePosition_ + outBytes, 0, bytes - outBytes);
-                        if (sound_->IsLooped())
-                            eof = true;
-                    }
+                    ReadDecodeBuffer(decodePosition_, currentPos - decodePosition_);
 
                     // If wrote to buffer start, correct interpolation wraparound
                     if (!decodePosition_)
@@ -413,40 +609,8 @@ void SoundSource::Mix(int* dest, unsigned samples, int mixRate, bool stereo, boo
                 }
             }
 
-            // If end of stream encountered, check whether we should rewind or stop
-            if (eof)
-            {
-                if (sound_->IsLooped())
-                {
-                    sound_->RewindDecoder(decoder_);
-                    timePosition_ = 0.0f;
-                }
-                else
-                    decodeBuffer_->SetLooped(false); // Stop after the current decode buffer has been played
-            }
-
             decodePosition_ = currentPos;
         }
-        else
-        {
-            // Setup the decoder and decode buffer
-            decoder_ = sound_->AllocateDecoder();
-            unsigned sampleSize = sound_->GetSampleSize();
-            unsigned DecodeBufferSize = sampleSize * sound_->GetIntFrequency() * DECODE_BUFFER_LENGTH / 1000;
-            decodeBuffer_ = new Sound(context_);
-            decodeBuffer_->SetSize(DecodeBufferSize);
-            decodeBuffer_->SetFormat(sound_->GetIntFrequency(), true, sound_->IsStereo());
-
-            // Clear the decode buffer, then fill with initial audio data and set it to loop
-            memset(decodeBuffer_->GetStart(), 0, DecodeBufferSize);
-            sound_->Decode(decoder_, decodeBuffer_->GetStart(), DecodeBufferSize);
-            decodeBuffer_->SetLooped(true);
-            decodePosition_ = 0;
-
-            // Start playing the decode buffer
-            position_ = decodeBuffer_->GetStart();
-            fractPosition_ = 0;
-        }
     }
 
     // If compressed, play the decode buffer. Otherwise play the original sound
@@ -454,47 +618,30 @@ void SoundSource::Mix(int* dest, unsigned samples, int mixRate, bool stereo, boo
     if (!sound)
         return;
 
-    // Choose the correct mixing routine
-    if (!sound->IsStereo())
-    {
-        if (interpolation)
-        {
-            if (stereo)
-                MixMonoToStereoIP(sound, dest, samples, mixRate);
-            else
-                MixMonoToMonoIP(sound, dest, samples, mixRate);
-        }
-        else
-        {
-            if (stereo)
-                MixMonoToStereo(sound, dest, samples, mixRate);
-            else
-                MixMonoToMono(sound, dest, samples, mixRate);
-        }
-    }
+    // If virtualized, only advance the playback position
+    if (!virtual_)
+        MixSamples(sound, dest, samples, mixRate, stereo, interpolation);
     else
+        MixZeroVolume(sound, samples, mixRate);
+
+    // The decode buffer always loops. Stop once playback has passed the end of a non-looped compressed sound
+    if (sound == decodeBuffer_ && decodeEndPosition_ != M_MAX_UNSIGNED)
     {
-        if (interpolation)
-        {
-            if (stereo)
-                MixStereoToStereoIP(sound, dest, samples, mixRate);
-            else
-                MixStereoToMonoIP(sound, dest, samples, mixRate);
-        }
-        else
-        {
-            if (stereo)
-                MixStereoToStereo(sound, dest, samples, mixRate);
-            else
-                MixStereoToMono(sound, dest, samples, mixRate);
-        }
+        unsigned size = decodeBuffer_->GetDataSize();
+        unsigned newPos = position_ - decodeBuffer_->GetStart();
+        if ((newPos + size - decodePosition_) % size >= (decodeEndPosition_ + size - decodePosition_) % size)
+            position_ = 0;
     }
 
     // Update the time position
     if (!sound_->IsCompressed())
         timePosition_ = ((float)(int)(size_t)(position_ - sound_->GetStart())) / (sound_->GetSampleSize() * sound_->GetFrequency());
     else
+    {
         timePosition_ += ((float)samples / (float)mixRate) * frequency_ / sound_->GetFrequency();
+        if (sound_->IsLooped() && timePosition_ >= sound_->GetLength())
+            timePosition_ -= sound_->GetLength();
+    }
 }
 
 void SoundSource::SetSoundAttr(ResourceRef value)
@@ -522,633 +669,121 @@ int SoundSource::GetPositionAttr() const
         return 0;
 }
 
-void SoundSource::MixMonoToMono(Sound* sound, int* dest, unsigned samples, int mixRate)
-{
-    float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int vol = (int)(256.0f * totalGain + 0.5f);
-    if (!vol)
-    {
-        MixZeroVolume(sound, samples, mixRate);
-        return;
-    }
-
-    float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
-
-    if (sound->IsSixteenBit())
-    {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                *dest = *dest + (*pos * vol) / 256;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = (signed char*)pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + (*pos * vol) / 256;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = (signed char*)pos;
-        }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                *dest = *dest + *pos * vol;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + *pos * vol;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = pos;
-        }
-    }
-
-    fractPosition_ = fractPos;
-}
-
-void SoundSource::MixMonoToStereo(Sound* sound, int* dest, unsigned samples, int mixRate)
-{
-    float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int leftVol = (int)((-panning_ + 1.0f) * (256.0f * totalGain + 0.5f));
-    int rightVol = (int)((panning_ + 1.0f) * (256.0f * totalGain + 0.5f));
-    if (!leftVol && !rightVol)
-    {
-        MixZeroVolume(sound, samples, mixRate);
-        return;
-    }
-
-    float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
-
-    if (sound->IsSixteenBit())
-    {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                *dest = *dest + (*pos * leftVol) / 256;
-                ++dest;
-                *dest = *dest + (*pos * rightVol) / 256;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = (signed char*)pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + (*pos * leftVol) / 256;
-                ++dest;
-                *dest = *dest + (*pos * rightVol) / 256;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = (signed char*)pos;
-        }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                *dest = *dest + *pos * leftVol;
-                ++dest;
-                *dest = *dest + *pos * rightVol;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + *pos * leftVol;
-                ++dest;
-                *dest = *dest + *pos * rightVol;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = pos;
-        }
-    }
-
-    fractPosition_ = fractPos;
-}
-
-void SoundSource::MixMonoToMonoIP(Sound* sound, int* dest, unsigned samples, int mixRate)
-{
-    float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int vol = (int)(256.0f * totalGain + 0.5f);
-    if (!vol)
-    {
-        MixZeroVolume(sound, samples, mixRate);
-        return;
-    }
-
-    float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
-
-    if (sound->IsSixteenBit())
-    {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                *dest = *dest + (GET_IP_SAMPLE() * vol) / 256;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = (signed char*)pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + (GET_IP_SAMPLE() * vol) / 256;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = (signed char*)pos;
-        }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                *dest = *dest + GET_IP_SAMPLE() * vol;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + GET_IP_SAMPLE() * vol;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = pos;
-        }
-    }
-
-    fractPosition_ = fractPos;
-}
-
-void SoundSource::MixMonoToStereoIP(Sound* sound, int* dest, unsigned samples, int mixRate)
+void SoundSource::MixSamples(Sound* sound, float* dest, unsigned samples, int mixRate, bool stereo, bool interpolation)
 {
     float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int leftVol = (int)((-panning_ + 1.0f) * (256.0f * totalGain + 0.5f));
-    int rightVol = (int)((panning_ + 1.0f) * (256.0f * totalGain + 0.5f));
-    if (!leftVol && !rightVol)
+    float leftGain = totalGain;
+    float rightGain = totalGain;
+    // Panning applies only when mixing a mono sound to stereo output
+    if (stereo && !sound->IsStereo())
     {
-        MixZeroVolume(sound, samples, mixRate);
-        return;
+        leftGain = (-panning_ + 1.0f) * totalGain;
+        rightGain = (panning_ + 1.0f) * totalGain;
     }
-
-    float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
-
-    if (sound->IsSixteenBit())
-    {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                int s = GET_IP_SAMPLE();
-                *dest = *dest + (s * leftVol) / 256;
-                ++dest;
-                *dest = *dest + (s * rightVol) / 256;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = (signed char*)pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                int s = GET_IP_SAMPLE();
-                *dest = *dest + (s * leftVol) / 256;
-                ++dest;
-                *dest = *dest + (s * rightVol) / 256;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = (signed char*)pos;
-        }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                int s = GET_IP_SAMPLE();
-                *dest = *dest + s * leftVol;
-                ++dest;
-                *dest = *dest + s * rightVol;
-                ++dest;
-                INC_POS_LOOPED();
-            }
-            position_ = pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                int s = GET_IP_SAMPLE();
-                *dest = *dest + s * leftVol;
-                ++dest;
-                *dest = *dest + s * rightVol;
-                ++dest;
-                INC_POS_ONESHOT();
-            }
-            position_ = pos;
-        }
-    }
-
-    fractPosition_ = fractPos;
-}
-
-void SoundSource::MixStereoToMono(Sound* sound, int* dest, unsigned samples, int mixRate)
-{
-    float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int vol = (int)(256.0f * totalGain + 0.5f);
-    if (!vol)
+    if (Max(leftGain, rightGain) < 0.5f / 256.0f)
     {
         MixZeroVolume(sound, samples, mixRate);
         return;
     }
 
-    float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
-
-    if (sound->IsSixteenBit())
-    {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                int s = ((int)pos[0] + (int)pos[1]) / 2;
-                *dest = *dest + (s * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
-            }
-            position_ = (signed char*)pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                int s = ((int)pos[0] + (int)pos[1]) / 2;
-                *dest = *dest + (s * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
-            }
-            position_ = (signed char*)pos;
-        }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                int s = ((int)pos[0] + (int)pos[1]) / 2;
-                *dest = *dest + s * vol;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
-            }
-            position_ = pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                int s = ((int)pos[0] + (int)pos[1]) / 2;
-                *dest = *dest + s * vol;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
-            }
-            position_ = pos;
-        }
-    }
-
-    fractPosition_ = fractPos;
-}
-
-void SoundSource::MixStereoToStereo(Sound* sound, int* dest, unsigned samples, int mixRate)
-{
-    float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int vol = (int)(256.0f * totalGain + 0.5f);
-    if (!vol)
+    // 8-bit samples are scaled to the 16-bit range
+    if (!sound->IsSixteenBit())
     {
-        MixZeroVolume(sound, samples, mixRate);
-        return;
+        leftGain *= 256.0f;
+        rightGain *= 256.0f;
     }
 
     float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
+    unsigned step = ((unsigned)add << 16) + (unsigned)((add - floorf(add)) * 65536.0f);
+    unsigned fractPos = fractPosition_;
+    unsigned sampleSize = sound->GetSampleSize();
+    bool stereoSound = sound->IsStereo();
+    bool sixteenBit = sound->IsSixteenBit();
+    signed char* pos = (signed char*)position_;
+    signed char* end = sound->GetEnd();
+    signed char* repeat = sound->GetRepeat();
+    float buffer[MIX_CHUNK_FRAMES * 2];
 
-    if (sound->IsSixteenBit())
+    while (samples)
     {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
+        // Mix in chunks that do not cross the end of the sound, so that the sample fetch does not need to check for it
+        unsigned count = Min((int)samples, (int)MIX_CHUNK_FRAMES);
+        unsigned framesLeft = (unsigned)(end - pos) / sampleSize;
+        if (step)
         {
-            while (--samples)
-            {
-                *dest = *dest + (pos[0] * vol) / 256;
-                ++dest;
-                *dest = *dest + (pos[1] * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
-            }
-            position_ = (signed char*)pos;
+            unsigned long long endFract = ((unsigned long long)framesLeft << 16) - fractPos;
+            unsigned long long framesToEnd = (endFract + step - 1) / step;
+            if (framesToEnd < count)
+                count = (unsigned)framesToEnd;
         }
-        else
+        if (!count || !framesLeft)
         {
-            while (--samples)
-            {
-                *dest = *dest + (pos[0] * vol) / 256;
-                ++dest;
-                *dest = *dest + (pos[1] * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
-            }
-            position_ = (signed char*)pos;
+            pos = 0;
+            break;
         }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
 
-        if (sound->IsLooped())
+        // Fetch the samples as floats, then scale and add them to the mixing buffer
+        unsigned channels = stereoSound ? 2 : 1;
+        if (step == 65536 && !fractPos)
         {
-            while (--samples)
-            {
-                *dest = *dest + pos[0] * vol;
-                ++dest;
-                *dest = *dest + pos[1] * vol;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
-            }
-            position_ = pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + pos[0] * vol;
-                ++dest;
-                *dest = *dest + pos[1] * vol;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
-            }
-            position_ = pos;
+            if (sixteenBit)
+                ConvertSamples(buffer, (const short*)pos, count * channels);
+            else
+                ConvertSamples(buffer, (const signed char*)pos, count * channels);
         }
-    }
-
-    fractPosition_ = fractPos;
-}
-
-void SoundSource::MixStereoToMonoIP(Sound* sound, int* dest, unsigned samples, int mixRate)
-{
-    float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int vol = (int)(256.0f * totalGain + 0.5f);
-    if (!vol)
-    {
-        MixZeroVolume(sound, samples, mixRate);
-        return;
-    }
-
-    float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
-
-    if (sound->IsSixteenBit())
-    {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
+        else if (stereoSound)
         {
-            while (--samples)
-            {
-                int s = (GET_IP_SAMPLE_LEFT() + GET_IP_SAMPLE_RIGHT()) / 2;
-                *dest = *dest + (s * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
-            }
-            position_ = (signed char*)pos;
+            if (sixteenBit)
+                FetchStereoSamples(buffer, (const short*)pos, fractPos, step, count, interpolation);
+            else
+                FetchStereoSamples(buffer, (const signed char*)pos, fractPos, step, count, interpolation);
         }
         else
         {
-            while (--samples)
-            {
-                int s = (GET_IP_SAMPLE_LEFT() + GET_IP_SAMPLE_RIGHT()) / 2;
-                *dest = *dest + (s * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
-            }
-            position_ = (signed char*)pos;
+            if (sixteenBit)
+                FetchMonoSamples(buffer, (const short*)pos, fractPos, step, count, interpolation);
+            else
+                FetchMonoSamples(buffer, (const signed char*)pos, fractPos, step, count, interpolation);
         }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
 
-        if (sound->IsLooped())
+        if (!stereoSound)
         {
-            while (--samples)
-            {
-                int s = (GET_IP_SAMPLE_LEFT() + GET_IP_SAMPLE_RIGHT()) / 2;
-                *dest = *dest + s * vol;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
-            }
-            position_ = pos;
+            if (stereo)
+                MixMonoToStereo(dest, buffer, count, leftGain, rightGain);
+            else
+                MixMonoToMono(dest, buffer, count, leftGain);
         }
         else
         {
-            while (--samples)
-            {
-                int s = (GET_IP_SAMPLE_LEFT() + GET_IP_SAMPLE_RIGHT()) / 2;
-                *dest = *dest + s * vol;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
-            }
-            position_ = pos;
+            if (stereo)
+                MixMonoToMono(dest, buffer, count * 2, leftGain);
+            else
+                MixStereoToMono(dest, buffer, count, leftGain);
         }
-    }
 
-    fractPosition_ = fractPos;
-}
+        dest += stereo ? count * 2 : count;
+        samples -= count;
 
-void SoundSource::MixStereoToStereoIP(Sound* sound, int* dest, unsigned samples, int mixRate)
-{
-    float totalGain = audio_->GetSoundSourceMasterGain(soundType_) * attenuation_ * gain_;
-    int vol = (int)(256.0f * totalGain + 0.5f);
-    if (!vol)
-    {
-        MixZeroVolume(sound, samples, mixRate);
-        return;
-    }
-
-    float add = frequency_ / (float)mixRate;
-    int intAdd = (int)add;
-    int fractAdd = (int)((add - floorf(add)) * 65536.0f);
-    int fractPos = fractPosition_;
-
-    if (sound->IsSixteenBit())
-    {
-        short* pos = (short*)position_;
-        short* end = (short*)sound->GetEnd();
-        short* repeat = (short*)sound->GetRepeat();
-
-        if (sound->IsLooped())
+        // Advance the playback position, then loop or stop at the end
+        unsigned newFractPos = fractPos + count * step;
+        pos += (newFractPos >> 16) * sampleSize;
+        fractPos = newFractPos & 65535;
+        if (pos >= end)
         {
-            while (--samples)
+            if (sound->IsLooped())
             {
-                *dest = *dest + (GET_IP_SAMPLE_LEFT() * vol) / 256;
-                ++dest;
-                *dest = *dest + (GET_IP_SAMPLE_RIGHT() * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
+                while (pos >= end)
+                    pos -= (end - repeat);
             }
-            position_ = (signed char*)pos;
-        }
-        else
-        {
-            while (--samples)
-            {
-                *dest = *dest + (GET_IP_SAMPLE_LEFT() * vol) / 256;
-                ++dest;
-                *dest = *dest + (GET_IP_SAMPLE_RIGHT() * vol) / 256;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
-            }
-            position_ = (signed char*)pos;
-        }
-    }
-    else
-    {
-        signed char* pos = (signed char*)position_;
-        signed char* end = sound->GetEnd();
-        signed char* repeat = sound->GetRepeat();
-
-        if (sound->IsLooped())
-        {
-            while (--samples)
-            {
-                *dest = *dest + GET_IP_SAMPLE_LEFT() * vol;
-                ++dest;
-                *dest = *dest + GET_IP_SAMPLE_RIGHT() * vol;
-                ++dest;
-                INC_POS_STEREO_LOOPED();
-            }
-            position_ = pos;
-        }
-        else
-        {
-            while (--samples)
+            else
             {
-                *dest = *dest + GET_IP_SAMPLE_LEFT() * vol;
-                ++dest;
-                *dest = *dest + GET_IP_SAMPLE_RIGHT() * vol;
-                ++dest;
-                INC_POS_STEREO_ONESHOT();
+                pos = 0;
+                break;
             }
-            position_ = pos;
         }
     }
 
+    position_ = pos;
     fractPosition_ = fractPos;
 }
 
@@ -1205,12 +840,34 @@ void SoundSource::MixNull(float timeStep)
     }
 }
 
+void SoundSource::ReadDecodeBuffer(unsigned offset, unsigned bytes)
+{
+    // If produced less output, end of sound encountered. Remember where it is, the stream has filled the rest with zero
+    unsigned outBytes = stream_->Read(decodeBuffer_->GetStart() + offset, bytes);
+    if (outBytes < bytes && decodeEndPosition_ == M_MAX_UNSIGNED)
+        decodeEndPosition_ = offset + outBytes;
+}
+
+void SoundSource::AllocateDecoder()
+{
+    stream_ = new SoundStream(sound_);
+    audio_->AddSoundStream(stream_);
+
+    unsigned sampleSize = sound_->GetSampleSize();
+    unsigned decodeBufferSize = sampleSize * (sound_->GetIntFrequency() * DECODE_BUFFER_LENGTH / 1000);
+    decodeBuffer_ = new Sound(context_);
+    decodeBuffer_->SetSize(decodeBufferSize);
+    decodeBuffer_->SetFormat(sound_->GetIntFrequency(), true, sound_->IsStereo());
+    decodeBuffer_->SetLooped(true);
+}
+
 void SoundSource::FreeDecoder()
 {
-    if (sound_ && decoder_)
+    if (stream_)
     {
-        sound_->FreeDecoder(decoder_);
-        decoder_ = 0;
+        if (audio_)
+            audio_->RemoveSoundStream(stream_);
+        stream_.Reset();
     }
 
     decodeBuffer_.Reset();
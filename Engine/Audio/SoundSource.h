@@ -30,6 +30,7 @@ namespace Urho3D
 
 class Audio;
 class Sound;
+class SoundStream;
 
 // Compressed audio decode buffer length in milliseconds
 static const int DECODE_BUFFER_LENGTH = 100;
@@ -67,6 +68,8 @@ public:
     void SetAttenuation(float attenuation);
     /// Set stereo panning. -1.0 is full left and 1.0 is full right.
     void SetPanning(float panning);
+    /// Set priority for the audio subsystem's voice limit. Multiplies the audible gain when choosing which sources to mix. Default 1.0.
+    void SetPriority(float priority);
    /// Set whether sound source will be automatically removed from the scene node when playback stops.
     void SetAutoRemove(bool enable);
     /// Set new playback position.
@@ -88,6 +91,12 @@ public:
     float GetAttenuation() const { return attenuation_; }
     /// Return stereo panning.
     float GetPanning() const { return panning_; }
+    /// Return priority for the voice limit.
+    float GetPriority() const { return priority_; }
+    /// Return audible gain, which is the gain multiplied by attenuation and master gain.
+    float GetAudibleGain() const;
+    /// Return whether is virtualized, meaning that playback advances without being mixed.
+    bool IsVirtual() const { return virtual_; }
     /// Return autoremove mode.
     bool GetAutoRemove() const { return autoRemove_; }
     /// Return whether is playing.
@@ -99,10 +108,12 @@ public:
     void StopLockless();
     /// Set new playback position without locking the audio mutex. Called internally.
     void SetPlayPositionLockless(signed char* position);
+    /// Set virtualized flag. Called by Audio.
+    void SetVirtual(bool enable) { virtual_ = enable; }
     /// Update the sound source. Perform subclass specific operations. Called by Audio.
     virtual void Update(float timeStep);
-    /// Mix sound source output to a 32-bit clipping buffer. Called by Audio.
-    void Mix(int* dest, unsigned samples, int mixRate, bool stereo, bool interpolation);
+    /// Mix sound source output to a floating point mixing buffer. Called by Audio.
+    void Mix(float* dest, unsigned samples, int mixRate, bool stereo, bool interpolation);
     
     /// Set sound attribute.
     void SetSoundAttr(ResourceRef value);
@@ -114,6 +125,9 @@ public:
     int GetPositionAttr() const;
     
 protected:
+    /// Handle a sound about to start playing. Called by Play() before the sound can be mixed.
+    virtual void OnPlay() {}
+    
     /// Audio subsystem.
     WeakPtr<Audio> audio_;
     /// SoundSource type, determines the master gain group.
@@ -126,33 +140,25 @@ protected:
     float attenuation_;
     /// Stereo panning.
     float panning_;
+    /// Voice limit priority.
+    float priority_;
     /// Autoremove timer.
     float autoRemoveTimer_;
     /// Autoremove flag.
     bool autoRemove_;
     
 private:
-    /// Mix mono sample to mono buffer.
-    void MixMonoToMono(Sound* sound, int* dest, unsigned samples, int mixRate);
-    /// Mix mono sample to stereo buffer.
-    void MixMonoToStereo(Sound* sound, int* dest, unsigned samples, int mixRate);
-    /// Mix mono sample to mono buffer interpolated.
-    void MixMonoToMonoIP(Sound* sound, int* dest, unsigned samples, int mixRate);
-    /// Mix mono sample to stereo buffer interpolated.
-    void MixMonoToStereoIP(Sound* sound, int* dest, unsigned samples, int mixRate);
-    /// Mix stereo sample to mono buffer.
-    void MixStereoToMono(Sound* sound, int* dest, unsigned samples, int mixRate);
-    /// Mix stereo sample to stereo buffer.
-    void MixStereoToStereo(Sound* sound, int* dest, unsigned samples, int mixRate);
-    /// Mix stereo sample to mono buffer interpolated.
-    void MixStereoToMonoIP(Sound* sound, int* dest, unsigned samples, int mixRate);
-    /// Mix stereo sample to stereo buffer interpolated.
-    void MixStereoToStereoIP(Sound* sound, int* dest, unsigned samples, int mixRate);
+    /// Mix mono or stereo sample to mono or stereo buffer, optionally interpolated.
+    void MixSamples(Sound* sound, float* dest, unsigned samples, int mixRate, bool stereo, bool interpolation);
     /// Advance playback pointer without producing audible output.
     void MixZeroVolume(Sound* sound, unsigned samples, int mixRate);
     /// Advance playback pointer to simulate audio playback in headless mode.
     void MixNull(float timeStep);
-    /// Free the decoder if any.
+    /// Read decoded audio from the stream into the decode buffer.
+    void ReadDecodeBuffer(unsigned offset, unsigned bytes);
+    /// Create the decoding stream and decode buffer for a compressed sound.
+    void AllocateDecoder();
+    /// Free the decoding stream and decode buffer if any.
     void FreeDecoder();
     
     /// Sound.
@@ -163,12 +169,16 @@ private:
     volatile int fractPosition_;
     /// Playback time position.
     volatile float timePosition_;
-    /// Ogg Vorbis decoder.
-    void* decoder_;
+    /// Virtualized flag.
+    volatile bool virtual_;
+    /// Ogg Vorbis decoding stream.
+    SharedPtr<SoundStream> stream_;
     /// Decode buffer.
     SharedPtr<Sound> decodeBuffer_;
     /// Previous decode buffer position.
     unsigned decodePosition_;
+    /// Decode buffer position where a non-looped compressed sound ends, or M_MAX_UNSIGNED if not yet decoded.
+    unsigned decodeEndPosition_;
 };
 
 }
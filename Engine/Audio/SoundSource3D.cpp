@@ -98,6 +98,20 @@ void SoundSource3D::SetRolloffFactor(float factor)
 }
 
 void SoundSource3D::CalculateAttenuation()
+{
+    // Sources that are not playing do not need attenuation. It is calculated again when playback starts
+    if (IsPlaying())
+        CalculateDistanceAttenuation();
+    else if (audio_)
+        attenuation_ = 0.0f;
+}
+
+void SoundSource3D::OnPlay()
+{
+    CalculateDistanceAttenuation();
+}
+
+void SoundSource3D::CalculateDistanceAttenuation()
 {
     if (!audio_)
         return;
@@ -111,13 +125,21 @@ void SoundSource3D::CalculateAttenuation()
         if (listener && listener->IsEnabledEffective() && (!listener->GetScene() || listener->GetScene() == GetScene()))
         {
             Node* listenerNode = listener->GetNode();
-            Vector3 relativePos(listenerNode->GetWorldRotation().Inverse() * (node_->GetWorldPosition() - listenerNode->GetWorldPosition()));
-            float distance = Clamp(relativePos.Length() - nearDistance_, 0.0f, interval);
-            float attenuation = powf(1.0f - distance / interval, rolloffFactor_);
-            float panning = relativePos.Normalized().x_;
-
-            attenuation_ = attenuation;
-            panning_ = panning;
+            Vector3 offset(node_->GetWorldPosition() - listenerNode->GetWorldPosition());
+
+            // Beyond the far distance the sound is silent, so skip the rotation and rolloff
+            if (offset.LengthSquared() >= farDistance_ * farDistance_)
+                attenuation_ = 0.0f;
+            else
+            {
+                Vector3 relativePos(listenerNode->GetWorldRotation().Inverse() * offset);
+                float distance = Clamp(relativePos.Length() - nearDistance_, 0.0f, interval);
+                float attenuation = powf(1.0f - distance / interval, rolloffFactor_);
+                float panning = relativePos.Normalized().x_;
+
+                attenuation_ = attenuation;
+                panning_ = panning;
+            }
         }
         else
             attenuation_ = 0.0f;
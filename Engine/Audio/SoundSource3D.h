@@ -62,12 +62,19 @@ public:
     float RollAngleoffFactor() const { return rolloffFactor_; }
     
 protected:
+    /// Handle a sound about to start playing. Calculate the attenuation so that the sound does not start from zero volume.
+    virtual void OnPlay();
+    
     /// Near distance.
     float nearDistance_;
     /// Far distance.
     float farDistance_;
     /// Rolloff power factor.
     float rolloffFactor_;
+    
+private:
+    /// Calculate attenuation and panning regardless of whether a sound is playing.
+    void CalculateDistanceAttenuation();
 };
 
 }
@@ -0,0 +1,281 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Precompiled.h"
+#include "Context.h"
+#include "File.h"
+#include "ResourceCache.h"
+#include "Sound.h"
+#include "SoundStream.h"
+
+#include <cstring>
+#include <stb_vorbis.h>
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+SoundStream::SoundStream(Sound* sound) :
+    sound_(sound),
+    memoryBuffer_(sound->GetStart(), sound->GetDataSize()),
+    source_(&memoryBuffer_),
+    decoder_(0),
+    inputPosition_(0),
+    pendingPosition_(0),
+    readPosition_(0),
+    writePosition_(0),
+    availableSize_(0),
+    numUnderruns_(0),
+    rewindRequested_(false),
+    eof_(false)
+{
+    if (sound->IsStreaming())
+    {
+        file_ = sound->GetSubsystem<ResourceCache>()->GetFile(sound->GetName());
+        if (file_)
+            source_ = file_;
+        else
+            eof_ = true;
+    }
+
+    bufferSize_ = sound->GetSampleSize() * (sound->GetIntFrequency() * STREAM_BUFFER_LENGTH / 1000);
+    buffer_ = new signed char[bufferSize_];
+}
+
+SoundStream::~SoundStream()
+{
+    CloseDecoder();
+}
+
+void SoundStream::Update()
+{
+    // Read both flags under the lock, as Rewind() may clear the end flag concurrently
+    bool rewind = false;
+    bool eof;
+    {
+        MutexLock lock(bufferMutex_);
+        if (rewindRequested_)
+        {
+            rewindRequested_ = false;
+            rewind = true;
+        }
+        eof = eof_;
+    }
+
+    if (rewind)
+    {
+        CloseDecoder();
+        pending_.Clear();
+        pendingPosition_ = 0;
+    }
+
+    if (eof)
+        return;
+
+    if (!decoder_ && !OpenDecoder())
+    {
+        MutexLock lock(bufferMutex_);
+        if (!rewindRequested_)
+            eof_ = true;
+        return;
+    }
+
+    for (;;)
+    {
+        // Flush the previously decoded frame first, then decode more when it has been fully written
+        if (pendingPosition_ < pending_.Size())
+        {
+            unsigned bytes = Write(&pending_[pendingPosition_], pending_.Size() - pendingPosition_);
+            if (!bytes)
+                break;
+            pendingPosition_ += bytes;
+        }
+        else if (!DecodeFrame())
+        {
+            MutexLock lock(bufferMutex_);
+            if (!rewindRequested_)
+                eof_ = true;
+            break;
+        }
+    }
+}
+
+unsigned SoundStream::Read(signed char* dest, unsigned bytes)
+{
+    MutexLock lock(bufferMutex_);
+
+    unsigned readBytes = Min((int)bytes, (int)availableSize_);
+    unsigned firstBytes = Min((int)readBytes, (int)(bufferSize_ - readPosition_));
+    memcpy(dest, buffer_.Get() + readPosition_, firstBytes);
+    memcpy(dest + firstBytes, buffer_.Get(), readBytes - firstBytes);
+    readPosition_ = (readPosition_ + readBytes) % bufferSize_;
+    availableSize_ -= readBytes;
+
+    if (readBytes == bytes)
+        return bytes;
+
+    // If decoding has not kept up, pad with silence and report as normal output so that playback continues
+    memset(dest + readBytes, 0, bytes - readBytes);
+    if (eof_)
+        return readBytes;
+
+    ++numUnderruns_;
+    return bytes;
+}
+
+void SoundStream::Rewind()
+{
+    MutexLock lock(bufferMutex_);
+
+    // The stream thread reopens the decoder on its next update
+    readPosition_ = 0;
+    writePosition_ = 0;
+    availableSize_ = 0;
+    rewindRequested_ = true;
+    eof_ = false;
+}
+
+bool SoundStream::OpenDecoder()
+{
+    source_->Seek(0);
+    input_.Clear();
+    inputPosition_ = 0;
+
+    for (;;)
+    {
+        if (!ReadInput())
+            return false;
+
+        int used;
+        int error;
+        stb_vorbis* vorbis = stb_vorbis_open_pushdata(&input_[0], input_.Size(), &used, &error, 0);
+        if (vorbis)
+        {
+            decoder_ = vorbis;
+            inputPosition_ = used;
+            return true;
+        }
+        // If the headers did not fit into the data read so far, retry with more data
+        if (error != VORBIS_need_more_data)
+            return false;
+    }
+}
+
+void SoundStream::CloseDecoder()
+{
+    if (decoder_)
+    {
+        stb_vorbis_close(static_cast<stb_vorbis*>(decoder_));
+        decoder_ = 0;
+    }
+}
+
+bool SoundStream::ReadInput()
+{
+    if (source_->IsEof())
+        return false;
+
+    // Discard the compressed data already consumed by the decoder
+    if (inputPosition_)
+    {
+        input_.Erase(0, inputPosition_);
+        inputPosition_ = 0;
+    }
+
+    unsigned oldSize = input_.Size();
+    input_.Resize(oldSize + STREAM_READ_SIZE);
+    unsigned bytes = source_->Read(&input_[oldSize], STREAM_READ_SIZE);
+    input_.Resize(oldSize + bytes);
+    return bytes != 0;
+}
+
+bool SoundStream::DecodeFrame()
+{
+    stb_vorbis* vorbis = static_cast<stb_vorbis*>(decoder_);
+    bool restarted = false;
+
+    for (;;)
+    {
+        int channels;
+        int samples = 0;
+        float** output;
+        int used = input_.Size() > inputPosition_ ? stb_vorbis_decode_frame_pushdata(vorbis, &input_[inputPosition_],
+            input_.Size() - inputPosition_, &channels, &output, &samples) : 0;
+        inputPosition_ += used;
+
+        if (samples)
+        {
+            // Convert to 16-bit, interleaving the left and right channels if stereo
+            unsigned outChannels = sound_->IsStereo() ? 2 : 1;
+            pending_.Resize(samples * outChannels * sizeof(short));
+            pendingPosition_ = 0;
+            short* dest = reinterpret_cast<short*>(&pending_[0]);
+            for (unsigned i = 0; i < outChannels; ++i)
+            {
+                const float* src = output[i];
+                for (int j = 0; j < samples; ++j)
+                {
+                    int value = (int)(src[j] * 32768.0f + (src[j] >= 0.0f ? 0.5f : -0.5f));
+                    dest[j * outChannels + i] = (short)Clamp(value, -32768, 32767);
+                }
+            }
+            return true;
+        }
+
+        if (used)
+            continue;
+
+        // The decoder needs more data. At the end of the data, restart a looped sound or finish. Restart only once
+        // per frame to not loop endlessly on data that produces no audio
+        if (!ReadInput())
+        {
+            if (!sound_->IsLooped() || restarted)
+                return false;
+
+            CloseDecoder();
+            if (!OpenDecoder())
+                return false;
+            vorbis = static_cast<stb_vorbis*>(decoder_);
+            restarted = true;
+        }
+    }
+}
+
+unsigned SoundStream::Write(const signed char* src, unsigned bytes)
+{
+    MutexLock lock(bufferMutex_);
+
+    // Data decoded before a rewind request is stale, so do not write it
+    if (rewindRequested_)
+        return 0;
+
+    unsigned writeBytes = Min((int)bytes, (int)(bufferSize_ - availableSize_));
+    unsigned firstBytes = Min((int)writeBytes, (int)(bufferSize_ - writePosition_));
+    memcpy(buffer_.Get() + writePosition_, src, firstBytes);
+    memcpy(buffer_.Get(), src + firstBytes, writeBytes - firstBytes);
+    writePosition_ = (writePosition_ + writeBytes) % bufferSize_;
+    availableSize_ += writeBytes;
+    return writeBytes;
+}
+
+}
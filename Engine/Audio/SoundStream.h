@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "ArrayPtr.h"
+#include "MemoryBuffer.h"
+#include "Mutex.h"
+#include "Ptr.h"
+
+namespace Urho3D
+{
+
+class File;
+class Sound;
+
+/// Decoded audio read-ahead length in milliseconds.
+static const int STREAM_BUFFER_LENGTH = 500;
+/// Compressed data read chunk size in bytes.
+static const unsigned STREAM_READ_SIZE = 16384;
+
+/// Ogg Vorbis decoding stream for a compressed sound. Reads the compressed data in chunks, either from disk or from the sound's memory, and decodes ahead into a ring buffer. Decoding is performed in the audio subsystem's stream thread while the mixing thread reads the decoded audio.
+class SoundStream : public RefCounted
+{
+public:
+    /// Construct for a compressed sound. If the sound is streamed, opens its file from the resource cache.
+    SoundStream(Sound* sound);
+    /// Destruct. Free the decoder.
+    virtual ~SoundStream();
+
+    /// Decode ahead until the ring buffer is full. Called from the stream thread.
+    void Update();
+    /// Read decoded 16-bit audio. Pads with silence on buffer underrun. Return number of bytes produced, which is less than requested only at the end of a non-looped sound.
+    unsigned Read(signed char* dest, unsigned bytes);
+    /// Restart decoding from the beginning. Any already decoded audio is discarded.
+    void Rewind();
+
+    /// Return the sound.
+    Sound* GetSound() const { return sound_; }
+    /// Return number of decoded bytes available for reading.
+    unsigned GetAvailableSize() const { return availableSize_; }
+    /// Return ring buffer size in bytes.
+    unsigned GetBufferSize() const { return bufferSize_; }
+    /// Return number of buffer underruns so far.
+    unsigned GetNumUnderruns() const { return numUnderruns_; }
+    /// Return whether the end of a non-looped sound has been decoded.
+    bool IsEof() const { return eof_; }
+
+private:
+    /// Open the decoder at the beginning of the compressed data. Return true if successful.
+    bool OpenDecoder();
+    /// Free the decoder.
+    void CloseDecoder();
+    /// Read the next chunk of compressed data. Return false if at the end of the data.
+    bool ReadInput();
+    /// Decode the next frame of audio into the pending buffer. Return false at the end of a non-looped sound or on error.
+    bool DecodeFrame();
+    /// Write decoded audio into the ring buffer. Return number of bytes written.
+    unsigned Write(const signed char* src, unsigned bytes);
+
+    /// Sound.
+    SharedPtr<Sound> sound_;
+    /// Source file when streaming from disk.
+    SharedPtr<File> file_;
+    /// Source buffer when decoding from the sound's memory.
+    MemoryBuffer memoryBuffer_;
+    /// Compressed data source.
+    Deserializer* source_;
+    /// Ogg Vorbis decoder.
+    void* decoder_;
+    /// Compressed data read from the source but not yet consumed by the decoder.
+    PODVector<unsigned char> input_;
+    /// Consumed position within the compressed data buffer.
+    unsigned inputPosition_;
+    /// Decoded audio of the latest frame that did not yet fit into the ring buffer.
+    PODVector<signed char> pending_;
+    /// Written position within the pending audio.
+    unsigned pendingPosition_;
+    /// Ring buffer for decoded audio.
+    SharedArrayPtr<signed char> buffer_;
+    /// Ring buffer size in bytes.
+    unsigned bufferSize_;
+    /// Ring buffer read position.
+    unsigned readPosition_;
+    /// Ring buffer write position.
+    unsigned writePosition_;
+    /// Decoded bytes available for reading.
+    volatile unsigned availableSize_;
+    /// Buffer underrun count.
+    volatile unsigned numUnderruns_;
+    /// Ring buffer mutex.
+    Mutex bufferMutex_;
+    /// Rewind requested flag.
+    volatile bool rewindRequested_;
+    /// End of non-looped sound decoded flag.
+    volatile bool eof_;
+};
+
+}
@@ -343,6 +343,15 @@ bool Object::HasSubscribedToEvent(Object* sender, StringHash eventType) const
         return FindSpecificEventHandler(sender, eventType) != 0;
 }
 
+bool Object::HasEventReceivers(StringHash eventType) const
+{
+    HashSet<Object*>* receivers = context_->GetEventReceivers(const_cast<Object*>(this), eventType);
+    if (receivers && !receivers->Empty())
+        return true;
+    receivers = context_->GetEventReceivers(eventType);
+    return receivers && !receivers->Empty();
+}
+
 const String& Object::GetCategory() const
 {
     const HashMap<String, Vector<ShortStringHash> >& objectCategories = context_->GetObjectCategories();
@@ -81,6 +81,8 @@ public:
     bool HasSubscribedToEvent(StringHash eventType) const;
     /// Return whether has subscribed to a specific sender's event.
     bool HasSubscribedToEvent(Object* sender, StringHash eventType) const;
+    /// Return whether any object has subscribed to an event sent by this object. Can be used to skip preparing the event data when sending frequent events.
+    bool HasEventReceivers(StringHash eventType) const;
     /// Template version of returning a subsystem.
     template <class T> T* GetSubsystem() const;
     /// Return object category. Categories are (optionally) registered along with the object factory. Return an empty string if the object category is not registered.
@@ -101,6 +101,15 @@ template <class T> CScriptArray* VectorToArray(const PODVector<T>& vector, const
         return 0;
 }
 
+/// Template function for array to PODVector conversion.
+template <class T> PODVector<T> ArrayToPODVector(CScriptArray* arr)
+{
+    PODVector<T> dest(arr ? arr->GetSize() : 0);
+    for (unsigned i = 0; i < dest.Size(); ++i)
+        dest[i] = *static_cast<T*>(arr->At(i));
+    return dest;
+}
+
 /// Template function for data buffer to array conversion.
 template <class T> CScriptArray* BufferToArray(const T* buffer, unsigned size, const char* arrayName)
 {
@@ -691,12 +700,15 @@ template <class T> void RegisterSoundSource(asIScriptEngine* engine, const char*
     engine->RegisterObjectMethod(className, "float get_gain() const", asMETHOD(T, GetGain), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "void set_panning(float)", asMETHOD(T, SetPanning), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "float get_panning() const", asMETHOD(T, GetPanning), asCALL_THISCALL);
+    engine->RegisterObjectMethod(className, "void set_priority(float)", asMETHOD(T, SetPriority), asCALL_THISCALL);
+    engine->RegisterObjectMethod(className, "float get_priority() const", asMETHOD(T, GetPriority), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "Sound@+ get_sound() const", asMETHOD(T, GetSound), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "float get_timePosition() const", asMETHOD(T, GetTimePosition), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "float get_attenuation() const", asMETHOD(T, GetAttenuation), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "void set_autoRemove(bool)", asMETHOD(T, SetAutoRemove), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "bool get_autoRemove() const", asMETHOD(T, GetAutoRemove), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "bool get_playing() const", asMETHOD(T, IsPlaying), asCALL_THISCALL);
+    engine->RegisterObjectMethod(className, "bool get_virtual() const", asMETHOD(T, IsVirtual), asCALL_THISCALL);
 }
 
 /// Template function for registering a class derived from Texture.
@@ -26,6 +26,7 @@
 #include "Sound.h"
 #include "SoundListener.h"
 #include "SoundSource3D.h"
+#include "VectorBuffer.h"
 
 namespace Urho3D
 {
@@ -41,6 +42,7 @@ void RegisterSound(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Sound", "bool get_sixteenBit() const", asMETHOD(Sound, IsSixteenBit), asCALL_THISCALL);
     engine->RegisterObjectMethod("Sound", "bool get_stereo() const", asMETHOD(Sound, IsStereo), asCALL_THISCALL);
     engine->RegisterObjectMethod("Sound", "bool get_compressed() const", asMETHOD(Sound, IsCompressed), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Sound", "bool get_streaming() const", asMETHOD(Sound, IsStreaming), asCALL_THISCALL);
 }
 
 void RegisterSoundSources(asIScriptEngine* engine)
@@ -75,16 +77,35 @@ static Audio* GetAudio()
     return GetScriptContext()->GetSubsystem<Audio>();
 }
 
+static VectorBuffer AudioMixOutput(unsigned samples, Audio* ptr)
+{
+    VectorBuffer ret;
+    ret.Resize(samples * ptr->GetSampleSize());
+    if (samples)
+    {
+        MutexLock lock(ptr->GetMutex());
+        ptr->MixOutput(ret.GetModifiableData(), samples);
+    }
+    return ret;
+}
+
 void RegisterAudio(asIScriptEngine* engine)
 {
     RegisterObject<Audio>(engine, "Audio");
     engine->RegisterObjectMethod("Audio", "void SetMode(int, int, bool, bool interpolate = true)", asMETHOD(Audio, SetMode), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Audio", "void SetOfflineMode(int, bool, bool interpolate = true)", asMETHOD(Audio, SetOfflineMode), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Audio", "VectorBuffer MixOutput(uint)", asFUNCTION(AudioMixOutput), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("Audio", "bool Play()", asMETHOD(Audio, Play), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "void Stop()", asMETHOD(Audio, Stop), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Audio", "void Update(float)", asMETHOD(Audio, Update), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "void set_masterGain(SoundType, float)", asMETHOD(Audio, SetMasterGain), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "float get_masterGain(SoundType) const", asMETHOD(Audio, GetMasterGain), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "void set_listener(SoundListener@+)", asMETHOD(Audio, SetListener), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "SoundListener@+ get_listener() const", asMETHOD(Audio, GetListener), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Audio", "void set_maxVoices(uint)", asMETHOD(Audio, SetMaxVoices), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Audio", "uint get_maxVoices() const", asMETHOD(Audio, GetMaxVoices), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Audio", "uint get_numVoices() const", asMETHOD(Audio, GetNumVoices), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Audio", "uint get_numVirtualVoices() const", asMETHOD(Audio, GetNumVirtualVoices), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "uint get_sampleSize() const", asMETHOD(Audio, GetSampleSize), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "int get_mixRate() const", asMETHOD(Audio, GetMixRate), asCALL_THISCALL);
     engine->RegisterObjectMethod("Audio", "bool get_stereo() const", asMETHOD(Audio, IsStereo), asCALL_THISCALL);
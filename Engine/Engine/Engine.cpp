@@ -136,8 +136,16 @@ bool Engine::Initialize(const VariantMap& parameters)
         SetMaxFps(0);
     
     // Set amount of worker threads according to the available physical CPU cores. Using also hyperthreaded cores results in
-    // unpredictable extra synchronization overhead. Also reserve one core for the main thread
-    unsigned numThreads = GetParameter(parameters, "WorkerThreads", true).GetBool() ? GetNumPhysicalCPUs() - 1 : 0;
+    // unpredictable extra synchronization overhead. Also reserve one core for the main thread. The amount can also be given
+    // explicitly, for example to measure how work scales with the thread count
+    unsigned numThreads = 0;
+    if (GetParameter(parameters, "WorkerThreads", true).GetBool())
+    {
+        if (HasParameter(parameters, "NumWorkerThreads"))
+            numThreads = Max(GetParameter(parameters, "NumWorkerThreads").GetInt(), 0);
+        else
+            numThreads = GetNumPhysicalCPUs() - 1;
+    }
     if (numThreads)
     {
         GetSubsystem<WorkQueue>()->CreateThreads(numThreads);
@@ -201,6 +209,9 @@ bool Engine::Initialize(const VariantMap& parameters)
         }
     }
     
+    // Set processed resource data cache directory if specified
+    if (HasParameter(parameters, "CacheDir"))
+        cache->SetCacheDir(exePath + GetParameter(parameters, "CacheDir").GetString());
 
     // Initialize graphics & audio output
     if (!headless_)
@@ -403,12 +414,20 @@ void Engine::DumpResources()
         
         if (num)
         {
-            LOGRAW("Resource type " + i->second_.resources_.Begin()->second_->GetTypeName() +
-                ": count " + String(num) + " memory use " + String(memoryUse) + "\n");
+            String line = "Resource type " + i->second_.resources_.Begin()->second_->GetTypeName() + ": count " + String(num) +
+                " memory use " + String(memoryUse);
+            if (i->second_.memoryBudget_)
+                line += " budget " + String(i->second_.memoryBudget_);
+            if (i->second_.numEvicted_)
+                line += " evicted " + String(i->second_.numEvicted_) + " (" + String(i->second_.evictedMemory_) + " bytes)";
+            LOGRAW(line + "\n");
         }
     }
     
-    LOGRAW("Total memory use of all resources " + String(cache->GetTotalMemoryUse()) + "\n\n");
+    String total = "Total memory use of all resources " + String(cache->GetTotalMemoryUse());
+    if (cache->GetTotalMemoryBudget())
+        total += " budget " + String(cache->GetTotalMemoryBudget());
+    LOGRAW(total + "\n\n");
     #endif
 }
 
@@ -571,6 +590,8 @@ VariantMap Engine::ParseParameters(const Vector<String>& arguments)
                 ret["LowQualityShadows"] = true;
             else if (argument == "nothreads")
                 ret["WorkerThreads"] = false;
+            else if (argument.Length() > 7 && argument.Substring(0, 7) == "threads")
+                ret["NumWorkerThreads"] = ToInt(argument.Substring(7));
             else if (argument == "sm2")
                 ret["ForceSM2"] = true;
             else
@@ -22,8 +22,11 @@
 
 #include "Precompiled.h"
 #include "APITemplates.h"
+#include "CrowdAgent.h"
+#include "CrowdManager.h"
 #include "Navigable.h"
 #include "NavigationMesh.h"
+#include "Obstacle.h"
 #include "OffMeshConnection.h"
 
 namespace Urho3D
@@ -49,6 +52,8 @@ void RegisterNavigationMesh(asIScriptEngine* engine)
     engine->RegisterObjectMethod("NavigationMesh", "bool Build()", asMETHODPR(NavigationMesh, Build, (void), bool), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "bool Build(const BoundingBox&in)", asMETHODPR(NavigationMesh, Build, (const BoundingBox&), bool), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "Array<Vector3>@ FindPath(const Vector3&in, const Vector3&in, const Vector3&in extents = Vector3(1.0, 1.0, 1.0))", asFUNCTION(NavigationMeshFindPath), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("NavigationMesh", "uint RequestPath(const Vector3&in, const Vector3&in, const Vector3&in extents = Vector3(1.0, 1.0, 1.0))", asMETHOD(NavigationMesh, RequestPath), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "void ProcessPathRequests()", asMETHOD(NavigationMesh, ProcessPathRequests), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "Vector3 GetRandomPoint()", asMETHOD(NavigationMesh, GetRandomPoint), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "Vector3 GetRandomPointInCircle(const Vector3&in, float, const Vector3&in extents = Vector3(1.0, 1.0, 1.0))", asMETHOD(NavigationMesh, GetRandomPointInCircle), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "float GetDistanceToWall(const Vector3&in, float, const Vector3&in extents = Vector3(1.0, 1.0, 1.0))", asMETHOD(NavigationMesh, GetDistanceToWall), asCALL_THISCALL);
@@ -81,6 +86,14 @@ void RegisterNavigationMesh(asIScriptEngine* engine)
     engine->RegisterObjectMethod("NavigationMesh", "float get_detailSampleMaxError() const", asMETHOD(NavigationMesh, GetDetailSampleMaxError), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "void set_padding(const Vector3&in)", asMETHOD(NavigationMesh, SetPadding), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "const Vector3& get_padding() const", asMETHOD(NavigationMesh, GetPadding), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "void set_maxPathRequests(uint)", asMETHOD(NavigationMesh, SetMaxPathRequests), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "uint get_maxPathRequests() const", asMETHOD(NavigationMesh, GetMaxPathRequests), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "uint get_numPathRequests() const", asMETHOD(NavigationMesh, GetNumPathRequests), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "void UpdateObstacles()", asMETHOD(NavigationMesh, UpdateObstacles), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "void set_tileCacheEnabled(bool)", asMETHOD(NavigationMesh, SetTileCacheEnabled), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "bool get_tileCacheEnabled() const", asMETHOD(NavigationMesh, IsTileCacheEnabled), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "uint get_numObstacles() const", asMETHOD(NavigationMesh, GetNumObstacles), asCALL_THISCALL);
+    engine->RegisterObjectMethod("NavigationMesh", "uint get_numDirtyTiles() const", asMETHOD(NavigationMesh, GetNumDirtyTiles), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "bool get_initialized() const", asMETHOD(NavigationMesh, IsInitialized), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "const BoundingBox& get_boundingBox() const", asMETHOD(NavigationMesh, GetBoundingBox), asCALL_THISCALL);
     engine->RegisterObjectMethod("NavigationMesh", "BoundingBox get_worldBoundingBox() const", asMETHOD(NavigationMesh, GetWorldBoundingBox), asCALL_THISCALL);
@@ -98,11 +111,61 @@ void RegisterOffMeshConnection(asIScriptEngine* engine)
     engine->RegisterObjectMethod("OffMeshConnection", "bool get_bidirectional() const", asMETHOD(OffMeshConnection, IsBidirectional), asCALL_THISCALL);
 }
 
+void RegisterObstacle(asIScriptEngine* engine)
+{
+    engine->RegisterEnum("ObstacleShape");
+    engine->RegisterEnumValue("ObstacleShape", "OBSTACLE_CYLINDER", OBSTACLE_CYLINDER);
+    engine->RegisterEnumValue("ObstacleShape", "OBSTACLE_BOX", OBSTACLE_BOX);
+    
+    RegisterComponent<Obstacle>(engine, "Obstacle");
+    engine->RegisterObjectMethod("Obstacle", "void set_shape(ObstacleShape)", asMETHOD(Obstacle, SetShape), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "ObstacleShape get_shape() const", asMETHOD(Obstacle, GetShape), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "void set_radius(float)", asMETHOD(Obstacle, SetRadius), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "float get_radius() const", asMETHOD(Obstacle, GetRadius), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "void set_height(float)", asMETHOD(Obstacle, SetHeight), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "float get_height() const", asMETHOD(Obstacle, GetHeight), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "void set_size(const Vector3&in)", asMETHOD(Obstacle, SetSize), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "const Vector3& get_size() const", asMETHOD(Obstacle, GetSize), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Obstacle", "NavigationMesh@+ get_navigationMesh() const", asMETHOD(Obstacle, GetNavigationMesh), asCALL_THISCALL);
+}
+
+void RegisterCrowdManager(asIScriptEngine* engine)
+{
+    RegisterComponent<CrowdManager>(engine, "CrowdManager");
+    engine->RegisterObjectMethod("CrowdManager", "void Update(float)", asMETHOD(CrowdManager, Update), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdManager", "void set_navigationMesh(NavigationMesh@+)", asMETHOD(CrowdManager, SetNavigationMesh), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdManager", "NavigationMesh@+ get_navigationMesh()", asMETHOD(CrowdManager, GetNavigationMesh), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdManager", "void set_neighborDistance(float)", asMETHOD(CrowdManager, SetNeighborDistance), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdManager", "float get_neighborDistance() const", asMETHOD(CrowdManager, GetNeighborDistance), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdManager", "void set_separationWeight(float)", asMETHOD(CrowdManager, SetSeparationWeight), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdManager", "float get_separationWeight() const", asMETHOD(CrowdManager, GetSeparationWeight), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdManager", "uint get_numAgents() const", asMETHOD(CrowdManager, GetNumAgents), asCALL_THISCALL);
+}
+
+void RegisterCrowdAgent(asIScriptEngine* engine)
+{
+    RegisterComponent<CrowdAgent>(engine, "CrowdAgent");
+    engine->RegisterObjectMethod("CrowdAgent", "void ResetTarget()", asMETHOD(CrowdAgent, ResetTarget), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "void set_radius(float)", asMETHOD(CrowdAgent, SetRadius), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "float get_radius() const", asMETHOD(CrowdAgent, GetRadius), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "void set_maxSpeed(float)", asMETHOD(CrowdAgent, SetMaxSpeed), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "float get_maxSpeed() const", asMETHOD(CrowdAgent, GetMaxSpeed), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "void set_maxAccel(float)", asMETHOD(CrowdAgent, SetMaxAccel), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "float get_maxAccel() const", asMETHOD(CrowdAgent, GetMaxAccel), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "void set_targetPosition(const Vector3&in)", asMETHOD(CrowdAgent, SetTargetPosition), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "const Vector3& get_targetPosition() const", asMETHOD(CrowdAgent, GetTargetPosition), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "bool get_hasTarget() const", asMETHOD(CrowdAgent, HasTarget), asCALL_THISCALL);
+    engine->RegisterObjectMethod("CrowdAgent", "Vector3 get_velocity() const", asMETHOD(CrowdAgent, GetVelocity), asCALL_THISCALL);
+}
+
 void RegisterNavigationAPI(asIScriptEngine* engine)
 {
     RegisterNavigable(engine);
     RegisterNavigationMesh(engine);
     RegisterOffMeshConnection(engine);
+    RegisterObstacle(engine);
+    RegisterCrowdManager(engine);
+    RegisterCrowdAgent(engine);
 }
 
 }
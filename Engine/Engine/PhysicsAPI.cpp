@@ -25,6 +25,7 @@
 #include "CollisionShape.h"
 #include "Constraint.h"
 #include "PhysicsWorld.h"
+#include "Ray.h"
 #include "RigidBody.h"
 #include "Scene.h"
 
@@ -57,6 +58,36 @@ static RigidBody* PhysicsRaycastResultGetRigidBody(PhysicsRaycastResult* ptr)
     return ptr->body_;
 }
 
+static void ConstructPhysicsContactPoint(PhysicsContactPoint* ptr)
+{
+    new(ptr) PhysicsContactPoint();
+}
+
+static void DestructPhysicsContactPoint(PhysicsContactPoint* ptr)
+{
+    ptr->~PhysicsContactPoint();
+}
+
+static void ConstructPhysicsContact(PhysicsContact* ptr)
+{
+    new(ptr) PhysicsContact();
+}
+
+static void DestructPhysicsContact(PhysicsContact* ptr)
+{
+    ptr->~PhysicsContact();
+}
+
+static RigidBody* PhysicsContactGetRigidBodyA(PhysicsContact* ptr)
+{
+    return ptr->bodyA_;
+}
+
+static RigidBody* PhysicsContactGetRigidBodyB(PhysicsContact* ptr)
+{
+    return ptr->bodyB_;
+}
+
 static void RegisterCollisionShape(asIScriptEngine* engine)
 {
     engine->RegisterEnum("ShapeType");
@@ -233,6 +264,30 @@ static PhysicsRaycastResult PhysicsWorldSphereCast(const Ray& ray, float radius,
     return result;
 }
 
+static CScriptArray* PhysicsWorldRaycastSingleBatch(CScriptArray* rays, float maxDistance, unsigned collisionMask, PhysicsWorld* ptr)
+{
+    PODVector<PhysicsRaycastResult> result;
+    ptr->RaycastSingleBatch(result, ArrayToPODVector<Ray>(rays), maxDistance, collisionMask);
+    return VectorToArray<PhysicsRaycastResult>(result, "Array<PhysicsRaycastResult>");
+}
+
+static CScriptArray* PhysicsWorldSphereCastBatch(CScriptArray* rays, float radius, float maxDistance, unsigned collisionMask, PhysicsWorld* ptr)
+{
+    PODVector<PhysicsRaycastResult> result;
+    ptr->SphereCastBatch(result, ArrayToPODVector<Ray>(rays), radius, maxDistance, collisionMask);
+    return VectorToArray<PhysicsRaycastResult>(result, "Array<PhysicsRaycastResult>");
+}
+
+static CScriptArray* PhysicsWorldGetContacts(PhysicsWorld* ptr)
+{
+    return VectorToArray<PhysicsContact>(ptr->GetContacts(), "Array<PhysicsContact>");
+}
+
+static CScriptArray* PhysicsWorldGetContactPoints(PhysicsWorld* ptr)
+{
+    return VectorToArray<PhysicsContactPoint>(ptr->GetContactPoints(), "Array<PhysicsContactPoint>");
+}
+
 static CScriptArray* PhysicsWorldGetRigidBodiesSphere(const Sphere& sphere, unsigned collisionMask, PhysicsWorld* ptr)
 {
     PODVector<RigidBody*> result;
@@ -264,6 +319,24 @@ static void RegisterPhysicsWorld(asIScriptEngine* engine)
     engine->RegisterObjectProperty("PhysicsRaycastResult", "Vector3 normal", offsetof(PhysicsRaycastResult, normal_));
     engine->RegisterObjectProperty("PhysicsRaycastResult", "float distance", offsetof(PhysicsRaycastResult, distance_));
     engine->RegisterObjectMethod("PhysicsRaycastResult", "RigidBody@+ get_body() const", asFUNCTION(PhysicsRaycastResultGetRigidBody), asCALL_CDECL_OBJLAST);
+
+    engine->RegisterObjectType("PhysicsContactPoint", sizeof(PhysicsContactPoint), asOBJ_VALUE | asOBJ_APP_CLASS_C);
+    engine->RegisterObjectBehaviour("PhysicsContactPoint", asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(ConstructPhysicsContactPoint), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectBehaviour("PhysicsContactPoint", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructPhysicsContactPoint), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("PhysicsContactPoint", "PhysicsContactPoint& opAssign(const PhysicsContactPoint&in)", asMETHODPR(PhysicsContactPoint, operator =, (const PhysicsContactPoint&), PhysicsContactPoint&), asCALL_THISCALL);
+    engine->RegisterObjectProperty("PhysicsContactPoint", "Vector3 position", offsetof(PhysicsContactPoint, position_));
+    engine->RegisterObjectProperty("PhysicsContactPoint", "Vector3 normal", offsetof(PhysicsContactPoint, normal_));
+    engine->RegisterObjectProperty("PhysicsContactPoint", "float distance", offsetof(PhysicsContactPoint, distance_));
+    engine->RegisterObjectProperty("PhysicsContactPoint", "float impulse", offsetof(PhysicsContactPoint, impulse_));
+
+    engine->RegisterObjectType("PhysicsContact", sizeof(PhysicsContact), asOBJ_VALUE | asOBJ_APP_CLASS_C);
+    engine->RegisterObjectBehaviour("PhysicsContact", asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(ConstructPhysicsContact), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectBehaviour("PhysicsContact", asBEHAVE_DESTRUCT, "void f()", asFUNCTION(DestructPhysicsContact), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("PhysicsContact", "PhysicsContact& opAssign(const PhysicsContact&in)", asMETHODPR(PhysicsContact, operator =, (const PhysicsContact&), PhysicsContact&), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsContact", "RigidBody@+ get_bodyA() const", asFUNCTION(PhysicsContactGetRigidBodyA), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("PhysicsContact", "RigidBody@+ get_bodyB() const", asFUNCTION(PhysicsContactGetRigidBodyB), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectProperty("PhysicsContact", "uint firstPoint", offsetof(PhysicsContact, firstPoint_));
+    engine->RegisterObjectProperty("PhysicsContact", "uint numPoints", offsetof(PhysicsContact, numPoints_));
     
     RegisterComponent<PhysicsWorld>(engine, "PhysicsWorld");
     engine->RegisterObjectMethod("PhysicsWorld", "void Update(float)", asMETHOD(PhysicsWorld, Update), asCALL_THISCALL);
@@ -271,6 +344,8 @@ static void RegisterPhysicsWorld(asIScriptEngine* engine)
     engine->RegisterObjectMethod("PhysicsWorld", "Array<PhysicsRaycastResult>@ Raycast(const Ray&in, float maxDistance = M_INFINITY, uint collisionMask = 0xffff)", asFUNCTION(PhysicsWorldRaycast), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("PhysicsWorld", "PhysicsRaycastResult RaycastSingle(const Ray&in, float maxDistance = M_INFINITY, uint collisionMask = 0xffff)", asFUNCTION(PhysicsWorldRaycastSingle), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("PhysicsWorld", "PhysicsRaycastResult SphereCast(const Ray&in, float, float maxDistance = M_INFINITY, uint collisionMask = 0xffff)", asFUNCTION(PhysicsWorldSphereCast), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("PhysicsWorld", "Array<PhysicsRaycastResult>@ RaycastSingleBatch(Array<Ray>@+, float maxDistance = M_INFINITY, uint collisionMask = 0xffff)", asFUNCTION(PhysicsWorldRaycastSingleBatch), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("PhysicsWorld", "Array<PhysicsRaycastResult>@ SphereCastBatch(Array<Ray>@+, float, float maxDistance = M_INFINITY, uint collisionMask = 0xffff)", asFUNCTION(PhysicsWorldSphereCastBatch), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("PhysicsWorld", "Array<RigidBody@>@ GetRigidBodies(const Sphere&in, uint collisionMask = 0xffff)", asFUNCTION(PhysicsWorldGetRigidBodiesSphere), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("PhysicsWorld", "Array<RigidBody@>@ GetRigidBodies(const BoundingBox&in, uint collisionMask = 0xffff)", asFUNCTION(PhysicsWorldGetRigidBodiesBox), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("PhysicsWorld", "Array<RigidBody@>@ GetRigidBodies(RigidBody@+)", asFUNCTION(PhysicsWorldGetRigidBodiesBody), asCALL_CDECL_OBJLAST);
@@ -281,6 +356,14 @@ static void RegisterPhysicsWorld(asIScriptEngine* engine)
     engine->RegisterObjectMethod("PhysicsWorld", "int get_fps() const", asMETHOD(PhysicsWorld, GetFps), asCALL_THISCALL);
     engine->RegisterObjectMethod("PhysicsWorld", "void set_interpolation(bool)", asMETHOD(PhysicsWorld, SetInterpolation), asCALL_THISCALL);
     engine->RegisterObjectMethod("PhysicsWorld", "bool get_interpolation() const", asMETHOD(PhysicsWorld, GetInterpolation), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsWorld", "void set_multithreaded(bool)", asMETHOD(PhysicsWorld, SetMultithreaded), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsWorld", "bool get_multithreaded() const", asMETHOD(PhysicsWorld, GetMultithreaded), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsWorld", "void set_deterministic(bool)", asMETHOD(PhysicsWorld, SetDeterministic), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsWorld", "bool get_deterministic() const", asMETHOD(PhysicsWorld, GetDeterministic), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsWorld", "void set_backgroundGeometryBuild(bool)", asMETHOD(PhysicsWorld, SetBackgroundGeometryBuild), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsWorld", "bool get_backgroundGeometryBuild() const", asMETHOD(PhysicsWorld, GetBackgroundGeometryBuild), asCALL_THISCALL);
+    engine->RegisterObjectMethod("PhysicsWorld", "Array<PhysicsContact>@ get_contacts() const", asFUNCTION(PhysicsWorldGetContacts), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("PhysicsWorld", "Array<PhysicsContactPoint>@ get_contactPoints() const", asFUNCTION(PhysicsWorldGetContactPoints), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("Scene", "PhysicsWorld@+ get_physicsWorld() const", asFUNCTION(SceneGetPhysicsWorld), asCALL_CDECL_OBJLAST);
     engine->RegisterGlobalFunction("PhysicsWorld@+ get_physicsWorld()", asFUNCTION(GetPhysicsWorld), asCALL_CDECL);
     
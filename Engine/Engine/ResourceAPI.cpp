@@ -81,6 +81,16 @@ static unsigned ResourceCacheGetMemoryUse(const String& type, ResourceCache* ptr
     return ptr->GetMemoryUse(type);
 }
 
+static unsigned ResourceCacheGetNumEvicted(const String& type, ResourceCache* ptr)
+{
+    return ptr->GetNumEvicted(type);
+}
+
+static unsigned ResourceCacheGetEvictedMemory(const String& type, ResourceCache* ptr)
+{
+    return ptr->GetEvictedMemory(type);
+}
+
 static ResourceCache* GetResourceCache()
 {
     return GetScriptContext()->GetSubsystem<ResourceCache>();
@@ -121,7 +131,11 @@ static void RegisterResourceCache(asIScriptEngine* engine)
     engine->RegisterObjectMethod("ResourceCache", "void set_memoryBudget(const String&in, uint)", asFUNCTION(ResourceCacheSetMemoryBudget), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("ResourceCache", "uint get_memoryBudget(const String&in) const", asFUNCTION(ResourceCacheGetMemoryBudget), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("ResourceCache", "uint get_memoryUse(const String&in) const", asFUNCTION(ResourceCacheGetMemoryUse), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("ResourceCache", "uint get_numEvicted(const String&in) const", asFUNCTION(ResourceCacheGetNumEvicted), asCALL_CDECL_OBJLAST);
+    engine->RegisterObjectMethod("ResourceCache", "uint get_evictedMemory(const String&in) const", asFUNCTION(ResourceCacheGetEvictedMemory), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("ResourceCache", "uint get_totalMemoryUse() const", asMETHOD(ResourceCache, GetTotalMemoryUse), asCALL_THISCALL);
+    engine->RegisterObjectMethod("ResourceCache", "void set_totalMemoryBudget(uint)", asMETHOD(ResourceCache, SetTotalMemoryBudget), asCALL_THISCALL);
+    engine->RegisterObjectMethod("ResourceCache", "uint get_totalMemoryBudget() const", asMETHOD(ResourceCache, GetTotalMemoryBudget), asCALL_THISCALL);
     engine->RegisterObjectMethod("ResourceCache", "Array<String>@ get_resourceDirs() const", asFUNCTION(ResourceCacheGetResourceDirs), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("ResourceCache", "Array<PackageFile@>@ get_packageFiles() const", asFUNCTION(ResourceCacheGetPackageFiles), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("ResourceCache", "void set_autoReloadResources(bool)", asMETHOD(ResourceCache, SetAutoReloadResources), asCALL_THISCALL);
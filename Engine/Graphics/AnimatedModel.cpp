@@ -42,6 +42,13 @@
 #include "Sort.h"
 #include "VertexBuffer.h"
 
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+
 #include "DebugNew.h"
 
 namespace Urho3D
@@ -54,6 +61,100 @@ static bool CompareAnimationOrder(const SharedPtr<AnimationState>& lhs, const Sh
     return lhs->GetLayer() < rhs->GetLayer();
 }
 
+#ifdef USE_SSE2
+/// Store the three low lanes of a SSE register.
+static inline void StoreVector3(float* dest, __m128 value)
+{
+    _mm_storel_pi((__m64*)dest, value);
+    _mm_store_ss(dest + 2, _mm_movehl_ps(value, value));
+}
+#endif
+
+/// Add weighted morph data to vertex elements.
+static inline void AddMorphData(float* dest, const float* src, unsigned count, float weight)
+{
+#if defined(USE_SSE2)
+    __m128 weightVec = _mm_set1_ps(weight);
+    for (; count >= 4; count -= 4, dest += 4, src += 4)
+        _mm_storeu_ps(dest, _mm_add_ps(_mm_loadu_ps(dest), _mm_mul_ps(_mm_loadu_ps(src), weightVec)));
+#elif defined(USE_NEON)
+    for (; count >= 4; count -= 4, dest += 4, src += 4)
+        vst1q_f32(dest, vmlaq_n_f32(vld1q_f32(dest), vld1q_f32(src), weight));
+#endif
+    for (; count; --count)
+        *dest++ += *src++ * weight;
+}
+
+/// Skin vertex positions to world space with four bone influences per vertex.
+static void SkinPositions(Vector3* dest, const unsigned char* positionData, unsigned positionSize, const unsigned char* blendData,
+    unsigned blendSize, unsigned weightOffset, unsigned indexOffset, unsigned count, const Matrix3x4* skinMatrices)
+{
+    while (count--)
+    {
+        const float* position = (const float*)positionData;
+        const float* weights = (const float*)(blendData + weightOffset);
+        const unsigned char* indices = blendData + indexOffset;
+
+#if defined(USE_SSE2)
+        // Blend the skin matrix rows, then transform the position and sum the row products by transposing them
+        __m128 row0 = _mm_setzero_ps();
+        __m128 row1 = _mm_setzero_ps();
+        __m128 row2 = _mm_setzero_ps();
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            if (weights[i] == 0.0f)
+                continue;
+            const float* matrix = skinMatrices[indices[i]].Data();
+            __m128 weight = _mm_set1_ps(weights[i]);
+            row0 = _mm_add_ps(row0, _mm_mul_ps(_mm_loadu_ps(matrix), weight));
+            row1 = _mm_add_ps(row1, _mm_mul_ps(_mm_loadu_ps(matrix + 4), weight));
+            row2 = _mm_add_ps(row2, _mm_mul_ps(_mm_loadu_ps(matrix + 8), weight));
+        }
+        __m128 pos = _mm_setr_ps(position[0], position[1], position[2], 1.0f);
+        __m128 x = _mm_mul_ps(row0, pos);
+        __m128 y = _mm_mul_ps(row1, pos);
+        __m128 z = _mm_mul_ps(row2, pos);
+        __m128 w = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        StoreVector3(&dest->x_, _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w)));
+#elif defined(USE_NEON)
+        float32x4_t row0 = vdupq_n_f32(0.0f);
+        float32x4_t row1 = vdupq_n_f32(0.0f);
+        float32x4_t row2 = vdupq_n_f32(0.0f);
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            if (weights[i] == 0.0f)
+                continue;
+            const float* matrix = skinMatrices[indices[i]].Data();
+            row0 = vmlaq_n_f32(row0, vld1q_f32(matrix), weights[i]);
+            row1 = vmlaq_n_f32(row1, vld1q_f32(matrix + 4), weights[i]);
+            row2 = vmlaq_n_f32(row2, vld1q_f32(matrix + 8), weights[i]);
+        }
+        float posData[4] = { position[0], position[1], position[2], 1.0f };
+        float32x4_t pos = vld1q_f32(posData);
+        float32x4_t x = vmulq_f32(row0, pos);
+        float32x4_t y = vmulq_f32(row1, pos);
+        float32x4_t z = vmulq_f32(row2, pos);
+        float32x2_t xy = vpadd_f32(vpadd_f32(vget_low_f32(x), vget_high_f32(x)), vpadd_f32(vget_low_f32(y), vget_high_f32(y)));
+        float32x2_t zz = vpadd_f32(vget_low_f32(z), vget_high_f32(z));
+        vst1_f32(&dest->x_, xy);
+        dest->z_ = vget_lane_f32(zz, 0) + vget_lane_f32(zz, 1);
+#else
+        Matrix3x4 skinMatrix(Matrix3x4::ZERO);
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            if (weights[i] != 0.0f)
+                skinMatrix = skinMatrix + skinMatrices[indices[i]] * weights[i];
+        }
+        *dest = skinMatrix * Vector3(position[0], position[1], position[2]);
+#endif
+
+        ++dest;
+        positionData += positionSize;
+        blendData += blendSize;
+    }
+}
+
 OBJECTTYPESTATIC(AnimatedModel);
 
 AnimatedModel::AnimatedModel(Context* context) :
@@ -64,13 +165,18 @@ AnimatedModel::AnimatedModel(Context* context) :
     animationLodTimer_(-1.0f),
     animationLodDistance_(0.0f),
     invisibleLodFactor_(0.0f),
+    boneLodDistance_(0.0f),
+    boneLodSkipLevels_(0),
     animationDirty_(false),
     animationOrderDirty_(false),
     morphsDirty_(false),
     skinningDirty_(true),
     isMaster_(true),
     loading_(false),
-    assignBonesPending_(false)
+    assignBonesPending_(false),
+    animateBoneNodes_(true),
+    syncingBoneNodes_(false),
+    animationLodInterpolation_(false)
 {
 }
 
@@ -93,6 +199,9 @@ void AnimatedModel::RegisterObject(Context* context)
     ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_FLOAT, "LOD Bias", GetLodBias, SetLodBias, float, 1.0f, AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_FLOAT, "Animation LOD Bias", GetAnimationLodBias, SetAnimationLodBias, float, 1.0f, AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_FLOAT, "Invisible Anim LOD", GetInvisibleLodFactor, SetInvisibleLodFactor, float, 0.0f, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_BOOL, "Animate Bone Nodes", GetAnimateBoneNodes, SetAnimateBoneNodes, bool, true, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_FLOAT, "Bone LOD Distance", GetBoneLodDistance, SetBoneLodDistance, float, 0.0f, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_BOOL, "Anim LOD Interpolation", GetAnimationLodInterpolation, SetAnimationLodInterpolation, bool, false, AM_DEFAULT);
     COPY_BASE_ATTRIBUTES(AnimatedModel, Drawable);
     ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_VARIANTVECTOR, "Bone Animation Enabled", GetBonesEnabledAttr, SetBonesEnabledAttr, VariantVector, Variant::emptyVariantVector, AM_FILE | AM_NOEDIT);
     ACCESSOR_ATTRIBUTE(AnimatedModel, VAR_VARIANTVECTOR, "Animation States", GetAnimationStatesAttr, SetAnimationStatesAttr, VariantVector, Variant::emptyVariantVector, AM_FILE);
@@ -127,7 +236,8 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
 {
     // If no bones or no bone-level testing, use the Drawable test
     RayQueryLevel level = query.level_;
-    if (level < RAY_AABB || !skeleton_.GetRootBone() || !skeleton_.GetRootBone()->node_)
+    bool usePose = !animateBoneNodes_ && isMaster_;
+    if (level < RAY_AABB || !skeleton_.GetRootBone() || (!usePose && !skeleton_.GetRootBone()->node_))
     {
         Drawable::ProcessRayQuery(query, results);
         return;
@@ -143,7 +253,7 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
     for (unsigned i = 0; i < bones.Size(); ++i)
     {
         const Bone& bone = bones[i];
-        if (!bone.node_)
+        if (!usePose && !bone.node_)
             continue;
 
         float distance;
@@ -153,7 +263,7 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
         {
             // Do an initial crude test using the bone's AABB
             const BoundingBox& box = bone.boundingBox_;
-            const Matrix3x4& transform = bone.node_->GetWorldTransform();
+            Matrix3x4 transform = usePose ? GetBoneWorldTransform(i) : bone.node_->GetWorldTransform();
             distance = query.ray_.HitDistance(box.Transformed(transform));
             if (distance >= query.maxDistance_)
                 continue;
@@ -169,7 +279,7 @@ void AnimatedModel::ProcessRayQuery(const RayOctreeQuery& query, PODVector<RayQu
         }
         else if (bone.collisionMask_ & BONECOLLISION_SPHERE)
         {
-            boneSphere.center_ = bone.node_->GetWorldPosition();
+            boneSphere.center_ = usePose ? GetBoneWorldTransform(i).Translation() : bone.node_->GetWorldPosition();
             boneSphere.radius_ = bone.radius_;
             distance = query.ray_.HitDistance(boneSphere);
             if (distance >= query.maxDistance_)
@@ -485,6 +595,75 @@ void AnimatedModel::SetInvisibleLodFactor(float factor)
     MarkNetworkUpdate();
 }
 
+void AnimatedModel::SetAnimateBoneNodes(bool enable)
+{
+    if (enable == animateBoneNodes_)
+        return;
+
+    // When returning to bone node animation, continue from the current pose
+    if (enable)
+        SyncBoneNodes();
+    else
+    {
+        boneLodSkipLevels_ = 0;
+        ResetBonePose();
+    }
+    previousPose_.Clear();
+    sampledPose_.Clear();
+
+    animateBoneNodes_ = enable;
+
+    // Bone nodes are not needed for the track mapping when animating the bone pose, so it may become available now
+    for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+    {
+        AnimationState* state = *i;
+        state->SetStartBone(state->GetStartBone());
+    }
+
+    MarkAnimationDirty();
+    MarkNetworkUpdate();
+}
+
+void AnimatedModel::SetBoneLodDistance(float distance)
+{
+    boneLodDistance_ = Max(distance, 0.0f);
+    MarkNetworkUpdate();
+}
+
+void AnimatedModel::SetAnimationLodInterpolation(bool enable)
+{
+    animationLodInterpolation_ = enable;
+    // Interpolation starts over from the next sampled pose
+    previousPose_.Clear();
+    sampledPose_.Clear();
+    MarkNetworkUpdate();
+}
+
+void AnimatedModel::SyncBoneNodes()
+{
+    if (animateBoneNodes_ || !isMaster_)
+        return;
+
+    PROFILE(SyncBoneNodes);
+
+    ApplyBonePoseToNodes();
+}
+
+void AnimatedModel::ApplyBonePoseToNodes()
+{
+    // Setting the transforms dirties the bone nodes, but they do not need to be read back into the pose. Bones that are
+    // not animated are controlled through their nodes, so leave them as is
+    syncingBoneNodes_ = true;
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    for (unsigned i = 0; i < bones.Size() && i < bonePose_.Size(); ++i)
+    {
+        Node* boneNode = bones[i].node_;
+        if (boneNode && bones[i].animated_)
+            boneNode->SetTransform(bonePose_[i].position_, bonePose_[i].rotation_, bonePose_[i].scale_);
+    }
+    syncingBoneNodes_ = false;
+}
+
 void AnimatedModel::SetMorphWeight(unsigned index, float weight)
 {
     if (index >= morphs_.Size())
@@ -634,6 +813,95 @@ AnimationState* AnimatedModel::GetAnimationState(unsigned index) const
     return index < animationStates_.Size() ? animationStates_[index].Get() : 0;
 }
 
+bool AnimatedModel::GetSkinnedPositions(unsigned batchIndex, PODVector<Vector3>& dest)
+{
+    if (batchIndex >= batches_.Size() || batches_[batchIndex].geometryType_ != GEOM_SKINNED || !batches_[batchIndex].geometry_)
+        return false;
+
+    if (morphsDirty_)
+        UpdateMorphs();
+    if (skinningDirty_)
+        UpdateSkinning();
+
+    // The positions may come from a morph vertex buffer, while the blend weights and indices come from the original
+    Geometry* geometry = batches_[batchIndex].geometry_;
+    const unsigned char* positionData;
+    const unsigned char* indexData;
+    unsigned positionSize;
+    unsigned indexSize;
+    unsigned elementMask;
+    geometry->GetRawData(positionData, positionSize, indexData, indexSize, elementMask);
+
+    const unsigned char* blendData = 0;
+    unsigned blendSize = 0;
+    unsigned weightOffset = 0;
+    unsigned indexOffset = 0;
+    const Vector<SharedPtr<VertexBuffer> >& buffers = geometry->GetVertexBuffers();
+    for (unsigned i = 0; i < buffers.Size(); ++i)
+    {
+        VertexBuffer* buffer = buffers[i];
+        if (buffer && buffer->GetShadowData() && (buffer->GetElementMask() & MASK_BLENDWEIGHTS) &&
+            (buffer->GetElementMask() & MASK_BLENDINDICES))
+        {
+            blendData = buffer->GetShadowData();
+            blendSize = buffer->GetVertexSize();
+            weightOffset = buffer->GetElementOffset(ELEMENT_BLENDWEIGHTS);
+            indexOffset = buffer->GetElementOffset(ELEMENT_BLENDINDICES);
+            break;
+        }
+    }
+
+    if (!positionData || !blendData)
+        return false;
+
+    // Use the same skin matrices as the shader
+    unsigned vertexStart = geometry->GetVertexStart();
+    unsigned vertexCount = geometry->GetVertexCount();
+    dest.Resize(vertexStart + vertexCount);
+    if (vertexCount)
+    {
+        SkinPositions(&dest[vertexStart], positionData + vertexStart * positionSize, positionSize, blendData + vertexStart *
+            blendSize, blendSize, weightOffset, indexOffset, vertexCount, reinterpret_cast<const Matrix3x4*>(batches_[batchIndex].shaderData_));
+    }
+
+    return true;
+}
+
+float AnimatedModel::GetSkinnedHitDistance(const Ray& ray)
+{
+    float distance = M_INFINITY;
+    if (ray.HitDistance(GetWorldBoundingBox()) == M_INFINITY)
+        return distance;
+
+    PODVector<Vector3> positions;
+    for (unsigned i = 0; i < batches_.Size(); ++i)
+    {
+        if (!GetSkinnedPositions(i, positions) || positions.Empty())
+            continue;
+
+        Geometry* geometry = batches_[i].geometry_;
+        const unsigned char* vertexData;
+        const unsigned char* indexData;
+        unsigned vertexSize;
+        unsigned indexSize;
+        unsigned elementMask;
+        geometry->GetRawData(vertexData, vertexSize, indexData, indexSize, elementMask);
+
+        if (indexData)
+        {
+            distance = Min(distance, ray.HitDistance(&positions[0], sizeof(Vector3), indexData, indexSize,
+                geometry->GetIndexStart(), geometry->GetIndexCount()));
+        }
+        else
+        {
+            distance = Min(distance, ray.HitDistance(&positions[0], sizeof(Vector3), geometry->GetVertexStart(),
+                geometry->GetVertexCount()));
+        }
+    }
+
+    return distance;
+}
+
 void AnimatedModel::SetSkeleton(const Skeleton& skeleton, bool createBones)
 {
     if (!node_ && createBones)
@@ -742,8 +1010,12 @@ void AnimatedModel::SetSkeleton(const Skeleton& skeleton, bool createBones)
         }
     }
 
-    // Reserve space for skinning matrices
+    // Reserve space for skinning matrices and the bone pose
     skinMatrices_.Resize(skeleton_.GetNumBones());
+    boneTransforms_.Resize(skeleton_.GetNumBones());
+    SetBoneOrder();
+    ResetBonePose();
+    UpdateBoneTransforms();
     SetGeometryBoneMappings();
 
     assignBonesPending_ = !createBones;
@@ -860,6 +1132,15 @@ void AnimatedModel::OnMarkedDirty(Node* node)
 
     // If the scene node or any of the bone nodes move, mark skinning dirty
     skinningDirty_ = true;
+
+    // When animating the bone pose, a bone node moved by other means than syncing may control a bone that is not animated,
+    // so the pose needs to be recalculated. This can not be queued during the threaded drawable update
+    if (!animateBoneNodes_ && node != node_ && !syncingBoneNodes_)
+    {
+        Scene* scene = GetScene();
+        if (!scene || !scene->IsThreadedUpdate())
+            MarkAnimationDirty();
+    }
 }
 
 void AnimatedModel::OnWorldBoundingBoxUpdate()
@@ -872,6 +1153,20 @@ void AnimatedModel::OnWorldBoundingBoxUpdate()
         worldBoundingBox_.defined_ = false;
 
         const Vector<Bone>& bones = skeleton_.GetBones();
+
+        if (!animateBoneNodes_ && isMaster_)
+        {
+            for (unsigned i = 0; i < bones.Size(); ++i)
+            {
+                const Bone& bone = bones[i];
+                if (bone.collisionMask_ & BONECOLLISION_BOX)
+                    worldBoundingBox_.Merge(bone.boundingBox_.Transformed(GetBoneWorldTransform(i)));
+                else if (bone.collisionMask_ & BONECOLLISION_SPHERE)
+                    worldBoundingBox_.Merge(Sphere(GetBoneWorldTransform(i).Translation(), bone.radius_ * 0.5f));
+            }
+            return;
+        }
+
         for (Vector<Bone>::ConstIterator i = bones.Begin(); i != bones.End(); ++i)
         {
             Node* boneNode = i->node_;
@@ -923,6 +1218,137 @@ void AnimatedModel::AssignBoneNodes()
     MarkAnimationDirty();
 }
 
+void AnimatedModel::SetBoneOrder()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    unsigned numBones = bones.Size();
+    boneOrder_.Clear();
+    boneOrder_.Reserve(numBones);
+
+    // Bones are usually already in parent-first order, but this is not guaranteed. Add a bone when its parent has been
+    // added; each pass adds at least one more level of the hierarchy
+    PODVector<bool> added(numBones);
+    for (unsigned i = 0; i < numBones; ++i)
+        added[i] = false;
+
+    while (boneOrder_.Size() < numBones)
+    {
+        unsigned oldSize = boneOrder_.Size();
+        for (unsigned i = 0; i < numBones; ++i)
+        {
+            if (added[i])
+                continue;
+            unsigned parentIndex = bones[i].parentIndex_;
+            if (parentIndex == i || parentIndex >= numBones || added[parentIndex])
+            {
+                boneOrder_.Push(i);
+                added[i] = true;
+            }
+        }
+
+        // Bones in a parent cycle can never be added: treat them as root bones
+        if (boneOrder_.Size() == oldSize)
+        {
+            LOGWARNING("Cyclic bone hierarchy in model " + (model_ ? model_->GetName() : String::EMPTY));
+            for (unsigned i = 0; i < numBones; ++i)
+            {
+                if (!added[i])
+                    boneOrder_.Push(i);
+            }
+        }
+    }
+
+    // Calculate the bone heights for bone LOD in child-first order. Root bones are never skipped
+    boneHeights_.Resize(numBones);
+    for (unsigned i = 0; i < numBones; ++i)
+        boneHeights_[i] = 0;
+    for (int i = boneOrder_.Size() - 1; i >= 0; --i)
+    {
+        unsigned index = boneOrder_[i];
+        unsigned parentIndex = bones[index].parentIndex_;
+        if (parentIndex != index && parentIndex < numBones)
+        {
+            if (boneHeights_[parentIndex] <= boneHeights_[index])
+                boneHeights_[parentIndex] = boneHeights_[index] + 1;
+        }
+        else
+            boneHeights_[index] = M_MAX_UNSIGNED;
+    }
+}
+
+void AnimatedModel::ResetBonePose()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    // Bones skipped by bone LOD keep their previous pose, unless there is none yet
+    unsigned skipLevels = bonePose_.Size() == bones.Size() ? boneLodSkipLevels_ : 0;
+    bonePose_.Resize(bones.Size());
+
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        if (boneHeights_[i] < skipLevels)
+            continue;
+
+        const Bone& bone = bones[i];
+        BoneTransform& transform = bonePose_[i];
+        Node* boneNode = bone.node_;
+
+        if (!bone.animated_ && boneNode)
+        {
+            transform.position_ = boneNode->GetPosition();
+            transform.rotation_ = boneNode->GetRotation();
+            transform.scale_ = boneNode->GetScale();
+        }
+        else
+        {
+            transform.position_ = bone.initialPosition_;
+            transform.rotation_ = bone.initialRotation_;
+            transform.scale_ = bone.initialScale_;
+        }
+    }
+}
+
+void AnimatedModel::InterpolateBonePose(float t)
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    t = Clamp(t, 0.0f, 1.0f);
+
+    for (unsigned i = 0; i < bonePose_.Size(); ++i)
+    {
+        // Manually controlled bones follow their bone node without delay
+        if (!bones[i].animated_ && bones[i].node_)
+            continue;
+
+        const BoneTransform& previous = previousPose_[i];
+        const BoneTransform& sampled = sampledPose_[i];
+        BoneTransform& transform = bonePose_[i];
+        transform.position_ = previous.position_.Lerp(sampled.position_, t);
+        transform.rotation_ = previous.rotation_.Slerp(sampled.rotation_, t);
+        transform.scale_ = previous.scale_.Lerp(sampled.scale_, t);
+    }
+}
+
+void AnimatedModel::UpdateBoneTransforms()
+{
+    const Vector<Bone>& bones = skeleton_.GetBones();
+    unsigned numBones = bones.Size();
+
+    for (unsigned i = 0; i < boneOrder_.Size(); ++i)
+    {
+        unsigned index = boneOrder_[i];
+        const BoneTransform& transform = bonePose_[index];
+        unsigned parentIndex = bones[index].parentIndex_;
+
+        // Root bones are relative to the model's scene node, like the root bone node would be
+        if (parentIndex != index && parentIndex < numBones)
+        {
+            boneTransforms_[index] = boneTransforms_[parentIndex] * Matrix3x4(transform.position_, transform.rotation_,
+                transform.scale_);
+        }
+        else
+            boneTransforms_[index] = Matrix3x4(transform.position_, transform.rotation_, transform.scale_);
+    }
+}
+
 void AnimatedModel::MarkAnimationDirty()
 {
     if (isMaster_)
@@ -1096,21 +1522,46 @@ void AnimatedModel::SetGeometryBoneMappings()
 
 void AnimatedModel::UpdateAnimation(const FrameInfo& frame)
 {
+    bool interpolate = false;
+
     // If using animation LOD, accumulate time and see if it is time to update
     if (animationLodBias_ > 0.0f && animationLodDistance_ > 0.0f)
     {
         // Check for first time update
         if (animationLodTimer_ >= 0.0f)
         {
-            animationLodTimer_ += animationLodBias_ * frame.timeStep_ * ANIMATION_LOD_BASESCALE;
+            float lodTime = animationLodBias_ * frame.timeStep_ * ANIMATION_LOD_BASESCALE;
+            // Interpolate the bone pose only when not updating on every frame
+            interpolate = animationLodInterpolation_ && !animateBoneNodes_ && lodTime < animationLodDistance_;
+            animationLodTimer_ += lodTime;
             if (animationLodTimer_ >= animationLodDistance_)
                 animationLodTimer_ = fmodf(animationLodTimer_, animationLodDistance_);
             else
+            {
+                if (interpolate && sampledPose_.Size() == bonePose_.Size())
+                {
+                    InterpolateBonePose(animationLodTimer_ / animationLodDistance_);
+                    FinishBonePoseUpdate(frame);
+                }
                 return;
+            }
         }
         else
-            animationLodTimer_ = 0.0f;
+        {
+            // Start at a phase derived from the node ID, so that models which share the same update interval do not all
+            // update on the same frame
+            unsigned phase = (node_->GetID() * 2654435761u) >> 16 & 0xffff;
+            animationLodTimer_ = animationLodDistance_ * phase / 65536.0f;
+        }
+
+        // Leave a further level of leaf bones unanimated at each multiple of the bone LOD distance
+        if (boneLodDistance_ > 0.0f)
+            boneLodSkipLevels_ = (unsigned)Min(animationLodDistance_ / boneLodDistance_, (float)skeleton_.GetNumBones());
+        else
+            boneLodSkipLevels_ = 0;
     }
+    else
+        boneLodSkipLevels_ = 0;
 
     // Make sure animations are in ascending priority order
     if (animationOrderDirty_)
@@ -1120,9 +1571,38 @@ void AnimatedModel::UpdateAnimation(const FrameInfo& frame)
     }
 
     // Reset skeleton, then apply all animations
-    skeleton_.Reset();
-    for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
-        (*i)->Apply();
+    if (animateBoneNodes_)
+    {
+        skeleton_.Reset();
+        for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+            (*i)->Apply();
+    }
+    else
+    {
+        // Blend into the bone pose without touching the bone nodes, then calculate the bone transforms in one pass
+        ResetBonePose();
+        for (Vector<SharedPtr<AnimationState> >::Iterator i = animationStates_.Begin(); i != animationStates_.End(); ++i)
+            (*i)->Apply();
+
+        // When interpolating, blend from the previously sampled pose towards the new one until the next update
+        if (interpolate)
+        {
+            if (sampledPose_.Size() != bonePose_.Size())
+                sampledPose_ = bonePose_;
+            previousPose_ = sampledPose_;
+            sampledPose_ = bonePose_;
+            InterpolateBonePose(animationLodTimer_ / animationLodDistance_);
+        }
+        else
+        {
+            previousPose_.Clear();
+            sampledPose_.Clear();
+        }
+
+        FinishBonePoseUpdate(frame);
+        animationDirty_ = false;
+        return;
+    }
 
     // Animation has changed the bounding box: mark node for octree reinsertion
     Drawable::OnMarkedDirty(node_);
@@ -1131,6 +1611,33 @@ void AnimatedModel::UpdateAnimation(const FrameInfo& frame)
     animationDirty_ = false;
 }
 
+void AnimatedModel::FinishBonePoseUpdate(const FrameInfo& frame)
+{
+    UpdateBoneTransforms();
+    skinningDirty_ = true;
+
+    // Non-master models skin themselves using the bone nodes, so keep writing the pose into the bone nodes while there are
+    // any. Bone nodes are also written by the animations in the threaded update when bone node animation is enabled
+    const Vector<SharedPtr<Component> >& components = node_->GetComponents();
+    for (Vector<SharedPtr<Component> >::ConstIterator i = components.Begin(); i != components.End(); ++i)
+    {
+        if (*i != this && (*i)->GetType() == AnimatedModel::GetTypeStatic())
+        {
+            ApplyBonePoseToNodes();
+            break;
+        }
+    }
+
+    // The bone pose has changed the bounding box: mark node for octree reinsertion
+    Drawable::OnMarkedDirty(node_);
+    GetWorldBoundingBox();
+
+    // The bone pose is private to the model, so if the model was visible last frame and is likely to be rendered, calculate
+    // the skinning here as well. If the scene node is moved after the update, skinning will be recalculated for rendering
+    if (frame.camera_ && abs((int)frame.frameNumber_ - (int)viewFrameNumber_) <= 1)
+        UpdateSkinning();
+}
+
 void AnimatedModel::UpdateSkinning()
 {
     // Note: the model's world transform will be baked in the skin matrices
@@ -1138,8 +1645,22 @@ void AnimatedModel::UpdateSkinning()
     // Use model's world transform in case a bone is missing
     const Matrix3x4& worldTransform = node_->GetWorldTransform();
 
+    // Skinning from the bone pose
+    if (!animateBoneNodes_ && isMaster_)
+    {
+        for (unsigned i = 0; i < bones.Size(); ++i)
+        {
+            skinMatrices_[i] = worldTransform * boneTransforms_[i] * bones[i].offsetMatrix_;
+
+            if (geometrySkinMatrices_.Size())
+            {
+                for (unsigned j = 0; j < geometrySkinMatrixPtrs_[i].Size(); ++j)
+                    *geometrySkinMatrixPtrs_[i][j] = skinMatrices_[i];
+            }
+        }
+    }
     // Skinning with global matrices only
-    if (!geometrySkinMatrices_.Size())
+    else if (!geometrySkinMatrices_.Size())
     {
         for (unsigned i = 0; i < bones.Size(); ++i)
         {
@@ -1172,10 +1693,7 @@ void AnimatedModel::UpdateSkinning()
 
 void AnimatedModel::UpdateMorphs()
 {
-    Graphics* graphics = GetSubsystem<Graphics>();
-    if (!graphics)
-        return;
-
+    // The morph vertex buffers are shadowed, so morphs can be applied also without graphics for CPU skinning
     if (morphs_.Size())
     {
         // Reset the morph data range from all morphable vertex buffers, then apply morphs
@@ -1225,38 +1743,37 @@ void AnimatedModel::ApplyMorph(VertexBuffer* buffer, void* destVertexData, unsig
     unsigned char* srcData = morph.morphData_;
     unsigned char* destData = (unsigned char*)destVertexData;
 
+    // Offsets of the morphed elements within the vertex, in the order they are stored in the morph data
+    unsigned elementOffsets[3];
+    unsigned numElements = 0;
+    if (elementMask & MASK_POSITION)
+        elementOffsets[numElements++] = 0;
+    if (elementMask & MASK_NORMAL)
+        elementOffsets[numElements++] = normalOffset;
+    if (elementMask & MASK_TANGENT)
+        elementOffsets[numElements++] = tangentOffset;
+
+    // If the elements follow each other in the vertex like in the morph data, they can be processed as one run
+    bool contiguous = true;
+    for (unsigned i = 0; i < numElements; ++i)
+    {
+        if (elementOffsets[i] != i * 3 * sizeof(float))
+            contiguous = false;
+    }
+
     while (vertexCount--)
     {
-        unsigned vertexIndex = *((unsigned*)srcData) - morphRangeStart;
+        unsigned char* vertex = destData + (*((unsigned*)srcData) - morphRangeStart) * vertexSize;
         srcData += sizeof(unsigned);
 
-        if (elementMask & MASK_POSITION)
-        {
-            float* dest = (float*)(destData + vertexIndex * vertexSize);
-            float* src = (float*)srcData;
-            dest[0] += src[0] * weight;
-            dest[1] += src[1] * weight;
-            dest[2] += src[2] * weight;
-            srcData += 3 * sizeof(float);
-        }
-        if (elementMask & MASK_NORMAL)
-        {
-            float* dest = (float*)(destData + vertexIndex * vertexSize + normalOffset);
-            float* src = (float*)srcData;
-            dest[0] += src[0] * weight;
-            dest[1] += src[1] * weight;
-            dest[2] += src[2] * weight;
-            srcData += 3 * sizeof(float);
-        }
-        if (elementMask & MASK_TANGENT)
+        if (contiguous)
+            AddMorphData((float*)vertex, (const float*)srcData, numElements * 3, weight);
+        else
         {
-            float* dest = (float*)(destData + vertexIndex * vertexSize + tangentOffset);
-            float* src = (float*)srcData;
-            dest[0] += src[0] * weight;
-            dest[1] += src[1] * weight;
-            dest[2] += src[2] * weight;
-            srcData += 3 * sizeof(float);
+            for (unsigned i = 0; i < numElements; ++i)
+                AddMorphData((float*)(vertex + elementOffsets[i]), (const float*)srcData + i * 3, 3, weight);
         }
+        srcData += numElements * 3 * sizeof(float);
     }
 }
 
@@ -31,6 +31,7 @@ namespace Urho3D
 
 class Animation;
 class AnimationState;
+class Ray;
 
 /// Animated model component.
 class AnimatedModel : public StaticModel
@@ -86,6 +87,14 @@ public:
     void SetAnimationLodBias(float bias);
     /// Set animation LOD distance factor when not visible (default 0 = do not update at all when invisible.)
     void SetInvisibleLodFactor(float factor);
+    /// Set whether animation is applied to the bone scene nodes (default true.) When disabled, animations are blended into a bone pose stored in the model, and the bone nodes are only updated by SyncBoneNodes(), or on each animation update if the node has non-master models.
+    void SetAnimateBoneNodes(bool enable);
+    /// Copy the bone pose to the bone scene nodes. Only needed when bone node animation is disabled.
+    void SyncBoneNodes();
+    /// Set animation LOD distance at which each further level of leaf bones is left unanimated (default 0 = disabled.) Only used when bone node animation is disabled.
+    void SetBoneLodDistance(float distance);
+    /// Set whether to interpolate the bone pose on frames between animation LOD updates (default false.) Only used when bone node animation is disabled. Delays the animation by one update interval.
+    void SetAnimationLodInterpolation(bool enable);
     /// Set vertex morph weight by index.
     void SetMorphWeight(unsigned index, float weight);
     /// Set vertex morph weight by name.
@@ -115,6 +124,14 @@ public:
     float GetAnimationLodBias() const { return animationLodBias_; }
     /// Return animation LOD distance factor when not visible.
     float GetInvisibleLodFactor() const { return invisibleLodFactor_; }
+    /// Return whether animation is applied to the bone scene nodes.
+    bool GetAnimateBoneNodes() const { return animateBoneNodes_; }
+    /// Return animation LOD distance per unanimated level of leaf bones.
+    float GetBoneLodDistance() const { return boneLodDistance_; }
+    /// Return whether the bone pose is interpolated between animation LOD updates.
+    bool GetAnimationLodInterpolation() const { return animationLodInterpolation_; }
+    /// Return bone pose transforms relative to the model's scene node. Updated only when bone node animation is disabled.
+    const PODVector<Matrix3x4>& GetBoneTransforms() const { return boneTransforms_; }
     /// Return all vertex morphs.
     const Vector<ModelMorph>& GetMorphs() const { return morphs_; }
     /// Return all morph vertex buffers.
@@ -129,6 +146,10 @@ public:
     float GetMorphWeight(StringHash nameHash) const;
     /// Return whether is the master (first) animated model.
     bool IsMaster() const { return isMaster_; }
+    /// Calculate the world space vertex positions of a batch's geometry with the current skinning and vertex morphs on the CPU. The positions are stored at their vertex index, so that the geometry's index data applies to them, but only the geometry's vertex range is written. Return true if successful.
+    bool GetSkinnedPositions(unsigned batchIndex, PODVector<Vector3>& dest);
+    /// Return distance to the nearest skinned triangle using CPU skinning, or infinity if no hit.
+    float GetSkinnedHitDistance(const Ray& ray);
 
     /// Set model attribute.
     void SetModelAttr(ResourceRef value);
@@ -170,6 +191,18 @@ private:
     void MarkMorphsDirty();
     /// Set skeleton.
     void SetSkeleton(const Skeleton& skeleton, bool createBones);
+    /// Calculate the parent-first bone order and the bone heights for the bone pose.
+    void SetBoneOrder();
+    /// Reset the bone pose. Bones that are not animated take their transform from the bone node, if it exists.
+    void ResetBonePose();
+    /// Return whether a bone is left unanimated by bone LOD.
+    bool IsBoneLodSkipped(unsigned index) const { return boneHeights_[index] < boneLodSkipLevels_; }
+    /// Interpolate the bone pose between the two latest sampled poses.
+    void InterpolateBonePose(float t);
+    /// Calculate the bone pose transforms relative to the model's scene node in a single pass over the bone hierarchy.
+    void UpdateBoneTransforms();
+    /// Return world transform of a bone from the bone pose.
+    Matrix3x4 GetBoneWorldTransform(unsigned index) const { return node_->GetWorldTransform() * boneTransforms_[index]; }
     /// Set mapping of subgeometry bone indices.
     void SetGeometryBoneMappings();
     /// Clone geometries for vertex morphing.
@@ -178,6 +211,10 @@ private:
     void CopyMorphVertices(void* dest, void* src, unsigned vertexCount, VertexBuffer* clone, VertexBuffer* original);
     /// Recalculate animations. Called from Update().
     void UpdateAnimation(const FrameInfo& frame);
+    /// Finish a bone pose update: calculate the bone transforms, bounding box, and skinning if likely to be rendered.
+    void FinishBonePoseUpdate(const FrameInfo& frame);
+    /// Copy the animated bones of the bone pose to the bone scene nodes. Does not profile, so can be called from worker threads.
+    void ApplyBonePoseToNodes();
     /// Recalculate skinning.
     void UpdateSkinning();
     /// Reapply all vertex morphs.
@@ -203,6 +240,18 @@ private:
     Vector<PODVector<Matrix3x4> > geometrySkinMatrices_;
     /// Subgeometry skinning matrix pointers, if more bones than skinning shader can manage.
     Vector<PODVector<Matrix3x4*> > geometrySkinMatrixPtrs_;
+    /// Bone pose local transforms, used when bone node animation is disabled.
+    PODVector<BoneTransform> bonePose_;
+    /// Bone pose transforms relative to the model's scene node.
+    PODVector<Matrix3x4> boneTransforms_;
+    /// Bone indices ordered so that parents come before their children.
+    PODVector<unsigned> boneOrder_;
+    /// Bone heights in the hierarchy for bone LOD. Leaf bones have height 0, root bones are never skipped.
+    PODVector<unsigned> boneHeights_;
+    /// Bone pose sampled on the previous animation LOD update, used for interpolation.
+    PODVector<BoneTransform> previousPose_;
+    /// Bone pose sampled on the latest animation LOD update, used for interpolation.
+    PODVector<BoneTransform> sampledPose_;
    /// Attribute buffer.
     mutable VectorBuffer attrBuffer_;
     /// The frame number animation LOD distance was last calculated on.
@@ -217,6 +266,10 @@ private:
     float animationLodDistance_;
     /// Animation LOD distance factor when not visible.
     float invisibleLodFactor_;
+    /// Animation LOD distance per unanimated level of leaf bones.
+    float boneLodDistance_;
+    /// Number of leaf bone levels left unanimated on the current update.
+    unsigned boneLodSkipLevels_;
     /// Animation dirty flag.
     bool animationDirty_;
     /// Animation order dirty flag.
@@ -231,6 +284,12 @@ private:
     bool loading_;
     /// Bone nodes assignment pending flag.
     bool assignBonesPending_;
+    /// Bone node animation flag.
+    bool animateBoneNodes_;
+    /// Bone node sync in progress flag.
+    bool syncingBoneNodes_;
+    /// Bone pose interpolation between animation LOD updates flag.
+    bool animationLodInterpolation_;
 };
 
 }
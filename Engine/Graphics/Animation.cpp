@@ -36,11 +36,128 @@
 namespace Urho3D
 {
 
+/// Maximum value of quantized time, position and scale.
+static const float QUANTIZE_MAX = 65535.0f;
+/// Maximum value of a quantized rotation component.
+static const float ROTATION_QUANTIZE_MAX = 32767.0f;
+/// Square root of two.
+static const float SQRT_2 = 1.41421356f;
+/// Maximum number of keyframes in a compressed track, as the keyframe lookup table is 16-bit.
+static const unsigned MAX_COMPRESSED_KEYFRAMES = 65536;
+
 inline bool CompareTriggers(AnimationTriggerPoint& lhs, AnimationTriggerPoint& rhs)
 {
     return lhs.time_ < rhs.time_;
 }
 
+static unsigned GetKeyStride(unsigned char channelMask)
+{
+    unsigned stride = 0;
+    if (channelMask & CHANNEL_POSITION)
+        stride += 3;
+    if (channelMask & CHANNEL_ROTATION)
+        stride += 3;
+    if (channelMask & CHANNEL_SCALE)
+        stride += 3;
+    return stride;
+}
+
+static unsigned short QuantizeValue(float value, float min, float range)
+{
+    return range > 0.0f ? (unsigned short)(Clamp((value - min) / range, 0.0f, 1.0f) * QUANTIZE_MAX + 0.5f) : 0;
+}
+
+static void QuantizeVector(unsigned short* dest, const Vector3& value, const Vector3& min, const Vector3& range)
+{
+    dest[0] = QuantizeValue(value.x_, min.x_, range.x_);
+    dest[1] = QuantizeValue(value.y_, min.y_, range.y_);
+    dest[2] = QuantizeValue(value.z_, min.z_, range.z_);
+}
+
+static Vector3 DequantizeVector(const unsigned short* src, const Vector3& min, const Vector3& range)
+{
+    const float scale = 1.0f / QUANTIZE_MAX;
+    return Vector3(min.x_ + src[0] * scale * range.x_, min.y_ + src[1] * scale * range.y_, min.z_ + src[2] * scale *
+        range.z_);
+}
+
+static void QuantizeRotation(unsigned short* dest, const Quaternion& rotation)
+{
+    // Store the three smallest components. The largest can be reconstructed, as the quaternion is unit length
+    Quaternion normalized = rotation.Normalized();
+    const float* src = normalized.Data();
+    unsigned largest = 0;
+    for (unsigned i = 1; i < 4; ++i)
+    {
+        if (Abs(src[i]) > Abs(src[largest]))
+            largest = i;
+    }
+    
+    // A negated quaternion represents the same rotation, so make the largest component positive to not need its sign
+    float sign = src[largest] < 0.0f ? -1.0f : 1.0f;
+    unsigned j = 0;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        // The smaller components are in range [-1 / sqrt(2), 1 / sqrt(2)]
+        float value = Clamp(src[i] * sign / SQRT_2 + 0.5f, 0.0f, 1.0f);
+        dest[j++] = (unsigned short)(value * ROTATION_QUANTIZE_MAX + 0.5f);
+    }
+    
+    // Store the index of the largest component in the high bits
+    dest[0] |= (largest & 1) << 15;
+    dest[1] |= (largest >> 1) << 15;
+}
+
+static Quaternion DequantizeRotation(const unsigned short* src)
+{
+    const float scale = 2.0f / (ROTATION_QUANTIZE_MAX * SQRT_2);
+    const float offset = 1.0f / SQRT_2;
+    float a = (src[0] & 0x7fff) * scale - offset;
+    float b = (src[1] & 0x7fff) * scale - offset;
+    float c = src[2] * scale - offset;
+    float largest = sqrtf(Max(1.0f - a * a - b * b - c * c, 0.0f));
+    
+    switch ((src[0] >> 15) | ((src[1] >> 15) << 1))
+    {
+    case 0:
+        return Quaternion(largest, a, b, c);
+        
+    case 1:
+        return Quaternion(a, largest, b, c);
+        
+    case 2:
+        return Quaternion(a, b, largest, c);
+        
+    default:
+        return Quaternion(a, b, c, largest);
+    }
+}
+
+static float GetRotationError(const Quaternion& lhs, const Quaternion& rhs)
+{
+    return 2.0f * acosf(Min(Abs(lhs.DotProduct(rhs)), 1.0f));
+}
+
+static bool IsInterpolated(const AnimationKeyFrame& start, const AnimationKeyFrame& end, const AnimationKeyFrame& keyFrame,
+    unsigned char channelMask, float positionError, float rotationError)
+{
+    float timeInterval = end.time_ - start.time_;
+    float t = timeInterval > 0.0f ? (keyFrame.time_ - start.time_) / timeInterval : 1.0f;
+    
+    if (channelMask & CHANNEL_POSITION && (start.position_.Lerp(end.position_, t) - keyFrame.position_).Length() >
+        positionError)
+        return false;
+    if (channelMask & CHANNEL_ROTATION && GetRotationError(start.rotation_.Slerp(end.rotation_, t), keyFrame.rotation_) >
+        rotationError)
+        return false;
+    if (channelMask & CHANNEL_SCALE && (start.scale_.Lerp(end.scale_, t) - keyFrame.scale_).Length() > positionError)
+        return false;
+    
+    return true;
+}
+
 void AnimationTrack::GetKeyFrameIndex(float time, unsigned& index) const
 {
     if (time < 0.0f)
@@ -58,11 +175,259 @@ void AnimationTrack::GetKeyFrameIndex(float time, unsigned& index) const
         ++index;
 }
 
+bool AnimationTrack::Sample(float time, float length, bool looped, unsigned& index, Vector3& position, Quaternion& rotation,
+    Vector3& scale) const
+{
+    if (!compressed_)
+    {
+        if (keyFrames_.Empty())
+            return false;
+        
+        GetKeyFrameIndex(time, index);
+        
+        // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
+        unsigned nextIndex = index + 1;
+        bool interpolate = true;
+        if (nextIndex >= keyFrames_.Size())
+        {
+            if (!looped)
+            {
+                nextIndex = index;
+                interpolate = false;
+            }
+            else
+                nextIndex = 0;
+        }
+        
+        const AnimationKeyFrame& keyFrame = keyFrames_[index];
+        
+        if (!interpolate)
+        {
+            position = keyFrame.position_;
+            rotation = keyFrame.rotation_;
+            scale = keyFrame.scale_;
+        }
+        else
+        {
+            const AnimationKeyFrame& nextKeyFrame = keyFrames_[nextIndex];
+            float timeInterval = nextKeyFrame.time_ - keyFrame.time_;
+            if (timeInterval < 0.0f)
+                timeInterval += length;
+            float t = timeInterval > 0.0f ? (time - keyFrame.time_) / timeInterval : 1.0f;
+            
+            if (channelMask_ & CHANNEL_POSITION)
+                position = keyFrame.position_.Lerp(nextKeyFrame.position_, t);
+            if (channelMask_ & CHANNEL_ROTATION)
+                rotation = keyFrame.rotation_.Slerp(nextKeyFrame.rotation_, t);
+            if (channelMask_ & CHANNEL_SCALE)
+                scale = keyFrame.scale_.Lerp(nextKeyFrame.scale_, t);
+        }
+        
+        return true;
+    }
+    
+    if (constantMask_ & CHANNEL_POSITION)
+        position = constantValue_.position_;
+    if (constantMask_ & CHANNEL_ROTATION)
+        rotation = constantValue_.rotation_;
+    if (constantMask_ & CHANNEL_SCALE)
+        scale = constantValue_.scale_;
+    
+    unsigned numKeyFrames = keyTimes_.Size();
+    if (!numKeyFrames)
+        return constantMask_ != 0;
+    
+    // Find the keyframe from the lookup table, then check the few keyframes within the same time block
+    float quantizedTime = Clamp(length > 0.0f ? time * QUANTIZE_MAX / length : 0.0f, 0.0f, QUANTIZE_MAX);
+    unsigned keyIndex = keyLookup_[(unsigned)(quantizedTime * numKeyFrames / (QUANTIZE_MAX + 1.0f))];
+    while (keyIndex + 1 < numKeyFrames && quantizedTime >= keyTimes_[keyIndex + 1])
+        ++keyIndex;
+    
+    unsigned nextIndex = keyIndex + 1;
+    bool interpolate = true;
+    if (nextIndex >= numKeyFrames)
+    {
+        if (!looped)
+        {
+            nextIndex = keyIndex;
+            interpolate = false;
+        }
+        else
+            nextIndex = 0;
+    }
+    
+    unsigned char animatedMask = channelMask_ & ~constantMask_;
+    unsigned stride = GetKeyStride(animatedMask);
+    const unsigned short* keyData = &keyData_[keyIndex * stride];
+    const unsigned short* nextKeyData = &keyData_[nextIndex * stride];
+    float t = 0.0f;
+    
+    if (interpolate)
+    {
+        float timeInterval = (float)keyTimes_[nextIndex] - (float)keyTimes_[keyIndex];
+        if (timeInterval < 0.0f)
+            timeInterval += QUANTIZE_MAX;
+        t = timeInterval > 0.0f ? (quantizedTime - keyTimes_[keyIndex]) / timeInterval : 1.0f;
+    }
+    
+    if (animatedMask & CHANNEL_POSITION)
+    {
+        position = DequantizeVector(keyData, positionMin_, positionRange_);
+        if (interpolate)
+            position = position.Lerp(DequantizeVector(nextKeyData, positionMin_, positionRange_), t);
+        keyData += 3;
+        nextKeyData += 3;
+    }
+    if (animatedMask & CHANNEL_ROTATION)
+    {
+        rotation = DequantizeRotation(keyData);
+        if (interpolate)
+            rotation = rotation.Slerp(DequantizeRotation(nextKeyData), t);
+        keyData += 3;
+        nextKeyData += 3;
+    }
+    if (animatedMask & CHANNEL_SCALE)
+    {
+        scale = DequantizeVector(keyData, scaleMin_, scaleRange_);
+        if (interpolate)
+            scale = scale.Lerp(DequantizeVector(nextKeyData, scaleMin_, scaleRange_), t);
+    }
+    
+    return true;
+}
+
+bool AnimationTrack::Compress(float length, float positionError, float rotationError)
+{
+    if (compressed_)
+        return true;
+    
+    compressed_ = true;
+    constantMask_ = 0;
+    keyTimes_.Clear();
+    keyData_.Clear();
+    keyLookup_.Clear();
+    
+    if (keyFrames_.Empty())
+        return true;
+    
+    // Remove channels that stay constant within the allowed error
+    const AnimationKeyFrame& firstKeyFrame = keyFrames_[0];
+    constantValue_ = firstKeyFrame;
+    constantMask_ = channelMask_;
+    for (unsigned i = 1; i < keyFrames_.Size(); ++i)
+    {
+        const AnimationKeyFrame& keyFrame = keyFrames_[i];
+        if ((keyFrame.position_ - firstKeyFrame.position_).Length() > positionError)
+            constantMask_ &= ~CHANNEL_POSITION;
+        if (GetRotationError(keyFrame.rotation_, firstKeyFrame.rotation_) > rotationError)
+            constantMask_ &= ~CHANNEL_ROTATION;
+        if ((keyFrame.scale_ - firstKeyFrame.scale_).Length() > positionError)
+            constantMask_ &= ~CHANNEL_SCALE;
+    }
+    
+    unsigned char animatedMask = channelMask_ & ~constantMask_;
+    if (animatedMask)
+    {
+        // Keep only the keyframes that can not be interpolated from the previous kept keyframe and a later keyframe
+        PODVector<unsigned> keptKeyFrames;
+        keptKeyFrames.Push(0);
+        unsigned start = 0;
+        for (unsigned end = 2; end < keyFrames_.Size(); ++end)
+        {
+            for (unsigned i = start + 1; i < end; ++i)
+            {
+                if (!IsInterpolated(keyFrames_[start], keyFrames_[end], keyFrames_[i], animatedMask, positionError,
+                    rotationError))
+                {
+                    start = end - 1;
+                    keptKeyFrames.Push(start);
+                    break;
+                }
+            }
+        }
+        if (keyFrames_.Size() > 1)
+            keptKeyFrames.Push(keyFrames_.Size() - 1);
+        
+        // Keep the track uncompressed rather than drop keyframes
+        if (keptKeyFrames.Size() > MAX_COMPRESSED_KEYFRAMES)
+        {
+            LOGWARNING("Animation track " + name_ + " has too many keyframes to compress, leaving uncompressed");
+            compressed_ = false;
+            constantMask_ = 0;
+            return false;
+        }
+        
+        // Calculate the quantization ranges
+        Vector3 positionMax(-M_INFINITY, -M_INFINITY, -M_INFINITY);
+        Vector3 scaleMax(-M_INFINITY, -M_INFINITY, -M_INFINITY);
+        positionMin_ = scaleMin_ = Vector3(M_INFINITY, M_INFINITY, M_INFINITY);
+        for (unsigned i = 0; i < keptKeyFrames.Size(); ++i)
+        {
+            const AnimationKeyFrame& keyFrame = keyFrames_[keptKeyFrames[i]];
+            positionMin_ = Vector3(Min(positionMin_.x_, keyFrame.position_.x_), Min(positionMin_.y_, keyFrame.position_.y_),
+                Min(positionMin_.z_, keyFrame.position_.z_));
+            positionMax = Vector3(Max(positionMax.x_, keyFrame.position_.x_), Max(positionMax.y_, keyFrame.position_.y_),
+                Max(positionMax.z_, keyFrame.position_.z_));
+            scaleMin_ = Vector3(Min(scaleMin_.x_, keyFrame.scale_.x_), Min(scaleMin_.y_, keyFrame.scale_.y_),
+                Min(scaleMin_.z_, keyFrame.scale_.z_));
+            scaleMax = Vector3(Max(scaleMax.x_, keyFrame.scale_.x_), Max(scaleMax.y_, keyFrame.scale_.y_),
+                Max(scaleMax.z_, keyFrame.scale_.z_));
+        }
+        positionRange_ = positionMax - positionMin_;
+        scaleRange_ = scaleMax - scaleMin_;
+        
+        // Quantize the kept keyframes. Keyframes at the same time position are kept to preserve discontinuities
+        unsigned stride = GetKeyStride(animatedMask);
+        for (unsigned i = 0; i < keptKeyFrames.Size(); ++i)
+        {
+            const AnimationKeyFrame& keyFrame = keyFrames_[keptKeyFrames[i]];
+            keyTimes_.Push(QuantizeValue(keyFrame.time_, 0.0f, length));
+            unsigned offset = keyData_.Size();
+            keyData_.Resize(offset + stride);
+            unsigned short* dest = &keyData_[offset];
+            if (animatedMask & CHANNEL_POSITION)
+            {
+                QuantizeVector(dest, keyFrame.position_, positionMin_, positionRange_);
+                dest += 3;
+            }
+            if (animatedMask & CHANNEL_ROTATION)
+            {
+                QuantizeRotation(dest, keyFrame.rotation_);
+                dest += 3;
+            }
+            if (animatedMask & CHANNEL_SCALE)
+                QuantizeVector(dest, keyFrame.scale_, scaleMin_, scaleRange_);
+        }
+    }
+    
+    keyFrames_.Clear();
+    BuildLookup();
+    return true;
+}
+
+void AnimationTrack::BuildLookup()
+{
+    // Divide the animation into as many uniform time blocks as there are keyframes, and store the last keyframe at or before
+    // the start of each block
+    unsigned numKeyFrames = keyTimes_.Size();
+    keyLookup_.Resize(numKeyFrames);
+    
+    unsigned keyIndex = 0;
+    for (unsigned i = 0; i < numKeyFrames; ++i)
+    {
+        float blockStart = i * (QUANTIZE_MAX + 1.0f) / numKeyFrames;
+        while (keyIndex + 1 < numKeyFrames && blockStart >= keyTimes_[keyIndex + 1])
+            ++keyIndex;
+        keyLookup_[i] = keyIndex;
+    }
+}
+
 OBJECTTYPESTATIC(Animation);
 
 Animation::Animation(Context* context) :
     Resource(context),
-    length_(0.f)
+    length_(0.f),
+    compressed_(false)
 {
 }
 
@@ -79,15 +444,16 @@ bool Animation::Load(Deserializer& source)
 {
     PROFILE(LoadAnimation);
     
-    unsigned memoryUse = sizeof(Animation);
-    
     // Check ID
-    if (source.ReadFileID() != "UANI")
+    String fileID = source.ReadFileID();
+    if (fileID != "UANI" && fileID != "UANC")
     {
         LOGERROR(source.GetName() + " is not a valid animation file");
         return false;
     }
     
+    compressed_ = fileID == "UANC";
+    
     // Read name and length
     animationName_ = source.ReadString();
     animationNameHash_ = animationName_;
@@ -96,7 +462,6 @@ bool Animation::Load(Deserializer& source)
     
     unsigned tracks = source.ReadUInt();
     tracks_.Resize(tracks);
-    memoryUse += tracks * sizeof(AnimationTrack);
     
     // Read tracks
     for (unsigned i = 0; i < tracks; ++i)
@@ -106,9 +471,50 @@ bool Animation::Load(Deserializer& source)
         newTrack.nameHash_ = newTrack.name_;
         newTrack.channelMask_ = source.ReadUByte();
         
+        if (compressed_)
+        {
+            newTrack.compressed_ = true;
+            newTrack.constantMask_ = source.ReadUByte();
+            if (newTrack.constantMask_ & CHANNEL_POSITION)
+                newTrack.constantValue_.position_ = source.ReadVector3();
+            if (newTrack.constantMask_ & CHANNEL_ROTATION)
+                newTrack.constantValue_.rotation_ = source.ReadQuaternion();
+            if (newTrack.constantMask_ & CHANNEL_SCALE)
+                newTrack.constantValue_.scale_ = source.ReadVector3();
+            
+            unsigned char animatedMask = newTrack.channelMask_ & ~newTrack.constantMask_;
+            if (animatedMask & CHANNEL_POSITION)
+            {
+                newTrack.positionMin_ = source.ReadVector3();
+                newTrack.positionRange_ = source.ReadVector3();
+            }
+            if (animatedMask & CHANNEL_SCALE)
+            {
+                newTrack.scaleMin_ = source.ReadVector3();
+                newTrack.scaleRange_ = source.ReadVector3();
+            }
+            
+            unsigned keyFrames = source.ReadUInt();
+            if (keyFrames > MAX_COMPRESSED_KEYFRAMES)
+            {
+                LOGERROR("Too many keyframes in compressed animation " + source.GetName());
+                return false;
+            }
+            
+            newTrack.keyTimes_.Resize(keyFrames);
+            newTrack.keyData_.Resize(keyFrames * GetKeyStride(animatedMask));
+            if (keyFrames)
+            {
+                source.Read(&newTrack.keyTimes_[0], newTrack.keyTimes_.Size() * sizeof(unsigned short));
+                if (newTrack.keyData_.Size())
+                    source.Read(&newTrack.keyData_[0], newTrack.keyData_.Size() * sizeof(unsigned short));
+            }
+            newTrack.BuildLookup();
+            continue;
+        }
+        
         unsigned keyFrames = source.ReadUInt();
         newTrack.keyFrames_.Resize(keyFrames);
-        memoryUse += keyFrames * sizeof(AnimationKeyFrame);
         
         // Read keyframes of the track
         for (unsigned j = 0; j < keyFrames; ++j)
@@ -144,19 +550,17 @@ bool Animation::Load(Deserializer& source)
                 
                 triggerElem = triggerElem.GetNext("trigger");
             }
-            
-            memoryUse += triggers_.Size() * sizeof(AnimationTriggerPoint);
         }
     }
     
-    SetMemoryUse(memoryUse);
+    UpdateMemoryUse();
     return true;
 }
 
 bool Animation::Save(Serializer& dest) const
 {
     // Write ID, name and length
-    dest.WriteFileID("UANI");
+    dest.WriteFileID(compressed_ ? "UANC" : "UANI");
     dest.WriteString(animationName_);
     dest.WriteFloat(length_);
     
@@ -167,6 +571,43 @@ bool Animation::Save(Serializer& dest) const
         const AnimationTrack& track = tracks_[i];
         dest.WriteString(track.name_);
         dest.WriteUByte(track.channelMask_);
+        
+        if (compressed_)
+        {
+            if (!track.compressed_)
+            {
+                LOGERROR("Can not save uncompressed track " + track.name_ + " into a compressed animation");
+                return false;
+            }
+            
+            dest.WriteUByte(track.constantMask_);
+            if (track.constantMask_ & CHANNEL_POSITION)
+                dest.WriteVector3(track.constantValue_.position_);
+            if (track.constantMask_ & CHANNEL_ROTATION)
+                dest.WriteQuaternion(track.constantValue_.rotation_);
+            if (track.constantMask_ & CHANNEL_SCALE)
+                dest.WriteVector3(track.constantValue_.scale_);
+            
+            unsigned char animatedMask = track.channelMask_ & ~track.constantMask_;
+            if (animatedMask & CHANNEL_POSITION)
+            {
+                dest.WriteVector3(track.positionMin_);
+                dest.WriteVector3(track.positionRange_);
+            }
+            if (animatedMask & CHANNEL_SCALE)
+            {
+                dest.WriteVector3(track.scaleMin_);
+                dest.WriteVector3(track.scaleRange_);
+            }
+            
+            dest.WriteUInt(track.keyTimes_.Size());
+            if (track.keyTimes_.Size())
+                dest.Write(&track.keyTimes_[0], track.keyTimes_.Size() * sizeof(unsigned short));
+            if (track.keyData_.Size())
+                dest.Write(&track.keyData_[0], track.keyData_.Size() * sizeof(unsigned short));
+            continue;
+        }
+        
         dest.WriteUInt(track.keyFrames_.Size());
         
         // Write keyframes of the track
@@ -225,6 +666,21 @@ void Animation::SetLength(float length)
 void Animation::SetTracks(const Vector<AnimationTrack>& tracks)
 {
     tracks_ = tracks;
+    
+    // Tracks can not be mixed: if any of the tracks is compressed, compress the rest
+    compressed_ = false;
+    for (unsigned i = 0; i < tracks_.Size(); ++i)
+        compressed_ |= tracks_[i].compressed_;
+    if (compressed_)
+    {
+        for (unsigned i = 0; i < tracks_.Size(); ++i)
+        {
+            if (!tracks_[i].Compress(length_, DEFAULT_ANIMATION_POSITION_ERROR, DEFAULT_ANIMATION_ROTATION_ERROR))
+                LOGERROR("Animation " + GetName() + " mixes compressed tracks with a track that can not be compressed, it can not be saved");
+        }
+    }
+    
+    UpdateMemoryUse();
 }
 
 void Animation::AddTrigger(float time, bool timeIsNormalized, const Variant& data)
@@ -248,6 +704,30 @@ void Animation::RemoveAllTriggers()
     triggers_.Clear();
 }
 
+bool Animation::Compress(float positionError, float rotationError)
+{
+    if (compressed_)
+        return true;
+    
+    PROFILE(CompressAnimation);
+    
+    // All tracks of an animation are either compressed or not, so compress copies and keep them only if all succeed
+    Vector<AnimationTrack> compressedTracks = tracks_;
+    for (unsigned i = 0; i < compressedTracks.Size(); ++i)
+    {
+        if (!compressedTracks[i].Compress(length_, positionError, rotationError))
+        {
+            LOGWARNING("Leaving animation " + GetName() + " uncompressed");
+            return false;
+        }
+    }
+    
+    tracks_.Swap(compressedTracks);
+    compressed_ = true;
+    UpdateMemoryUse();
+    return true;
+}
+
 void Animation::SetNumTriggers(unsigned num)
 {
     triggers_.Resize(num);
@@ -280,4 +760,19 @@ const AnimationTrack* Animation::GetTrack(StringHash nameHash) const
     return 0;
 }
 
+void Animation::UpdateMemoryUse()
+{
+    unsigned memoryUse = sizeof(Animation);
+    memoryUse += tracks_.Size() * sizeof(AnimationTrack);
+    for (unsigned i = 0; i < tracks_.Size(); ++i)
+    {
+        const AnimationTrack& track = tracks_[i];
+        memoryUse += track.keyFrames_.Size() * sizeof(AnimationKeyFrame);
+        memoryUse += (track.keyTimes_.Size() + track.keyData_.Size() + track.keyLookup_.Size()) * sizeof(unsigned short);
+    }
+    memoryUse += triggers_.Size() * sizeof(AnimationTriggerPoint);
+    
+    SetMemoryUse(memoryUse);
+}
+
 }
@@ -46,8 +46,22 @@ struct AnimationKeyFrame
 /// Skeletal animation track, stores keyframes of a single bone.
 struct AnimationTrack
 {
-    /// Return keyframe index based on time and previous index.
+    /// Construct.
+    AnimationTrack() :
+        channelMask_(0),
+        constantMask_(0),
+        compressed_(false)
+    {
+    }
+    
+    /// Return keyframe index based on time and previous index. Not used for compressed tracks.
     void GetKeyFrameIndex(float time, unsigned& index) const;
+    /// Sample the included channels at a time position, interpolating between keyframes. The previous keyframe index is used for optimized search of uncompressed keyframes. Return false if the track has no keyframes.
+    bool Sample(float time, float length, bool looped, unsigned& index, Vector3& position, Quaternion& rotation, Vector3& scale) const;
+    /// Compress the keyframes: remove constant channels and keyframes that can be interpolated from their neighbours within the given position (also used for scale) and rotation (radians) error, then quantize. Return false and leave the track uncompressed if too many keyframes remain.
+    bool Compress(float length, float positionError, float rotationError);
+    /// Build the keyframe lookup table of a compressed track.
+    void BuildLookup();
     
     /// Bone name.
     String name_;
@@ -57,6 +71,26 @@ struct AnimationTrack
     unsigned char channelMask_;
     /// Keyframes.
     Vector<AnimationKeyFrame> keyFrames_;
+    /// Bitmask of included data that stays constant, compressed track only.
+    unsigned char constantMask_;
+    /// Value of the constant channels, compressed track only.
+    AnimationKeyFrame constantValue_;
+    /// Position quantization minimum, compressed track only.
+    Vector3 positionMin_;
+    /// Position quantization range, compressed track only.
+    Vector3 positionRange_;
+    /// Scale quantization minimum, compressed track only.
+    Vector3 scaleMin_;
+    /// Scale quantization range, compressed track only.
+    Vector3 scaleRange_;
+    /// Quantized keyframe times as fractions of the animation length, compressed track only.
+    PODVector<unsigned short> keyTimes_;
+    /// Quantized keyframe data of the channels that are not constant, three values per channel, compressed track only.
+    PODVector<unsigned short> keyData_;
+    /// Keyframe index at the start of each uniform time block, for constant time keyframe lookup. Compressed track only.
+    PODVector<unsigned short> keyLookup_;
+    /// Compressed flag.
+    bool compressed_;
 };
 
 /// %Animation trigger point.
@@ -78,6 +112,11 @@ static const unsigned char CHANNEL_POSITION = 0x1;
 static const unsigned char CHANNEL_ROTATION = 0x2;
 static const unsigned char CHANNEL_SCALE = 0x4;
 
+/// Default maximum position and scale error for animation compression.
+static const float DEFAULT_ANIMATION_POSITION_ERROR = 0.001f;
+/// Default maximum rotation error in radians for animation compression.
+static const float DEFAULT_ANIMATION_ROTATION_ERROR = 0.001f;
+
 /// Skeletal animation resource.
 class Animation : public Resource
 {
@@ -110,6 +149,8 @@ public:
     void RemoveAllTriggers();
     /// Resize trigger point vector.
     void SetNumTriggers(unsigned num);
+    /// Compress all tracks. The keyframes are replaced with quantized data, which is smaller and has constant time keyframe lookup, but can not be modified. Return false and leave the animation uncompressed if a track has too many keyframes.
+    bool Compress(float positionError = DEFAULT_ANIMATION_POSITION_ERROR, float rotationError = DEFAULT_ANIMATION_ROTATION_ERROR);
     
     /// Return animation name.
     const String& GetAnimationName() const { return animationName_; }
@@ -131,8 +172,13 @@ public:
     const Vector<AnimationTriggerPoint>& GetTriggers() const { return triggers_; }
     /// Return number of animation trigger points.
     unsigned GetNumTriggers() const {return triggers_.Size(); }
+    /// Return whether the tracks are compressed.
+    bool IsCompressed() const { return compressed_; }
     
 private:
+    /// Update memory use from the tracks and triggers.
+    void UpdateMemoryUse();
+    
     /// Animation name.
     String animationName_;
     /// Animation name hash.
@@ -143,6 +189,8 @@ private:
     Vector<AnimationTrack> tracks_;
     /// Animation trigger points.
     Vector<AnimationTriggerPoint> triggers_;
+    /// Compressed flag.
+    bool compressed_;
 };
 
 }
@@ -34,6 +34,22 @@
 namespace Urho3D
 {
 
+static bool IsChildBone(const Vector<Bone>& bones, unsigned index, unsigned parentIndex)
+{
+    // Walk up the parent chain. Limit the number of steps in case the hierarchy is malformed
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        unsigned next = bones[index].parentIndex_;
+        if (next == index || next >= bones.Size())
+            return false;
+        if (next == parentIndex)
+            return true;
+        index = next;
+    }
+    
+    return false;
+}
+
 AnimationState::AnimationState(AnimatedModel* model, Animation* animation) :
     model_(model),
     animation_(animation),
@@ -122,10 +138,14 @@ void AnimationState::SetStartBone(Bone* startBone)
     startBone_ = startBone;
     
     trackToBoneMap_.Clear();
-    if (!startBone->node_)
+    // When animating the bone pose instead of the bone nodes, the nodes are not needed: check the hierarchy from the skeleton
+    bool animateBoneNodes = model_->GetAnimateBoneNodes();
+    if (animateBoneNodes && !startBone->node_)
         return;
     
     const Vector<AnimationTrack>& tracks = animation_->GetTracks();
+    const Vector<Bone>& bones = skeleton.GetBones();
+    unsigned startBoneIndex = startBone - &bones[0];
     
     for (unsigned i = 0; i < tracks.Size(); ++i)
     {
@@ -135,12 +155,18 @@ void AnimationState::SetStartBone(Bone* startBone)
         
         if (nameHash == startBone->nameHash_)
             trackBone = startBone;
-        else
+        else if (animateBoneNodes)
         {
             Node* trackBoneNode = startBone->node_->GetChild(nameHash, true);
             if (trackBoneNode)
                 trackBone = skeleton.GetBone(nameHash);
         }
+        else
+        {
+            Bone* bone = skeleton.GetBone(nameHash);
+            if (bone && IsChildBone(bones, bone - &bones[0], startBoneIndex))
+                trackBone = bone;
+        }
         
         if (trackBone)
             trackToBoneMap_[i] = trackBone;
@@ -280,6 +306,12 @@ void AnimationState::Apply()
 
 void AnimationState::ApplyToModel()
 {
+    if (!model_->GetAnimateBoneNodes())
+    {
+        ApplyToPose();
+        return;
+    }
+    
     // Check first if full weight or blending
     if (Equals(weight_, 1.0f))
     {
@@ -307,6 +339,27 @@ void AnimationState::ApplyToModel()
     }
 }
 
+void AnimationState::ApplyToPose()
+{
+    PODVector<BoneTransform>& pose = model_->bonePose_;
+    const Vector<Bone>& bones = model_->GetSkeleton().GetBones();
+    if (pose.Size() != bones.Size())
+        return;
+    
+    bool fullWeight = Equals(weight_, 1.0f);
+    
+    for (HashMap<unsigned, Bone*>::ConstIterator i = trackToBoneMap_.Begin(); i != trackToBoneMap_.End(); ++i)
+    {
+        Bone* bone = i->second_;
+        unsigned boneIndex = bone - &bones[0];
+        // Leaf bones left unanimated by bone LOD keep their previous pose
+        if (!bone->animated_ || model_->IsBoneLodSkipped(boneIndex))
+            continue;
+        
+        ApplyTrackToTransform(i->first_, pose[boneIndex], fullWeight);
+    }
+}
+
 void AnimationState::ApplyToNodes()
 {
     // When applying to a node hierarchy, can only use full weight (nothing to blend to)
@@ -323,119 +376,69 @@ void AnimationState::ApplyToNodes()
 void AnimationState::ApplyTrackToNodeFullWeight(unsigned index, Node* node)
 {
     const AnimationTrack* track = animation_->GetTrack(index);
-    if (track->keyFrames_.Empty())
+    Vector3 position;
+    Quaternion rotation;
+    Vector3 scale;
+    if (!track->Sample(time_, animation_->GetLength(), looped_, lastKeyFrame_[index], position, rotation, scale))
         return;
     
-    unsigned& frame = lastKeyFrame_[index];
-    track->GetKeyFrameIndex(time_, frame);
-    
-    // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
-    unsigned nextFrame = frame + 1;
-    bool interpolate = true;
-    if (nextFrame >= track->keyFrames_.Size())
-    {
-        if (!looped_)
-        {
-            nextFrame = frame;
-            interpolate = false;
-        }
-        else
-            nextFrame = 0;
-    }
-    
-    const AnimationKeyFrame* keyFrame = &track->keyFrames_[frame];
     unsigned char channelMask = track->channelMask_;
-    
-    if (!interpolate)
-    {
-        // No interpolation, full weight
-        if (channelMask & CHANNEL_POSITION)
-            node->SetPosition(keyFrame->position_);
-        if (channelMask & CHANNEL_ROTATION)
-            node->SetRotation(keyFrame->rotation_);
-        if (channelMask & CHANNEL_SCALE)
-            node->SetScale(keyFrame->scale_);
-    }
-    else
-    {
-        const AnimationKeyFrame* nextKeyFrame = &track->keyFrames_[nextFrame];
-        float timeInterval = nextKeyFrame->time_ - keyFrame->time_;
-        if (timeInterval < 0.0f)
-            timeInterval += animation_->GetLength();
-        float t = timeInterval > 0.0f ? (time_ - keyFrame->time_) / timeInterval : 1.0f;
-        
-        // Interpolation, full weight
-        if (channelMask & CHANNEL_POSITION)
-            node->SetPosition(keyFrame->position_.Lerp(nextKeyFrame->position_, t));
-        if (channelMask & CHANNEL_ROTATION)
-            node->SetRotation(keyFrame->rotation_.Slerp(nextKeyFrame->rotation_, t));
-        if (channelMask & CHANNEL_SCALE)
-            node->SetScale(keyFrame->scale_.Lerp(nextKeyFrame->scale_, t));
-    }
+    if (channelMask & CHANNEL_POSITION)
+        node->SetPosition(position);
+    if (channelMask & CHANNEL_ROTATION)
+        node->SetRotation(rotation);
+    if (channelMask & CHANNEL_SCALE)
+        node->SetScale(scale);
 }
 
 void AnimationState::ApplyTrackToNodeBlended(unsigned index, Node* node)
 {
     const AnimationTrack* track = animation_->GetTrack(index);
-    if (track->keyFrames_.Empty())
+    Vector3 position;
+    Quaternion rotation;
+    Vector3 scale;
+    if (!track->Sample(time_, animation_->GetLength(), looped_, lastKeyFrame_[index], position, rotation, scale))
         return;
     
-    unsigned& frame = lastKeyFrame_[index];
-    track->GetKeyFrameIndex(time_, frame);
-    
-    // Check if next frame to interpolate to is valid, or if wrapping is needed (looping animation only)
-    unsigned nextFrame = frame + 1;
-    bool interpolate = true;
-    if (nextFrame >= track->keyFrames_.Size())
-    {
-        if (!looped_)
-        {
-            nextFrame = frame;
-            interpolate = false;
-        }
-        else
-            nextFrame = 0;
-    }
-    
-    const AnimationKeyFrame* keyFrame = &track->keyFrames_[frame];
+    // Blend between old transform & animation
     unsigned char channelMask = track->channelMask_;
+    if (channelMask & CHANNEL_POSITION)
+        node->SetPosition(node->GetPosition().Lerp(position, weight_));
+    if (channelMask & CHANNEL_ROTATION)
+        node->SetRotation(node->GetRotation().Slerp(rotation, weight_));
+    if (channelMask & CHANNEL_SCALE)
+        node->SetScale(node->GetScale().Lerp(scale, weight_));
+}
+
+void AnimationState::ApplyTrackToTransform(unsigned index, BoneTransform& transform, bool fullWeight)
+{
+    const AnimationTrack* track = animation_->GetTrack(index);
+    Vector3 position;
+    Quaternion rotation;
+    Vector3 scale;
+    if (!track->Sample(time_, animation_->GetLength(), looped_, lastKeyFrame_[index], position, rotation, scale))
+        return;
     
-    if (!interpolate)
+    unsigned char channelMask = track->channelMask_;
+    if (fullWeight)
     {
-        // No interpolation, blend between old transform & animation
         if (channelMask & CHANNEL_POSITION)
-            node->SetPosition(node->GetPosition().Lerp(keyFrame->position_, weight_));
+            transform.position_ = position;
         if (channelMask & CHANNEL_ROTATION)
-            node->SetRotation(node->GetRotation().Slerp(keyFrame->rotation_, weight_));
+            transform.rotation_ = rotation;
         if (channelMask & CHANNEL_SCALE)
-            node->SetScale(node->GetScale().Lerp(keyFrame->scale_, weight_));
+            transform.scale_ = scale;
     }
     else
     {
-        const AnimationKeyFrame* nextKeyFrame = &track->keyFrames_[nextFrame];
-        float timeInterval = nextKeyFrame->time_ - keyFrame->time_;
-        if (timeInterval < 0.0f)
-            timeInterval += animation_->GetLength();
-        float t = timeInterval > 0.0f ? (time_ - keyFrame->time_) / timeInterval : 1.0f;
-        
-        // Interpolation, blend between old transform & animation
+        // Blend between the pose so far & animation
         if (channelMask & CHANNEL_POSITION)
-        {
-            node->SetPosition(node->GetPosition().Lerp(
-                keyFrame->position_.Lerp(nextKeyFrame->position_, t), weight_));
-        }
+            transform.position_ = transform.position_.Lerp(position, weight_);
         if (channelMask & CHANNEL_ROTATION)
-        {
-            node->SetRotation(node->GetRotation().Slerp(
-                keyFrame->rotation_.Slerp(nextKeyFrame->rotation_, t), weight_));
-        }
+            transform.rotation_ = transform.rotation_.Slerp(rotation, weight_);
         if (channelMask & CHANNEL_SCALE)
-        {
-            node->SetScale(node->GetScale().Lerp(
-                keyFrame->scale_.Lerp(nextKeyFrame->scale_, t), weight_));
-        }
+            transform.scale_ = transform.scale_.Lerp(scale, weight_);
     }
 }
 
-
 }
@@ -35,6 +35,7 @@ class Serializer;
 class Skeleton;
 struct AnimationTrack;
 struct Bone;
+struct BoneTransform;
 
 /// %Animation instance.
 class AnimationState : public RefCounted
@@ -85,12 +86,16 @@ public:
 private:
     /// Apply animation to a skeleton.
     void ApplyToModel();
+    /// Apply animation to the bone pose of the model.
+    void ApplyToPose();
     /// Apply animation to a scene node hierarchy.
     void ApplyToNodes();
     /// Apply animation track to a scene node, full weight.
     void ApplyTrackToNodeFullWeight(unsigned index, Node* node);
     /// Apply animation track to a scene node, blended with current node transform.
     void ApplyTrackToNodeBlended(unsigned index, Node* node);
+    /// Apply animation track to a bone pose transform, blended with the current transform unless at full weight.
+    void ApplyTrackToTransform(unsigned index, BoneTransform& transform, bool fullWeight);
     
     /// Animated model (model mode.)
     WeakPtr<AnimatedModel> model_;
@@ -635,6 +635,25 @@ void BatchGroup::SetTransforms(void* lockedData, unsigned& freeIndex)
     freeIndex += instances_.Size();
 }
 
+void BatchGroup::SetSkinMatrices(float* dest, unsigned& freeOffset)
+{
+    if (geometryType_ != GEOM_SKINNED || !shaderDataSize_ || instances_.Empty())
+        return;
+    
+    // The packed layout can be uploaded as is into a texture or uniform buffer for instanced skinning
+    skinMatrices_ = dest;
+    for (unsigned i = 0; i < instances_.Size(); ++i)
+    {
+        InstanceData& instance = instances_[i];
+        memcpy(dest + freeOffset, instance.shaderData_, shaderDataSize_ * sizeof(float));
+        instance.paletteOffset_ = freeOffset;
+        freeOffset += shaderDataSize_;
+    }
+    
+    // The first instance's skin matrices are set when preparing the group
+    shaderData_ = skinMatrices_ + instances_[0].paletteOffset_;
+}
+
 void BatchGroup::Draw(View* view) const
 {
     Graphics* graphics = view->GetGraphics();
@@ -656,6 +675,15 @@ void BatchGroup::Draw(View* view) const
                 if (graphics->NeedParameterUpdate(SP_OBJECTTRANSFORM, instances_[i].worldTransform_))
                     graphics->SetShaderParameter(VSP_MODEL, *instances_[i].worldTransform_);
                 
+                // Skinned groups can not be drawn instanced, but share the state setup. Set each instance's skin matrices
+                if (geometryType_ == GEOM_SKINNED)
+                {
+                    const float* skinMatrices = skinMatrices_ ? skinMatrices_ + instances_[i].paletteOffset_ :
+                        instances_[i].shaderData_;
+                    if (skinMatrices && graphics->NeedParameterUpdate(SP_OBJECTDATA, skinMatrices))
+                        graphics->SetShaderParameter(VSP_SKINMATRICES, skinMatrices, shaderDataSize_);
+                }
+                
                 graphics->Draw(geometry_->GetPrimitiveType(), geometry_->GetIndexStart(), geometry_->GetIndexCount(),
                     geometry_->GetVertexStart(), geometry_->GetVertexCount());
             }
@@ -721,7 +749,7 @@ unsigned BatchGroupKey::ToHash() const
         ((unsigned)(size_t)lightQueue_) / sizeof(LightBatchQueue) +
         ((unsigned)(size_t)pass_) / sizeof(Pass) +
         ((unsigned)(size_t)material_) / sizeof(Material) +
-        ((unsigned)(size_t)geometry_) / sizeof(Geometry);
+        ((unsigned)(size_t)geometry_) / sizeof(Geometry) + (unsigned)geometryType_;
 }
 
 void BatchQueue::Clear(int maxSortedInstances)
@@ -890,6 +918,14 @@ void BatchQueue::SetTransforms(void* lockedData, unsigned& freeIndex)
         i->second_.SetTransforms(lockedData, freeIndex);
 }
 
+void BatchQueue::SetSkinMatrices(float* dest, unsigned& freeOffset)
+{
+    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = baseBatchGroups_.Begin(); i != baseBatchGroups_.End(); ++i)
+        i->second_.SetSkinMatrices(dest, freeOffset);
+    for (HashMap<BatchGroupKey, BatchGroup>::Iterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+        i->second_.SetSkinMatrices(dest, freeOffset);
+}
+
 void BatchQueue::Draw(View* view, bool useScissor, bool markToStencil) const
 {
     Graphics* graphics = view->GetGraphics();
@@ -1017,4 +1053,22 @@ unsigned BatchQueue::GetNumInstances() const
     return total;
 }
 
+unsigned BatchQueue::GetSkinMatricesSize() const
+{
+    unsigned total = 0;
+    
+    for (HashMap<BatchGroupKey, BatchGroup>::ConstIterator i = baseBatchGroups_.Begin(); i != baseBatchGroups_.End(); ++i)
+    {
+        if (i->second_.geometryType_ == GEOM_SKINNED)
+            total += i->second_.instances_.Size() * i->second_.shaderDataSize_;
+    }
+    for (HashMap<BatchGroupKey, BatchGroup>::ConstIterator i = batchGroups_.Begin(); i != batchGroups_.End(); ++i)
+    {
+        if (i->second_.geometryType_ == GEOM_SKINNED)
+            total += i->second_.instances_.Size() * i->second_.shaderDataSize_;
+    }
+    
+    return total;
+}
+
 }
@@ -124,12 +124,27 @@ struct InstanceData
     /// Construct with transform and distance.
     InstanceData(const Matrix3x4* worldTransform, float distance) :
         worldTransform_(worldTransform),
+        shaderData_(0),
+        paletteOffset_(0),
+        distance_(distance)
+    {
+    }
+    
+    /// Construct with transform, vertex shader data and distance.
+    InstanceData(const Matrix3x4* worldTransform, const float* shaderData, float distance) :
+        worldTransform_(worldTransform),
+        shaderData_(shaderData),
+        paletteOffset_(0),
         distance_(distance)
     {
     }
     
     /// World transform.
     const Matrix3x4* worldTransform_;
+    /// Vertex shader data, the skin matrices of a skinned instance.
+    const float* shaderData_;
+    /// Offset of the skin matrices in the packed skin matrix buffer, skinned instance only.
+    unsigned paletteOffset_;
     /// Distance from camera.
     float distance_;
 };
@@ -139,6 +154,7 @@ struct BatchGroup : public Batch
 {
     /// Construct with defaults.
     BatchGroup() :
+        skinMatrices_(0),
         startIndex_(M_MAX_UNSIGNED)
     {
     }
@@ -146,6 +162,7 @@ struct BatchGroup : public Batch
     /// Construct from a batch.
     BatchGroup(const Batch& batch) :
         Batch(batch),
+        skinMatrices_(0),
         startIndex_(M_MAX_UNSIGNED)
     {
     }
@@ -157,11 +174,15 @@ struct BatchGroup : public Batch
     
     /// Pre-set the instance transforms. Buffer must be big enough to hold all transforms.
     void SetTransforms(void* lockedData, unsigned& freeIndex);
+    /// Pack the skin matrices of a skinned group, one bone palette per instance in instance order. Buffer must be big enough to hold all palettes.
+    void SetSkinMatrices(float* dest, unsigned& freeOffset);
     /// Prepare and draw.
     void Draw(View* view) const;
     
     /// Instance data.
     PODVector<InstanceData> instances_;
+    /// Packed skin matrix buffer of a skinned group, or null if not packed. Each instance's palette starts at its palette offset.
+    const float* skinMatrices_;
     /// Instance stream start index, or M_MAX_UNSIGNED if transforms not pre-set.
     unsigned startIndex_;
 };
@@ -180,7 +201,8 @@ struct BatchGroupKey
         lightQueue_(batch.lightQueue_),
         pass_(batch.pass_),
         material_(batch.material_),
-        geometry_(batch.geometry_)
+        geometry_(batch.geometry_),
+        geometryType_(batch.geometryType_)
     {
     }
     
@@ -194,11 +216,13 @@ struct BatchGroupKey
     Material* material_;
     /// Geometry.
     Geometry* geometry_;
+    /// %Geometry type, to keep skinned and instanced groups of the same geometry apart.
+    GeometryType geometryType_;
     
     /// Test for equality with another batch group key.
-    bool operator == (const BatchGroupKey& rhs) const { return zone_ == rhs.zone_ && lightQueue_ == rhs.lightQueue_ && pass_ == rhs.pass_ && material_ == rhs.material_ && geometry_ == rhs.geometry_; }
+    bool operator == (const BatchGroupKey& rhs) const { return zone_ == rhs.zone_ && lightQueue_ == rhs.lightQueue_ && pass_ == rhs.pass_ && material_ == rhs.material_ && geometry_ == rhs.geometry_ && geometryType_ == rhs.geometryType_; }
     /// Test for inequality with another batch group key.
-    bool operator != (const BatchGroupKey& rhs) const { return zone_ != rhs.zone_ || lightQueue_ != rhs.lightQueue_ || pass_ != rhs.pass_ || material_ != rhs.material_ || geometry_ != rhs.geometry_; }
+    bool operator != (const BatchGroupKey& rhs) const { return zone_ != rhs.zone_ || lightQueue_ != rhs.lightQueue_ || pass_ != rhs.pass_ || material_ != rhs.material_ || geometry_ != rhs.geometry_ || geometryType_ != rhs.geometryType_; }
     
     /// Return hash value.
     unsigned ToHash() const;
@@ -218,12 +242,16 @@ public:
     void SortFrontToBack2Pass(PODVector<Batch*>& batches);
     /// Pre-set instance transforms of all groups. The vertex buffer must be big enough to hold all transforms.
     void SetTransforms(void* lockedData, unsigned& freeIndex);
+    /// Pack the skin matrices of all skinned groups. The buffer must be big enough to hold all palettes.
+    void SetSkinMatrices(float* dest, unsigned& freeOffset);
     /// Draw.
     void Draw(View* view, bool useScissor = false, bool markToStencil = false) const;
     /// Draw with forward light optimizations.
     void Draw(Light* light, View* view) const;
     /// Return the combined amount of instances.
     unsigned GetNumInstances() const;
+    /// Return the combined size of the skinned groups' bone palettes in floats.
+    unsigned GetSkinMatricesSize() const;
     /// Return whether the batch group is empty.
     bool IsEmpty() const { return batches_.Empty() && baseBatchGroups_.Empty() && batchGroups_.Empty(); }
     
@@ -33,9 +33,10 @@
 #include "Node.h"
 #include "Profiler.h"
 #include "ResourceCache.h"
-#include "Sort.h"
 #include "VertexBuffer.h"
 
+#include <cstring>
+
 #include "DebugNew.h"
 
 namespace Urho3D
@@ -44,10 +45,97 @@ namespace Urho3D
 extern const char* GEOMETRY_CATEGORY;
 
 static const float INV_SQRT_TWO = 1.0f / sqrtf(2.0f);
+/// Billboard count below which insertion sort is always used.
+static const unsigned MIN_RADIX_SORT_BILLBOARDS = 64;
+/// Insertion sort moves allowed per billboard before falling back to radix sort.
+static const unsigned MAX_SORT_MOVES_PER_BILLBOARD = 8;
+/// Fraction of the enabled billboards to rewrite above which the whole vertex buffer is discarded and rewritten.
+static const float FULL_REWRITE_THRESHOLD = 0.25f;
+
+/// Sort billboard indices and their distances by descending distance with insertion sort, which is fast if the order is nearly correct already. Return false if the allowed number of moves was exceeded and the sort was not finished.
+static bool InsertionSortBillboards(unsigned* order, float* distances, unsigned count, unsigned maxMoves)
+{
+    unsigned moves = 0;
+    
+    for (unsigned i = 1; i < count; ++i)
+    {
+        unsigned index = order[i];
+        float distance = distances[i];
+        unsigned j = i;
+        
+        while (j > 0 && distances[j - 1] < distance)
+        {
+            order[j] = order[j - 1];
+            distances[j] = distances[j - 1];
+            --j;
+            if (++moves > maxMoves)
+            {
+                order[j] = index;
+                distances[j] = distance;
+                return false;
+            }
+        }
+        
+        order[j] = index;
+        distances[j] = distance;
+    }
+    
+    return true;
+}
 
-inline bool CompareBillboards(Billboard* lhs, Billboard* rhs)
+/// Sort billboard indices by descending distance with radix sort. The work buffer must have room for three times the billboard count.
+static void RadixSortBillboards(unsigned* order, const float* distances, unsigned count, unsigned* buffer)
 {
-    return lhs->sortDistance_ > rhs->sortDistance_;
+    unsigned* keys = buffer;
+    unsigned* tempKeys = buffer + count;
+    unsigned* tempOrder = buffer + 2 * count;
+    unsigned* dest = order;
+    unsigned histograms[4][256];
+    memset(histograms, 0, sizeof histograms);
+    
+    // The squared distances are non-negative, so their bit patterns sort the same as the values. Invert them to sort
+    // the furthest billboards first
+    memcpy(keys, distances, count * sizeof(unsigned));
+    for (unsigned i = 0; i < count; ++i)
+    {
+        unsigned key = ~keys[i];
+        keys[i] = key;
+        ++histograms[0][key & 0xff];
+        ++histograms[1][(key >> 8) & 0xff];
+        ++histograms[2][(key >> 16) & 0xff];
+        ++histograms[3][key >> 24];
+    }
+    
+    for (unsigned pass = 0; pass < 4; ++pass)
+    {
+        unsigned shift = pass * 8;
+        unsigned* histogram = histograms[pass];
+        
+        // Skip the pass if all keys have the same digit
+        if (histogram[(keys[0] >> shift) & 0xff] == count)
+            continue;
+        
+        unsigned offset = 0;
+        for (unsigned i = 0; i < 256; ++i)
+        {
+            unsigned digitCount = histogram[i];
+            histogram[i] = offset;
+            offset += digitCount;
+        }
+        
+        for (unsigned i = 0; i < count; ++i)
+        {
+            unsigned position = histogram[(keys[i] >> shift) & 0xff]++;
+            tempKeys[position] = keys[i];
+            tempOrder[position] = order[i];
+        }
+        
+        Swap(keys, tempKeys);
+        Swap(order, tempOrder);
+    }
+    
+    if (order != dest)
+        memcpy(dest, order, count * sizeof(unsigned));
 }
 
 OBJECTTYPESTATIC(BillboardSet);
@@ -64,9 +152,13 @@ BillboardSet::BillboardSet(Context* context) :
     indexBuffer_(new IndexBuffer(context_)),
     bufferSizeDirty_(true),
     bufferDirty_(true),
+    sortDirty_(false),
     forceUpdate_(false),
     sortFrameNumber_(0),
-    previousOffset_(Vector3::ZERO)
+    previousOffset_(Vector3::ZERO),
+    previousScale_(Vector3::ONE),
+    dirtyStart_(0),
+    dirtyEnd_(0)
 {
     geometry_->SetVertexBuffer(0, vertexBuffer_, MASK_POSITION | MASK_COLOR | MASK_TEXCOORD1 | MASK_TEXCOORD2);
     geometry_->SetIndexBuffer(indexBuffer_);
@@ -115,6 +207,7 @@ void BillboardSet::UpdateBatches(const FrameInfo& frame)
             {
                 sortFrameNumber_ = frame.frameNumber_;
                 bufferDirty_ = true;
+                sortDirty_ = true;
             }
         }
     }
@@ -191,6 +284,10 @@ void BillboardSet::SetScaled(bool enable)
 
 void BillboardSet::SetSorted(bool enable)
 {
+    // Rebuild the billboard order to either sort it or return to index order
+    if (enable != sorted_)
+        billboardSlots_.Clear();
+    
     sorted_ = enable;
     Commit();
 }
@@ -207,6 +304,29 @@ void BillboardSet::Commit()
     MarkNetworkUpdate();
 }
 
+void BillboardSet::CommitRange(unsigned start, unsigned count)
+{
+    unsigned numBillboards = billboards_.Size();
+    if (start >= numBillboards || !count)
+        return;
+    
+    unsigned end = count < numBillboards - start ? start + count : numBillboards;
+    if (dirtyStart_ < dirtyEnd_)
+    {
+        dirtyStart_ = Min((int)dirtyStart_, (int)start);
+        dirtyEnd_ = Max((int)dirtyEnd_, (int)end);
+    }
+    else
+    {
+        dirtyStart_ = start;
+        dirtyEnd_ = end;
+    }
+    
+    Drawable::OnMarkedDirty(node_);
+    bufferDirty_ = true;
+    MarkNetworkUpdate();
+}
+
 Material* BillboardSet::GetMaterial() const
 {
     return batches_[0].material_;
@@ -344,6 +464,10 @@ void BillboardSet::UpdateBufferSize()
     bufferDirty_ = true;
     forceUpdate_ = true;
     
+    // Resizing loses the vertex buffer contents, so all billboards must be rewritten
+    dirtyStart_ = 0;
+    dirtyEnd_ = numBillboards;
+    
     if (!numBillboards)
         return;
     
@@ -382,50 +506,101 @@ void BillboardSet::UpdateVertexBuffer(const FrameInfo& frame)
     }
     
     unsigned numBillboards = billboards_.Size();
-    unsigned enabledBillboards = 0;
     const Matrix3x4& worldTransform = node_->GetWorldTransform();
     Matrix3x4 billboardTransform = relative_ ? worldTransform : Matrix3x4::IDENTITY;
     Vector3 billboardScale = scaled_ ? worldTransform.Scale() : Vector3::ONE;
     
-    // First check number of enabled billboards
-    for (unsigned i = 0; i < numBillboards; ++i)
+    // If the buffer contents were lost or the scale changed, all billboards must be rewritten
+    if (vertexBuffer_->IsDataLost() || billboardScale != previousScale_)
     {
-        if (billboards_[i].enabled_)
-            ++enabledBillboards;
+        previousScale_ = billboardScale;
+        dirtyStart_ = 0;
+        dirtyEnd_ = numBillboards;
     }
+    if (dirtyEnd_ > numBillboards)
+        dirtyEnd_ = numBillboards;
     
-    sortedBillboards_.Resize(enabledBillboards);
-    unsigned index = 0;
+    bool orderChanged = UpdateBillboardOrder();
+    if (sorted_ && (sortDirty_ || orderChanged || dirtyStart_ < dirtyEnd_))
+    {
+        SortBillboards(frame, billboardTransform);
+        orderChanged = true;
+    }
+    
+    unsigned enabledBillboards = sortedBillboards_.Size();
+    unsigned writeStart = M_MAX_UNSIGNED;
+    unsigned writeEnd = 0;
+    
+    // Rewrite the vertex buffer positions that now hold a different billboard
+    if (orderChanged)
+    {
+        for (unsigned i = 0; i < enabledBillboards; ++i)
+        {
+            unsigned& slot = billboardSlots_[sortedBillboards_[i]];
+            if (slot != i)
+            {
+                slot = i;
+                if (writeStart == M_MAX_UNSIGNED)
+                    writeStart = i;
+                writeEnd = i + 1;
+            }
+        }
+    }
     
-    // Then set initial sort order and distances
-    for (unsigned i = 0; i < numBillboards; ++i)
+    // Rewrite the modified billboards
+    for (unsigned i = dirtyStart_; i < dirtyEnd_; ++i)
     {
-        Billboard& billboard = billboards_[i];
-        if (billboard.enabled_)
+        unsigned slot = billboardSlots_[i];
+        if (slot != M_MAX_UNSIGNED)
         {
-            sortedBillboards_[index++] = &billboard;
-            if (sorted_)
-                billboard.sortDistance_ = frame.camera_->GetDistanceSquared(billboardTransform * billboards_[i].position_);
+            if (slot < writeStart)
+                writeStart = slot;
+            if (slot >= writeEnd)
+                writeEnd = slot + 1;
         }
     }
     
     batches_[0].geometry_->SetDrawRange(TRIANGLE_LIST, 0, enabledBillboards * 6, false);
     
+    if (writeStart < writeEnd)
+    {
+        // A partial lock without discard makes the CPU wait for the GPU on some APIs. That is only worth it for a small
+        // update, so past the threshold discard the old contents and rewrite all billboards
+        bool discard = (float)(writeEnd - writeStart) > FULL_REWRITE_THRESHOLD * (float)enabledBillboards;
+        if (discard)
+        {
+            writeStart = 0;
+            writeEnd = enabledBillboards;
+        }
+        
+        float* dest = (float*)vertexBuffer_->Lock(writeStart * 4, (writeEnd - writeStart) * 4, discard);
+        if (!dest)
+        {
+            // The slots have already been reassigned, so retry with all billboards on the next update
+            bufferDirty_ = true;
+            forceUpdate_ = true;
+            dirtyStart_ = 0;
+            dirtyEnd_ = numBillboards;
+            return;
+        }
+        
+        WriteBillboards(dest, writeStart, writeEnd, billboardScale);
+        
+        vertexBuffer_->Unlock();
+        vertexBuffer_->ClearDataLost();
+    }
+    
     bufferDirty_ = false;
     forceUpdate_ = false;
-    if (!enabledBillboards)
-        return;
-    
-    if (sorted_)
-        Sort(sortedBillboards_.Begin(), sortedBillboards_.End(), CompareBillboards);
-    
-    float* dest = (float*)vertexBuffer_->Lock(0, enabledBillboards * 4, true);
-    if (!dest)
-        return;
-    
-    for (unsigned i = 0; i < enabledBillboards; ++i)
+    dirtyStart_ = 0;
+    dirtyEnd_ = 0;
+}
+
+void BillboardSet::WriteBillboards(float* dest, unsigned start, unsigned end, const Vector3& billboardScale)
+{
+    for (unsigned i = start; i < end; ++i)
     {
-        Billboard& billboard = *sortedBillboards_[i];
+        Billboard& billboard = billboards_[sortedBillboards_[i]];
         
         Vector2 size(billboard.size_.x_ * billboardScale.x_, billboard.size_.y_ * billboardScale.y_);
         unsigned color = billboard.color_.ToUInt();
@@ -461,15 +636,106 @@ void BillboardSet::UpdateVertexBuffer(const FrameInfo& frame)
         *dest++ = -size.x_ * rotationMatrix[0][0] - size.y_ * rotationMatrix[0][1];
         *dest++ = -size.x_ * rotationMatrix[1][0] - size.y_ * rotationMatrix[1][1];
     }
+}
+
+bool BillboardSet::UpdateBillboardOrder()
+{
+    unsigned numBillboards = billboards_.Size();
+    
+    if (billboardSlots_.Size() != numBillboards)
+    {
+        billboardSlots_.Resize(numBillboards);
+        for (unsigned i = 0; i < numBillboards; ++i)
+            billboardSlots_[i] = M_MAX_UNSIGNED;
+        sortedBillboards_.Clear();
+        dirtyStart_ = 0;
+        dirtyEnd_ = numBillboards;
+    }
     
-    vertexBuffer_->Unlock();
-    vertexBuffer_->ClearDataLost();
+    // Billboards can only have been enabled or disabled within the modified range
+    bool changed = false;
+    for (unsigned i = dirtyStart_; i < dirtyEnd_; ++i)
+    {
+        if (billboards_[i].enabled_ != (billboardSlots_[i] != M_MAX_UNSIGNED))
+        {
+            changed = true;
+            break;
+        }
+    }
+    if (!changed)
+        return false;
+    
+    if (sorted_)
+    {
+        // Keep the previous order of the billboards that remain enabled, so that it stays nearly sorted, and add the
+        // newly enabled billboards to the end
+        unsigned index = 0;
+        for (unsigned i = 0; i < sortedBillboards_.Size(); ++i)
+        {
+            unsigned billboardIndex = sortedBillboards_[i];
+            if (billboards_[billboardIndex].enabled_)
+                sortedBillboards_[index++] = billboardIndex;
+            else
+                billboardSlots_[billboardIndex] = M_MAX_UNSIGNED;
+        }
+        sortedBillboards_.Resize(index);
+        
+        for (unsigned i = dirtyStart_; i < dirtyEnd_; ++i)
+        {
+            if (billboards_[i].enabled_ && billboardSlots_[i] == M_MAX_UNSIGNED)
+                sortedBillboards_.Push(i);
+        }
+    }
+    else
+    {
+        sortedBillboards_.Clear();
+        for (unsigned i = 0; i < numBillboards; ++i)
+        {
+            if (billboards_[i].enabled_)
+                sortedBillboards_.Push(i);
+            else
+                billboardSlots_[i] = M_MAX_UNSIGNED;
+        }
+    }
+    
+    return true;
+}
+
+void BillboardSet::SortBillboards(const FrameInfo& frame, const Matrix3x4& billboardTransform)
+{
+    unsigned numSorted = sortedBillboards_.Size();
+    sortDirty_ = false;
+    if (!numSorted)
+        return;
+    
+    // Gather the distances in the current order, so that sorting does not need to access the billboards
+    sortDistances_.Resize(numSorted);
+    unsigned* order = &sortedBillboards_[0];
+    float* distances = &sortDistances_[0];
+    for (unsigned i = 0; i < numSorted; ++i)
+    {
+        Billboard& billboard = billboards_[order[i]];
+        billboard.sortDistance_ = frame.camera_->GetDistanceSquared(billboardTransform * billboard.position_);
+        distances[i] = billboard.sortDistance_;
+    }
+    
+    // The previous order is usually nearly correct, so try to fix it with insertion sort first. If too many billboards
+    // have changed places, use radix sort instead
+    if (numSorted < MIN_RADIX_SORT_BILLBOARDS)
+        InsertionSortBillboards(order, distances, numSorted, M_MAX_UNSIGNED);
+    else if (!InsertionSortBillboards(order, distances, numSorted, numSorted * MAX_SORT_MOVES_PER_BILLBOARD))
+    {
+        sortBuffer_.Resize(numSorted * 3);
+        RadixSortBillboards(order, distances, numSorted, &sortBuffer_[0]);
+    }
 }
 
 void BillboardSet::MarkPositionsDirty()
 {
     Drawable::OnMarkedDirty(node_);
     bufferDirty_ = true;
+    dirtyStart_ = 0;
+    dirtyEnd_ = billboards_.Size();
 }
 
 }
@@ -86,6 +86,8 @@ public:
     void SetAnimationLodBias(float bias);
     /// Mark for bounding box and vertex buffer update. Call after modifying the billboards.
     void Commit();
+    /// Mark for bounding box and vertex buffer update, with only a range of billboards having been modified. Only the modified billboards are rewritten to the vertex buffer.
+    void CommitRange(unsigned start, unsigned count);
     
     /// Return material.
     Material* GetMaterial() const;
@@ -139,8 +141,14 @@ protected:
 private:
     /// Resize billboard vertex and index buffers.
     void UpdateBufferSize();
-    /// Rewrite billboard vertex buffer.
+    /// Rewrite the modified or reordered part of the billboard vertex buffer.
     void UpdateVertexBuffer(const FrameInfo& frame);
+    /// Write the vertices of a range of vertex buffer slots.
+    void WriteBillboards(float* dest, unsigned start, unsigned end, const Vector3& billboardScale);
+    /// Update the vertex buffer order of the enabled billboards when billboards have been enabled or disabled. Return true if changed.
+    bool UpdateBillboardOrder();
+    /// Sort the enabled billboards by distance.
+    void SortBillboards(const FrameInfo& frame, const Matrix3x4& billboardTransform);
     
     /// Geometry.
     SharedPtr<Geometry> geometry_;
@@ -152,14 +160,28 @@ private:
     bool bufferSizeDirty_;
     /// Vertex buffer needs rewrite flag.
     bool bufferDirty_;
+    /// Billboards need resort flag.
+    bool sortDirty_;
     /// Force update flag (ignore animation LOD momentarily.)
     bool forceUpdate_;
     /// Frame number on which was last sorted.
     unsigned sortFrameNumber_;
     /// Previous offset to camera for determining whether sorting is necessary.
     Vector3 previousOffset_;
-    /// Billboard pointers for sorting.
-    Vector<Billboard*> sortedBillboards_;
+    /// Billboard scale used in the last vertex buffer update.
+    Vector3 previousScale_;
+    /// Start of the billboard range modified since the last vertex buffer update.
+    unsigned dirtyStart_;
+    /// End of the billboard range modified since the last vertex buffer update.
+    unsigned dirtyEnd_;
+    /// Indices of the enabled billboards in vertex buffer order.
+    PODVector<unsigned> sortedBillboards_;
+    /// Vertex buffer position of each billboard, or M_MAX_UNSIGNED if not enabled.
+    PODVector<unsigned> billboardSlots_;
+    /// Billboard distances for sorting.
+    PODVector<float> sortDistances_;
+    /// Radix sort work buffer.
+    PODVector<unsigned> sortBuffer_;
     /// Attribute buffer for network replication.
     mutable VectorBuffer attrBuffer_;
 };
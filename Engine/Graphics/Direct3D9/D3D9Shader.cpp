@@ -32,6 +32,7 @@
 #include "ResourceCache.h"
 #include "Shader.h"
 #include "ShaderVariation.h"
+#include "VectorBuffer.h"
 #include "XMLFile.h"
 
 #include "DebugNew.h"
@@ -39,6 +40,8 @@
 namespace Urho3D
 {
 
+static const unsigned SHADER_CACHE_VERSION = 1;
+
 OBJECTTYPESTATIC(Shader);
 
 Shader::Shader(Context* context) :
@@ -141,17 +144,6 @@ bool Shader::Load(Deserializer& source)
         }
     }
     
-    SharedPtr<XMLFile> xml(new XMLFile(context_));
-    if (!xml->Load(source))
-        return false;
-    
-    XMLElement shaders = xml->GetRoot("shaders");
-    if (!shaders)
-    {
-        LOGERROR("No shaders element in " + source.GetName());
-        return false;
-    }
-    
     Vector<String> globalDefines;
     Vector<String> globalDefineValues;
     
@@ -161,18 +153,59 @@ bool Shader::Load(Deserializer& source)
         globalDefineValues.Push("1");
     }
     
+    // Building the shader combinations is expensive with many options, so if processed data caching is enabled, check
+    // first for the combinations stored on an earlier run
+    String cacheKey = graphics->GetSM3Support() ? "ShaderSM3" : "ShaderSM2";
+    VectorBuffer sourceData;
+    unsigned checksum = 0;
+    bool useDataCache = cache && cache->ReadCacheSource(source, sourceData, checksum);
+    bool parsed = false;
+    if (useDataCache)
     {
-        PROFILE(ParseShaderDefinition);
+        SharedPtr<File> cacheFile = cache->GetCacheFile(cacheKey, checksum);
+        if (cacheFile && cacheFile->ReadFileID() == "USHC" && cacheFile->ReadUInt() == SHADER_CACHE_VERSION &&
+            vsParser_.Load(*cacheFile) && psParser_.Load(*cacheFile))
+            parsed = true;
+    }
+    
+    if (!parsed)
+    {
+        SharedPtr<XMLFile> xml(new XMLFile(context_));
+        if (!xml->Load(sourceData.GetSize() ? (Deserializer&)sourceData : source))
+            return false;
         
-        if (!vsParser_.Parse(VS, shaders, globalDefines, globalDefineValues))
+        XMLElement shaders = xml->GetRoot("shaders");
+        if (!shaders)
         {
-            LOGERROR("VS: " + vsParser_.GetErrorMessage());
+            LOGERROR("No shaders element in " + source.GetName());
             return false;
         }
-        if (!psParser_.Parse(PS, shaders, globalDefines, globalDefineValues))
+        
         {
-            LOGERROR("PS: " + psParser_.GetErrorMessage());
-            return false;
+            PROFILE(ParseShaderDefinition);
+            
+            if (!vsParser_.Parse(VS, shaders, globalDefines, globalDefineValues))
+            {
+                LOGERROR("VS: " + vsParser_.GetErrorMessage());
+                return false;
+            }
+            if (!psParser_.Parse(PS, shaders, globalDefines, globalDefineValues))
+            {
+                LOGERROR("PS: " + psParser_.GetErrorMessage());
+                return false;
+            }
+        }
+        
+        if (useDataCache)
+        {
+            SharedPtr<File> cacheFile = cache->CreateCacheFile(cacheKey, checksum);
+            if (cacheFile)
+            {
+                cacheFile->WriteFileID("USHC");
+                cacheFile->WriteUInt(SHADER_CACHE_VERSION);
+                vsParser_.Save(*cacheFile);
+                psParser_.Save(*cacheFile);
+            }
         }
     }
     
@@ -33,6 +33,7 @@
 #include "Technique.h"
 #include "Texture2D.h"
 #include "TextureCube.h"
+#include "VectorBuffer.h"
 #include "XMLFile.h"
 
 #include "DebugNew.h"
@@ -40,6 +41,8 @@
 namespace Urho3D
 {
 
+static const unsigned MATERIAL_CACHE_VERSION = 1;
+
 static const char* textureUnitNames[] =
 {
     "diffuse",
@@ -135,17 +138,38 @@ bool Material::Load(Deserializer& source)
     
     ResourceCache* cache = GetSubsystem<ResourceCache>();
     
+    // If processed data caching is enabled, check first for the definition stored in binary form on an earlier run
+    VectorBuffer sourceData;
+    unsigned checksum = 0;
+    bool useDataCache = cache->ReadCacheSource(source, sourceData, checksum);
+    if (useDataCache)
+    {
+        SharedPtr<File> cacheFile = cache->GetCacheFile("Material", checksum);
+        if (cacheFile && LoadCachedData(*cacheFile))
+        {
+            FinishLoad();
+            return true;
+        }
+        
+        ResetToDefaults();
+    }
+    
     SharedPtr<XMLFile> xml(new XMLFile(context_));
-    if (!xml->Load(source))
+    if (!xml->Load(sourceData.GetSize() ? (Deserializer&)sourceData : source))
         return false;
     
+    // Track whether all referenced resources loaded, as a failure must not be stored in the processed data cache
+    bool resourcesLoaded = true;
+    
     XMLElement rootElem = xml->GetRoot();
     XMLElement techniqueElem = rootElem.GetChild("technique");
     techniques_.Clear();
     while (techniqueElem)
     {
         Technique* tech = cache->GetResource<Technique>(techniqueElem.GetAttribute("name"));
-        if (tech)
+        if (!tech)
+            resourcesLoaded = false;
+        else
         {
             TechniqueEntry newTechnique;
             newTechnique.technique_ = tech;
@@ -178,10 +202,14 @@ bool Material::Load(Deserializer& source)
         {
             String name = textureElem.GetAttribute("name");
             // Detect cube maps by file extension: they are defined by an XML file
+            Texture* texture;
             if (GetExtension(name) == ".xml")
-                SetTexture(unit, cache->GetResource<TextureCube>(name));
+                texture = cache->GetResource<TextureCube>(name);
             else
-                SetTexture(unit, cache->GetResource<Texture2D>(name));
+                texture = cache->GetResource<Texture2D>(name);
+            if (!texture)
+                resourcesLoaded = false;
+            SetTexture(unit, texture);
         }
         textureElem = textureElem.GetNext("texture");
     }
@@ -208,15 +236,10 @@ bool Material::Load(Deserializer& source)
     if (depthBiasElem)
         SetDepthBias(BiasParameters(depthBiasElem.GetFloat("constant"), depthBiasElem.GetFloat("slopescaled")));
     
-    // Calculate memory use
-    unsigned memoryUse = sizeof(Material);
-    
-    memoryUse += techniques_.Size() * sizeof(TechniqueEntry);
-    memoryUse += MAX_MATERIAL_TEXTURE_UNITS * sizeof(SharedPtr<Texture>);
-    memoryUse += shaderParameters_.Size() * sizeof(MaterialShaderParameter);
+    if (useDataCache && resourcesLoaded)
+        StoreCachedData(checksum);
     
-    SetMemoryUse(memoryUse);
-    CheckOcclusion();
+    FinishLoad();
     return true;
 }
 
@@ -446,6 +469,126 @@ void Material::CheckOcclusion()
     }
 }
 
+bool Material::LoadCachedData(Deserializer& source)
+{
+    if (source.ReadFileID() != "UMTC" || source.ReadUInt() != MATERIAL_CACHE_VERSION)
+    {
+        LOGWARNING("Ignoring mismatching cached material data for " + GetName());
+        return false;
+    }
+    
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    
+    unsigned numTechniques = source.ReadVLE();
+    techniques_.Clear();
+    for (unsigned i = 0; i < numTechniques; ++i)
+    {
+        String name = source.ReadString();
+        int qualityLevel = source.ReadInt();
+        float lodDistance = source.ReadFloat();
+        Technique* tech = cache->GetResource<Technique>(name);
+        if (!tech)
+            return false;
+        techniques_.Push(TechniqueEntry(tech, qualityLevel, lodDistance));
+    }
+    
+    unsigned numTextures = source.ReadVLE();
+    for (unsigned i = 0; i < numTextures; ++i)
+    {
+        unsigned unit = source.ReadUByte();
+        ShortStringHash type = source.ReadShortStringHash();
+        String name = source.ReadString();
+        if (unit >= MAX_MATERIAL_TEXTURE_UNITS)
+            return false;
+        Texture* texture;
+        if (type == TextureCube::GetTypeStatic())
+            texture = cache->GetResource<TextureCube>(name);
+        else
+            texture = cache->GetResource<Texture2D>(name);
+        if (!texture)
+            return false;
+        SetTexture((TextureUnit)unit, texture);
+    }
+    
+    unsigned numParameters = source.ReadVLE();
+    for (unsigned i = 0; i < numParameters; ++i)
+    {
+        String name = source.ReadString();
+        SetShaderParameter(name, source.ReadVector4());
+    }
+    
+    SetCullMode((CullMode)source.ReadUByte());
+    SetShadowCullMode((CullMode)source.ReadUByte());
+    float constantBias = source.ReadFloat();
+    float slopeScaledBias = source.ReadFloat();
+    SetDepthBias(BiasParameters(constantBias, slopeScaledBias));
+    
+    return true;
+}
+
+void Material::StoreCachedData(unsigned checksum)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SharedPtr<File> file = cache->CreateCacheFile("Material", checksum);
+    if (!file)
+        return;
+    
+    file->WriteFileID("UMTC");
+    file->WriteUInt(MATERIAL_CACHE_VERSION);
+    
+    // Techniques that failed to load have not been added, so they are not stored either
+    file->WriteVLE(techniques_.Size());
+    for (unsigned i = 0; i < techniques_.Size(); ++i)
+    {
+        const TechniqueEntry& entry = techniques_[i];
+        file->WriteString(entry.technique_ ? entry.technique_->GetName() : String::EMPTY);
+        file->WriteInt(entry.qualityLevel_);
+        file->WriteFloat(entry.lodDistance_);
+    }
+    
+    unsigned numTextures = 0;
+    for (unsigned i = 0; i < MAX_MATERIAL_TEXTURE_UNITS; ++i)
+    {
+        if (textures_[i])
+            ++numTextures;
+    }
+    file->WriteVLE(numTextures);
+    for (unsigned i = 0; i < MAX_MATERIAL_TEXTURE_UNITS; ++i)
+    {
+        if (textures_[i])
+        {
+            file->WriteUByte(i);
+            file->WriteShortStringHash(textures_[i]->GetType());
+            file->WriteString(textures_[i]->GetName());
+        }
+    }
+    
+    file->WriteVLE(shaderParameters_.Size());
+    for (HashMap<StringHash, MaterialShaderParameter>::ConstIterator i = shaderParameters_.Begin(); i != shaderParameters_.End(); ++i)
+    {
+        file->WriteString(i->second_.name_);
+        file->WriteVector4(i->second_.value_);
+    }
+    
+    file->WriteUByte(cullMode_);
+    file->WriteUByte(shadowCullMode_);
+    file->WriteFloat(depthBias_.constantBias_);
+    file->WriteFloat(depthBias_.slopeScaledBias_);
+}
+
+void Material::FinishLoad()
+{
+    // Calculate memory use
+    unsigned memoryUse = sizeof(Material);
+    
+    memoryUse += techniques_.Size() * sizeof(TechniqueEntry);
+    memoryUse += MAX_MATERIAL_TEXTURE_UNITS * sizeof(SharedPtr<Texture>);
+    memoryUse += shaderParameters_.Size() * sizeof(MaterialShaderParameter);
+    
+    SetMemoryUse(memoryUse);
+    CheckOcclusion();
+}
+
 void Material::ResetToDefaults()
 {
     for (unsigned i = 0; i < MAX_MATERIAL_TEXTURE_UNITS; ++i)
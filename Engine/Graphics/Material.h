@@ -147,6 +147,12 @@ private:
     void CheckOcclusion();
     /// Reset to defaults.
     void ResetToDefaults();
+    /// Load the definition from the processed resource data cache. Return true if successful.
+    bool LoadCachedData(Deserializer& source);
+    /// Store the definition to the processed resource data cache.
+    void StoreCachedData(unsigned checksum);
+    /// Calculate memory use and re-evaluate occlusion rendering after loading.
+    void FinishLoad();
     
     /// Techniques.
     Vector<TechniqueEntry> techniques_;
@@ -29,7 +29,9 @@
 #include "Model.h"
 #include "Profiler.h"
 #include "Graphics.h"
+#include "ResourceCache.h"
 #include "Serializer.h"
+#include "VectorBuffer.h"
 #include "VertexBuffer.h"
 
 #include <cstring>
@@ -39,6 +41,8 @@
 namespace Urho3D
 {
 
+static const unsigned MODEL_CACHE_VERSION = 1;
+
 unsigned LookupVertexBuffer(VertexBuffer* buffer, const Vector<SharedPtr<VertexBuffer> >& buffers)
 {
     for (unsigned i = 0; i < buffers.Size(); ++i)
@@ -79,8 +83,16 @@ bool Model::Load(Deserializer& source)
 {
     PROFILE(LoadModel);
     
+    // If processed data caching is enabled, get the model data checksum first so that it can be used to look up data
+    // calculated on an earlier run. The data is read into memory and hashed only if the file has changed since
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    VectorBuffer sourceData;
+    unsigned checksum = 0;
+    bool useDataCache = cache && cache->ReadCacheSource(source, sourceData, checksum);
+    Deserializer& modelSource = sourceData.GetSize() ? (Deserializer&)sourceData : source;
+    
     // Check ID
-    if (source.ReadFileID() != "UMDL")
+    if (modelSource.ReadFileID() != "UMDL")
     {
         LOGERROR(source.GetName() + " is not a valid model file");
         return false;
@@ -96,16 +108,16 @@ bool Model::Load(Deserializer& source)
     unsigned memoryUse = sizeof(Model);
     
     // Read vertex buffers
-    unsigned numVertexBuffers = source.ReadUInt();
+    unsigned numVertexBuffers = modelSource.ReadUInt();
     vertexBuffers_.Reserve(numVertexBuffers);
     morphRangeStarts_.Resize(numVertexBuffers);
     morphRangeCounts_.Resize(numVertexBuffers);
     for (unsigned i = 0; i < numVertexBuffers; ++i)
     {
-        unsigned vertexCount = source.ReadUInt();
-        unsigned elementMask = source.ReadUInt();
-        morphRangeStarts_[i] = source.ReadUInt();
-        morphRangeCounts_[i] = source.ReadUInt();
+        unsigned vertexCount = modelSource.ReadUInt();
+        unsigned elementMask = modelSource.ReadUInt();
+        morphRangeStarts_[i] = modelSource.ReadUInt();
+        morphRangeCounts_[i] = modelSource.ReadUInt();
         
         SharedPtr<VertexBuffer> buffer(new VertexBuffer(context_));
         buffer->SetShadowed(true);
@@ -113,7 +125,7 @@ bool Model::Load(Deserializer& source)
         
         void* dest = buffer->Lock(0, vertexCount);
         unsigned vertexSize = buffer->GetVertexSize();
-        source.Read(dest, vertexCount * vertexSize);
+        modelSource.Read(dest, vertexCount * vertexSize);
         buffer->Unlock();
         
         memoryUse += sizeof(VertexBuffer) + vertexCount * vertexSize;
@@ -121,19 +133,19 @@ bool Model::Load(Deserializer& source)
     }
 
     // Read index buffers
-    unsigned numIndexBuffers = source.ReadUInt();
+    unsigned numIndexBuffers = modelSource.ReadUInt();
     indexBuffers_.Reserve(numIndexBuffers);
     for (unsigned i = 0; i < numIndexBuffers; ++i)
     {
-        unsigned indexCount = source.ReadUInt();
-        unsigned indexSize = source.ReadUInt();
+        unsigned indexCount = modelSource.ReadUInt();
+        unsigned indexSize = modelSource.ReadUInt();
         
         SharedPtr<IndexBuffer> buffer(new IndexBuffer(context_));
         buffer->SetShadowed(true);
         buffer->SetSize(indexCount, indexSize > sizeof(unsigned short));
         
         void* dest = buffer->Lock(0, indexCount);
-        source.Read(dest, indexCount * indexSize);
+        modelSource.Read(dest, indexCount * indexSize);
         buffer->Unlock();
         
         memoryUse += sizeof(IndexBuffer) + indexCount * indexSize;
@@ -141,32 +153,32 @@ bool Model::Load(Deserializer& source)
     }
     
     // Read geometries
-    unsigned numGeometries = source.ReadUInt();
+    unsigned numGeometries = modelSource.ReadUInt();
     geometries_.Reserve(numGeometries);
     geometryBoneMappings_.Reserve(numGeometries);
     geometryCenters_.Reserve(numGeometries);
     for (unsigned i = 0; i < numGeometries; ++i)
     {
         // Read bone mappings
-        unsigned boneMappingCount = source.ReadUInt();
+        unsigned boneMappingCount = modelSource.ReadUInt();
         PODVector<unsigned> boneMapping(boneMappingCount);
         for (unsigned j = 0; j < boneMappingCount; ++j)
-            boneMapping[j] = source.ReadUInt();
+            boneMapping[j] = modelSource.ReadUInt();
         geometryBoneMappings_.Push(boneMapping);
         
-        unsigned numLodLevels = source.ReadUInt();
+        unsigned numLodLevels = modelSource.ReadUInt();
         Vector<SharedPtr<Geometry> > geometryLodLevels;
         geometryLodLevels.Reserve(numLodLevels);
         
         for (unsigned j = 0; j < numLodLevels; ++j)
         {
-            float distance = source.ReadFloat();
-            PrimitiveType type = (PrimitiveType)source.ReadUInt();
+            float distance = modelSource.ReadFloat();
+            PrimitiveType type = (PrimitiveType)modelSource.ReadUInt();
             
-            unsigned vertexBufferRef = source.ReadUInt();
-            unsigned indexBufferRef = source.ReadUInt();
-            unsigned indexStart = source.ReadUInt();
-            unsigned indexCount = source.ReadUInt();
+            unsigned vertexBufferRef = modelSource.ReadUInt();
+            unsigned indexBufferRef = modelSource.ReadUInt();
+            unsigned indexStart = modelSource.ReadUInt();
+            unsigned indexCount = modelSource.ReadUInt();
             
             if (vertexBufferRef >= vertexBuffers_.Size())
             {
@@ -193,24 +205,24 @@ bool Model::Load(Deserializer& source)
     }
     
     // Read morphs
-    unsigned numMorphs = source.ReadUInt();
+    unsigned numMorphs = modelSource.ReadUInt();
     morphs_.Reserve(numMorphs);
     for (unsigned i = 0; i < numMorphs; ++i)
     {
         ModelMorph newMorph;
         
-        newMorph.name_ = source.ReadString();
+        newMorph.name_ = modelSource.ReadString();
         newMorph.nameHash_ = newMorph.name_;
         newMorph.weight_ = 0.0f;
-        unsigned nubuffers_ = source.ReadUInt();
+        unsigned nubuffers_ = modelSource.ReadUInt();
         
         for (unsigned j = 0; j < nubuffers_; ++j)
         {
             VertexBufferMorph newBuffer;
-            unsigned bufferIndex = source.ReadUInt();
+            unsigned bufferIndex = modelSource.ReadUInt();
             
-            newBuffer.elementMask_ = source.ReadUInt();
-            newBuffer.vertexCount_ = source.ReadUInt();
+            newBuffer.elementMask_ = modelSource.ReadUInt();
+            newBuffer.vertexCount_ = modelSource.ReadUInt();
             
             // Base size: size of each vertex index
             unsigned vertexSize = sizeof(unsigned);
@@ -223,7 +235,7 @@ bool Model::Load(Deserializer& source)
                 vertexSize += sizeof(Vector3);
             newBuffer.morphData_ = new unsigned char[newBuffer.vertexCount_ * vertexSize];
             
-            source.Read(&newBuffer.morphData_[0], newBuffer.vertexCount_ * vertexSize);
+            modelSource.Read(&newBuffer.morphData_[0], newBuffer.vertexCount_ * vertexSize);
             
             newMorph.buffers_[bufferIndex] = newBuffer;
             memoryUse += sizeof(VertexBufferMorph) + newBuffer.vertexCount_ * vertexSize;
@@ -234,23 +246,93 @@ bool Model::Load(Deserializer& source)
     }
     
     // Read skeleton
-    skeleton_.Load(source);
+    skeleton_.Load(modelSource);
     memoryUse += skeleton_.GetNumBones() * sizeof(Bone);
     
     // Read bounding box
-    boundingBox_ = source.ReadBoundingBox();
+    boundingBox_ = modelSource.ReadBoundingBox();
     
     // Read geometry centers
-    for (unsigned i = 0; i < geometries_.Size() && !source.IsEof(); ++i)
-        geometryCenters_.Push(source.ReadVector3());
-    while (geometryCenters_.Size() < geometries_.Size())
-        geometryCenters_.Push(Vector3::ZERO);
+    for (unsigned i = 0; i < geometries_.Size() && !modelSource.IsEof(); ++i)
+        geometryCenters_.Push(modelSource.ReadVector3());
+    
+    // Older model files do not store the geometry centers. Calculate them from the geometry data, or if caching is
+    // enabled, use the centers calculated on an earlier run
+    if (geometryCenters_.Size() < geometries_.Size())
+    {
+        unsigned numStored = geometryCenters_.Size();
+        bool cached = false;
+        if (useDataCache)
+        {
+            SharedPtr<File> cacheFile = cache->GetCacheFile("Model", checksum);
+            if (cacheFile && cacheFile->ReadFileID() == "UMCN" && cacheFile->ReadUInt() == MODEL_CACHE_VERSION &&
+                cacheFile->ReadVLE() == geometries_.Size() && cacheFile->GetSize() - cacheFile->GetPosition() >=
+                geometries_.Size() * sizeof(Vector3))
+            {
+                cacheFile->Seek(cacheFile->GetPosition() + numStored * sizeof(Vector3));
+                while (geometryCenters_.Size() < geometries_.Size())
+                    geometryCenters_.Push(cacheFile->ReadVector3());
+                cached = true;
+            }
+        }
+        
+        if (!cached)
+        {
+            while (geometryCenters_.Size() < geometries_.Size())
+                geometryCenters_.Push(CalculateGeometryCenter(geometryCenters_.Size()));
+            
+            if (useDataCache)
+            {
+                SharedPtr<File> cacheFile = cache->CreateCacheFile("Model", checksum);
+                if (cacheFile)
+                {
+                    cacheFile->WriteFileID("UMCN");
+                    cacheFile->WriteUInt(MODEL_CACHE_VERSION);
+                    cacheFile->WriteVLE(geometryCenters_.Size());
+                    for (unsigned i = 0; i < geometryCenters_.Size(); ++i)
+                        cacheFile->WriteVector3(geometryCenters_[i]);
+                }
+            }
+        }
+    }
     memoryUse += sizeof(Vector3) * geometries_.Size();
     
     SetMemoryUse(memoryUse);
     return true;
 }
 
+Vector3 Model::CalculateGeometryCenter(unsigned index) const
+{
+    if (index >= geometries_.Size() || geometries_[index].Empty() || !geometries_[index][0])
+        return Vector3::ZERO;
+    
+    Geometry* geometry = geometries_[index][0];
+    if (geometry->GetPrimitiveType() != TRIANGLE_LIST)
+        return Vector3::ZERO;
+    
+    const unsigned char* vertexData;
+    const unsigned char* indexData;
+    unsigned vertexSize;
+    unsigned indexSize;
+    unsigned elementMask;
+    geometry->GetRawData(vertexData, vertexSize, indexData, indexSize, elementMask);
+    if (!vertexData || !indexData || !(elementMask & MASK_POSITION))
+        return Vector3::ZERO;
+    
+    // Position is always the first vertex element
+    unsigned indexStart = geometry->GetIndexStart();
+    unsigned indexEnd = indexStart + geometry->GetIndexCount();
+    Vector3 center = Vector3::ZERO;
+    for (unsigned i = indexStart; i < indexEnd; ++i)
+    {
+        unsigned vertexIndex = indexSize == sizeof(unsigned short) ? ((const unsigned short*)indexData)[i] :
+            ((const unsigned*)indexData)[i];
+        center += *((const Vector3*)(vertexData + vertexIndex * vertexSize));
+    }
+    
+    return indexEnd > indexStart ? center / (float)(indexEnd - indexStart) : Vector3::ZERO;
+}
+
 bool Model::Save(Serializer& dest) const
 {
     // Write ID
@@ -135,6 +135,9 @@ public:
     unsigned GetMorphRangeCount(unsigned bufferIndex) const;
     
 private:
+    /// Calculate a geometry's center as the average of its LOD level 0 triangle vertices.
+    Vector3 CalculateGeometryCenter(unsigned index) const;
+    
     /// Bounding box.
     BoundingBox boundingBox_;
     /// Skeleton.
@@ -30,6 +30,7 @@
 #include "ResourceCache.h"
 #include "Shader.h"
 #include "ShaderVariation.h"
+#include "VectorBuffer.h"
 #include "XMLFile.h"
 
 #include "DebugNew.h"
@@ -37,6 +38,8 @@
 namespace Urho3D
 {
 
+static const unsigned SHADER_CACHE_VERSION = 1;
+
 OBJECTTYPESTATIC(Shader);
 
 Shader::Shader(Context* context) :
@@ -69,29 +72,59 @@ bool Shader::Load(Deserializer& source)
     vsSourceCodeLength_ = 0;
     psSourceCodeLength_ = 0;
     
-    SharedPtr<XMLFile> xml(new XMLFile(context_));
-    if (!xml->Load(source))
-        return false;
-
-    XMLElement shaders = xml->GetRoot("shaders");
-    if (!shaders)
+    // Building the shader combinations is expensive with many options, so if processed data caching is enabled, check
+    // first for the combinations stored on an earlier run
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    VectorBuffer sourceData;
+    unsigned checksum = 0;
+    bool useDataCache = cache && cache->ReadCacheSource(source, sourceData, checksum);
+    bool parsed = false;
+    if (useDataCache)
     {
-        LOGERROR("No shaders element in " + source.GetName());
-        return false;
+        SharedPtr<File> cacheFile = cache->GetCacheFile("Shader", checksum);
+        if (cacheFile && cacheFile->ReadFileID() == "USHC" && cacheFile->ReadUInt() == SHADER_CACHE_VERSION &&
+            vsParser_.Load(*cacheFile) && psParser_.Load(*cacheFile))
+            parsed = true;
     }
     
+    if (!parsed)
     {
-        PROFILE(ParseShaderDefinition);
-        
-        if (!vsParser_.Parse(VS, shaders))
+        SharedPtr<XMLFile> xml(new XMLFile(context_));
+        if (!xml->Load(sourceData.GetSize() ? (Deserializer&)sourceData : source))
+            return false;
+
+        XMLElement shaders = xml->GetRoot("shaders");
+        if (!shaders)
         {
-            LOGERROR("VS: " + vsParser_.GetErrorMessage());
+            LOGERROR("No shaders element in " + source.GetName());
             return false;
         }
-        if (!psParser_.Parse(PS, shaders))
+        
         {
-            LOGERROR("PS: " + psParser_.GetErrorMessage());
-            return false;
+            PROFILE(ParseShaderDefinition);
+            
+            if (!vsParser_.Parse(VS, shaders))
+            {
+                LOGERROR("VS: " + vsParser_.GetErrorMessage());
+                return false;
+            }
+            if (!psParser_.Parse(PS, shaders))
+            {
+                LOGERROR("PS: " + psParser_.GetErrorMessage());
+                return false;
+            }
+        }
+        
+        if (useDataCache)
+        {
+            SharedPtr<File> cacheFile = cache->CreateCacheFile("Shader", checksum);
+            if (cacheFile)
+            {
+                cacheFile->WriteFileID("USHC");
+                cacheFile->WriteUInt(SHADER_CACHE_VERSION);
+                vsParser_.Save(*cacheFile);
+                psParser_.Save(*cacheFile);
+            }
         }
     }
     
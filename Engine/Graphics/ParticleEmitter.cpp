@@ -31,6 +31,13 @@
 #include "SceneEvents.h"
 #include "XMLFile.h"
 
+#ifdef USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef USE_NEON
+#include <arm_neon.h>
+#endif
+
 #include "DebugNew.h"
 
 namespace Urho3D
@@ -38,6 +45,52 @@ namespace Urho3D
 
 extern const char* GEOMETRY_CATEGORY;
 
+/// Advance the particle timers. Particles that had already reached their time to live are flagged with a negative timer.
+static void AdvanceTimers(float* timers, const float* timesToLive, unsigned count, float timeStep)
+{
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    __m128 timeStepVec = _mm_set1_ps(timeStep);
+    __m128 expiredVec = _mm_set1_ps(-1.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 timer = _mm_loadu_ps(timers + i);
+        __m128 alive = _mm_cmplt_ps(timer, _mm_loadu_ps(timesToLive + i));
+        _mm_storeu_ps(timers + i, _mm_or_ps(_mm_and_ps(alive, _mm_add_ps(timer, timeStepVec)), _mm_andnot_ps(alive,
+            expiredVec)));
+    }
+#elif defined(USE_NEON)
+    float32x4_t timeStepVec = vdupq_n_f32(timeStep);
+    float32x4_t expiredVec = vdupq_n_f32(-1.0f);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t timer = vld1q_f32(timers + i);
+        uint32x4_t alive = vcltq_f32(timer, vld1q_f32(timesToLive + i));
+        vst1q_f32(timers + i, vbslq_f32(alive, vaddq_f32(timer, timeStepVec), expiredVec));
+    }
+#endif
+    for (; i < count; ++i)
+        timers[i] = timers[i] < timesToLive[i] ? timers[i] + timeStep : -1.0f;
+}
+
+/// Add a value to each element of a particle state array, then multiply by another value.
+static void AddMultiply(float* dest, unsigned count, float add, float mul)
+{
+    unsigned i = 0;
+#if defined(USE_SSE2)
+    __m128 addVec = _mm_set1_ps(add);
+    __m128 mulVec = _mm_set1_ps(mul);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(dest + i), addVec), mulVec));
+#elif defined(USE_NEON)
+    float32x4_t addVec = vdupq_n_f32(add);
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dest + i, vmulq_n_f32(vaddq_f32(vld1q_f32(dest + i), addVec), mul));
+#endif
+    for (; i < count; ++i)
+        dest[i] = (dest[i] + add) * mul;
+}
+
 OBJECTTYPESTATIC(ParticleEmitter);
 
 ParticleEmitter::ParticleEmitter(Context* context) :
@@ -114,8 +167,9 @@ void ParticleEmitter::OnSetEnabled()
 void ParticleEmitter::Update(const FrameInfo& frame)
 {
     // If there is an amount mismatch between particles and billboards, correct it
-    if (particles_.Size() != billboards_.Size())
-        SetNumBillboards(particles_.Size());
+    unsigned numParticles = timers_.Size();
+    if (numParticles != billboards_.Size())
+        SetNumBillboards(numParticles);
     
     bool needCommit = false;
     
@@ -150,81 +204,73 @@ void ParticleEmitter::Update(const FrameInfo& frame)
         }
     }
     
-    // Update existing particles
-    Vector3 relativeConstantForce = node_->GetWorldRotation().Inverse() * constanceForce_;
-    // If billboards are not relative, apply scaling to the position update
-    Vector3 scaleVector = Vector3::ONE;
-    if (scaled_ && !relative_)
-        scaleVector = node_->GetWorldScale();
-    
-    for (unsigned i = 0; i < particles_.Size(); ++i)
+    if (numParticles)
     {
-        Particle& particle = particles_[i];
-        Billboard& billboard = billboards_[i];
+        // Advance the particle timers, velocities and size scaling values several particles at a time. Disabled particles
+        // are included, as their state is reset when they are emitted again
+        AdvanceTimers(&timers_[0], &timesToLive_[0], numParticles, lastTimeStep_);
+        
+        if (constanceForce_ != Vector3::ZERO || dampingForce_ != 0.0f)
+        {
+            Vector3 force = relative_ ? node_->GetWorldRotation().Inverse() * constanceForce_ : constanceForce_;
+            float damping = 1.0f - lastTimeStep_ * dampingForce_;
+            AddMultiply(&velocityX_[0], numParticles, lastTimeStep_ * force.x_, damping);
+            AddMultiply(&velocityY_[0], numParticles, lastTimeStep_ * force.y_, damping);
+            AddMultiply(&velocityZ_[0], numParticles, lastTimeStep_ * force.z_, damping);
+        }
+        
+        bool scaling = sizeAdd_ != 0.0f || sizeMul_ != 1.0f;
+        if (scaling)
+            AddMultiply(&scales_[0], numParticles, lastTimeStep_ * sizeAdd_, lastTimeStep_ * (sizeMul_ - 1.0f) + 1.0f);
         
-        if (billboard.enabled_)
+        // If billboards are not relative, apply scaling to the position update
+        Vector3 positionScale = lastTimeStep_ * ((scaled_ && !relative_) ? node_->GetWorldScale() : Vector3::ONE);
+        unsigned lastColor = colors_.Size() - 1;
+        unsigned lastTexAnim = textureAnimation_.Size() ? textureAnimation_.Size() - 1 : 0;
+        
+        // Write the particles to the billboards
+        for (unsigned i = 0; i < numParticles; ++i)
         {
+            Billboard& billboard = billboards_[i];
+            if (!billboard.enabled_)
+                continue;
+            
             needCommit = true;
             
             // Time to live
-            if (particle.timer_ >= particle.timeToLive_)
+            float timer = timers_[i];
+            if (timer < 0.0f)
             {
                 billboard.enabled_ = false;
                 continue;
             }
-            particle.timer_ += lastTimeStep_;
-            
-            // Velocity & position
-            if (constanceForce_ != Vector3::ZERO)
-            {
-                if (relative_)
-                    particle.velocity_ += lastTimeStep_ * relativeConstantForce;
-                else
-                    particle.velocity_ += lastTimeStep_ * constanceForce_;
-            }
-            if (dampingForce_ != 0.0f)
-            {
-                Vector3 force = -dampingForce_ * particle.velocity_;
-                particle.velocity_ += lastTimeStep_ * force;
-            }
-            billboard.position_ += lastTimeStep_ * particle.velocity_ * scaleVector;
             
-            // Rotation
-            billboard.rotation_ += lastTimeStep_ * particle.rotationSpeed_;
-            
-            // Scaling
-            if (sizeAdd_ != 0.0f || sizeMul_ != 1.0f)
-            {
-                particle.scale_ += lastTimeStep_ * sizeAdd_;
-                if (sizeMul_ != 1.0f)
-                    particle.scale_ *= (lastTimeStep_ * (sizeMul_ - 1.0f)) + 1.0f;
-                billboard.size_ = particle.size_ * particle.scale_;
-            }
+            // Position, rotation & scaling
+            billboard.position_ += Vector3(velocityX_[i], velocityY_[i], velocityZ_[i]) * positionScale;
+            billboard.rotation_ += lastTimeStep_ * rotationSpeeds_[i];
+            if (scaling)
+                billboard.size_ = sizes_[i] * scales_[i];
             
             // Color interpolation
-            unsigned& index = particle.colorIndex_;
-            if (index < colors_.Size())
+            unsigned& index = colorIndices_[i];
+            if (index < lastColor)
             {
-                if (index < colors_.Size() - 1)
-                {
-                    if (particle.timer_ >= colors_[index + 1].time_)
-                        ++index;
-                }
-                if (index < colors_.Size() - 1)
-                    billboard.color_ = colors_[index].Interpolate(colors_[index + 1], particle.timer_);
+                if (timer >= colors_[index + 1].time_)
+                    ++index;
+                if (index < lastColor)
+                    billboard.color_ = colors_[index].Interpolate(colors_[index + 1], timer);
                 else
                     billboard.color_ = colors_[index].color_;
             }
+            else if (index == lastColor)
+                billboard.color_ = colors_[index].color_;
             
             // Texture animation
-            unsigned& texIndex = particle.texIndex_;
-            if (textureAnimation_.Size() && texIndex < textureAnimation_.Size() - 1)
+            unsigned& texIndex = texIndices_[i];
+            if (texIndex < lastTexAnim && timer >= textureAnimation_[texIndex + 1].time_)
             {
-                if (particle.timer_ >= textureAnimation_[texIndex + 1].time_)
-                {
-                    billboard.uv_ = textureAnimation_[texIndex + 1].uv_;
-                    ++texIndex;
-                }
+                billboard.uv_ = textureAnimation_[texIndex + 1].uv_;
+                ++texIndex;
             }
         }
     }
@@ -386,16 +432,19 @@ void ParticleEmitter::SetParticlesAttr(VariantVector value)
 {
     unsigned index = 0;
     SetNumParticles(value[index++].GetInt());
-    for (PODVector<Particle>::Iterator i = particles_.Begin(); i != particles_.End() && index < value.Size(); ++i)
+    for (unsigned i = 0; i < timers_.Size() && index < value.Size(); ++i)
     {
-        i->velocity_ = value[index++].GetVector3();
-        i->size_ = value[index++].GetVector2();
-        i->timer_ = value[index++].GetFloat();
-        i->timeToLive_ = value[index++].GetFloat();
-        i->scale_ = value[index++].GetFloat();
-        i->rotationSpeed_ = value[index++].GetFloat();
-        i->colorIndex_ = value[index++].GetInt();
-        i->texIndex_ = value[index++].GetInt();
+        Vector3 velocity = value[index++].GetVector3();
+        velocityX_[i] = velocity.x_;
+        velocityY_[i] = velocity.y_;
+        velocityZ_[i] = velocity.z_;
+        sizes_[i] = value[index++].GetVector2();
+        timers_[i] = value[index++].GetFloat();
+        timesToLive_[i] = value[index++].GetFloat();
+        scales_[i] = value[index++].GetFloat();
+        rotationSpeeds_[i] = value[index++].GetFloat();
+        colorIndices_[i] = value[index++].GetInt();
+        texIndices_[i] = value[index++].GetInt();
     }
 }
 
@@ -407,18 +456,18 @@ ResourceRef ParticleEmitter::GetParameterSourceAttr() const
 VariantVector ParticleEmitter::GetParticlesAttr() const
 {
     VariantVector ret;
-    ret.Reserve(particles_.Size() * 8 + 1);
-    ret.Push(particles_.Size());
-    for (PODVector<Particle>::ConstIterator i = particles_.Begin(); i != particles_.End(); ++i)
+    ret.Reserve(timers_.Size() * 8 + 1);
+    ret.Push(timers_.Size());
+    for (unsigned i = 0; i < timers_.Size(); ++i)
     {
-        ret.Push(i->velocity_);
-        ret.Push(i->size_);
-        ret.Push(i->timer_);
-        ret.Push(i->timeToLive_);
-        ret.Push(i->scale_);
-        ret.Push(i->rotationSpeed_);
-        ret.Push(i->colorIndex_);
-        ret.Push(i->texIndex_);
+        ret.Push(Vector3(velocityX_[i], velocityY_[i], velocityZ_[i]));
+        ret.Push(sizes_[i]);
+        ret.Push(timers_[i]);
+        ret.Push(timesToLive_[i]);
+        ret.Push(scales_[i]);
+        ret.Push(rotationSpeeds_[i]);
+        ret.Push(colorIndices_[i]);
+        ret.Push(texIndices_[i]);
     }
     return ret;
 }
@@ -438,7 +487,16 @@ void ParticleEmitter::OnNodeSet(Node* node)
 void ParticleEmitter::SetNumParticles(int num)
 {
     num = Max(num, 0);
-    particles_.Resize(num);
+    velocityX_.Resize(num);
+    velocityY_.Resize(num);
+    velocityZ_.Resize(num);
+    sizes_.Resize(num);
+    timers_.Resize(num);
+    timesToLive_.Resize(num);
+    scales_.Resize(num);
+    rotationSpeeds_.Resize(num);
+    colorIndices_.Resize(num);
+    texIndices_.Resize(num);
     SetNumBillboards(num);
 }
 
@@ -461,8 +519,7 @@ bool ParticleEmitter::EmitNewParticle()
     unsigned index = GetFreeParticle();
     if (index == M_MAX_UNSIGNED)
         return false;
-    assert(index < particles_.Size());
-    Particle& particle = particles_[index];
+    assert(index < timers_.Size());
     Billboard& billboard = billboards_[index];
     
     Vector3 startPos;
@@ -508,17 +565,20 @@ bool ParticleEmitter::EmitNewParticle()
         startDir = node_->GetWorldRotation() * startDir;
     };
     
-    particle.velocity_ = Lerp(velocityMin_, velocityMax_, Random(1.0f)) * startDir;
-    particle.size_ = sizeMin_.Lerp(sizeMax_, Random(1.0f));
-    particle.timer_ = 0.0f;
-    particle.timeToLive_ = Lerp(timeToLiveMin_, timeToLiveMax_, Random(1.0f));
-    particle.scale_ = 1.0f;
-    particle.rotationSpeed_ = Lerp(rotationSpeedMin_, rotationSpeedMax_, Random(1.0f));
-    particle.colorIndex_ = 0;
-    particle.texIndex_ = 0;
+    Vector3 velocity = Lerp(velocityMin_, velocityMax_, Random(1.0f)) * startDir;
+    velocityX_[index] = velocity.x_;
+    velocityY_[index] = velocity.y_;
+    velocityZ_[index] = velocity.z_;
+    sizes_[index] = sizeMin_.Lerp(sizeMax_, Random(1.0f));
+    timers_[index] = 0.0f;
+    timesToLive_[index] = Lerp(timeToLiveMin_, timeToLiveMax_, Random(1.0f));
+    scales_[index] = 1.0f;
+    rotationSpeeds_[index] = Lerp(rotationSpeedMin_, rotationSpeedMax_, Random(1.0f));
+    colorIndices_[index] = 0;
+    texIndices_[index] = 0;
     
     billboard.position_ = startPos;
-    billboard.size_ = particles_[index].size_;
+    billboard.size_ = sizes_[index];
     billboard.uv_ = textureAnimation_.Size() ? textureAnimation_[0].uv_ : Rect::POSITIVE;
     billboard.rotation_ = Lerp(rotationMin_, rotationMax_, Random(1.0f));
     billboard.color_ = colors_[0].color_;
@@ -35,27 +35,6 @@ enum EmitterType
     EMITTER_BOX
 };
 
-/// One particle in the particle system.
-struct Particle
-{
-    /// Velocity.
-    Vector3 velocity_;
-    /// Original billboard size.
-    Vector2 size_;
-    /// Time elapsed from creation.
-    float timer_;
-    /// Lifetime.
-    float timeToLive_;
-    /// Size scaling value.
-    float scale_;
-    /// Rotation speed.
-    float rotationSpeed_;
-    /// Current color fade index.
-    unsigned colorIndex_;
-    /// Current texture animation index.
-    unsigned texIndex_;
-};
-
 /// %Texture animation definition.
 struct TextureAnimation
 {
@@ -94,7 +73,7 @@ public:
     /// Return parameter XML file.
     XMLFile* GetParameters() const { return parameterSource_; }
     /// Return number of particles.
-    unsigned GetNumParticles() const { return particles_.Size(); }
+    unsigned GetNumParticles() const { return timers_.Size(); }
     /// Return whether is currently emitting.
     bool IsEmitting() const { return emitting_; }
     
@@ -134,8 +113,26 @@ private:
     
     /// Parameter XML file.
     SharedPtr<XMLFile> parameterSource_;
-    /// Particles.
-    PODVector<Particle> particles_;
+    /// Particle velocities along the X axis. The particle state is stored as separate arrays to simulate several particles at a time.
+    PODVector<float> velocityX_;
+    /// Particle velocities along the Y axis.
+    PODVector<float> velocityY_;
+    /// Particle velocities along the Z axis.
+    PODVector<float> velocityZ_;
+    /// Particle original billboard sizes.
+    PODVector<Vector2> sizes_;
+    /// Particle times elapsed from creation.
+    PODVector<float> timers_;
+    /// Particle lifetimes.
+    PODVector<float> timesToLive_;
+    /// Particle size scaling values.
+    PODVector<float> scales_;
+    /// Particle rotation speeds.
+    PODVector<float> rotationSpeeds_;
+    /// Particle current color fade indices.
+    PODVector<unsigned> colorIndices_;
+    /// Particle current texture animation indices.
+    PODVector<unsigned> texIndices_;
     /// Color fade range.
     Vector<ColorFade> colors_;
     /// Texture animation.
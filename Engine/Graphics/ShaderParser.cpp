@@ -21,6 +21,8 @@
 //
 
 #include "Precompiled.h"
+#include "Deserializer.h"
+#include "Serializer.h"
 #include "ShaderParser.h"
 #include "XMLElement.h"
 
@@ -59,6 +61,80 @@ bool ShaderParser::Parse(ShaderType type, const XMLElement& element, const Vecto
     return true;
 }
 
+bool ShaderParser::Load(Deserializer& source)
+{
+    errorMessage_.Clear();
+    globalDefines_.Clear();
+    globalDefineValues_.Clear();
+    options_.Clear();
+    combinations_.Clear();
+    
+    unsigned numGlobalDefines = source.ReadVLE();
+    for (unsigned i = 0; i < numGlobalDefines; ++i)
+    {
+        globalDefines_.Push(source.ReadString());
+        globalDefineValues_.Push(source.ReadString());
+    }
+    
+    // Only the defines of the options are needed for returning combinations after they have been built
+    unsigned numOptions = source.ReadVLE();
+    if (numOptions > 31)
+        return false;
+    options_.Resize(numOptions);
+    for (unsigned i = 0; i < numOptions; ++i)
+    {
+        ShaderOption& option = options_[i];
+        option.name_ = source.ReadString();
+        option.isVariation_ = source.ReadBool();
+        unsigned numDefines = source.ReadVLE();
+        for (unsigned j = 0; j < numDefines; ++j)
+        {
+            option.defines_.Push(source.ReadString());
+            option.defineValues_.Push(source.ReadString());
+        }
+    }
+    
+    unsigned numCombinations = source.ReadVLE();
+    for (unsigned i = 0; i < numCombinations && !source.IsEof(); ++i)
+    {
+        String name = source.ReadString();
+        combinations_[name] = source.ReadUInt();
+    }
+    
+    return combinations_.Size() == numCombinations;
+}
+
+void ShaderParser::Save(Serializer& dest) const
+{
+    dest.WriteVLE(globalDefines_.Size());
+    for (unsigned i = 0; i < globalDefines_.Size(); ++i)
+    {
+        dest.WriteString(globalDefines_[i]);
+        dest.WriteString(globalDefineValues_[i]);
+    }
+    
+    dest.WriteVLE(options_.Size());
+    for (unsigned i = 0; i < options_.Size(); ++i)
+    {
+        const ShaderOption& option = options_[i];
+        dest.WriteString(option.name_);
+        dest.WriteBool(option.isVariation_);
+        dest.WriteVLE(option.defines_.Size());
+        for (unsigned j = 0; j < option.defines_.Size(); ++j)
+        {
+            dest.WriteString(option.defines_[j]);
+            dest.WriteString(option.defineValues_[j]);
+        }
+    }
+    
+    dest.WriteVLE(combinations_.Size());
+    for (HashMap<String, unsigned>::ConstIterator i = combinations_.Begin(); i != combinations_.End(); ++i)
+    {
+        dest.WriteString(i->first_);
+        dest.WriteUInt(i->second_);
+    }
+}
+
 bool ShaderParser::HasCombination(const String& name) const
 {
     return combinations_.Contains(name);
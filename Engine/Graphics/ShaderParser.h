@@ -28,6 +28,8 @@
 namespace Urho3D
 {
 
+class Deserializer;
+class Serializer;
 class XMLElement;
 
 /// Option definition and combination rules for constructing shader variations.
@@ -72,6 +74,10 @@ class ShaderParser
 public:
     /// Parse from an XML element. Return true if successful.
     bool Parse(ShaderType type, const XMLElement& element, const Vector<String>& globalDefines = Vector<String>(), const Vector<String>& globalDefineValues = Vector<String>());
+    /// Load the result of parsing from a binary stream. Return true if successful.
+    bool Load(Deserializer& source);
+    /// Save the result of parsing to a binary stream.
+    void Save(Serializer& dest) const;
     
     /// Return error message if parsing failed.
     String GetErrorMessage() const { return errorMessage_; }
@@ -77,6 +77,17 @@ struct Bone
     WeakPtr<Node> node_;
 };
 
+/// Local transform of a bone in an animated model's bone pose.
+struct BoneTransform
+{
+    /// Position.
+    Vector3 position_;
+    /// Rotation.
+    Quaternion rotation_;
+    /// Scale.
+    Vector3 scale_;
+};
+
 /// Hierarchical collection of bones.
 class Skeleton
 {
@@ -28,6 +28,7 @@
 #include "ResourceCache.h"
 #include "ShaderVariation.h"
 #include "StringUtils.h"
+#include "VectorBuffer.h"
 #include "XMLFile.h"
 
 #include "DebugNew.h"
@@ -35,6 +36,8 @@
 namespace Urho3D
 {
 
+static const unsigned TECHNIQUE_CACHE_VERSION = 1;
+
 const char* blendModeNames[] =
 {
     "replace",
@@ -156,8 +159,25 @@ bool Technique::Load(Deserializer& source)
 {
     PROFILE(LoadTechnique);
     
+    // If processed data caching is enabled, check first for the passes stored in binary form on an earlier run
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    VectorBuffer sourceData;
+    unsigned checksum = 0;
+    bool useDataCache = cache && cache->ReadCacheSource(source, sourceData, checksum);
+    if (useDataCache)
+    {
+        SharedPtr<File> cacheFile = cache->GetCacheFile("Technique", checksum);
+        if (cacheFile && LoadCachedData(*cacheFile))
+        {
+            FinishLoad();
+            return true;
+        }
+        
+        passes_.Clear();
+    }
+    
     SharedPtr<XMLFile> xml(new XMLFile(context_));
-    if (!xml->Load(source))
+    if (!xml->Load(sourceData.GetSize() ? (Deserializer&)sourceData : source))
         return false;
     
     XMLElement rootElem = xml->GetRoot();
@@ -212,14 +232,10 @@ bool Technique::Load(Deserializer& source)
         passElem = passElem.GetNext("pass");
     }
     
-    // Rehash the pass map to ensure minimum load factor and fast queries
-    passes_.Rehash(NextPowerOfTwo(passes_.Size()));
-    
-    // Calculate memory use
-    unsigned memoryUse = sizeof(Technique);
-    memoryUse += sizeof(HashMap<StringHash, SharedPtr<Pass> >) + passes_.Size() * sizeof(Pass);
+    if (useDataCache)
+        StoreCachedData(checksum);
     
-    SetMemoryUse(memoryUse);
+    FinishLoad();
     return true;
 }
 
@@ -260,4 +276,68 @@ Pass* Technique::GetPass(StringHash type) const
     return i != passes_.End() ? i->second_ : (Pass*)0;
 }
 
+bool Technique::LoadCachedData(Deserializer& source)
+{
+    if (source.ReadFileID() != "UTEC" || source.ReadUInt() != TECHNIQUE_CACHE_VERSION)
+    {
+        LOGWARNING("Ignoring mismatching cached technique data for " + GetName());
+        return false;
+    }
+    
+    isSM3_ = source.ReadBool();
+    
+    unsigned numPasses = source.ReadVLE();
+    for (unsigned i = 0; i < numPasses; ++i)
+    {
+        Pass* newPass = CreatePass(source.ReadStringHash());
+        newPass->SetVertexShader(source.ReadString());
+        newPass->SetPixelShader(source.ReadString());
+        newPass->SetLightingMode((PassLightingMode)source.ReadUByte());
+        newPass->SetBlendMode((BlendMode)source.ReadUByte());
+        newPass->SetDepthTestMode((CompareMode)source.ReadUByte());
+        newPass->SetDepthWrite(source.ReadBool());
+        newPass->SetAlphaMask(source.ReadBool());
+    }
+    
+    return true;
+}
+
+void Technique::StoreCachedData(unsigned checksum)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SharedPtr<File> file = cache->CreateCacheFile("Technique", checksum);
+    if (!file)
+        return;
+    
+    file->WriteFileID("UTEC");
+    file->WriteUInt(TECHNIQUE_CACHE_VERSION);
+    file->WriteBool(isSM3_);
+    
+    file->WriteVLE(passes_.Size());
+    for (HashMap<StringHash, SharedPtr<Pass> >::ConstIterator i = passes_.Begin(); i != passes_.End(); ++i)
+    {
+        Pass* pass = i->second_;
+        file->WriteStringHash(pass->GetType());
+        file->WriteString(pass->GetVertexShader());
+        file->WriteString(pass->GetPixelShader());
+        file->WriteUByte(pass->GetLightingMode());
+        file->WriteUByte(pass->GetBlendMode());
+        file->WriteUByte(pass->GetDepthTestMode());
+        file->WriteBool(pass->GetDepthWrite());
+        file->WriteBool(pass->GetAlphaMask());
+    }
+}
+
+void Technique::FinishLoad()
+{
+    // Rehash the pass map to ensure minimum load factor and fast queries
+    passes_.Rehash(NextPowerOfTwo(passes_.Size()));
+    
+    // Calculate memory use
+    unsigned memoryUse = sizeof(Technique);
+    memoryUse += sizeof(HashMap<StringHash, SharedPtr<Pass> >) + passes_.Size() * sizeof(Pass);
+    
+    SetMemoryUse(memoryUse);
+}
+
 }
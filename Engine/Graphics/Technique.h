@@ -151,6 +151,13 @@ public:
     bool IsSM3() const { return isSM3_; }
     
 private:
+    /// Load the passes from the processed resource data cache. Return true if successful.
+    bool LoadCachedData(Deserializer& source);
+    /// Store the passes to the processed resource data cache.
+    void StoreCachedData(unsigned checksum);
+    /// Calculate memory use after loading.
+    void FinishLoad();
+    
     /// Require %Shader %Model 3 flag.
     bool isSM3_;
     /// Passes.
@@ -459,6 +459,9 @@ void View::Render()
     // Actually update geometry data now
     UpdateGeometries();
     
+    // Skinning is now complete, so the bone palettes of skinned batch groups can be packed
+    PrepareSkinMatrices();
+    
     // Allocate screen buffers as necessary
     AllocateScreenBuffers();
     
@@ -2371,7 +2374,12 @@ void View::AddBatchToQueue(BatchQueue& batchQueue, Batch& batch, Technique* tech
         !batch.overrideView_)
         batch.geometryType_ = GEOM_INSTANCED;
     
-    if (batch.geometryType_ == GEOM_INSTANCED)
+    // Skinned batches of models sharing the same geometry are grouped to draw them with one state setup, though they are
+    // not drawn instanced. Each instance's skin matrices are set from the model's own palette
+    bool groupSkinned = allowInstancing && batch.geometryType_ == GEOM_SKINNED && batch.shaderData_ && batch.shaderDataSize_ &&
+        !batch.overrideView_;
+    
+    if (batch.geometryType_ == GEOM_INSTANCED || groupSkinned)
     {
         HashMap<BatchGroupKey, BatchGroup>* groups = batch.isBase_ ? &batchQueue.baseBatchGroups_ : &batchQueue.batchGroups_;
         BatchGroupKey key(batch);
@@ -2382,18 +2390,19 @@ void View::AddBatchToQueue(BatchQueue& batchQueue, Batch& batch, Technique* tech
             // Create a new group based on the batch
             // In case the group remains below the instancing limit, do not enable instancing shaders yet
             BatchGroup newGroup(batch);
-            newGroup.geometryType_ = GEOM_STATIC;
+            if (!groupSkinned)
+                newGroup.geometryType_ = GEOM_STATIC;
             renderer_->SetBatchShaders(newGroup, tech, allowShadows);
             newGroup.CalculateSortKey();
-            newGroup.instances_.Push(InstanceData(batch.worldTransform_, batch.distance_));
+            newGroup.instances_.Push(InstanceData(batch.worldTransform_, batch.shaderData_, batch.distance_));
             groups->Insert(MakePair(key, newGroup));
         }
         else
         {
-            i->second_.instances_.Push(InstanceData(batch.worldTransform_, batch.distance_));
+            i->second_.instances_.Push(InstanceData(batch.worldTransform_, batch.shaderData_, batch.distance_));
             
             // Convert to using instancing shaders when the instancing limit is reached
-            if (i->second_.instances_.Size() == minInstances_)
+            if (!groupSkinned && i->second_.instances_.Size() == minInstances_)
             {
                 i->second_.geometryType_ = GEOM_INSTANCED;
                 renderer_->SetBatchShaders(i->second_, tech, allowShadows);
@@ -2448,6 +2457,41 @@ void View::PrepareInstancingBuffer()
     }
 }
 
+void View::PrepareSkinMatrices()
+{
+    unsigned totalSize = 0;
+    
+    for (HashMap<StringHash, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
+        totalSize += i->second_.GetSkinMatricesSize();
+    
+    for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
+    {
+        for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
+            totalSize += i->shadowSplits_[j].shadowBatches_.GetSkinMatricesSize();
+        totalSize += i->litBatches_.GetSkinMatricesSize();
+    }
+    
+    if (!totalSize)
+        return;
+    
+    PROFILE(PrepareSkinMatrices);
+    
+    // The buffer keeps its capacity between frames, so it is reallocated only when it grows
+    skinMatrices_.Resize(totalSize);
+    float* dest = &skinMatrices_[0];
+    unsigned freeOffset = 0;
+    
+    for (HashMap<StringHash, BatchQueue>::Iterator i = batchQueues_.Begin(); i != batchQueues_.End(); ++i)
+        i->second_.SetSkinMatrices(dest, freeOffset);
+    
+    for (Vector<LightBatchQueue>::Iterator i = lightQueues_.Begin(); i != lightQueues_.End(); ++i)
+    {
+        for (unsigned j = 0; j < i->shadowSplits_.Size(); ++j)
+            i->shadowSplits_[j].shadowBatches_.SetSkinMatrices(dest, freeOffset);
+        i->litBatches_.SetSkinMatrices(dest, freeOffset);
+    }
+}
+
 void View::SetupLightVolumeBatch(Batch& batch)
 {
     Light* light = batch.lightQueue_->light_;
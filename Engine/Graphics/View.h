@@ -193,6 +193,8 @@ private:
     void AddBatchToQueue(BatchQueue& queue, Batch& batch, Technique* tech, bool allowInstancing = true, bool allowShadows = true);
     /// Prepare instancing buffer by filling it with all instance transforms.
     void PrepareInstancingBuffer();
+    /// Pack the skin matrices of all skinned batch groups into one buffer with per-instance offsets.
+    void PrepareSkinMatrices();
     /// Set up a light volume rendering batch.
     void SetupLightVolumeBatch(Batch& batch);
     /// Render a shadow map.
@@ -292,6 +294,8 @@ private:
     HashMap<unsigned long long, LightBatchQueue> vertexLightQueues_;
     /// Batch queues.
     HashMap<StringHash, BatchQueue> batchQueues_;
+    /// Packed skin matrices of the skinned batch groups.
+    PODVector<float> skinMatrices_;
     /// Hash of the GBuffer pass, or null if none.
     StringHash gBufferPassName_;
     /// Hash of the opaque forward base pass.
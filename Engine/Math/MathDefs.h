@@ -27,6 +27,13 @@
 #include <cstdlib>
 #include <cmath>
 
+// Use SSE2 intrinsics if SSE is enabled and the compiler targets SSE2, or NEON intrinsics if targeting it
+#if defined(ENABLE_SSE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define USE_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define USE_NEON
+#endif
+
 namespace Urho3D
 {
 
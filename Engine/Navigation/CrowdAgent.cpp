@@ -0,0 +1,160 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Precompiled.h"
+#include "Context.h"
+#include "CrowdAgent.h"
+#include "CrowdManager.h"
+#include "DebugRenderer.h"
+#include "Log.h"
+#include "Scene.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+extern const char* NAVIGATION_CATEGORY;
+
+static const float DEFAULT_RADIUS = 0.5f;
+static const float DEFAULT_MAX_SPEED = 3.0f;
+static const float DEFAULT_MAX_ACCEL = 8.0f;
+
+OBJECTTYPESTATIC(CrowdAgent);
+
+CrowdAgent::CrowdAgent(Context* context) :
+    Component(context),
+    index_(0),
+    radius_(DEFAULT_RADIUS),
+    maxSpeed_(DEFAULT_MAX_SPEED),
+    maxAccel_(DEFAULT_MAX_ACCEL),
+    targetPosition_(Vector3::ZERO)
+{
+}
+
+CrowdAgent::~CrowdAgent()
+{
+    if (crowdManager_)
+        crowdManager_->RemoveAgent(this);
+}
+
+void CrowdAgent::RegisterObject(Context* context)
+{
+    context->RegisterFactory<CrowdAgent>(NAVIGATION_CATEGORY);
+    
+    ACCESSOR_ATTRIBUTE(CrowdAgent, VAR_BOOL, "Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(CrowdAgent, VAR_FLOAT, "Radius", GetRadius, SetRadius, float, DEFAULT_RADIUS, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(CrowdAgent, VAR_FLOAT, "Max Speed", GetMaxSpeed, SetMaxSpeed, float, DEFAULT_MAX_SPEED, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(CrowdAgent, VAR_FLOAT, "Max Accel", GetMaxAccel, SetMaxAccel, float, DEFAULT_MAX_ACCEL, AM_DEFAULT);
+}
+
+void CrowdAgent::OnSetEnabled()
+{
+    if (crowdManager_)
+        crowdManager_->SetAgentParameters(this);
+}
+
+void CrowdAgent::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
+{
+    if (!node_)
+        return;
+    
+    debug->AddSphere(Sphere(node_->GetWorldPosition(), radius_), IsEnabledEffective() ? Color::GREEN : Color::WHITE, depthTest);
+}
+
+void CrowdAgent::SetRadius(float radius)
+{
+    radius_ = Max(radius, M_EPSILON);
+    if (crowdManager_)
+        crowdManager_->SetAgentParameters(this);
+    MarkNetworkUpdate();
+}
+
+void CrowdAgent::SetMaxSpeed(float speed)
+{
+    maxSpeed_ = Max(speed, 0.0f);
+    if (crowdManager_)
+        crowdManager_->SetAgentParameters(this);
+    MarkNetworkUpdate();
+}
+
+void CrowdAgent::SetMaxAccel(float accel)
+{
+    maxAccel_ = Max(accel, 0.0f);
+    if (crowdManager_)
+        crowdManager_->SetAgentParameters(this);
+    MarkNetworkUpdate();
+}
+
+void CrowdAgent::SetTargetPosition(const Vector3& position)
+{
+    targetPosition_ = position;
+    if (crowdManager_)
+        crowdManager_->SetAgentTarget(this, position);
+}
+
+void CrowdAgent::ResetTarget()
+{
+    if (crowdManager_)
+        crowdManager_->ResetAgentTarget(this);
+}
+
+bool CrowdAgent::HasTarget() const
+{
+    return crowdManager_ ? crowdManager_->GetAgentData(const_cast<CrowdAgent*>(this)).hasTarget_ : false;
+}
+
+Vector3 CrowdAgent::GetVelocity() const
+{
+    return crowdManager_ ? crowdManager_->GetAgentData(const_cast<CrowdAgent*>(this)).velocity_ : Vector3::ZERO;
+}
+
+void CrowdAgent::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        Scene* scene = GetScene();
+        if (scene)
+        {
+            if (scene == node)
+                LOGWARNING(GetTypeName() + " should not be created to the root scene node");
+            
+            CrowdManager* manager = scene->GetComponent<CrowdManager>();
+            if (manager)
+                manager->AddAgent(this);
+            else
+                LOGDEBUG("No crowd manager component in scene yet, crowd agent will be added when it is created");
+        }
+        node->AddListener(this);
+    }
+    else if (crowdManager_)
+        crowdManager_->RemoveAgent(this);
+}
+
+void CrowdAgent::OnMarkedDirty(Node* node)
+{
+    // If the node was moved by other means than the crowd simulation, teleport the agent
+    if (crowdManager_ && !crowdManager_->IsApplyingTransforms())
+        crowdManager_->SetAgentPosition(this, node->GetWorldPosition());
+}
+
+}
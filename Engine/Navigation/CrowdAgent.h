@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Component.h"
+
+namespace Urho3D
+{
+
+class CrowdManager;
+
+/// Navigation agent that is moved along the navigation mesh by the scene's CrowdManager, avoiding other agents.
+class CrowdAgent : public Component
+{
+    OBJECT(CrowdAgent);
+    
+    friend class CrowdManager;
+    
+public:
+    /// Construct.
+    CrowdAgent(Context* context);
+    /// Destruct.
+    virtual ~CrowdAgent();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+    
+    /// Handle enabled/disabled state change.
+    virtual void OnSetEnabled();
+    /// Visualize the component as debug geometry.
+    virtual void DrawDebugGeometry(DebugRenderer* debug, bool depthTest);
+    
+    /// Set radius.
+    void SetRadius(float radius);
+    /// Set maximum speed.
+    void SetMaxSpeed(float speed);
+    /// Set maximum acceleration.
+    void SetMaxAccel(float accel);
+    /// Set world space target position and request a path to it.
+    void SetTargetPosition(const Vector3& position);
+    /// Stop moving towards the target position.
+    void ResetTarget();
+    
+    /// Return radius.
+    float GetRadius() const { return radius_; }
+    /// Return maximum speed.
+    float GetMaxSpeed() const { return maxSpeed_; }
+    /// Return maximum acceleration.
+    float GetMaxAccel() const { return maxAccel_; }
+    /// Return world space target position.
+    const Vector3& GetTargetPosition() const { return targetPosition_; }
+    /// Return whether is moving towards a target position. Becomes false when the target is reached, or no path to it was found.
+    bool HasTarget() const;
+    /// Return current velocity.
+    Vector3 GetVelocity() const;
+    
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+    /// Handle node transform being dirtied.
+    virtual void OnMarkedDirty(Node* node);
+    
+private:
+    /// Crowd manager.
+    WeakPtr<CrowdManager> crowdManager_;
+    /// Index in the crowd manager's agent data.
+    unsigned index_;
+    /// Radius.
+    float radius_;
+    /// Maximum speed.
+    float maxSpeed_;
+    /// Maximum acceleration.
+    float maxAccel_;
+    /// World space target position.
+    Vector3 targetPosition_;
+};
+
+}
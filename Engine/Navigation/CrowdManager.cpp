@@ -0,0 +1,578 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Precompiled.h"
+#include "Context.h"
+#include "CrowdAgent.h"
+#include "CrowdManager.h"
+#include "DebugRenderer.h"
+#include "Log.h"
+#include "NavigationEvents.h"
+#include "NavigationMesh.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "SceneEvents.h"
+#include "WorkQueue.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+extern const char* NAVIGATION_CATEGORY;
+
+static const float DEFAULT_NEIGHBOR_DISTANCE = 2.0f;
+static const float DEFAULT_SEPARATION_WEIGHT = 1.0f;
+static const unsigned MAX_NEIGHBORS = 8;
+static const unsigned AGENTS_PER_WORK_ITEM = 64;
+
+/// Return proximity grid bucket of a cell.
+static inline unsigned GetGridBucket(int x, int z, unsigned mask)
+{
+    return ((unsigned)x * 73856093U ^ (unsigned)z * 19349663U) & mask;
+}
+
+/// Return the point on a path segment closest to a position on the XZ plane.
+static Vector3 ClosestPointOnSegment(const Vector3& position, const Vector3& start, const Vector3& end)
+{
+    Vector3 dir(end.x_ - start.x_, 0.0f, end.z_ - start.z_);
+    float lengthSquared = dir.LengthSquared();
+    if (lengthSquared < M_EPSILON)
+        return end;
+    
+    float t = Clamp(((position.x_ - start.x_) * dir.x_ + (position.z_ - start.z_) * dir.z_) / lengthSquared, 0.0f, 1.0f);
+    return start + (end - start) * t;
+}
+
+void UpdateCrowdVelocitiesWork(const WorkItem* item, unsigned threadIndex)
+{
+    CrowdManager* manager = reinterpret_cast<CrowdManager*>(item->aux_);
+    CrowdAgentData* start = reinterpret_cast<CrowdAgentData*>(item->start_);
+    CrowdAgentData* end = reinterpret_cast<CrowdAgentData*>(item->end_);
+    CrowdAgentData* first = &manager->agentData_[0];
+    
+    manager->UpdateVelocities(start - first, end - first);
+}
+
+OBJECTTYPESTATIC(CrowdManager);
+
+CrowdManager::CrowdManager(Context* context) :
+    Component(context),
+    neighborDistance_(DEFAULT_NEIGHBOR_DISTANCE),
+    separationWeight_(DEFAULT_SEPARATION_WEIGHT),
+    timeStep_(0.0f),
+    applyingTransforms_(false)
+{
+}
+
+CrowdManager::~CrowdManager()
+{
+    // Detach the remaining agents
+    for (PODVector<CrowdAgent*>::Iterator i = agents_.Begin(); i != agents_.End(); ++i)
+        (*i)->crowdManager_.Reset();
+}
+
+void CrowdManager::RegisterObject(Context* context)
+{
+    context->RegisterFactory<CrowdManager>(NAVIGATION_CATEGORY);
+    
+    ACCESSOR_ATTRIBUTE(CrowdManager, VAR_FLOAT, "Neighbor Distance", GetNeighborDistance, SetNeighborDistance, float, DEFAULT_NEIGHBOR_DISTANCE, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(CrowdManager, VAR_FLOAT, "Separation Weight", GetSeparationWeight, SetSeparationWeight, float, DEFAULT_SEPARATION_WEIGHT, AM_DEFAULT);
+}
+
+void CrowdManager::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
+{
+    // Draw the remaining path of each agent. The agents draw themselves
+    for (unsigned i = 0; i < agents_.Size(); ++i)
+    {
+        const CrowdAgentData& data = agentData_[i];
+        if (!data.hasTarget_)
+            continue;
+        
+        const PODVector<Vector3>& path = paths_[i];
+        Vector3 last = data.position_;
+        for (unsigned j = data.corner_; j < path.Size(); ++j)
+        {
+            debug->AddLine(last, path[j], Color::YELLOW, depthTest);
+            last = path[j];
+        }
+    }
+}
+
+void CrowdManager::SetNavigationMesh(NavigationMesh* navMesh)
+{
+    if (navigationMesh_)
+        UnsubscribeFromEvent(navigationMesh_, E_NAVIGATIONPATHFOUND);
+    
+    navigationMesh_ = navMesh;
+    
+    if (navigationMesh_)
+        SubscribeToEvent(navigationMesh_, E_NAVIGATIONPATHFOUND, HANDLER(CrowdManager, HandleNavigationPathFound));
+}
+
+void CrowdManager::SetNeighborDistance(float distance)
+{
+    neighborDistance_ = Max(distance, M_EPSILON);
+    MarkNetworkUpdate();
+}
+
+void CrowdManager::SetSeparationWeight(float weight)
+{
+    separationWeight_ = Max(weight, 0.0f);
+    MarkNetworkUpdate();
+}
+
+void CrowdManager::Update(float timeStep)
+{
+    if (agents_.Empty() || timeStep <= 0.0f)
+        return;
+    
+    PROFILE(UpdateCrowd);
+    
+    timeStep_ = timeStep;
+    UpdateGrid();
+    
+    // The velocity pass only writes each agent's own state, so the agents can be split freely between threads
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (queue && queue->GetNumThreads() && agents_.Size() > AGENTS_PER_WORK_ITEM)
+    {
+        WorkItem item;
+        item.workFunction_ = UpdateCrowdVelocitiesWork;
+        item.aux_ = this;
+        
+        CrowdAgentData* start = &agentData_[0];
+        CrowdAgentData* last = start + agentData_.Size();
+        while (start != last)
+        {
+            CrowdAgentData* end = last;
+            if (end - start > AGENTS_PER_WORK_ITEM)
+                end = start + AGENTS_PER_WORK_ITEM;
+            
+            item.start_ = start;
+            item.end_ = end;
+            queue->AddWorkItem(item);
+            
+            start = end;
+        }
+        
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+    else
+        UpdateVelocities(0, agents_.Size());
+    
+    ApplyVelocities();
+}
+
+void CrowdManager::AddAgent(CrowdAgent* agent)
+{
+    if (!agent || agent->crowdManager_ == this)
+        return;
+    
+    if (agent->crowdManager_)
+        agent->crowdManager_->RemoveAgent(agent);
+    
+    agent->crowdManager_ = this;
+    agent->index_ = agents_.Size();
+    agents_.Push(agent);
+    paths_.Push(PODVector<Vector3>());
+    
+    CrowdAgentData data;
+    data.position_ = agent->GetNode() ? agent->GetNode()->GetWorldPosition() : Vector3::ZERO;
+    data.velocity_ = Vector3::ZERO;
+    data.newVelocity_ = Vector3::ZERO;
+    data.corner_ = 0;
+    data.pathRequest_ = 0;
+    data.polyRef_ = 0;
+    data.hasTarget_ = false;
+    agentData_.Push(data);
+    
+    SetAgentParameters(agent);
+}
+
+void CrowdManager::RemoveAgent(CrowdAgent* agent)
+{
+    if (!agent || agent->crowdManager_ != this)
+        return;
+    
+    unsigned index = agent->index_;
+    if (agentData_[index].pathRequest_)
+        pathRequests_.Erase(agentData_[index].pathRequest_);
+    
+    // Move the last agent to the freed slot to keep the arrays contiguous
+    unsigned last = agents_.Size() - 1;
+    if (index != last)
+    {
+        agents_[index] = agents_[last];
+        agentData_[index] = agentData_[last];
+        paths_[index].Swap(paths_[last]);
+        agents_[index]->index_ = index;
+    }
+    
+    agents_.Pop();
+    agentData_.Pop();
+    paths_.Pop();
+    
+    agent->crowdManager_.Reset();
+}
+
+void CrowdManager::SetAgentParameters(CrowdAgent* agent)
+{
+    if (!agent || agent->crowdManager_ != this)
+        return;
+    
+    CrowdAgentData& data = agentData_[agent->index_];
+    data.radius_ = agent->radius_;
+    data.maxSpeed_ = agent->maxSpeed_;
+    data.maxAccel_ = agent->maxAccel_;
+    data.enabled_ = agent->IsEnabledEffective();
+    
+    if (!data.enabled_)
+        data.velocity_ = data.newVelocity_ = Vector3::ZERO;
+}
+
+void CrowdManager::SetAgentPosition(CrowdAgent* agent, const Vector3& position)
+{
+    if (!agent || agent->crowdManager_ != this)
+        return;
+    
+    CrowdAgentData& data = agentData_[agent->index_];
+    data.position_ = position;
+    data.polyRef_ = 0;
+}
+
+void CrowdManager::SetAgentTarget(CrowdAgent* agent, const Vector3& position)
+{
+    if (!agent || agent->crowdManager_ != this)
+        return;
+    
+    unsigned index = agent->index_;
+    CrowdAgentData& data = agentData_[index];
+    PODVector<Vector3>& path = paths_[index];
+    
+    if (data.pathRequest_)
+        pathRequests_.Erase(data.pathRequest_);
+    
+    data.hasTarget_ = true;
+    data.corner_ = 1;
+    path.Clear();
+    
+    NavigationMesh* navMesh = GetNavigationMesh();
+    if (navMesh)
+    {
+        data.pathRequest_ = navMesh->RequestPath(data.position_, position);
+        pathRequests_[data.pathRequest_] = agent;
+    }
+    else
+    {
+        // Without a navigation mesh, move straight towards the target
+        data.pathRequest_ = 0;
+        path.Push(data.position_);
+        path.Push(position);
+    }
+}
+
+void CrowdManager::ResetAgentTarget(CrowdAgent* agent)
+{
+    if (!agent || agent->crowdManager_ != this)
+        return;
+    
+    CrowdAgentData& data = agentData_[agent->index_];
+    if (data.pathRequest_)
+    {
+        pathRequests_.Erase(data.pathRequest_);
+        data.pathRequest_ = 0;
+    }
+    
+    data.hasTarget_ = false;
+    paths_[agent->index_].Clear();
+}
+
+NavigationMesh* CrowdManager::GetNavigationMesh()
+{
+    if (!navigationMesh_ && node_)
+    {
+        PODVector<NavigationMesh*> navMeshes;
+        node_->GetComponents<NavigationMesh>(navMeshes, true);
+        if (navMeshes.Size())
+            SetNavigationMesh(navMeshes[0]);
+    }
+    
+    return navigationMesh_;
+}
+
+const CrowdAgentData& CrowdManager::GetAgentData(CrowdAgent* agent) const
+{
+    return agentData_[agent->index_];
+}
+
+void CrowdManager::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        Scene* scene = GetScene();
+        if (scene)
+        {
+            // Subscribe to the scene subsystem update, which will trigger the crowd simulation step
+            SubscribeToEvent(scene, E_SCENESUBSYSTEMUPDATE, HANDLER(CrowdManager, HandleSceneSubsystemUpdate));
+            
+            // Take over the agents that were created before the crowd manager
+            PODVector<CrowdAgent*> agents;
+            scene->GetComponents<CrowdAgent>(agents, true);
+            for (PODVector<CrowdAgent*>::Iterator i = agents.Begin(); i != agents.End(); ++i)
+                AddAgent(*i);
+        }
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_SCENESUBSYSTEMUPDATE);
+        
+        // Detach the agents, they can not be simulated without a scene
+        while (!agents_.Empty())
+            RemoveAgent(agents_.Back());
+    }
+}
+
+void CrowdManager::HandleSceneSubsystemUpdate(StringHash eventType, VariantMap& eventData)
+{
+    using namespace SceneSubsystemUpdate;
+    
+    Update(eventData[P_TIMESTEP].GetFloat());
+}
+
+void CrowdManager::HandleNavigationPathFound(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NavigationPathFound;
+    
+    unsigned requestID = eventData[P_REQUESTID].GetUInt();
+    HashMap<unsigned, CrowdAgent*>::Iterator i = pathRequests_.Find(requestID);
+    if (i == pathRequests_.End())
+        return;
+    
+    unsigned index = i->second_->index_;
+    pathRequests_.Erase(i);
+    
+    CrowdAgentData& data = agentData_[index];
+    PODVector<Vector3>& path = paths_[index];
+    const VariantVector& points = eventData[P_PATH].GetVariantVector();
+    
+    data.pathRequest_ = 0;
+    data.corner_ = 1;
+    path.Resize(points.Size());
+    for (unsigned j = 0; j < points.Size(); ++j)
+        path[j] = points[j].GetVector3();
+    
+    if (path.Empty())
+        data.hasTarget_ = false;
+}
+
+void CrowdManager::UpdateGrid()
+{
+    unsigned numAgents = agentData_.Size();
+    unsigned numBuckets = NextPowerOfTwo(numAgents * 2);
+    unsigned mask = numBuckets - 1;
+    float invCellSize = 1.0f / neighborDistance_;
+    
+    // Counting sort of the agents by bucket
+    gridBuckets_.Resize(numBuckets + 1);
+    gridAgents_.Resize(numAgents);
+    agentBuckets_.Resize(numAgents);
+    memset(&gridBuckets_[0], 0, gridBuckets_.Size() * sizeof(unsigned));
+    
+    for (unsigned i = 0; i < numAgents; ++i)
+    {
+        const Vector3& position = agentData_[i].position_;
+        unsigned bucket = GetGridBucket((int)floorf(position.x_ * invCellSize), (int)floorf(position.z_ * invCellSize), mask);
+        agentBuckets_[i] = bucket;
+        ++gridBuckets_[bucket + 1];
+    }
+    
+    for (unsigned i = 1; i <= numBuckets; ++i)
+        gridBuckets_[i] += gridBuckets_[i - 1];
+    
+    for (unsigned i = 0; i < numAgents; ++i)
+        gridAgents_[gridBuckets_[agentBuckets_[i]]++] = i;
+    
+    // Filling shifted each bucket start to the next bucket's start, shift them back
+    for (unsigned i = numBuckets; i > 0; --i)
+        gridBuckets_[i] = gridBuckets_[i - 1];
+    gridBuckets_[0] = 0;
+}
+
+void CrowdManager::UpdateVelocities(unsigned start, unsigned end)
+{
+    unsigned mask = gridBuckets_.Size() - 2;
+    float invCellSize = 1.0f / neighborDistance_;
+    
+    for (unsigned i = start; i < end; ++i)
+    {
+        CrowdAgentData& data = agentData_[i];
+        if (!data.enabled_)
+            continue;
+        
+        const PODVector<Vector3>& path = paths_[i];
+        Vector3 desiredVelocity(Vector3::ZERO);
+        
+        // Steer towards the next corner of the path
+        if (data.hasTarget_ && !data.pathRequest_ && data.corner_ < path.Size())
+        {
+            Vector3 offset;
+            for (;;)
+            {
+                offset = path[data.corner_] - data.position_;
+                offset.y_ = 0.0f;
+                if (data.corner_ + 1 < path.Size() && offset.LengthSquared() < data.radius_ * data.radius_)
+                    ++data.corner_;
+                else
+                    break;
+            }
+            
+            float distance = offset.Length();
+            bool lastCorner = data.corner_ + 1 == path.Size();
+            if (lastCorner && distance < data.radius_)
+                data.hasTarget_ = false;
+            else if (distance > M_EPSILON)
+            {
+                // Slow down when approaching the end of the path
+                float speed = data.maxSpeed_;
+                if (lastCorner)
+                    speed *= Min(distance / (data.radius_ * 2.0f), 1.0f);
+                desiredVelocity = offset * (speed / distance);
+            }
+        }
+        
+        // Separate from the neighbors found from the proximity grid cells around the agent. Idle agents stay put, so that
+        // a group arriving at a target does not keep pushing itself apart. They still act as obstacles for moving agents
+        if (separationWeight_ > 0.0f && data.hasTarget_)
+        {
+            int cellX = (int)floorf(data.position_.x_ * invCellSize);
+            int cellZ = (int)floorf(data.position_.z_ * invCellSize);
+            unsigned visitedBuckets[9];
+            unsigned numVisited = 0;
+            unsigned numNeighbors = 0;
+            Vector3 separation(Vector3::ZERO);
+            
+            for (int z = cellZ - 1; z <= cellZ + 1 && numNeighbors < MAX_NEIGHBORS; ++z)
+            {
+                for (int x = cellX - 1; x <= cellX + 1 && numNeighbors < MAX_NEIGHBORS; ++x)
+                {
+                    // Different cells may hash to the same bucket, visit each bucket only once
+                    unsigned bucket = GetGridBucket(x, z, mask);
+                    bool visited = false;
+                    for (unsigned j = 0; j < numVisited; ++j)
+                    {
+                        if (visitedBuckets[j] == bucket)
+                        {
+                            visited = true;
+                            break;
+                        }
+                    }
+                    if (visited)
+                        continue;
+                    visitedBuckets[numVisited++] = bucket;
+                    
+                    for (unsigned j = gridBuckets_[bucket]; j < gridBuckets_[bucket + 1] && numNeighbors < MAX_NEIGHBORS; ++j)
+                    {
+                        unsigned other = gridAgents_[j];
+                        if (other == i)
+                            continue;
+                        
+                        // Keep a gap of the own radius between the agents
+                        const CrowdAgentData& otherData = agentData_[other];
+                        float range = Min(data.radius_ * 2.0f + otherData.radius_, neighborDistance_);
+                        Vector3 diff = data.position_ - otherData.position_;
+                        diff.y_ = 0.0f;
+                        float distance = diff.Length();
+                        if (distance >= range || distance < M_EPSILON)
+                            continue;
+                        
+                        separation += diff * ((1.0f - distance / range) / distance);
+                        ++numNeighbors;
+                    }
+                }
+            }
+            
+            if (numNeighbors)
+                desiredVelocity += separation * (data.maxSpeed_ * separationWeight_);
+        }
+        
+        float desiredSpeed = desiredVelocity.Length();
+        if (desiredSpeed > data.maxSpeed_)
+            desiredVelocity *= data.maxSpeed_ / desiredSpeed;
+        
+        // Limit the velocity change by the maximum acceleration
+        Vector3 deltaVelocity = desiredVelocity - data.velocity_;
+        float maxDelta = data.maxAccel_ * timeStep_;
+        float delta = deltaVelocity.Length();
+        if (delta > maxDelta)
+            deltaVelocity *= maxDelta / delta;
+        
+        data.newVelocity_ = data.velocity_ + deltaVelocity;
+    }
+}
+
+void CrowdManager::ApplyVelocities()
+{
+    NavigationMesh* navMesh = GetNavigationMesh();
+    applyingTransforms_ = true;
+    
+    for (unsigned i = 0; i < agents_.Size(); ++i)
+    {
+        CrowdAgentData& data = agentData_[i];
+        if (!data.enabled_)
+            continue;
+        
+        data.velocity_ = data.newVelocity_;
+        if (data.velocity_.LengthSquared() < M_EPSILON * M_EPSILON)
+        {
+            data.velocity_ = Vector3::ZERO;
+            continue;
+        }
+        
+        Vector3 target = data.position_ + data.velocity_ * timeStep_;
+        
+        // Keep the agent within its radius from the path corridor and follow the path height
+        const PODVector<Vector3>& path = paths_[i];
+        if (data.hasTarget_ && data.corner_ > 0 && data.corner_ < path.Size())
+        {
+            Vector3 closest = ClosestPointOnSegment(target, path[data.corner_ - 1], path[data.corner_]);
+            Vector3 lateral(target.x_ - closest.x_, 0.0f, target.z_ - closest.z_);
+            float lateralDistance = lateral.Length();
+            if (lateralDistance > data.radius_)
+                lateral *= data.radius_ / lateralDistance;
+            target = closest + lateral;
+        }
+        
+        // Slide along the navigation mesh walls, so that separation can not push the agent off the mesh
+        if (navMesh)
+            data.position_ = navMesh->MoveAlongSurface(data.position_, target, data.polyRef_);
+        else
+            data.position_ = target;
+        
+        Node* node = agents_[i]->GetNode();
+        if (node)
+            node->SetWorldPosition(data.position_);
+    }
+    
+    applyingTransforms_ = false;
+}
+
+}
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Component.h"
+
+namespace Urho3D
+{
+
+class CrowdAgent;
+class NavigationMesh;
+
+struct WorkItem;
+
+/// Simulation state of a crowd agent.
+struct CrowdAgentData
+{
+    /// World space position.
+    Vector3 position_;
+    /// Velocity.
+    Vector3 velocity_;
+    /// Velocity for the next step.
+    Vector3 newVelocity_;
+    /// Radius.
+    float radius_;
+    /// Maximum speed.
+    float maxSpeed_;
+    /// Maximum acceleration.
+    float maxAccel_;
+    /// Index of the path corner being steered towards.
+    unsigned corner_;
+    /// Pending path request ID, or 0 if none.
+    unsigned pathRequest_;
+    /// Navigation mesh polygon the agent is on, or 0 if not known.
+    unsigned polyRef_;
+    /// Moving towards a target flag.
+    bool hasTarget_;
+    /// Enabled flag.
+    bool enabled_;
+};
+
+/// Crowd simulation component. Moves all CrowdAgent components of the scene along their paths in one batch, using worker threads if available. Should be created to the root scene node.
+class CrowdManager : public Component
+{
+    OBJECT(CrowdManager);
+    
+    friend void UpdateCrowdVelocitiesWork(const WorkItem* item, unsigned threadIndex);
+    
+public:
+    /// Construct.
+    CrowdManager(Context* context);
+    /// Destruct.
+    virtual ~CrowdManager();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+    
+    /// Visualize the component as debug geometry.
+    virtual void DrawDebugGeometry(DebugRenderer* debug, bool depthTest);
+    
+    /// Set navigation mesh to use for paths. If not set, the first navigation mesh found in the scene is used.
+    void SetNavigationMesh(NavigationMesh* navMesh);
+    /// Set distance within which agents avoid each other.
+    void SetNeighborDistance(float distance);
+    /// Set weight of the agent separation compared to steering towards the path.
+    void SetSeparationWeight(float weight);
+    /// Step the simulation. Called automatically during the scene subsystem update.
+    void Update(float timeStep);
+    /// Add an agent.
+    void AddAgent(CrowdAgent* agent);
+    /// Remove an agent.
+    void RemoveAgent(CrowdAgent* agent);
+    /// Copy an agent's parameters and enabled state to its simulation state.
+    void SetAgentParameters(CrowdAgent* agent);
+    /// Set an agent's world space position.
+    void SetAgentPosition(CrowdAgent* agent, const Vector3& position);
+    /// Set an agent's target position and request a path to it.
+    void SetAgentTarget(CrowdAgent* agent, const Vector3& position);
+    /// Stop an agent from moving towards its target position.
+    void ResetAgentTarget(CrowdAgent* agent);
+    
+    /// Return navigation mesh in use.
+    NavigationMesh* GetNavigationMesh();
+    /// Return distance within which agents avoid each other.
+    float GetNeighborDistance() const { return neighborDistance_; }
+    /// Return weight of the agent separation.
+    float GetSeparationWeight() const { return separationWeight_; }
+    /// Return number of agents.
+    unsigned GetNumAgents() const { return agents_.Size(); }
+    /// Return an agent's simulation state.
+    const CrowdAgentData& GetAgentData(CrowdAgent* agent) const;
+    /// Return whether node transforms are being assigned from the simulation.
+    bool IsApplyingTransforms() const { return applyingTransforms_; }
+    
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+    
+private:
+    /// Handle the scene subsystem update event, step the simulation here.
+    void HandleSceneSubsystemUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle a path request being processed by the navigation mesh.
+    void HandleNavigationPathFound(StringHash eventType, VariantMap& eventData);
+    /// Sort the agents into the proximity grid.
+    void UpdateGrid();
+    /// Calculate new velocities for a range of agents. Does not access the scene, so can be called from worker threads.
+    void UpdateVelocities(unsigned start, unsigned end);
+    /// Integrate velocities, keep the agents on their path corridors and the navigation mesh surface, and assign the new positions to the scene nodes.
+    void ApplyVelocities();
+    
+    /// Navigation mesh.
+    WeakPtr<NavigationMesh> navigationMesh_;
+    /// Agent components.
+    PODVector<CrowdAgent*> agents_;
+    /// Agent simulation states.
+    PODVector<CrowdAgentData> agentData_;
+    /// Agent paths.
+    Vector<PODVector<Vector3> > paths_;
+    /// Pending path requests.
+    HashMap<unsigned, CrowdAgent*> pathRequests_;
+    /// Proximity grid bucket start indices into the sorted agent indices.
+    PODVector<unsigned> gridBuckets_;
+    /// Agent indices sorted by proximity grid bucket.
+    PODVector<unsigned> gridAgents_;
+    /// Proximity grid bucket of each agent.
+    PODVector<unsigned> agentBuckets_;
+    /// Neighbor distance.
+    float neighborDistance_;
+    /// Separation weight.
+    float separationWeight_;
+    /// Time step of the current update.
+    float timeStep_;
+    /// Applying transforms flag.
+    bool applyingTransforms_;
+};
+
+}
@@ -21,8 +21,11 @@
 //
 
 #include "Precompiled.h"
+#include "CrowdAgent.h"
+#include "CrowdManager.h"
 #include "Navigable.h"
 #include "NavigationMesh.h"
+#include "Obstacle.h"
 #include "OffMeshConnection.h"
 
 #include "DebugNew.h"
@@ -34,8 +37,11 @@ const char* NAVIGATION_CATEGORY = "Navigation";
 
 void RegisterNavigationLibrary(Context* context)
 {
+    CrowdAgent::RegisterObject(context);
+    CrowdManager::RegisterObject(context);
     Navigable::RegisterObject(context);
     NavigationMesh::RegisterObject(context);
+    Obstacle::RegisterObject(context);
     OffMeshConnection::RegisterObject(context);
 }
 
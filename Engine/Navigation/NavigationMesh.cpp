@@ -30,19 +30,24 @@
 #include "MemoryBuffer.h"
 #include "Model.h"
 #include "Navigable.h"
+#include "NavigationEvents.h"
 #include "NavigationMesh.h"
+#include "Obstacle.h"
 #include "OffMeshConnection.h"
 #include "Profiler.h"
 #include "Scene.h"
+#include "SceneEvents.h"
 #include "StaticModel.h"
 #include "TerrainPatch.h"
 #include "VectorBuffer.h"
+#include "WorkQueue.h"
 
 #include <cfloat>
 #include <DetourNavMesh.h>
 #include <DetourNavMeshBuilder.h>
 #include <DetourNavMeshQuery.h>
-#include <Recast.h>
+#include <Recast.h>
+#include <RecastAlloc.h>
 
 #include "DebugNew.h"
 
@@ -66,6 +71,26 @@ static const float DEFAULT_DETAIL_SAMPLE_DISTANCE = 6.0f;
 static const float DEFAULT_DETAIL_SAMPLE_MAX_ERROR = 1.0f;
 
 static const int MAX_POLYS = 2048;
+static const unsigned TILES_PER_THREAD = 4;
+static const unsigned PATH_REQUESTS_PER_WORK_ITEM = 8;
+static const int MAX_OBSTACLE_VERTS = 12;
+
+/// Dynamic obstacle shape in navigation mesh local space.
+struct NavigationObstacleData
+{
+    /// Box flag. If false, the obstacle is a cylinder.
+    bool box_;
+    /// Base center position.
+    Vector3 position_;
+    /// Cylinder radius.
+    float radius_;
+    /// Height.
+    float height_;
+    /// Box corners.
+    Vector3 corners_[4];
+    /// Bounding box.
+    BoundingBox bounds_;
+};
 
 /// Temporary data for building one tile of the navigation mesh.
 struct NavigationBuildData
@@ -73,11 +98,17 @@ struct NavigationBuildData
     /// Construct.
     NavigationBuildData() :
         ctx_(new rcContext(false)),
+        sourceHeightField_(0),
+        cachedHeightField_(0),
+        keepHeightField_(false),
         heightField_(0),
         compactHeightField_(0),
         contourSet_(0),
         polyMesh_(0),
-        polyMeshDetail_(0)
+        polyMeshDetail_(0),
+        navData_(0),
+        navDataSize_(0),
+        error_(0)
     {
     }
     
@@ -85,6 +116,8 @@ struct NavigationBuildData
     ~NavigationBuildData()
     {
         delete(ctx_);
+        dtFree(navData_);
+        rcFreeCompactHeightfield(cachedHeightField_);
         rcFreeHeightField(heightField_);
         rcFreeCompactHeightfield(compactHeightField_);
         rcFreeContourSet(contourSet_);
@@ -92,13 +125,27 @@ struct NavigationBuildData
         rcFreePolyMeshDetail(polyMeshDetail_);
         
         ctx_ = 0;
+        cachedHeightField_ = 0;
         heightField_ = 0;
         compactHeightField_ = 0;
         contourSet_ = 0;
         polyMesh_ = 0;
         polyMeshDetail_ = 0;
+        navData_ = 0;
     }
     
+    /// Tile X coordinate.
+    int tileX_;
+    /// Tile Z coordinate.
+    int tileZ_;
+    /// Recast configuration.
+    rcConfig config_;
+    /// Navigation agent height.
+    float agentHeight_;
+    /// Navigation agent radius.
+    float agentRadius_;
+    /// Navigation agent max vertical climb.
+    float agentMaxClimb_;
     /// World-space bounding box of the navigation mesh tile.
     BoundingBox worldBoundingBox_;
     /// Vertices from geometries.
@@ -115,8 +162,16 @@ struct NavigationBuildData
     PODVector<unsigned char> offMeshAreas_;
     /// Offmesh connection direction.
     PODVector<unsigned char> offMeshDir_;
+    /// Dynamic obstacles overlapping the tile.
+    PODVector<NavigationObstacleData> obstacles_;
     /// Recast context.
     rcContext* ctx_;
+    /// Cached compact heightfield to rebuild from instead of the geometry. Owned by the navigation mesh.
+    const rcCompactHeightfield* sourceHeightField_;
+    /// Copy of the compact heightfield built from the geometry, to be cached.
+    rcCompactHeightfield* cachedHeightField_;
+    /// Whether to copy the compact heightfield for the tile cache.
+    bool keepHeightField_;
     /// Recast heightfield.
     rcHeightfield* heightField_;
     /// Recast compact heightfield.
@@ -127,6 +182,12 @@ struct NavigationBuildData
     rcPolyMesh* polyMesh_;
     /// Recast detail poly mesh.
     rcPolyMeshDetail* polyMeshDetail_;
+    /// Detour tile data. Null if the tile has no geometry.
+    unsigned char* navData_;
+    /// Detour tile data size.
+    int navDataSize_;
+    /// Error message if building failed.
+    const char* error_;
 };
 
 /// Temporary data for finding a path.
@@ -142,6 +203,292 @@ struct FindPathData
     unsigned char pathFlags_[MAX_POLYS];
 };
 
+/// Return a copy of a compact heightfield without the distance field, or null if out of memory.
+static rcCompactHeightfield* CopyCompactHeightfield(const rcCompactHeightfield& src)
+{
+    rcCompactHeightfield* dest = rcAllocCompactHeightfield();
+    if (!dest)
+        return 0;
+    
+    *dest = src;
+    dest->dist = 0;
+    dest->maxDistance = 0;
+    
+    unsigned numCells = src.width * src.height;
+    dest->cells = (rcCompactCell*)rcAlloc(sizeof(rcCompactCell) * numCells, RC_ALLOC_PERM);
+    dest->spans = (rcCompactSpan*)rcAlloc(sizeof(rcCompactSpan) * src.spanCount, RC_ALLOC_PERM);
+    dest->areas = (unsigned char*)rcAlloc(src.spanCount, RC_ALLOC_PERM);
+    if (!dest->cells || !dest->spans || !dest->areas)
+    {
+        rcFreeCompactHeightfield(dest);
+        return 0;
+    }
+    
+    memcpy(dest->cells, src.cells, sizeof(rcCompactCell) * numCells);
+    memcpy(dest->spans, src.spans, sizeof(rcCompactSpan) * src.spanCount);
+    memcpy(dest->areas, src.areas, src.spanCount);
+    return dest;
+}
+
+/// Build the eroded compact heightfield of a navigation mesh tile from the collected geometry.
+static bool BuildTileHeightfield(NavigationBuildData& build)
+{
+    const rcConfig& cfg = build.config_;
+    
+    build.heightField_ = rcAllocHeightfield();
+    if (!build.heightField_)
+    {
+        build.error_ = "Could not allocate heightfield";
+        return false;
+    }
+    
+    if (!rcCreateHeightfield(build.ctx_, *build.heightField_, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs,
+        cfg.ch))
+    {
+        build.error_ = "Could not create heightfield";
+        return false;
+    }
+    
+    unsigned numTriangles = build.indices_.Size() / 3;
+    SharedArrayPtr<unsigned char> triAreas(new unsigned char[numTriangles]);
+    memset(triAreas.Get(), 0, numTriangles);
+    
+    rcMarkWalkableTriangles(build.ctx_, cfg.walkableSlopeAngle, &build.vertices_[0].x_, build.vertices_.Size(),
+        &build.indices_[0], numTriangles, triAreas.Get());
+    rcRasterizeTriangles(build.ctx_, &build.vertices_[0].x_, build.vertices_.Size(), &build.indices_[0],
+        triAreas.Get(), numTriangles, *build.heightField_, cfg.walkableClimb);
+    rcFilterLowHangingWalkableObstacles(build.ctx_, cfg.walkableClimb, *build.heightField_);
+    rcFilterLedgeSpans(build.ctx_, cfg.walkableHeight, cfg.walkableClimb, *build.heightField_);
+    rcFilterWalkableLowHeightSpans(build.ctx_, cfg.walkableHeight, *build.heightField_);
+    
+    build.compactHeightField_ = rcAllocCompactHeightfield();
+    if (!build.compactHeightField_)
+    {
+        build.error_ = "Could not allocate create compact heightfield";
+        return false;
+    }
+    if (!rcBuildCompactHeightfield(build.ctx_, cfg.walkableHeight, cfg.walkableClimb, *build.heightField_,
+        *build.compactHeightField_))
+    {
+        build.error_ = "Could not build compact heightfield";
+        return false;
+    }
+    if (!rcErodeWalkableArea(build.ctx_, cfg.walkableRadius, *build.compactHeightField_))
+    {
+        build.error_ = "Could not erode compact heightfield";
+        return false;
+    }
+    
+    return true;
+}
+
+/// Build the Detour data of a navigation mesh tile from the collected geometry or a cached heightfield, cutting out the dynamic obstacles. Does not access the scene, so can be called from worker threads.
+static bool BuildTileData(NavigationBuildData& build)
+{
+    const rcConfig& cfg = build.config_;
+    
+    if (build.sourceHeightField_)
+    {
+        build.compactHeightField_ = CopyCompactHeightfield(*build.sourceHeightField_);
+        if (!build.compactHeightField_)
+        {
+            build.error_ = "Could not copy cached compact heightfield";
+            return false;
+        }
+    }
+    else
+    {
+        if (build.vertices_.Empty() || build.indices_.Empty())
+            return true; // Nothing to do
+        
+        if (!BuildTileHeightfield(build))
+            return false;
+        
+        if (build.keepHeightField_)
+            build.cachedHeightField_ = CopyCompactHeightfield(*build.compactHeightField_);
+    }
+    
+    // Cut out the obstacles, expanded by the agent radius as the walkable area has already been eroded
+    for (unsigned i = 0; i < build.obstacles_.Size(); ++i)
+    {
+        const NavigationObstacleData& obstacle = build.obstacles_[i];
+        float minY = obstacle.position_.y_ - build.agentMaxClimb_;
+        float height = obstacle.height_ + build.agentMaxClimb_;
+        
+        if (obstacle.box_)
+        {
+            // Each corner is beveled into two vertices. rcOffsetPoly() fails unless there is room for more
+            float verts[MAX_OBSTACLE_VERTS * 3];
+            int numVerts = rcOffsetPoly(&obstacle.corners_[0].x_, 4, build.agentRadius_, verts, MAX_OBSTACLE_VERTS);
+            if (numVerts)
+                rcMarkConvexPolyArea(build.ctx_, verts, numVerts, minY, minY + height, RC_NULL_AREA, *build.compactHeightField_);
+        }
+        else
+        {
+            Vector3 base(obstacle.position_.x_, minY, obstacle.position_.z_);
+            rcMarkCylinderArea(build.ctx_, &base.x_, obstacle.radius_ + build.agentRadius_, height, RC_NULL_AREA,
+                *build.compactHeightField_);
+        }
+    }
+    
+    if (!rcBuildDistanceField(build.ctx_, *build.compactHeightField_))
+    {
+        build.error_ = "Could not build distance field";
+        return false;
+    }
+    if (!rcBuildRegions(build.ctx_, *build.compactHeightField_, cfg.borderSize, cfg.minRegionArea,
+        cfg.mergeRegionArea))
+    {
+        build.error_ = "Could not build regions";
+        return false;
+    }
+    
+    build.contourSet_ = rcAllocContourSet();
+    if (!build.contourSet_)
+    {
+        build.error_ = "Could not allocate contour set";
+        return false;
+    }
+    if (!rcBuildContours(build.ctx_, *build.compactHeightField_, cfg.maxSimplificationError, cfg.maxEdgeLen,
+        *build.contourSet_))
+    {
+        build.error_ = "Could not create contours";
+        return false;
+    }
+    
+    build.polyMesh_ = rcAllocPolyMesh();
+    if (!build.polyMesh_)
+    {
+        build.error_ = "Could not allocate poly mesh";
+        return false;
+    }
+    if (!rcBuildPolyMesh(build.ctx_, *build.contourSet_, cfg.maxVertsPerPoly, *build.polyMesh_))
+    {
+        build.error_ = "Could not triangulate contours";
+        return false;
+    }
+    
+    build.polyMeshDetail_ = rcAllocPolyMeshDetail();
+    if (!build.polyMeshDetail_)
+    {
+        build.error_ = "Could not allocate detail mesh";
+        return false;
+    }
+    if (!rcBuildPolyMeshDetail(build.ctx_, *build.polyMesh_, *build.compactHeightField_, cfg.detailSampleDist,
+        cfg.detailSampleMaxError, *build.polyMeshDetail_))
+    {
+        build.error_ = "Could not build detail mesh";
+        return false;
+    }
+    
+    // Set polygon flags
+    /// \todo Allow to define custom flags
+    for (int i = 0; i < build.polyMesh_->npolys; ++i)
+    {
+        if (build.polyMesh_->areas[i] == RC_WALKABLE_AREA)
+            build.polyMesh_->flags[i] = 0x1;
+    }
+    
+    dtNavMeshCreateParams params;
+    memset(&params, 0, sizeof params);
+    params.verts = build.polyMesh_->verts;
+    params.vertCount = build.polyMesh_->nverts;
+    params.polys = build.polyMesh_->polys;
+    params.polyAreas = build.polyMesh_->areas;
+    params.polyFlags = build.polyMesh_->flags;
+    params.polyCount = build.polyMesh_->npolys;
+    params.nvp = build.polyMesh_->nvp;
+    params.detailMeshes = build.polyMeshDetail_->meshes;
+    params.detailVerts = build.polyMeshDetail_->verts;
+    params.detailVertsCount = build.polyMeshDetail_->nverts;
+    params.detailTris = build.polyMeshDetail_->tris;
+    params.detailTriCount = build.polyMeshDetail_->ntris;
+    params.walkableHeight = build.agentHeight_;
+    params.walkableRadius = build.agentRadius_;
+    params.walkableClimb = build.agentMaxClimb_;
+    params.tileX = build.tileX_;
+    params.tileY = build.tileZ_;
+    rcVcopy(params.bmin, build.polyMesh_->bmin);
+    rcVcopy(params.bmax, build.polyMesh_->bmax);
+    params.cs = cfg.cs;
+    params.ch = cfg.ch;
+    params.buildBvTree = true;
+    
+    // Add off-mesh connections if have them
+    if (build.offMeshRadii_.Size())
+    {
+        params.offMeshConCount = build.offMeshRadii_.Size();
+        params.offMeshConVerts = &build.offMeshVertices_[0].x_;
+        params.offMeshConRad = &build.offMeshRadii_[0];
+        params.offMeshConFlags = &build.offMeshFlags_[0];
+        params.offMeshConAreas = &build.offMeshAreas_[0];
+        params.offMeshConDir = &build.offMeshDir_[0];
+    }
+    
+    if (!dtCreateNavMeshData(&params, &build.navData_, &build.navDataSize_))
+    {
+        build.error_ = "Could not build navigation mesh tile data";
+        return false;
+    }
+    
+    return true;
+}
+
+void BuildNavigationTileWork(const WorkItem* item, unsigned threadIndex)
+{
+    BuildTileData(*reinterpret_cast<NavigationBuildData*>(item->aux_));
+}
+
+/// Find a path between local space points using the given query object and temporary data. Return the path in local space.
+static void FindLocalPath(PODVector<Vector3>& dest, const Vector3& localStart, const Vector3& localEnd, const Vector3& extents,
+    dtNavMeshQuery* query, const dtQueryFilter* filter, FindPathData* data)
+{
+    dest.Clear();
+    
+    dtPolyRef startRef;
+    dtPolyRef endRef;
+    query->findNearestPoly(&localStart.x_, &extents.x_, filter, &startRef, 0);
+    query->findNearestPoly(&localEnd.x_, &extents.x_, filter, &endRef, 0);
+    
+    if (!startRef || !endRef)
+        return;
+    
+    int numPolys = 0;
+    int numPathPoints = 0;
+    
+    query->findPath(startRef, endRef, &localStart.x_, &localEnd.x_, filter, data->polys_, &numPolys, MAX_POLYS);
+    if (!numPolys)
+        return;
+    
+    Vector3 actualLocalEnd = localEnd;
+    
+    // If full path was not found, clamp end point to the end polygon
+    if (data->polys_[numPolys - 1] != endRef)
+        query->closestPointOnPoly(data->polys_[numPolys - 1], &localEnd.x_, &actualLocalEnd.x_);
+    
+    query->findStraightPath(&localStart.x_, &actualLocalEnd.x_, data->polys_, numPolys, &data->pathPoints_[0].x_,
+        data->pathFlags_, data->pathPolys_, &numPathPoints, MAX_POLYS);
+    
+    dest.Resize(numPathPoints);
+    for (int i = 0; i < numPathPoints; ++i)
+        dest[i] = data->pathPoints_[i];
+}
+
+void FindPathWork(const WorkItem* item, unsigned threadIndex)
+{
+    NavigationMesh* navMesh = reinterpret_cast<NavigationMesh*>(item->aux_);
+    NavigationPathRequest* start = reinterpret_cast<NavigationPathRequest*>(item->start_);
+    NavigationPathRequest* end = reinterpret_cast<NavigationPathRequest*>(item->end_);
+    dtNavMeshQuery* query = navMesh->threadQueries_[threadIndex];
+    FindPathData* data = navMesh->threadPathData_[threadIndex];
+    
+    while (start != end)
+    {
+        FindLocalPath(start->path_, start->start_, start->end_, start->extents_, query, navMesh->queryFilter_, data);
+        ++start;
+    }
+}
+
 OBJECTTYPESTATIC(NavigationMesh);
 
 NavigationMesh::NavigationMesh(Context* context) :
@@ -150,6 +497,9 @@ NavigationMesh::NavigationMesh(Context* context) :
     navMeshQuery_(0),
     queryFilter_(new dtQueryFilter()),
     pathData_(new FindPathData()),
+    nextPathRequestID_(1),
+    maxPathRequests_(0),
+    tileCacheEnabled_(false),
     tileSize_(DEFAULT_TILE_SIZE),
     cellSize_(DEFAULT_CELL_SIZE),
     cellHeight_(DEFAULT_CELL_HEIGHT),
@@ -178,6 +528,10 @@ NavigationMesh::~NavigationMesh()
     
     delete pathData_;
     pathData_ = 0;
+    
+    for (unsigned i = 0; i < threadPathData_.Size(); ++i)
+        delete threadPathData_[i];
+    threadPathData_.Clear();
 }
 
 void NavigationMesh::RegisterObject(Context* context)
@@ -198,6 +552,8 @@ void NavigationMesh::RegisterObject(Context* context)
     ACCESSOR_ATTRIBUTE(NavigationMesh, VAR_FLOAT, "Detail Sample Distance", GetDetailSampleDistance, SetDetailSampleDistance, float, DEFAULT_DETAIL_SAMPLE_DISTANCE, AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(NavigationMesh, VAR_FLOAT, "Detail Sample Max Error", GetDetailSampleMaxError, SetDetailSampleMaxError, float, DEFAULT_DETAIL_SAMPLE_MAX_ERROR, AM_DEFAULT);
     REF_ACCESSOR_ATTRIBUTE(NavigationMesh, VAR_VECTOR3, "Bounding Box Padding", GetPadding, SetPadding, Vector3, Vector3::ONE, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(NavigationMesh, VAR_INT, "Max Path Requests", GetMaxPathRequests, SetMaxPathRequests, unsigned, 0, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(NavigationMesh, VAR_BOOL, "Tile Cache", IsTileCacheEnabled, SetTileCacheEnabled, bool, false, AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(NavigationMesh, VAR_BUFFER, "Navigation Data", GetNavigationDataAttr, SetNavigationDataAttr, PODVector<unsigned char>, Variant::emptyBuffer, AM_FILE | AM_NOEDIT);
 }
 
@@ -333,6 +689,22 @@ void NavigationMesh::SetPadding(const Vector3& padding)
     MarkNetworkUpdate();
 }
 
+void NavigationMesh::SetMaxPathRequests(unsigned num)
+{
+    maxPathRequests_ = num;
+    
+    MarkNetworkUpdate();
+}
+
+void NavigationMesh::SetTileCacheEnabled(bool enable)
+{
+    tileCacheEnabled_ = enable;
+    if (!tileCacheEnabled_)
+        ReleaseTileCache();
+    
+    MarkNetworkUpdate();
+}
+
 bool NavigationMesh::Build()
 {
     PROFILE(BuildNavigationMesh);
@@ -403,18 +775,24 @@ bool NavigationMesh::Build()
             return false;
         }
         
-        // Build each tile
-        unsigned numTiles = 0;
-        
-        for (int z = 0; z < numTilesZ_; ++z)
+        // Pick up obstacles that were created before the navigation mesh
+        PODVector<Obstacle*> obstacles;
+        GetScene()->GetComponents<Obstacle>(obstacles, true);
+        for (unsigned i = 0; i < obstacles.Size(); ++i)
         {
-            for (int x = 0; x < numTilesX_; ++x)
-            {
-                if (BuildTile(geometryList, x, z))
-                    ++numTiles;
-            }
+            if (!obstacles[i]->GetNavigationMesh())
+                AddObstacle(obstacles[i]);
         }
         
+        // Build each tile
+        unsigned numTiles = BuildTiles(geometryList, 0, 0, numTilesX_ - 1, numTilesZ_ - 1);
+        
+        // The obstacles are now included in the tiles
+        NavigationObstacleData obstacleData;
+        for (unsigned i = 0; i < obstacles_.Size(); ++i)
+            obstacles_[i]->lastBounds_ = GetObstacleData(obstacles_[i], obstacleData) ? obstacleData.bounds_ : BoundingBox();
+        dirtyTiles_.Clear();
+        
         LOGDEBUG("Built navigation mesh with " + String(numTiles) + " tiles");
         return true;
     }
@@ -448,16 +826,7 @@ bool NavigationMesh::Build(const BoundingBox& boundingBox)
     int ex = Clamp((int)((localSpaceBox.max_.x_ - boundingBox_.min_.x_) / tileEdgeLength), 0, numTilesX_ - 1);
     int ez = Clamp((int)((localSpaceBox.max_.z_ - boundingBox_.min_.z_) / tileEdgeLength), 0, numTilesZ_ - 1);
     
-    unsigned numTiles = 0;
-    
-    for (int z = sz; z <= ez; ++z)
-    {
-        for (int x = sx; x <= ex; ++x)
-        {
-            if (BuildTile(geometryList, x, z))
-                ++numTiles;
-        }
-    }
+    unsigned numTiles = BuildTiles(geometryList, sx, sz, ex, ez);
     
     LOGDEBUG("Rebuilt " + String(numTiles) + " tiles of the navigation mesh");
     return true;
@@ -476,37 +845,260 @@ void NavigationMesh::FindPath(PODVector<Vector3>& dest, const Vector3& start, co
     const Matrix3x4& transform = node_->GetWorldTransform();
     Matrix3x4 inverse = transform.Inverse();
     
-    Vector3 localStart = inverse * start;
-    Vector3 localEnd = inverse * end;
+    FindLocalPath(dest, inverse * start, inverse * end, extents, navMeshQuery_, queryFilter_, pathData_);
     
-    dtPolyRef startRef;
-    dtPolyRef endRef;
-    navMeshQuery_->findNearestPoly(&localStart.x_, &extents.x_, queryFilter_, &startRef, 0);
-    navMeshQuery_->findNearestPoly(&localEnd.x_, &extents.x_, queryFilter_, &endRef, 0);
+    // Transform path result back to world space
+    for (unsigned i = 0; i < dest.Size(); ++i)
+        dest[i] = transform * dest[i];
+}
+
+unsigned NavigationMesh::RequestPath(const Vector3& start, const Vector3& end, const Vector3& extents)
+{
+    // The requests are processed during the scene subsystem update, so they can not be queued outside a scene
+    if (!GetScene())
+    {
+        LOGERROR("Can not request a path from a navigation mesh that is not in a scene");
+        return 0;
+    }
     
-    if (!startRef || !endRef)
+    SubscribeToUpdate();
+    
+    NavigationPathRequest request;
+    request.id_ = nextPathRequestID_++;
+    if (!nextPathRequestID_)
+        nextPathRequestID_ = 1;
+    request.start_ = start;
+    request.end_ = end;
+    request.extents_ = extents;
+    pathRequests_.Push(request);
+    
+    return request.id_;
+}
+
+void NavigationMesh::ProcessPathRequests()
+{
+    if (pathRequests_.Empty())
         return;
     
-    int numPolys = 0;
-    int numPathPoints = 0;
+    PROFILE(ProcessPathRequests);
     
-    navMeshQuery_->findPath(startRef, endRef, &localStart.x_, &localEnd.x_, queryFilter_, pathData_->polys_, &numPolys,
-        MAX_POLYS);
-    if (!numPolys)
+    // Take the requests to process out of the queue, so that event handlers can queue new ones
+    Vector<NavigationPathRequest> requests;
+    unsigned numRequests = pathRequests_.Size();
+    if (maxPathRequests_ && numRequests > maxPathRequests_)
+    {
+        numRequests = maxPathRequests_;
+        requests.Reserve(numRequests);
+        for (unsigned i = 0; i < numRequests; ++i)
+            requests.Push(pathRequests_[i]);
+        pathRequests_.Erase(0, numRequests);
+    }
+    else
+        requests.Swap(pathRequests_);
+    
+    if (InitializeQuery())
+    {
+        // Navigation data is in local space. Transform the request points from world to local
+        const Matrix3x4& transform = node_->GetWorldTransform();
+        Matrix3x4 inverse = transform.Inverse();
+        for (unsigned i = 0; i < numRequests; ++i)
+        {
+            requests[i].start_ = inverse * requests[i].start_;
+            requests[i].end_ = inverse * requests[i].end_;
+        }
+        
+        WorkQueue* queue = GetSubsystem<WorkQueue>();
+        unsigned numThreads = queue ? queue->GetNumThreads() : 0;
+        NavigationPathRequest* start = &requests[0];
+        NavigationPathRequest* last = start + numRequests;
+        
+        // Each request writes only its own path, and each thread uses its own query object and temporary data
+        if (numThreads && numRequests > PATH_REQUESTS_PER_WORK_ITEM && InitializeThreadQueries(numThreads))
+        {
+            WorkItem item;
+            item.workFunction_ = FindPathWork;
+            item.aux_ = this;
+            
+            while (start != last)
+            {
+                NavigationPathRequest* end = last;
+                if ((unsigned)(end - start) > PATH_REQUESTS_PER_WORK_ITEM)
+                    end = start + PATH_REQUESTS_PER_WORK_ITEM;
+                
+                item.start_ = start;
+                item.end_ = end;
+                queue->AddWorkItem(item);
+                
+                start = end;
+            }
+            
+            queue->Complete(M_MAX_UNSIGNED);
+        }
+        else
+        {
+            for (; start != last; ++start)
+                FindLocalPath(start->path_, start->start_, start->end_, start->extents_, navMeshQuery_, queryFilter_, pathData_);
+        }
+        
+        // Transform path results back to world space
+        for (unsigned i = 0; i < numRequests; ++i)
+        {
+            PODVector<Vector3>& path = requests[i].path_;
+            for (unsigned j = 0; j < path.Size(); ++j)
+                path[j] = transform * path[j];
+        }
+    }
+    
+    // Send the result events. An event handler may destroy the navigation mesh, so check for it
+    using namespace NavigationPathFound;
+    
+    WeakPtr<NavigationMesh> self(this);
+    VariantMap eventData;
+    eventData[P_NODE] = (void*)node_;
+    
+    for (unsigned i = 0; i < numRequests; ++i)
+    {
+        const PODVector<Vector3>& path = requests[i].path_;
+        VariantVector points(path.Size());
+        for (unsigned j = 0; j < path.Size(); ++j)
+            points[j] = path[j];
+        
+        eventData[P_REQUESTID] = requests[i].id_;
+        eventData[P_PATH] = points;
+        SendEvent(E_NAVIGATIONPATHFOUND, eventData);
+        
+        if (self.Expired())
+            return;
+    }
+}
+
+void NavigationMesh::AddObstacle(Obstacle* obstacle)
+{
+    if (!obstacle || obstacle->navigationMesh_ == this)
+        return;
+    
+    obstacle->navigationMesh_ = this;
+    obstacle->lastBounds_ = BoundingBox();
+    obstacles_.Push(obstacle);
+    MarkObstacleDirty(obstacle);
+}
+
+void NavigationMesh::RemoveObstacle(Obstacle* obstacle)
+{
+    if (!obstacle || obstacle->navigationMesh_ != this)
+        return;
+    
+    MarkTilesDirty(obstacle->lastBounds_);
+    obstacle->navigationMesh_.Reset();
+    obstacles_.Remove(obstacle);
+}
+
+void NavigationMesh::MarkObstacleDirty(Obstacle* obstacle)
+{
+    if (!obstacle || obstacle->navigationMesh_ != this)
+        return;
+    
+    // Rebuild the tiles under both the old and the new shape
+    NavigationObstacleData obstacleData;
+    BoundingBox bounds;
+    if (GetObstacleData(obstacle, obstacleData))
+        bounds = obstacleData.bounds_;
+    
+    MarkTilesDirty(obstacle->lastBounds_);
+    MarkTilesDirty(bounds);
+    obstacle->lastBounds_ = bounds;
+}
+
+void NavigationMesh::UpdateObstacles()
+{
+    if (dirtyTiles_.Empty())
         return;
     
-    Vector3 actualLocalEnd = localEnd;
+    PROFILE(UpdateNavigationObstacles);
+    
+    if (!navMesh_)
+    {
+        dirtyTiles_.Clear();
+        return;
+    }
+    
+    // Rebuild from the cached heightfields when possible, otherwise from the scene geometry
+    PODVector<NavigationBuildData*> builds;
+    Vector<NavigationGeometryInfo> geometryList;
+    Vector<NavigationGeometryInfo> connectionList;
+    bool geometryCollected = false;
+    bool connectionsCollected = false;
+    
+    for (HashSet<unsigned>::ConstIterator i = dirtyTiles_.Begin(); i != dirtyTiles_.End(); ++i)
+    {
+        unsigned index = *i;
+        int x = index % numTilesX_;
+        int z = index / numTilesX_;
+        
+        if (tileCacheEnabled_ && index < tileCached_.Size() && tileCached_[index])
+        {
+            // Tiles without geometry can not be affected by obstacles
+            if (!tileCache_[index])
+                continue;
+            
+            // The heightfield does not include the off-mesh connections, so add them to the tile again
+            if (!connectionsCollected)
+            {
+                CollectOffMeshConnections(connectionList);
+                connectionsCollected = true;
+            }
+            
+            NavigationBuildData* build = new NavigationBuildData();
+            GetTileConfig(*build, x, z);
+            GetTileObstacles(*build);
+            const rcConfig& cfg = build->config_;
+            BoundingBox expandedBox(*reinterpret_cast<const Vector3*>(cfg.bmin), *reinterpret_cast<const Vector3*>(cfg.bmax));
+            GetTileGeometry(*build, connectionList, expandedBox);
+            build->sourceHeightField_ = tileCache_[index];
+            builds.Push(build);
+        }
+        else
+        {
+            if (!geometryCollected)
+            {
+                CollectGeometries(geometryList);
+                geometryCollected = true;
+            }
+            
+            NavigationBuildData* build = new NavigationBuildData();
+            GetTileBuildData(*build, geometryList, x, z);
+            builds.Push(build);
+        }
+    }
+    
+    dirtyTiles_.Clear();
     
-    // If full path was not found, clamp end point to the end polygon
-    if (pathData_->polys_[numPolys - 1] != endRef)
-        navMeshQuery_->closestPointOnPoly(pathData_->polys_[numPolys - 1], &localEnd.x_, &actualLocalEnd.x_);
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (queue && queue->GetNumThreads() && builds.Size() > 1)
+    {
+        for (unsigned i = 0; i < builds.Size(); ++i)
+        {
+            WorkItem item;
+            item.workFunction_ = BuildNavigationTileWork;
+            item.aux_ = builds[i];
+            queue->AddWorkItem(item);
+        }
+        
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+    else
+    {
+        for (unsigned i = 0; i < builds.Size(); ++i)
+            BuildTileData(*builds[i]);
+    }
     
-    navMeshQuery_->findStraightPath(&localStart.x_, &actualLocalEnd.x_, pathData_->polys_, numPolys,
-        &pathData_->pathPoints_[0].x_, pathData_->pathFlags_, pathData_->pathPolys_, &numPathPoints, MAX_POLYS);
+    for (unsigned i = 0; i < builds.Size(); ++i)
+    {
+        AddTile(*builds[i]);
+        delete builds[i];
+    }
     
-    // Transform path result back to world space
-    for (int i = 0; i < numPathPoints; ++i)
-        dest.Push(transform * pathData_->pathPoints_[i]);
+    LOGDEBUG("Rebuilt " + String(builds.Size()) + " tiles of the navigation mesh due to obstacle changes");
 }
 
 Vector3 NavigationMesh::GetRandomPoint()
@@ -593,6 +1185,45 @@ Vector3 NavigationMesh::Raycast(const Vector3& start, const Vector3& end, const
     return start.Lerp(end, t);
 }
 
+Vector3 NavigationMesh::MoveAlongSurface(const Vector3& start, const Vector3& end, unsigned& polyRef, const Vector3& extents)
+{
+    if (!InitializeQuery())
+        return end;
+    
+    const Matrix3x4& transform = node_->GetWorldTransform();
+    Matrix3x4 inverse = transform.Inverse();
+    
+    Vector3 localStart = inverse * start;
+    Vector3 localEnd = inverse * end;
+    
+    // The polygon may have been removed by a tile rebuild since the last move
+    dtPolyRef startRef = polyRef;
+    if (!startRef || !navMeshQuery_->isValidPolyRef(startRef, queryFilter_))
+    {
+        startRef = 0;
+        navMeshQuery_->findNearestPoly(&localStart.x_, &extents.x_, queryFilter_, &startRef, 0);
+        polyRef = startRef;
+        if (!startRef)
+            return end;
+    }
+    
+    Vector3 localResult;
+    int numVisited;
+    
+    navMeshQuery_->moveAlongSurface(startRef, &localStart.x_, &localEnd.x_, queryFilter_, &localResult.x_, pathData_->polys_,
+        &numVisited, MAX_POLYS);
+    if (!numVisited)
+        return start;
+    
+    // The move is done on the plane of the polygons, so take the height from the detail mesh
+    polyRef = pathData_->polys_[numVisited - 1];
+    float height;
+    if (dtStatusSucceed(navMeshQuery_->getPolyHeight(polyRef, &localResult.x_, &height)))
+        localResult.y_ = height;
+    
+    return transform * localResult;
+}
+
 BoundingBox NavigationMesh::GetWorldBoundingBox() const
 {
     return node_ ? boundingBox_.Transformed(node_->GetWorldTransform()) : boundingBox_;
@@ -716,7 +1347,11 @@ void NavigationMesh::CollectGeometries(Vector<NavigationGeometryInfo>& geometryL
             CollectGeometries(geometryList, navigables[i]->GetNode(), processedNodes, navigables[i]->IsRecursive());
     }
     
-    // Get offmesh connections
+    CollectOffMeshConnections(geometryList);
+}
+
+void NavigationMesh::CollectOffMeshConnections(Vector<NavigationGeometryInfo>& geometryList)
+{
     Matrix3x4 inverse = node_->GetWorldTransform().Inverse();
     PODVector<OffMeshConnection*> connections;
     node_->GetComponents<OffMeshConnection>(connections, true);
@@ -973,9 +1608,101 @@ bool NavigationMesh::BuildTile(Vector<NavigationGeometryInfo>& geometryList, int
 {
     PROFILE(BuildNavigationMeshTile);
     
-    // Remove previous tile (if any)
-    navMesh_->removeTile(navMesh_->getTileRefAt(x, z, 0), 0, 0);
+    NavigationBuildData build;
+    GetTileBuildData(build, geometryList, x, z);
+    BuildTileData(build);
+    return AddTile(build);
+}
+
+unsigned NavigationMesh::BuildTiles(Vector<NavigationGeometryInfo>& geometryList, int sx, int sz, int ex, int ez)
+{
+    unsigned numTiles = 0;
+    
+    // Without worker threads, build one tile at a time to minimize memory use
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (!queue || !queue->GetNumThreads())
+    {
+        for (int z = sz; z <= ez; ++z)
+        {
+            for (int x = sx; x <= ex; ++x)
+            {
+                if (BuildTile(geometryList, x, z))
+                    ++numTiles;
+            }
+        }
+        
+        return numTiles;
+    }
+    
+    // Collect the geometry of the next batch of tiles in the main thread while the worker threads build the previous
+    // batch. Only the main thread adds the finished tiles to the Detour navigation mesh
+    unsigned batchSize = (queue->GetNumThreads() + 1) * TILES_PER_THREAD;
+    unsigned width = ex - sx + 1;
+    unsigned totalTiles = width * (ez - sz + 1);
+    unsigned nextTile = 0;
+    PODVector<NavigationBuildData*> building;
+    PODVector<NavigationBuildData*> collected;
+    
+    for (;;)
+    {
+        {
+            PROFILE(CollectTileGeometry);
+            
+            while (collected.Size() < batchSize && nextTile < totalTiles)
+            {
+                NavigationBuildData* build = new NavigationBuildData();
+                GetTileBuildData(*build, geometryList, sx + nextTile % width, sz + nextTile / width);
+                collected.Push(build);
+                ++nextTile;
+            }
+        }
+        
+        if (building.Size())
+        {
+            {
+                PROFILE(BuildNavigationMeshTiles);
+                queue->Complete(M_MAX_UNSIGNED);
+            }
+            
+            for (unsigned i = 0; i < building.Size(); ++i)
+            {
+                if (AddTile(*building[i]))
+                    ++numTiles;
+                delete building[i];
+            }
+            building.Clear();
+        }
+        
+        if (collected.Empty())
+            break;
+        
+        for (unsigned i = 0; i < collected.Size(); ++i)
+        {
+            WorkItem item;
+            item.workFunction_ = BuildNavigationTileWork;
+            item.aux_ = collected[i];
+            queue->AddWorkItem(item);
+        }
+        
+        building = collected;
+        collected.Clear();
+    }
+    
+    return numTiles;
+}
+
+void NavigationMesh::GetTileBuildData(NavigationBuildData& build, Vector<NavigationGeometryInfo>& geometryList, int x, int z)
+{
+    GetTileConfig(build, x, z);
+    GetTileObstacles(build);
     
+    const rcConfig& cfg = build.config_;
+    BoundingBox expandedBox(*reinterpret_cast<const Vector3*>(cfg.bmin), *reinterpret_cast<const Vector3*>(cfg.bmax));
+    GetTileGeometry(build, geometryList, expandedBox);
+}
+
+void NavigationMesh::GetTileConfig(NavigationBuildData& build, int x, int z)
+{
     float tileEdgeLength = (float)tileSize_ * cellSize_;
     
     BoundingBox tileBoundingBox(Vector3(
@@ -989,9 +1716,7 @@ bool NavigationMesh::BuildTile(Vector<NavigationGeometryInfo>& geometryList, int
         boundingBox_.min_.z_ + tileEdgeLength * (float)(z + 1)
     ));
     
-    NavigationBuildData build;
-    
-    rcConfig cfg;
+    rcConfig& cfg = build.config_;
     memset(&cfg, 0, sizeof cfg);
     cfg.cs = cellSize_;
     cfg.ch = cellHeight_;
@@ -1018,165 +1743,163 @@ bool NavigationMesh::BuildTile(Vector<NavigationGeometryInfo>& geometryList, int
     cfg.bmax[0] += cfg.borderSize * cfg.cs;
     cfg.bmax[2] += cfg.borderSize * cfg.cs;
     
-    BoundingBox expandedBox(*reinterpret_cast<Vector3*>(cfg.bmin), *reinterpret_cast<Vector3*>(cfg.bmax));
-    GetTileGeometry(build, geometryList, expandedBox);
-    
-    if (build.vertices_.Empty() || build.indices_.Empty())
-        return true; // Nothing to do
-    
-    build.heightField_ = rcAllocHeightfield();
-    if (!build.heightField_)
+    build.tileX_ = x;
+    build.tileZ_ = z;
+    build.agentHeight_ = agentHeight_;
+    build.agentRadius_ = agentRadius_;
+    build.agentMaxClimb_ = agentMaxClimb_;
+    build.keepHeightField_ = tileCacheEnabled_;
+}
+
+void NavigationMesh::GetTileObstacles(NavigationBuildData& build)
+{
+    const rcConfig& cfg = build.config_;
+    BoundingBox expandedBox(*reinterpret_cast<const Vector3*>(cfg.bmin), *reinterpret_cast<const Vector3*>(cfg.bmax));
+    expandedBox.min_.x_ -= agentRadius_;
+    expandedBox.min_.z_ -= agentRadius_;
+    expandedBox.max_.x_ += agentRadius_;
+    expandedBox.max_.z_ += agentRadius_;
+    
+    NavigationObstacleData obstacleData;
+    for (unsigned i = 0; i < obstacles_.Size(); ++i)
     {
-        LOGERROR("Could not allocate heightfield");
-        return false;
+        if (GetObstacleData(obstacles_[i], obstacleData) && expandedBox.IsInside(obstacleData.bounds_) != OUTSIDE)
+            build.obstacles_.Push(obstacleData);
     }
-    
-    if (!rcCreateHeightfield(build.ctx_, *build.heightField_, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs,
-        cfg.ch))
-    {
-        LOGERROR("Could not create heightfield");
+}
+
+bool NavigationMesh::GetObstacleData(Obstacle* obstacle, NavigationObstacleData& dest)
+{
+    Node* obstacleNode = obstacle->GetNode();
+    if (!node_ || !obstacleNode || !obstacle->IsEnabledEffective())
         return false;
-    }
     
-    unsigned numTriangles = build.indices_.Size() / 3;
-    SharedArrayPtr<unsigned char> triAreas(new unsigned char[numTriangles]);
-    memset(triAreas.Get(), 0, numTriangles);
+    // Obstacles ignore scaling
+    Matrix3x4 transform = node_->GetWorldTransform().Inverse() * Matrix3x4(obstacleNode->GetWorldPosition(),
+        obstacleNode->GetWorldRotation(), 1.0f);
     
-    rcMarkWalkableTriangles(build.ctx_, cfg.walkableSlopeAngle, &build.vertices_[0].x_, build.vertices_.Size(),
-        &build.indices_[0], numTriangles, triAreas.Get());
-    rcRasterizeTriangles(build.ctx_, &build.vertices_[0].x_, build.vertices_.Size(), &build.indices_[0],
-        triAreas.Get(), numTriangles, *build.heightField_, cfg.walkableClimb);
-    rcFilterLowHangingWalkableObstacles(build.ctx_, cfg.walkableClimb, *build.heightField_);
-    rcFilterLedgeSpans(build.ctx_, cfg.walkableHeight, cfg.walkableClimb, *build.heightField_);
-    rcFilterWalkableLowHeightSpans(build.ctx_, cfg.walkableHeight, *build.heightField_);
+    dest.box_ = obstacle->GetShape() == OBSTACLE_BOX;
+    dest.position_ = transform.Translation();
+    dest.radius_ = obstacle->GetRadius();
     
-    build.compactHeightField_ = rcAllocCompactHeightfield();
-    if (!build.compactHeightField_)
-    {
-        LOGERROR("Could not allocate create compact heightfield");
-        return false;
-    }
-    if (!rcBuildCompactHeightfield(build.ctx_, cfg.walkableHeight, cfg.walkableClimb, *build.heightField_,
-        *build.compactHeightField_))
-    {
-        LOGERROR("Could not build compact heightfield");
-        return false;
-    }
-    if (!rcErodeWalkableArea(build.ctx_, cfg.walkableRadius, *build.compactHeightField_))
+    if (dest.box_)
     {
-        LOGERROR("Could not erode compact heightfield");
-        return false;
-    }
-    if (!rcBuildDistanceField(build.ctx_, *build.compactHeightField_))
-    {
-        LOGERROR("Could not build distance field");
-        return false;
+        const Vector3& size = obstacle->GetSize();
+        float halfX = 0.5f * size.x_;
+        float halfZ = 0.5f * size.z_;
+        dest.height_ = Max(size.y_, 0.0f);
+        
+        // Flattened to the base height. rcOffsetPoly() grows the polygon only when the corners are in positive XZ
+        // winding order, which the rotation can mirror, so check the winding and reverse if necessary
+        dest.corners_[0] = transform * Vector3(-halfX, 0.0f, -halfZ);
+        dest.corners_[1] = transform * Vector3(halfX, 0.0f, -halfZ);
+        dest.corners_[2] = transform * Vector3(halfX, 0.0f, halfZ);
+        dest.corners_[3] = transform * Vector3(-halfX, 0.0f, halfZ);
+        
+        float area = 0.0f;
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            const Vector3& a = dest.corners_[i];
+            const Vector3& b = dest.corners_[(i + 1) & 3];
+            area += a.x_ * b.z_ - b.x_ * a.z_;
+        }
+        if (area < 0.0f)
+            Swap(dest.corners_[1], dest.corners_[3]);
+        
+        dest.bounds_.defined_ = false;
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            dest.corners_[i].y_ = dest.position_.y_;
+            dest.bounds_.Merge(dest.corners_[i]);
+        }
+        dest.bounds_.max_.y_ += dest.height_;
     }
-    if (!rcBuildRegions(build.ctx_, *build.compactHeightField_, cfg.borderSize, cfg.minRegionArea,
-        cfg.mergeRegionArea))
+    else
     {
-        LOGERROR("Could not build regions");
-        return false;
+        dest.height_ = obstacle->GetHeight();
+        dest.bounds_ = BoundingBox(dest.position_ - Vector3(dest.radius_, 0.0f, dest.radius_), dest.position_ +
+            Vector3(dest.radius_, dest.height_, dest.radius_));
     }
     
-    build.contourSet_ = rcAllocContourSet();
-    if (!build.contourSet_)
-    {
-        LOGERROR("Could not allocate contour set");
-        return false;
-    }
-    if (!rcBuildContours(build.ctx_, *build.compactHeightField_, cfg.maxSimplificationError, cfg.maxEdgeLen,
-        *build.contourSet_))
-    {
-        LOGERROR("Could not create contours");
-        return false;
-    }
+    return true;
+}
+
+void NavigationMesh::MarkTilesDirty(const BoundingBox& box)
+{
+    if (!box.defined_ || !navMesh_ || !numTilesX_ || !numTilesZ_)
+        return;
     
-    build.polyMesh_ = rcAllocPolyMesh();
-    if (!build.polyMesh_)
-    {
-        LOGERROR("Could not allocate poly mesh");
-        return false;
-    }
-    if (!rcBuildPolyMesh(build.ctx_, *build.contourSet_, cfg.maxVertsPerPoly, *build.polyMesh_))
-    {
-        LOGERROR("Could not triangulate contours");
-        return false;
-    }
+    // Tiles are built with a border, and obstacles are expanded by the agent radius
+    float tileEdgeLength = (float)tileSize_ * cellSize_;
+    float margin = agentRadius_ + ((float)(int)ceilf(agentRadius_ / cellSize_) + 3.0f) * cellSize_;
     
-    build.polyMeshDetail_ = rcAllocPolyMeshDetail();
-    if (!build.polyMeshDetail_)
-    {
-        LOGERROR("Could not allocate detail mesh");
-        return false;
-    }
-    if (!rcBuildPolyMeshDetail(build.ctx_, *build.polyMesh_, *build.compactHeightField_, cfg.detailSampleDist,
-        cfg.detailSampleMaxError, *build.polyMeshDetail_))
-    {
-        LOGERROR("Could not build detail mesh");
-        return false;
-    }
+    int sx = Clamp((int)floorf((box.min_.x_ - margin - boundingBox_.min_.x_) / tileEdgeLength), 0, numTilesX_ - 1);
+    int sz = Clamp((int)floorf((box.min_.z_ - margin - boundingBox_.min_.z_) / tileEdgeLength), 0, numTilesZ_ - 1);
+    int ex = Clamp((int)floorf((box.max_.x_ + margin - boundingBox_.min_.x_) / tileEdgeLength), 0, numTilesX_ - 1);
+    int ez = Clamp((int)floorf((box.max_.z_ + margin - boundingBox_.min_.z_) / tileEdgeLength), 0, numTilesZ_ - 1);
     
-    // Set polygon flags
-    /// \todo Allow to define custom flags
-    for (int i = 0; i < build.polyMesh_->npolys; ++i)
+    for (int z = sz; z <= ez; ++z)
     {
-        if (build.polyMesh_->areas[i] == RC_WALKABLE_AREA)
-            build.polyMesh_->flags[i] = 0x1;
+        for (int x = sx; x <= ex; ++x)
+            dirtyTiles_.Insert(z * numTilesX_ + x);
     }
     
-    unsigned char* navData = 0;
-    int navDataSize = 0;
+    SubscribeToUpdate();
+}
+
+void NavigationMesh::ReleaseTileCache()
+{
+    for (unsigned i = 0; i < tileCache_.Size(); ++i)
+        rcFreeCompactHeightfield(tileCache_[i]);
     
-    dtNavMeshCreateParams params;
-    memset(&params, 0, sizeof params);
-    params.verts = build.polyMesh_->verts;
-    params.vertCount = build.polyMesh_->nverts;
-    params.polys = build.polyMesh_->polys;
-    params.polyAreas = build.polyMesh_->areas;
-    params.polyFlags = build.polyMesh_->flags;
-    params.polyCount = build.polyMesh_->npolys;
-    params.nvp = build.polyMesh_->nvp;
-    params.detailMeshes = build.polyMeshDetail_->meshes;
-    params.detailVerts = build.polyMeshDetail_->verts;
-    params.detailVertsCount = build.polyMeshDetail_->nverts;
-    params.detailTris = build.polyMeshDetail_->tris;
-    params.detailTriCount = build.polyMeshDetail_->ntris;
-    params.walkableHeight = agentHeight_;
-    params.walkableRadius = agentRadius_;
-    params.walkableClimb = agentMaxClimb_;
-    params.tileX = x;
-    params.tileY = z;
-    rcVcopy(params.bmin, build.polyMesh_->bmin);
-    rcVcopy(params.bmax, build.polyMesh_->bmax);
-    params.cs = cfg.cs;
-    params.ch = cfg.ch;
-    params.buildBvTree = true;
+    tileCache_.Clear();
+    tileCached_.Clear();
+}
+
+bool NavigationMesh::AddTile(NavigationBuildData& build)
+{
+    // Remove previous tile (if any)
+    navMesh_->removeTile(navMesh_->getTileRefAt(build.tileX_, build.tileZ_, 0), 0, 0);
     
-    // Add off-mesh connections if have them
-    if (build.offMeshRadii_.Size())
+    // Store the heightfield if the tile was built from the geometry for the tile cache
+    if (build.keepHeightField_ && !build.sourceHeightField_ && !build.error_)
     {
-        params.offMeshConCount = build.offMeshRadii_.Size();
-        params.offMeshConVerts = &build.offMeshVertices_[0].x_;
-        params.offMeshConRad = &build.offMeshRadii_[0];
-        params.offMeshConFlags = &build.offMeshFlags_[0];
-        params.offMeshConAreas = &build.offMeshAreas_[0];
-        params.offMeshConDir = &build.offMeshDir_[0];
+        unsigned index = build.tileZ_ * numTilesX_ + build.tileX_;
+        if (tileCache_.Size() != (unsigned)(numTilesX_ * numTilesZ_))
+        {
+            ReleaseTileCache();
+            tileCache_.Resize(numTilesX_ * numTilesZ_);
+            tileCached_.Resize(numTilesX_ * numTilesZ_);
+            for (unsigned i = 0; i < tileCache_.Size(); ++i)
+            {
+                tileCache_[i] = 0;
+                tileCached_[i] = false;
+            }
+        }
+        
+        rcFreeCompactHeightfield(tileCache_[index]);
+        tileCache_[index] = build.cachedHeightField_;
+        tileCached_[index] = true;
+        build.cachedHeightField_ = 0;
     }
     
-    if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
+    if (build.error_)
     {
-        LOGERROR("Could not build navigation mesh tile data");
+        LOGERROR(build.error_);
         return false;
     }
     
-    if (dtStatusFailed(navMesh_->addTile(navData, navDataSize, DT_TILE_FREE_DATA, 0, 0)))
+    if (!build.navData_)
+        return true; // Nothing to do
+    
+    if (dtStatusFailed(navMesh_->addTile(build.navData_, build.navDataSize_, DT_TILE_FREE_DATA, 0, 0)))
     {
         LOGERROR("Failed to add navigation mesh tile");
-        dtFree(navData);
         return false;
     }
     
+    // The navigation mesh now owns the data
+    build.navData_ = 0;
     return true;
 }
 
@@ -1204,6 +1927,68 @@ bool NavigationMesh::InitializeQuery()
     return true;
 }
 
+bool NavigationMesh::InitializeThreadQueries(unsigned numThreads)
+{
+    if (threadPathData_.Size() < numThreads + 1)
+    {
+        unsigned oldSize = threadPathData_.Size();
+        threadPathData_.Resize(numThreads + 1);
+        for (unsigned i = oldSize; i < threadPathData_.Size(); ++i)
+            threadPathData_[i] = new FindPathData();
+    }
+    
+    if (threadQueries_.Size() < numThreads + 1)
+    {
+        unsigned oldSize = threadQueries_.Size();
+        threadQueries_.Resize(numThreads + 1);
+        for (unsigned i = oldSize; i < threadQueries_.Size(); ++i)
+        {
+            threadQueries_[i] = dtAllocNavMeshQuery();
+            if (!threadQueries_[i])
+            {
+                LOGERROR("Could not create navigation mesh query");
+                threadQueries_.Resize(i);
+                return false;
+            }
+            
+            if (dtStatusFailed(threadQueries_[i]->init(navMesh_, MAX_POLYS)))
+            {
+                LOGERROR("Could not init navigation mesh query");
+                dtFreeNavMeshQuery(threadQueries_[i]);
+                threadQueries_.Resize(i);
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+void NavigationMesh::OnNodeSet(Node* node)
+{
+    // Resume processing queued work when assigned to a node in a scene
+    if (node && (!pathRequests_.Empty() || !dirtyTiles_.Empty()))
+        SubscribeToUpdate();
+}
+
+void NavigationMesh::SubscribeToUpdate()
+{
+    Scene* scene = GetScene();
+    if (scene && !HasSubscribedToEvent(scene, E_SCENESUBSYSTEMUPDATE))
+        SubscribeToEvent(scene, E_SCENESUBSYSTEMUPDATE, HANDLER(NavigationMesh, HandleSceneSubsystemUpdate));
+}
+
+void NavigationMesh::HandleSceneSubsystemUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Rebuild the tiles first so that the path requests see the obstacles
+    UpdateObstacles();
+    ProcessPathRequests();
+    
+    // Only stay subscribed while there is work queued
+    if (pathRequests_.Empty() && dirtyTiles_.Empty())
+        UnsubscribeFromEvent(E_SCENESUBSYSTEMUPDATE);
+}
+
 void NavigationMesh::ReleaseNavigationMesh()
 {
     dtFreeNavMesh(navMesh_);
@@ -1212,6 +1997,13 @@ void NavigationMesh::ReleaseNavigationMesh()
     dtFreeNavMeshQuery(navMeshQuery_);
     navMeshQuery_ = 0;
     
+    for (unsigned i = 0; i < threadQueries_.Size(); ++i)
+        dtFreeNavMeshQuery(threadQueries_[i]);
+    threadQueries_.Clear();
+    
+    ReleaseTileCache();
+    dirtyTiles_.Clear();
+    
     numTilesX_ = 0;
     numTilesZ_ = 0;
     boundingBox_.min_ = boundingBox_.max_ = Vector3::ZERO;
@@ -25,19 +25,25 @@
 #include "ArrayPtr.h"
 #include "BoundingBox.h"
 #include "Component.h"
+#include "HashSet.h"
 #include "Matrix3x4.h"
 
 class dtNavMesh;
 class dtNavMeshQuery;
 class dtQueryFilter;
 
+struct rcCompactHeightfield;
+
 namespace Urho3D
 {
 
 class Geometry;
+class Obstacle;
 
 struct FindPathData;
 struct NavigationBuildData;
+struct NavigationObstacleData;
+struct WorkItem;
 
 /// Description of a navigation mesh geometry component, with transform and bounds information.
 struct NavigationGeometryInfo
@@ -52,11 +58,28 @@ struct NavigationGeometryInfo
     BoundingBox boundingBox_;
 };
 
+/// Asynchronous path request.
+struct NavigationPathRequest
+{
+    /// Request ID.
+    unsigned id_;
+    /// Start point.
+    Vector3 start_;
+    /// End point.
+    Vector3 end_;
+    /// Extents for finding the nearest polygons.
+    Vector3 extents_;
+    /// Resulting path points.
+    PODVector<Vector3> path_;
+};
+
 /// Navigation mesh component. Collects the navigation geometry from child nodes with the Navigable component and responds to path queries.
 class NavigationMesh : public Component
 {
     OBJECT(NavigationMesh);
     
+    friend void FindPathWork(const WorkItem* item, unsigned threadIndex);
+    
 public:
     /// Construct.
     NavigationMesh(Context* context);
@@ -96,12 +119,28 @@ public:
     void SetDetailSampleMaxError(float error);
     /// Set padding of the navigation mesh bounding box. Having enough padding allows to add geometry on the extremities of the navigation mesh when doing partial rebuilds.
     void SetPadding(const Vector3& padding);
+    /// Set maximum number of asynchronous path requests to process per scene update. 0 (default) processes all.
+    void SetMaxPathRequests(unsigned num);
+    /// Set whether to keep the intermediate heightfields of the tiles, so that tiles affected by dynamic obstacles can be rebuilt quickly. Takes effect on the next build; tiles not yet cached are rebuilt from the scene geometry.
+    void SetTileCacheEnabled(bool enable);
     /// Rebuild the navigation mesh. Return true if successful.
     bool Build();
     /// Rebuild part of the navigation mesh contained by the world-space bounding box. Return true if successful.
     bool Build(const BoundingBox& boundingBox);
     /// Find a path between world space points. Return non-empty list of points if successful. Extents specifies how far off the navigation mesh the points can be.
     void FindPath(PODVector<Vector3>& dest, const Vector3& start, const Vector3& end, const Vector3& extents = Vector3::ONE);
+    /// Queue an asynchronous path request between world space points. It is processed during the scene subsystem update, using worker threads if available, and the result is sent with the E_NAVIGATIONPATHFOUND event. Return the request ID, or 0 if the navigation mesh is not in a scene.
+    unsigned RequestPath(const Vector3& start, const Vector3& end, const Vector3& extents = Vector3::ONE);
+    /// Process the queued path requests now (up to the maximum number per update) and send their result events.
+    void ProcessPathRequests();
+    /// Add a dynamic obstacle. Called by Obstacle.
+    void AddObstacle(Obstacle* obstacle);
+    /// Remove a dynamic obstacle. Called by Obstacle.
+    void RemoveObstacle(Obstacle* obstacle);
+    /// Mark the tiles affected by a dynamic obstacle change for rebuild. Called by Obstacle.
+    void MarkObstacleDirty(Obstacle* obstacle);
+    /// Rebuild the tiles affected by dynamic obstacle changes now. Called automatically during the scene subsystem update.
+    void UpdateObstacles();
     /// Return a random point on the navigation mesh.
     Vector3 GetRandomPoint();
     /// Return a random point on the navigation mesh within a circle. The circle radius is only a guideline and in practice the returned point may be further away.
@@ -110,6 +149,8 @@ public:
     float GetDistanceToWall(const Vector3& point, float radius, const Vector3& extents = Vector3::ONE);
     /// Perform a walkability raycast on the navigation mesh between start and end and return the point where a wall was hit, or the end point if no walls.
     Vector3 Raycast(const Vector3& start, const Vector3& end, const Vector3& extents = Vector3::ONE);
+    /// Move from start towards end along the navigation mesh surface and return the reached point. The polygon containing the start is passed in and updated to the polygon containing the result, or searched for if not valid.
+    Vector3 MoveAlongSurface(const Vector3& start, const Vector3& end, unsigned& polyRef, const Vector3& extents = Vector3::ONE);
 
     /// Return tile size.
     int GetTileSize() const { return tileSize_; }
@@ -139,6 +180,16 @@ public:
     float GetDetailSampleMaxError() const { return detailSampleMaxError_; }
     /// Return navigation mesh bounding box padding.
     const Vector3& GetPadding() const { return padding_; }
+    /// Return maximum number of asynchronous path requests to process per scene update.
+    unsigned GetMaxPathRequests() const { return maxPathRequests_; }
+    /// Return number of queued path requests.
+    unsigned GetNumPathRequests() const { return pathRequests_.Size(); }
+    /// Return whether the tile cache is enabled.
+    bool IsTileCacheEnabled() const { return tileCacheEnabled_; }
+    /// Return number of dynamic obstacles.
+    unsigned GetNumObstacles() const { return obstacles_.Size(); }
+    /// Return number of tiles waiting to be rebuilt due to dynamic obstacle changes.
+    unsigned GetNumDirtyTiles() const { return dirtyTiles_.Size(); }
     /// Return whether has been initialized with valid navigation data.
     bool IsInitialized() const { return navMesh_ != 0; }
     /// Return local space bounding box of the navigation mesh.
@@ -153,19 +204,47 @@ public:
     /// Return navigation data attribute.
     PODVector<unsigned char> GetNavigationDataAttr() const;
     
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+    
 private:
     /// Collect geometry from under Navigable components.
     void CollectGeometries(Vector<NavigationGeometryInfo>& geometryList);
     /// Visit nodes and collect navigable geometry.
     void CollectGeometries(Vector<NavigationGeometryInfo>& geometryList, Node* node, HashSet<Node*>& processedNodes, bool recursive);
+    /// Collect enabled off-mesh connections.
+    void CollectOffMeshConnections(Vector<NavigationGeometryInfo>& geometryList);
     /// Get geometry data within a bounding box.
     void GetTileGeometry(NavigationBuildData& build, Vector<NavigationGeometryInfo>& geometryList, BoundingBox& box);
     /// Add a triangle mesh to the geometry data.
     void AddTriMeshGeometry(NavigationBuildData& build, Geometry* geometry, const Matrix3x4& transform);
     /// Build one tile of the navigation mesh. Return true if successful.
     bool BuildTile(Vector<NavigationGeometryInfo>& geometryList, int x, int z);
+    /// Build a rectangular range of tiles, using worker threads if available. Return number of tiles built successfully.
+    unsigned BuildTiles(Vector<NavigationGeometryInfo>& geometryList, int sx, int sz, int ex, int ez);
+    /// Set up the Recast configuration and collect the geometry and obstacles for building one tile.
+    void GetTileBuildData(NavigationBuildData& build, Vector<NavigationGeometryInfo>& geometryList, int x, int z);
+    /// Set up the Recast configuration for building one tile.
+    void GetTileConfig(NavigationBuildData& build, int x, int z);
+    /// Collect the dynamic obstacles affecting one tile.
+    void GetTileObstacles(NavigationBuildData& build);
+    /// Return a dynamic obstacle's shape in local space. Return false if it is disabled or not in the scene.
+    bool GetObstacleData(Obstacle* obstacle, NavigationObstacleData& dest);
+    /// Mark the tiles overlapping a local space bounding box for rebuild.
+    void MarkTilesDirty(const BoundingBox& box);
+    /// Release the cached tile heightfields.
+    void ReleaseTileCache();
+    /// Replace a tile of the navigation mesh with built tile data. Return true if successful.
+    bool AddTile(NavigationBuildData& build);
     /// Ensure that the navigation mesh query is initialized. Return true if successful.
     bool InitializeQuery();
+    /// Ensure that the per-thread navigation mesh queries are initialized. Return true if successful.
+    bool InitializeThreadQueries(unsigned numThreads);
+    /// Subscribe to the scene subsystem update to process path requests and obstacle changes.
+    void SubscribeToUpdate();
+    /// Handle scene subsystem update event.
+    void HandleSceneSubsystemUpdate(StringHash eventType, VariantMap& eventData);
     /// Release the navigation mesh and the query.
     void ReleaseNavigationMesh();
     
@@ -177,6 +256,26 @@ private:
     dtQueryFilter* queryFilter_;
     /// Temporary data for finding a path.
     FindPathData* pathData_;
+    /// Detour navigation mesh queries for worker threads, indexed by thread.
+    PODVector<dtNavMeshQuery*> threadQueries_;
+    /// Temporary data for finding a path in worker threads, indexed by thread.
+    PODVector<FindPathData*> threadPathData_;
+    /// Queued asynchronous path requests.
+    Vector<NavigationPathRequest> pathRequests_;
+    /// Next path request ID.
+    unsigned nextPathRequestID_;
+    /// Maximum number of path requests to process per scene update.
+    unsigned maxPathRequests_;
+    /// Dynamic obstacles.
+    PODVector<Obstacle*> obstacles_;
+    /// Indices of tiles to rebuild due to dynamic obstacle changes.
+    HashSet<unsigned> dirtyTiles_;
+    /// Cached compact heightfields of the tiles, null for tiles without geometry.
+    PODVector<rcCompactHeightfield*> tileCache_;
+    /// Cached flags of the tiles.
+    PODVector<bool> tileCached_;
+    /// Tile cache enabled flag.
+    bool tileCacheEnabled_;
     /// Tile size.
     int tileSize_;
     /// Cell size.
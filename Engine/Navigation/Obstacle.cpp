@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Precompiled.h"
+#include "Context.h"
+#include "DebugRenderer.h"
+#include "NavigationMesh.h"
+#include "Obstacle.h"
+#include "Scene.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+extern const char* NAVIGATION_CATEGORY;
+
+static const char* shapeNames[] =
+{
+    "Cylinder",
+    "Box",
+    0
+};
+
+static const float DEFAULT_RADIUS = 1.0f;
+static const float DEFAULT_HEIGHT = 2.0f;
+static const Vector3 DEFAULT_SIZE(2.0f, 2.0f, 2.0f);
+static const unsigned NUM_DEBUG_SEGMENTS = 16;
+
+template<> ObstacleShape Variant::Get<ObstacleShape>() const
+{
+    return (ObstacleShape)GetInt();
+}
+
+OBJECTTYPESTATIC(Obstacle);
+
+Obstacle::Obstacle(Context* context) :
+    Component(context),
+    shape_(OBSTACLE_CYLINDER),
+    radius_(DEFAULT_RADIUS),
+    height_(DEFAULT_HEIGHT),
+    size_(DEFAULT_SIZE)
+{
+}
+
+Obstacle::~Obstacle()
+{
+    if (navigationMesh_)
+        navigationMesh_->RemoveObstacle(this);
+}
+
+void Obstacle::RegisterObject(Context* context)
+{
+    context->RegisterFactory<Obstacle>(NAVIGATION_CATEGORY);
+    
+    ACCESSOR_ATTRIBUTE(Obstacle, VAR_BOOL, "Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    ENUM_ACCESSOR_ATTRIBUTE(Obstacle, "Shape", GetShape, SetShape, ObstacleShape, shapeNames, OBSTACLE_CYLINDER, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(Obstacle, VAR_FLOAT, "Radius", GetRadius, SetRadius, float, DEFAULT_RADIUS, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(Obstacle, VAR_FLOAT, "Height", GetHeight, SetHeight, float, DEFAULT_HEIGHT, AM_DEFAULT);
+    REF_ACCESSOR_ATTRIBUTE(Obstacle, VAR_VECTOR3, "Size", GetSize, SetSize, Vector3, DEFAULT_SIZE, AM_DEFAULT);
+}
+
+void Obstacle::OnSetEnabled()
+{
+    MarkNavigationDirty();
+}
+
+void Obstacle::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
+{
+    if (!node_)
+        return;
+    
+    Matrix3x4 transform(node_->GetWorldPosition(), node_->GetWorldRotation(), 1.0f);
+    
+    if (shape_ == OBSTACLE_BOX)
+    {
+        BoundingBox box(Vector3(-0.5f * size_.x_, 0.0f, -0.5f * size_.z_), Vector3(0.5f * size_.x_, size_.y_, 0.5f * size_.z_));
+        debug->AddBoundingBox(box, transform, Color::RED, depthTest);
+    }
+    else
+    {
+        Vector3 base = node_->GetWorldPosition();
+        Vector3 top = base + Vector3(0.0f, height_, 0.0f);
+        for (unsigned i = 0; i < NUM_DEBUG_SEGMENTS; ++i)
+        {
+            float angle0 = 2.0f * M_PI * i / NUM_DEBUG_SEGMENTS;
+            float angle1 = 2.0f * M_PI * (i + 1) / NUM_DEBUG_SEGMENTS;
+            Vector3 offset0(radius_ * cosf(angle0), 0.0f, radius_ * sinf(angle0));
+            Vector3 offset1(radius_ * cosf(angle1), 0.0f, radius_ * sinf(angle1));
+            debug->AddLine(base + offset0, base + offset1, Color::RED, depthTest);
+            debug->AddLine(top + offset0, top + offset1, Color::RED, depthTest);
+            debug->AddLine(base + offset0, top + offset0, Color::RED, depthTest);
+        }
+    }
+}
+
+void Obstacle::SetShape(ObstacleShape shape)
+{
+    shape_ = shape;
+    MarkNavigationDirty();
+    MarkNetworkUpdate();
+}
+
+void Obstacle::SetRadius(float radius)
+{
+    radius_ = Max(radius, 0.0f);
+    MarkNavigationDirty();
+    MarkNetworkUpdate();
+}
+
+void Obstacle::SetHeight(float height)
+{
+    height_ = Max(height, 0.0f);
+    MarkNavigationDirty();
+    MarkNetworkUpdate();
+}
+
+void Obstacle::SetSize(const Vector3& size)
+{
+    size_ = size;
+    MarkNavigationDirty();
+    MarkNetworkUpdate();
+}
+
+void Obstacle::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        Scene* scene = GetScene();
+        if (scene)
+        {
+            PODVector<NavigationMesh*> navMeshes;
+            scene->GetComponents<NavigationMesh>(navMeshes, true);
+            if (navMeshes.Size())
+                navMeshes[0]->AddObstacle(this);
+        }
+        node->AddListener(this);
+    }
+}
+
+void Obstacle::OnMarkedDirty(Node* node)
+{
+    // Navigation mesh operations are not safe from worker threads
+    Scene* scene = GetScene();
+    if (scene && scene->IsThreadedUpdate())
+    {
+        scene->DelayedMarkedDirty(this);
+        return;
+    }
+    
+    MarkNavigationDirty();
+}
+
+void Obstacle::MarkNavigationDirty()
+{
+    if (navigationMesh_)
+        navigationMesh_->MarkObstacleDirty(this);
+}
+
+}
@@ -0,0 +1,104 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "BoundingBox.h"
+#include "Component.h"
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+/// Dynamic obstacle shape.
+enum ObstacleShape
+{
+    OBSTACLE_CYLINDER = 0,
+    OBSTACLE_BOX
+};
+
+/// Dynamic obstacle that cuts a hole into the navigation mesh. The obstacle's base is at the node position; the box shape follows the node rotation, while node scale is ignored.
+class Obstacle : public Component
+{
+    OBJECT(Obstacle);
+    
+    friend class NavigationMesh;
+    
+public:
+    /// Construct.
+    Obstacle(Context* context);
+    /// Destruct.
+    virtual ~Obstacle();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+    
+    /// Handle enabled/disabled state change.
+    virtual void OnSetEnabled();
+    /// Visualize the component as debug geometry.
+    virtual void DrawDebugGeometry(DebugRenderer* debug, bool depthTest);
+    
+    /// Set shape.
+    void SetShape(ObstacleShape shape);
+    /// Set cylinder radius.
+    void SetRadius(float radius);
+    /// Set cylinder height.
+    void SetHeight(float height);
+    /// Set box size. The Y coordinate is the height above the base.
+    void SetSize(const Vector3& size);
+    
+    /// Return shape.
+    ObstacleShape GetShape() const { return shape_; }
+    /// Return cylinder radius.
+    float GetRadius() const { return radius_; }
+    /// Return cylinder height.
+    float GetHeight() const { return height_; }
+    /// Return box size.
+    const Vector3& GetSize() const { return size_; }
+    /// Return navigation mesh the obstacle affects.
+    NavigationMesh* GetNavigationMesh() const { return navigationMesh_; }
+    
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+    /// Handle node transform being dirtied.
+    virtual void OnMarkedDirty(Node* node);
+    
+private:
+    /// Notify the navigation mesh of a change.
+    void MarkNavigationDirty();
+    
+    /// Navigation mesh.
+    WeakPtr<NavigationMesh> navigationMesh_;
+    /// Shape.
+    ObstacleShape shape_;
+    /// Cylinder radius.
+    float radius_;
+    /// Cylinder height.
+    float height_;
+    /// Box size.
+    Vector3 size_;
+    /// Navigation mesh local space bounds last applied to the navigation mesh.
+    BoundingBox lastBounds_;
+};
+
+}
@@ -158,6 +158,7 @@ void Connection::SetScene(Scene* newScene)
     scene_ = newScene;
     sceneLoaded_ = false;
     UnsubscribeFromEvent(E_ASYNCLOADFINISHED);
+    UnsubscribeFromEvent(E_ASYNCLOADFAILED);
     
     if (!scene_)
         return;
@@ -186,6 +187,7 @@ void Connection::SetScene(Scene* newScene)
         // Make sure there is no existing async loading
         scene_->StopAsyncLoading();
         SubscribeToEvent(scene_, E_ASYNCLOADFINISHED, HANDLER(Connection, HandleAsyncLoadFinished));
+        SubscribeToEvent(scene_, E_ASYNCLOADFAILED, HANDLER(Connection, HandleAsyncLoadFailed));
     }
 }
 
@@ -1052,6 +1054,11 @@ void Connection::HandleAsyncLoadFinished(StringHash eventType, VariantMap& event
     SendMessage(MSG_SCENELOADED, true, true, msg_);
 }
 
+void Connection::HandleAsyncLoadFailed(StringHash eventType, VariantMap& eventData)
+{
+    OnSceneLoadFailed();
+}
+
 void Connection::ProcessNode(unsigned nodeID)
 {
     // Check that we have not already processed this due to dependency recursion
@@ -181,6 +181,8 @@ public:
 private:
     /// Handle scene loaded event.
     void HandleAsyncLoadFinished(StringHash eventType, VariantMap& eventData);
+    /// Handle scene load failed event.
+    void HandleAsyncLoadFailed(StringHash eventType, VariantMap& eventData);
     /// Process a LoadScene message from the server. Called by Network.
     void ProcessLoadScene(int msgID, MemoryBuffer& msg);
     /// Process a SceneChecksumError message from the server. Called by Network.
@@ -26,9 +26,12 @@
 #include "CustomGeometry.h"
 #include "DebugRenderer.h"
 #include "DrawableEvents.h"
+#include "File.h"
+#include "FileSystem.h"
 #include "Geometry.h"
 #include "Log.h"
 #include "Model.h"
+#include "Mutex.h"
 #include "PhysicsUtils.h"
 #include "PhysicsWorld.h"
 #include "Profiler.h"
@@ -36,6 +39,7 @@
 #include "RigidBody.h"
 #include "Scene.h"
 #include "Terrain.h"
+#include "WorkQueue.h"
 
 #include <BulletCollision/CollisionShapes/btBoxShape.h>
 #include <BulletCollision/CollisionShapes/btCapsuleShape.h>
@@ -75,12 +79,80 @@ static const char* typeNames[] =
 
 extern const char* PHYSICS_CATEGORY;
 
+/// Collision geometry cache file version.
+static const unsigned COLLISION_CACHE_VERSION = 2;
+
+/// Vertex position key for welding identical triangle mesh vertices.
+struct VertexKey
+{
+    /// Construct undefined.
+    VertexKey()
+    {
+    }
+    
+    /// Construct from a position. Adding zero turns a negative zero coordinate into positive zero, so that both hash the same.
+    VertexKey(const Vector3& position) :
+        position_(position + Vector3::ZERO)
+    {
+    }
+    
+    /// Test for equality.
+    bool operator == (const VertexKey& rhs) const { return position_ == rhs.position_; }
+    /// Return hash value for HashMap.
+    unsigned ToHash() const
+    {
+        const unsigned* data = reinterpret_cast<const unsigned*>(position_.Data());
+        return (data[0] * 31 + data[1]) * 31 + data[2];
+    }
+    
+    /// Position.
+    Vector3 position_;
+};
+
+/// Return the pointer size and byte order of this platform, which Bullet's in-place bounding volume hierarchy depends on.
+static unsigned GetPlatformTag()
+{
+    const unsigned one = 1;
+    bool bigEndian = *reinterpret_cast<const unsigned char*>(&one) == 0;
+    return sizeof(void*) | (bigEndian ? 0x100 : 0);
+}
+
+static unsigned CalculateChecksum(const PODVector<Vector3>& vertices)
+{
+    unsigned checksum = 0;
+    unsigned size = vertices.Size() * sizeof(Vector3);
+    if (size)
+    {
+        const unsigned char* data = (const unsigned char*)&vertices[0];
+        for (unsigned i = 0; i < size; ++i)
+            checksum = SDBMHash(checksum, data[i]);
+    }
+    return checksum;
+}
+
+void BuildCollisionGeometryWork(const WorkItem* item, unsigned threadIndex)
+{
+    CollisionGeometryData* geometry = reinterpret_cast<CollisionGeometryData*>(item->aux_);
+    geometry->Build();
+    // Must be the last access, as the main thread may free the data after this
+    geometry->built_ = true;
+}
+
+CollisionGeometryData::CollisionGeometryData() :
+    sourceVertexCount_(0),
+    checksum_(0),
+    built_(true),
+    savePending_(false)
+{
+}
+
 TriangleMeshData::TriangleMeshData(Model* model, unsigned lodLevel) :
     meshData_(0),
-    shape_(0)
+    shape_(0),
+    bvhData_(0)
 {
-    modelName_ = model->GetName();
-    meshData_ = new btTriangleMesh();
+    model_ = model;
+    built_ = false;
     
     unsigned numGeometries = model->GetNumGeometries();
     
@@ -119,7 +191,9 @@ TriangleMeshData::TriangleMeshData(Model* model, unsigned lodLevel) :
                 const Vector3& v0 = *((const Vector3*)(&vertexData[indices[j] * vertexSize]));
                 const Vector3& v1 = *((const Vector3*)(&vertexData[indices[j + 1] * vertexSize]));
                 const Vector3& v2 = *((const Vector3*)(&vertexData[indices[j + 2] * vertexSize]));
-                meshData_->addTriangle(ToBtVector3(v0), ToBtVector3(v1), ToBtVector3(v2), true);
+                sourceVertices_.Push(v0);
+                sourceVertices_.Push(v1);
+                sourceVertices_.Push(v2);
             }
         }
         // 32-bit indices
@@ -132,12 +206,15 @@ TriangleMeshData::TriangleMeshData(Model* model, unsigned lodLevel) :
                 const Vector3& v0 = *((const Vector3*)(&vertexData[indices[j] * vertexSize]));
                 const Vector3& v1 = *((const Vector3*)(&vertexData[indices[j + 1] * vertexSize]));
                 const Vector3& v2 = *((const Vector3*)(&vertexData[indices[j + 2] * vertexSize]));
-                meshData_->addTriangle(ToBtVector3(v0), ToBtVector3(v1), ToBtVector3(v2), true);
+                sourceVertices_.Push(v0);
+                sourceVertices_.Push(v1);
+                sourceVertices_.Push(v2);
             }
         }
     }
     
-    shape_ = new btBvhTriangleMeshShape(meshData_, true, true);
+    sourceVertexCount_ = sourceVertices_.Size();
+    checksum_ = CalculateChecksum(sourceVertices_);
 }
 
 TriangleMeshData::~TriangleMeshData()
@@ -145,15 +222,141 @@ TriangleMeshData::~TriangleMeshData()
     delete shape_;
     shape_ = 0;
     
+    // A loaded hierarchy lives in its own buffer and is not owned by the shape
+    if (bvhData_)
+    {
+        reinterpret_cast<btOptimizedBvh*>(bvhData_)->~btOptimizedBvh();
+        btAlignedFree(bvhData_);
+        bvhData_ = 0;
+    }
+    
     delete meshData_;
     meshData_ = 0;
 }
 
-ConvexData::ConvexData(Model* model, unsigned lodLevel)
+void TriangleMeshData::Build()
 {
-    modelName_ = model->GetName();
+    // Weld identical vertices using a hash map. Welding in btTriangleMesh::addTriangle() compares each new vertex against
+    // all added vertices, which is quadratic
+    meshData_ = new btTriangleMesh();
+    HashMap<VertexKey, int> vertexIndices;
+    unsigned numTriangles = sourceVertices_.Size() / 3;
+    for (unsigned i = 0; i < numTriangles * 3; ++i)
+    {
+        VertexKey key(sourceVertices_[i]);
+        HashMap<VertexKey, int>::ConstIterator j = vertexIndices.Find(key);
+        int index;
+        if (j != vertexIndices.End())
+            index = j->second_;
+        else
+        {
+            index = meshData_->findOrAddVertex(ToBtVector3(sourceVertices_[i]), false);
+            vertexIndices[key] = index;
+        }
+        meshData_->addIndex(index);
+    }
+    meshData_->getIndexedMeshArray()[0].m_numTriangles = numTriangles;
+    
+    shape_ = new btBvhTriangleMeshShape(meshData_, true, true);
+    sourceVertices_.Clear();
+}
+
+bool TriangleMeshData::Load(Deserializer& source)
+{
+    unsigned numVertices = source.ReadUInt();
+    unsigned numTriangles = source.ReadUInt();
+    unsigned remaining = source.GetSize() - source.GetPosition();
+    if (numVertices > remaining / sizeof(Vector3) || numTriangles > (remaining - numVertices * sizeof(Vector3)) / (3 *
+        sizeof(unsigned)))
+        return false;
+    
+    // The stored vertices are already welded, so add them directly
+    btTriangleMesh* meshData = new btTriangleMesh();
+    for (unsigned i = 0; i < numVertices; ++i)
+        meshData->findOrAddVertex(ToBtVector3(source.ReadVector3()), false);
+    for (unsigned i = 0; i < numTriangles * 3; ++i)
+    {
+        unsigned index = source.ReadUInt();
+        if (index >= numVertices)
+        {
+            delete meshData;
+            return false;
+        }
+        meshData->addIndex(index);
+    }
+    meshData->getIndexedMeshArray()[0].m_numTriangles = numTriangles;
+    
+    unsigned bvhSize = source.ReadUInt();
+    if (!bvhSize || bvhSize > source.GetSize() - source.GetPosition())
+    {
+        delete meshData;
+        return false;
+    }
+    
+    void* bvhData = btAlignedAlloc(bvhSize, 16);
+    btOptimizedBvh* bvh = 0;
+    if (source.Read(bvhData, bvhSize) == bvhSize)
+        bvh = btOptimizedBvh::deSerializeInPlace(bvhData, bvhSize, false);
+    if (!bvh)
+    {
+        btAlignedFree(bvhData);
+        delete meshData;
+        return false;
+    }
+    
+    meshData_ = meshData;
+    bvhData_ = bvhData;
+    shape_ = new btBvhTriangleMeshShape(meshData_, true, false);
+    shape_->setOptimizedBvh(bvh);
+    sourceVertices_.Clear();
+    return true;
+}
+
+void TriangleMeshData::Save(Serializer& dest) const
+{
+    const unsigned char* vertexData;
+    const unsigned char* indexData;
+    int numVertices;
+    int numTriangles;
+    int vertexStride;
+    int indexStride;
+    PHY_ScalarType vertexType;
+    PHY_ScalarType indexType;
+    
+    meshData_->getLockedReadOnlyVertexIndexBase(&vertexData, numVertices, vertexType, vertexStride, &indexData, indexStride,
+        numTriangles, indexType);
+    
+    dest.WriteUInt(numVertices);
+    dest.WriteUInt(numTriangles);
+    for (int i = 0; i < numVertices; ++i)
+        dest.WriteVector3(*((const Vector3*)(&vertexData[i * vertexStride])));
+    for (int i = 0; i < numTriangles; ++i)
+    {
+        const unsigned* indices = (const unsigned*)(&indexData[i * indexStride]);
+        dest.WriteUInt(indices[0]);
+        dest.WriteUInt(indices[1]);
+        dest.WriteUInt(indices[2]);
+    }
+    
+    meshData_->unLockReadOnlyVertexBase(0);
+    
+    // Store the hierarchy in Bullet's in-place format, so that loading requires no rebuilding
+    btOptimizedBvh* bvh = shape_->getOptimizedBvh();
+    unsigned bvhSize = bvh->calculateSerializeBufferSize();
+    void* bvhData = btAlignedAlloc(bvhSize, 16);
+    bvh->serializeInPlace(bvhData, bvhSize, false);
+    dest.WriteUInt(bvhSize);
+    dest.Write(bvhData, bvhSize);
+    btAlignedFree(bvhData);
+}
+
+ConvexData::ConvexData(Model* model, unsigned lodLevel) :
+    vertexCount_(0),
+    indexCount_(0)
+{
+    model_ = model;
+    built_ = false;
     
-    PODVector<Vector3> vertices;
     unsigned numGeometries = model->GetNumGeometries();
     
     for (unsigned i = 0; i < numGeometries; ++i)
@@ -185,11 +388,12 @@ ConvexData::ConvexData(Model* model, unsigned lodLevel)
         for (unsigned j = 0; j < vertexCount; ++j)
         {
             const Vector3& v = *((const Vector3*)(&vertexData[(vertexStart + j) * vertexSize]));
-            vertices.Push(v);
+            sourceVertices_.Push(v);
         }
     }
     
-    BuildHull(vertices);
+    sourceVertexCount_ = sourceVertices_.Size();
+    checksum_ = CalculateChecksum(sourceVertices_);
 }
 
 ConvexData::ConvexData(CustomGeometry* custom)
@@ -233,6 +437,43 @@ ConvexData::ConvexData(CustomGeometry* custom)
     BuildHull(vertices);
 }
 
+void ConvexData::Build()
+{
+    BuildHull(sourceVertices_);
+    sourceVertices_.Clear();
+}
+
+bool ConvexData::Load(Deserializer& source)
+{
+    unsigned vertexCount = source.ReadUInt();
+    unsigned indexCount = source.ReadUInt();
+    unsigned remaining = source.GetSize() - source.GetPosition();
+    if (vertexCount > remaining / sizeof(Vector3) || indexCount > (remaining - vertexCount * sizeof(Vector3)) /
+        sizeof(unsigned))
+        return false;
+    
+    SharedArrayPtr<Vector3> vertexData(new Vector3[vertexCount]);
+    SharedArrayPtr<unsigned> indexData(new unsigned[indexCount]);
+    if (source.Read(vertexData.Get(), vertexCount * sizeof(Vector3)) != vertexCount * sizeof(Vector3) ||
+        source.Read(indexData.Get(), indexCount * sizeof(unsigned)) != indexCount * sizeof(unsigned))
+        return false;
+    
+    vertexData_ = vertexData;
+    indexData_ = indexData;
+    vertexCount_ = vertexCount;
+    indexCount_ = indexCount;
+    sourceVertices_.Clear();
+    return true;
+}
+
+void ConvexData::Save(Serializer& dest) const
+{
+    dest.WriteUInt(vertexCount_);
+    dest.WriteUInt(indexCount_);
+    dest.Write(vertexData_.Get(), vertexCount_ * sizeof(Vector3));
+    dest.Write(indexData_.Get(), indexCount_ * sizeof(unsigned));
+}
+
 void ConvexData::BuildHull(const PODVector<Vector3>& vertices)
 {
     if (vertices.Size())
@@ -268,8 +509,6 @@ void ConvexData::BuildHull(const PODVector<Vector3>& vertices)
     }
 }
 
-
-
 ConvexData::~ConvexData()
 {
 }
@@ -299,6 +538,59 @@ HeightfieldData::~HeightfieldData()
 {
 }
 
+OBJECTTYPESTATIC(CollisionGeometryCache);
+
+CollisionGeometryCache::CollisionGeometryCache(Context* context) :
+    Object(context)
+{
+    workQueue_ = GetSubsystem<WorkQueue>();
+}
+
+CollisionGeometryCache::~CollisionGeometryCache()
+{
+    // Wait for geometry still being built in worker threads, as the work items refer to the cached data. If the work
+    // queue has already been destroyed, its threads have stopped
+    if (workQueue_)
+    {
+        for (HashMap<String, SharedPtr<CollisionGeometryData> >::ConstIterator i = geometry_.Begin(); i != geometry_.End(); ++i)
+        {
+            if (!i->second_->built_)
+            {
+                workQueue_->Complete(GEOMETRY_BUILD_PRIORITY);
+                break;
+            }
+        }
+    }
+}
+
+void CollisionGeometryCache::SetGeometry(const String& key, CollisionGeometryData* geometry)
+{
+    // If stale data is being replaced while still being built, it must stay alive until the worker thread is done
+    HashMap<String, SharedPtr<CollisionGeometryData> >::Iterator i = geometry_.Find(key);
+    if (i != geometry_.End() && !i->second_->built_ && workQueue_)
+        workQueue_->Complete(GEOMETRY_BUILD_PRIORITY);
+    
+    geometry_[key] = geometry;
+}
+
+void CollisionGeometryCache::ReleaseUnusedGeometry()
+{
+    // Remove data whose only reference is the cache itself, once the model is no longer loaded. Data still being built
+    // in a worker thread must be kept alive until finished
+    for (HashMap<String, SharedPtr<CollisionGeometryData> >::Iterator i = geometry_.Begin(); i != geometry_.End();)
+    {
+        HashMap<String, SharedPtr<CollisionGeometryData> >::Iterator current = i++;
+        if (current->second_.Refs() == 1 && current->second_->built_ && current->second_->model_.Expired())
+            geometry_.Erase(current);
+    }
+}
+
+CollisionGeometryData* CollisionGeometryCache::GetGeometry(const String& key) const
+{
+    HashMap<String, SharedPtr<CollisionGeometryData> >::ConstIterator i = geometry_.Find(key);
+    return i != geometry_.End() ? i->second_.Get() : 0;
+}
+
 OBJECTTYPESTATIC(CollisionShape);
 
 CollisionShape::CollisionShape(Context* context) :
@@ -727,8 +1019,27 @@ void CollisionShape::ReleaseShape()
     
     geometry_.Reset();
     
-    if (physicsWorld_)
-        physicsWorld_->CleanupGeometryCache();
+    CollisionGeometryCache* geometryCache = GetSubsystem<CollisionGeometryCache>();
+    if (geometryCache)
+        geometryCache->ReleaseUnusedGeometry();
+}
+
+bool CollisionShape::UpdatePendingGeometry()
+{
+    // If the shape was changed meanwhile, it is no longer waiting for the geometry
+    if (shape_ || !geometry_ || (shapeType_ != SHAPE_TRIANGLEMESH && shapeType_ != SHAPE_CONVEXHULL))
+        return true;
+    if (!geometry_->built_)
+        return false;
+    
+    // Hold a reference so that the geometry is not removed from the cache while the shape is recreated
+    SharedPtr<CollisionGeometryData> geometry(geometry_);
+    if (geometry->savePending_)
+        SaveModelGeometry(geometry);
+    
+    UpdateShape();
+    NotifyRigidBody();
+    return true;
 }
 
 void CollisionShape::OnNodeSet(Node* node)
@@ -858,21 +1169,14 @@ void CollisionShape::UpdateShape()
             size_ = size_.Abs();
             if (model_)
             {
-                // Check the geometry cache
-                String id = "TriMesh_" + model_->GetName() + "_" + String(lodLevel_);
-                
-                HashMap<String, SharedPtr<CollisionGeometryData> >& cache = physicsWorld_->GetGeometryCache();
-                HashMap<String, SharedPtr<CollisionGeometryData> >::Iterator j = cache.Find(id);
-                if (j != cache.End())
-                    geometry_ = j->second_;
-                else
+                geometry_ = GetModelGeometry();
+                if (geometry_->built_)
                 {
-                    geometry_ = new TriangleMeshData(model_, lodLevel_);
-                    cache[id] = geometry_;
+                    TriangleMeshData* triMesh = static_cast<TriangleMeshData*>(geometry_.Get());
+                    shape_ = new btScaledBvhTriangleMeshShape(triMesh->shape_, ToBtVector3(newWorldScale * size_));
                 }
-                
-                TriangleMeshData* triMesh = static_cast<TriangleMeshData*>(geometry_.Get());
-                shape_ = new btScaledBvhTriangleMeshShape(triMesh->shape_, ToBtVector3(newWorldScale * size_));
+                else
+                    physicsWorld_->AddPendingCollisionShape(this);
             }
             break;
             
@@ -895,22 +1199,15 @@ void CollisionShape::UpdateShape()
             }
             else if (model_)
             {
-                // Check the geometry cache
-                String id = "Convex_" + model_->GetName() + "_" + String(lodLevel_);
-                
-                HashMap<String, SharedPtr<CollisionGeometryData> >& cache = physicsWorld_->GetGeometryCache();
-                HashMap<String, SharedPtr<CollisionGeometryData> >::Iterator j = cache.Find(id);
-                if (j != cache.End())
-                    geometry_ = j->second_;
-                else
+                geometry_ = GetModelGeometry();
+                if (geometry_->built_)
                 {
-                    geometry_ = new ConvexData(model_, lodLevel_);
-                    cache[id] = geometry_;
+                    ConvexData* convex = static_cast<ConvexData*>(geometry_.Get());
+                    shape_ = new btConvexHullShape((btScalar*)convex->vertexData_.Get(), convex->vertexCount_, sizeof(Vector3));
+                    shape_->setLocalScaling(ToBtVector3(newWorldScale * size_));
                 }
-                
-                ConvexData* convex = static_cast<ConvexData*>(geometry_.Get());
-                shape_ = new btConvexHullShape((btScalar*)convex->vertexData_.Get(), convex->vertexCount_, sizeof(Vector3));
-                shape_->setLocalScaling(ToBtVector3(newWorldScale * size_));
+                else
+                    physicsWorld_->AddPendingCollisionShape(this);
             }
             break;
             
@@ -945,12 +1242,102 @@ void CollisionShape::UpdateShape()
         cachedWorldScale_ = newWorldScale;
     }
     
-    if (physicsWorld_)
-        physicsWorld_->CleanupGeometryCache();
+    CollisionGeometryCache* geometryCache = GetSubsystem<CollisionGeometryCache>();
+    if (geometryCache)
+        geometryCache->ReleaseUnusedGeometry();
     
     recreateShape_ = false;
 }
 
+SharedPtr<CollisionGeometryData> CollisionShape::GetModelGeometry()
+{
+    bool triMesh = shapeType_ == SHAPE_TRIANGLEMESH;
+    
+    // Check the geometry cache shared by all physics worlds. Create it on first use
+    CollisionGeometryCache* cache = GetSubsystem<CollisionGeometryCache>();
+    if (!cache)
+        context_->RegisterSubsystem(cache = new CollisionGeometryCache(context_));
+    
+    // If the model has been reloaded as a new object, the cached data is stale
+    String id = (triMesh ? "TriMesh_" : "Convex_") + model_->GetName() + "_" + String(lodLevel_);
+    CollisionGeometryData* cached = cache->GetGeometry(id);
+    if (cached && cached->model_.Get() == model_.Get())
+        return SharedPtr<CollisionGeometryData>(cached);
+    
+    SharedPtr<CollisionGeometryData> geometry;
+    if (triMesh)
+        geometry = new TriangleMeshData(model_, lodLevel_);
+    else
+        geometry = new ConvexData(model_, lodLevel_);
+    cache->SetGeometry(id, geometry);
+    
+    // Check for data built on a previous run. The checksum of the source vertices is part of the file name
+    ResourceCache* resourceCache = GetSubsystem<ResourceCache>();
+    String key = (triMesh ? "TriMesh_" : "Convex_") + GetFileName(model_->GetName()) + "_" + String(lodLevel_);
+    SharedPtr<File> file = resourceCache->GetCacheFile(key, geometry->checksum_);
+    if (file)
+    {
+        PROFILE(LoadCachedCollisionGeometry);
+        
+        if (file->ReadFileID() == "UCOL" && file->ReadUInt() == COLLISION_CACHE_VERSION && file->ReadUInt() ==
+            GetPlatformTag() && file->ReadUInt() == geometry->sourceVertexCount_ && geometry->Load(*file))
+        {
+            geometry->built_ = true;
+            return geometry;
+        }
+        
+        LOGWARNING("Ignoring mismatching cached collision geometry for " + model_->GetName());
+    }
+    
+    if (!resourceCache->GetCacheDir().Empty())
+        geometry->savePending_ = true;
+    
+    // Build a triangle mesh in a worker thread if enabled. When there are no worker threads, the work queue would only
+    // execute the item on the next frame, so build immediately instead. Convex hulls are always built immediately, as
+    // the StanHull library uses global state
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (triMesh && physicsWorld_->GetBackgroundGeometryBuild() && queue && queue->GetNumThreads())
+    {
+        WorkItem item;
+        item.workFunction_ = BuildCollisionGeometryWork;
+        item.aux_ = geometry.Get();
+        // Use low priority so that frame-critical work is not delayed
+        item.priority_ = GEOMETRY_BUILD_PRIORITY;
+        queue->AddWorkItem(item);
+    }
+    else
+    {
+        PROFILE(BuildCollisionGeometry);
+        
+        geometry->Build();
+        geometry->built_ = true;
+        if (geometry->savePending_)
+            SaveModelGeometry(geometry);
+    }
+    
+    return geometry;
+}
+
+void CollisionShape::SaveModelGeometry(CollisionGeometryData* geometry)
+{
+    geometry->savePending_ = false;
+    
+    ResourceCache* resourceCache = GetSubsystem<ResourceCache>();
+    String key = (shapeType_ == SHAPE_TRIANGLEMESH ? "TriMesh_" : "Convex_") + GetFileName(model_->GetName()) + "_" +
+        String(lodLevel_);
+    SharedPtr<File> file = resourceCache->CreateCacheFile(key, geometry->checksum_);
+    if (!file)
+        return;
+    
+    PROFILE(StoreCachedCollisionGeometry);
+    
+    file->WriteFileID("UCOL");
+    file->WriteUInt(COLLISION_CACHE_VERSION);
+    file->WriteUInt(GetPlatformTag());
+    file->WriteUInt(geometry->sourceVertexCount_);
+    geometry->Save(*file);
+}
+
 void CollisionShape::HandleTerrainCreated(StringHash eventType, VariantMap& eventData)
 {
     if (shapeType_ == SHAPE_TERRAIN)
@@ -36,11 +36,14 @@ namespace Urho3D
 {
 
 class CustomGeometry;
+class Deserializer;
 class Geometry;
 class Model;
 class PhysicsWorld;
 class RigidBody;
+class Serializer;
 class Terrain;
+class WorkQueue;
 
 /// Collision shape type.
 enum ShapeType
@@ -56,37 +59,75 @@ enum ShapeType
     SHAPE_TERRAIN
 };
 
+/// Work priority for building collision geometry in a worker thread. Distinct from the default low priority 0, so that waiting for the geometry does not wait for other low-priority work.
+static const unsigned GEOMETRY_BUILD_PRIORITY = 1;
+
 /// Base class for collision shape geometry data.
 struct CollisionGeometryData : public RefCounted
 {
-    /// Original model name
-    String modelName_;
+    /// Construct.
+    CollisionGeometryData();
+    
+    /// Build from the source vertices. May be called from a worker thread.
+    virtual void Build() {}
+    /// Load built data from the resource cache directory. Return true if successful.
+    virtual bool Load(Deserializer& source) { return false; }
+    /// Save built data to the resource cache directory.
+    virtual void Save(Serializer& dest) const {}
+    
+    /// Source model. Cached data is released once no collision shape uses it and the model has been released.
+    WeakPtr<Model> model_;
+    /// Source vertices, kept until built.
+    PODVector<Vector3> sourceVertices_;
+    /// Number of source vertices.
+    unsigned sourceVertexCount_;
+    /// Checksum of the source vertices.
+    unsigned checksum_;
+    /// Built flag. Set by a worker thread when building in the background.
+    volatile bool built_;
+    /// Save to the resource cache directory pending flag.
+    bool savePending_;
 };
 
 /// Triangle mesh geometry data.
 struct TriangleMeshData : public CollisionGeometryData
 {
-    /// Construct from a model.
+    /// Construct from a model. The triangles are copied, but the mesh is not built until Build() or Load() is called.
     TriangleMeshData(Model* model, unsigned lodLevel);
     /// Destruct. Free geometry data.
     ~TriangleMeshData();
     
+    /// Build the triangle mesh and its bounding volume hierarchy.
+    virtual void Build();
+    /// Load the triangle mesh and its bounding volume hierarchy. Return true if successful.
+    virtual bool Load(Deserializer& source);
+    /// Save the triangle mesh and its bounding volume hierarchy.
+    virtual void Save(Serializer& dest) const;
+    
     /// Bullet triangle mesh data.
     btTriangleMesh* meshData_;
     /// Bullet triangle mesh collision shape.
     btBvhTriangleMeshShape* shape_;
+    /// Loaded bounding volume hierarchy. Null if built instead.
+    void* bvhData_;
 };
 
 /// Convex hull geometry data.
 struct ConvexData : public CollisionGeometryData
 {
-    /// Construct from a model.
+    /// Construct from a model. The vertices are copied, but the hull is not built until Build() or Load() is called.
     ConvexData(Model* model, unsigned lodLevel);
     /// Construct from a custom geometry.
     ConvexData(CustomGeometry* custom);
     /// Destruct. Free geometry data.
     ~ConvexData();
     
+    /// Build the convex hull from the source vertices.
+    virtual void Build();
+    /// Load the convex hull. Return true if successful.
+    virtual bool Load(Deserializer& source);
+    /// Save the convex hull.
+    virtual void Save(Serializer& dest) const;
     /// Build the convex hull from vertices.
     void BuildHull(const PODVector<Vector3>& vertices);
     
@@ -120,6 +161,32 @@ struct HeightfieldData : public CollisionGeometryData
     float maxHeight_;
 };
 
+/// %Collision geometry cache subsystem. Shares triangle mesh and convex hull data between all physics worlds by model and LOD level.
+class CollisionGeometryCache : public Object
+{
+    OBJECT(CollisionGeometryCache);
+    
+public:
+    /// Construct.
+    CollisionGeometryCache(Context* context);
+    /// Destruct. Wait for geometry still being built in worker threads.
+    virtual ~CollisionGeometryCache();
+    
+    /// Store geometry data.
+    void SetGeometry(const String& key, CollisionGeometryData* geometry);
+    /// Release geometry data that is not used by any collision shape and whose model has been released.
+    void ReleaseUnusedGeometry();
+    
+    /// Return geometry data, or null if not cached.
+    CollisionGeometryData* GetGeometry(const String& key) const;
+    
+private:
+    /// Geometry data by shape type, model name and LOD level.
+    HashMap<String, SharedPtr<CollisionGeometryData> > geometry_;
+    /// Work queue used for building geometry in the background.
+    WeakPtr<WorkQueue> workQueue_;
+};
+
 /// Physics collision shape component.
 class CollisionShape : public Component
 {
@@ -208,6 +275,8 @@ public:
     ResourceRef GetModelAttr() const;
     /// Release the collision shape.
     void ReleaseShape();
+    /// Create the collision shape if its geometry has finished building in the background. Return true if no longer waiting. Called by PhysicsWorld.
+    bool UpdatePendingGeometry();
     
 protected:
     /// Handle node being assigned.
@@ -220,6 +289,10 @@ private:
     btCompoundShape* GetParentCompoundShape();
     /// Update the collision shape after attribute changes.
     void UpdateShape();
+    /// Return triangle mesh or convex hull geometry data for the model from the geometry cache or the resource cache directory, or start building it.
+    SharedPtr<CollisionGeometryData> GetModelGeometry();
+    /// Save built model geometry data to the resource cache directory.
+    void SaveModelGeometry(CollisionGeometryData* geometry);
     /// Update terrain collision shape from the terrain component.
     void HandleTerrainCreated(StringHash eventType, VariantMap& eventData);
     
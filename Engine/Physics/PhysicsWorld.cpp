@@ -36,10 +36,13 @@
 #include "Scene.h"
 #include "SceneEvents.h"
 #include "Sort.h"
+#include "WorkQueue.h"
 
 #include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
 #include <BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h>
+#include <BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
 #include <BulletCollision/CollisionShapes/btBoxShape.h>
+#include <BulletCollision/CollisionShapes/btCompoundShape.h>
 #include <BulletCollision/CollisionShapes/btSphereShape.h>
 #include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h>
 #include <BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
@@ -52,12 +55,19 @@ extern const char* SUBSYSTEM_CATEGORY;
 
 static const int DEFAULT_FPS = 60;
 static const Vector3 DEFAULT_GRAVITY = Vector3(0.0f, -9.81f, 0.0f);
+static const unsigned PAIRS_PER_WORK_ITEM = 64;
+static const unsigned QUERIES_PER_WORK_ITEM = 16;
 
 static bool CompareRaycastResults(const PhysicsRaycastResult& lhs, const PhysicsRaycastResult& rhs)
 {
     return lhs.distance_ < rhs.distance_;
 }
 
+static bool CompareDelayedWorldTransforms(const DelayedWorldTransform& lhs, const DelayedWorldTransform& rhs)
+{
+    return lhs.depth_ < rhs.depth_;
+}
+
 void InternalPreTickCallback(btDynamicsWorld *world, btScalar timeStep)
 {
     static_cast<PhysicsWorld*>(world->getWorldUserInfo())->PreStep(timeStep);
@@ -92,6 +102,642 @@ struct PhysicsQueryCallback : public btCollisionWorld::ContactResultCallback
     PODVector<RigidBody*>& result_;
 };
 
+/// Overlapping pair queued for threaded collision detection.
+struct ThreadedPair
+{
+    /// Group of pairs connected through shared collision objects. Pairs of the same group must be processed in the same thread.
+    unsigned group_;
+    /// Broadphase pair.
+    btBroadphasePair* pair_;
+};
+
+static bool CompareThreadedPairs(const ThreadedPair& lhs, const ThreadedPair& rhs)
+{
+    return lhs.group_ < rhs.group_;
+}
+
+/// Collision dispatcher that processes independent overlapping pairs in worker threads.
+class ThreadedCollisionDispatcher : public btCollisionDispatcher
+{
+public:
+    /// Construct.
+    ThreadedCollisionDispatcher(btCollisionConfiguration* configuration) :
+        btCollisionDispatcher(configuration),
+        workQueue_(0),
+        dispatchInfo_(0),
+        threaded_(false)
+    {
+    }
+
+    /// Create a contact manifold.
+    virtual btPersistentManifold* getNewManifold(void* body0, void* body1)
+    {
+        if (!threaded_)
+            return btCollisionDispatcher::getNewManifold(body0, body1);
+
+        MutexLock lock(mutex_);
+        return btCollisionDispatcher::getNewManifold(body0, body1);
+    }
+
+    /// Release a contact manifold.
+    virtual void releaseManifold(btPersistentManifold* manifold)
+    {
+        if (!threaded_)
+        {
+            btCollisionDispatcher::releaseManifold(manifold);
+            return;
+        }
+
+        MutexLock lock(mutex_);
+        btCollisionDispatcher::releaseManifold(manifold);
+    }
+
+    /// Allocate memory for a collision algorithm.
+    virtual void* allocateCollisionAlgorithm(int size)
+    {
+        if (!threaded_)
+            return btCollisionDispatcher::allocateCollisionAlgorithm(size);
+
+        MutexLock lock(mutex_);
+        return btCollisionDispatcher::allocateCollisionAlgorithm(size);
+    }
+
+    /// Free memory of a collision algorithm.
+    virtual void freeCollisionAlgorithm(void* ptr)
+    {
+        if (!threaded_)
+        {
+            btCollisionDispatcher::freeCollisionAlgorithm(ptr);
+            return;
+        }
+
+        MutexLock lock(mutex_);
+        btCollisionDispatcher::freeCollisionAlgorithm(ptr);
+    }
+
+    /// Run collision detection for all overlapping pairs.
+    virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher* dispatcher);
+
+    /// Work queue to use, or null to process in the main thread.
+    WorkQueue* workQueue_;
+    /// Dispatch info of the current collision detection.
+    const btDispatcherInfo* dispatchInfo_;
+
+private:
+    /// Group pairs connected through shared collision objects and process them in worker threads. Wait for completion.
+    void DispatchPairs(PODVector<ThreadedPair>& pairs);
+    /// Return a temporary index for a collision object.
+    unsigned GetObjectIndex(btCollisionObject* object)
+    {
+        // Use the companion ID to store the index, it is not used during collision detection
+        int index = object->getCompanionId();
+        if (index < 0)
+        {
+            index = objects_.Size();
+            object->setCompanionId(index);
+            objects_.Push(object);
+            groups_.Push(index);
+        }
+        return index;
+    }
+
+    /// Return the group of a collision object index.
+    unsigned FindGroup(unsigned index)
+    {
+        while (groups_[index] != index)
+        {
+            groups_[index] = groups_[groups_[index]];
+            index = groups_[index];
+        }
+        return index;
+    }
+
+    /// Pairs involving static or kinematic objects.
+    PODVector<ThreadedPair> staticPairs_;
+    /// Pairs between dynamic objects.
+    PODVector<ThreadedPair> dynamicPairs_;
+    /// Collision objects indexed during grouping.
+    PODVector<btCollisionObject*> objects_;
+    /// Union-find parent indices of the collision objects.
+    PODVector<unsigned> groups_;
+    /// Mutex for manifold and collision algorithm allocation.
+    Mutex mutex_;
+    /// Worker threads running flag.
+    bool threaded_;
+};
+
+void DispatchPairsWork(const WorkItem* item, unsigned threadIndex)
+{
+    ThreadedCollisionDispatcher* dispatcher = reinterpret_cast<ThreadedCollisionDispatcher*>(item->aux_);
+    ThreadedPair* start = reinterpret_cast<ThreadedPair*>(item->start_);
+    ThreadedPair* end = reinterpret_cast<ThreadedPair*>(item->end_);
+    btNearCallback nearCallback = dispatcher->getNearCallback();
+
+    while (start != end)
+    {
+        nearCallback(*start->pair_, *dispatcher, *dispatcher->dispatchInfo_);
+        ++start;
+    }
+}
+
+void ThreadedCollisionDispatcher::dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo,
+    btDispatcher* dispatcher)
+{
+    if (!workQueue_ || !workQueue_->GetNumThreads() || dispatchInfo.m_dispatchFunc != btDispatcherInfo::DISPATCH_DISCRETE)
+    {
+        btCollisionDispatcher::dispatchAllCollisionPairs(pairCache, dispatchInfo, dispatcher);
+        return;
+    }
+
+    btBroadphasePair* pairs = pairCache->getOverlappingPairArrayPtr();
+    int numPairs = pairCache->getNumOverlappingPairs();
+
+    staticPairs_.Clear();
+    dynamicPairs_.Clear();
+
+    for (int i = 0; i < numPairs; ++i)
+    {
+        btBroadphasePair& pair = pairs[i];
+        btCollisionObject* object0 = static_cast<btCollisionObject*>(pair.m_pProxy0->m_clientObject);
+        btCollisionObject* object1 = static_cast<btCollisionObject*>(pair.m_pProxy1->m_clientObject);
+        if (!needsCollision(object0, object1))
+            continue;
+
+        // Create the collision algorithms in the main thread, as their construction may modify both collision objects
+        if (!pair.m_algorithm)
+            pair.m_algorithm = findAlgorithm(object0, object1);
+        if (!pair.m_algorithm)
+            continue;
+
+        ThreadedPair threadedPair;
+        threadedPair.group_ = 0;
+        threadedPair.pair_ = &pair;
+        if (object0->isStaticOrKinematicObject() || object1->isStaticOrKinematicObject())
+            staticPairs_.Push(threadedPair);
+        else
+            dynamicPairs_.Push(threadedPair);
+    }
+
+    // Pairs involving static or kinematic objects are processed first, then the pairs between dynamic objects, as before
+    // threading. Each set is grouped separately, so that a static object overlapping many dynamic objects (for example
+    // the ground) does not join all the dynamic pairs into one group
+    dispatchInfo_ = &dispatchInfo;
+    threaded_ = true;
+
+    DispatchPairs(staticPairs_);
+    DispatchPairs(dynamicPairs_);
+
+    threaded_ = false;
+    dispatchInfo_ = 0;
+}
+
+void ThreadedCollisionDispatcher::DispatchPairs(PODVector<ThreadedPair>& pairs)
+{
+    if (pairs.Empty())
+        return;
+
+    // Every rigid body has a compound shape, and Bullet 2.80 collision detection temporarily replaces the shape and
+    // transform of both objects of a pair with those of each child shape, including static objects. Therefore pairs
+    // sharing any object, static or not, can not be processed concurrently. Group them by connected objects
+    objects_.Clear();
+    groups_.Clear();
+
+    for (PODVector<ThreadedPair>::Iterator i = pairs.Begin(); i != pairs.End(); ++i)
+    {
+        btCollisionObject* object0 = static_cast<btCollisionObject*>(i->pair_->m_pProxy0->m_clientObject);
+        btCollisionObject* object1 = static_cast<btCollisionObject*>(i->pair_->m_pProxy1->m_clientObject);
+        unsigned group0 = FindGroup(GetObjectIndex(object0));
+        unsigned group1 = FindGroup(GetObjectIndex(object1));
+        if (group0 != group1)
+            groups_[group1] = group0;
+        i->group_ = group0;
+    }
+
+    for (PODVector<ThreadedPair>::Iterator i = pairs.Begin(); i != pairs.End(); ++i)
+        i->group_ = FindGroup(i->group_);
+    for (PODVector<btCollisionObject*>::Iterator i = objects_.Begin(); i != objects_.End(); ++i)
+        (*i)->setCompanionId(-1);
+
+    Sort(pairs.Begin(), pairs.End(), CompareThreadedPairs);
+
+    WorkItem item;
+    item.workFunction_ = DispatchPairsWork;
+    item.aux_ = this;
+
+    PODVector<ThreadedPair>::Iterator start = pairs.Begin();
+    while (start != pairs.End())
+    {
+        PODVector<ThreadedPair>::Iterator end = pairs.End();
+        if ((unsigned)(end - start) > PAIRS_PER_WORK_ITEM)
+        {
+            end = start + PAIRS_PER_WORK_ITEM;
+            // Do not split a group between work items
+            while (end != pairs.End() && end->group_ == (end - 1)->group_)
+                ++end;
+        }
+
+        item.start_ = &(*start);
+        item.end_ = &(*end);
+        workQueue_->AddWorkItem(item);
+
+        start = end;
+    }
+
+    workQueue_->Complete(M_MAX_UNSIGNED);
+}
+
+/// Simulation island gathered for threaded constraint solving. Islands are stored consecutively, so the next island marks the end of the previous.
+struct SolverIsland
+{
+    /// Index of the first body.
+    unsigned bodyStart_;
+    /// Index of the first contact manifold.
+    unsigned manifoldStart_;
+    /// Index of the first constraint.
+    unsigned constraintStart_;
+};
+
+static int GetConstraintIslandId(const btTypedConstraint* constraint)
+{
+    const btCollisionObject& bodyA = constraint->getRigidBodyA();
+    const btCollisionObject& bodyB = constraint->getRigidBodyB();
+    return bodyA.getIslandTag() >= 0 ? bodyA.getIslandTag() : bodyB.getIslandTag();
+}
+
+/// Constraint sort predicate. Matches the ordering Bullet uses when solving in a single thread.
+struct ConstraintIslandPredicate
+{
+    /// Compare constraints by island.
+    bool operator () (const btTypedConstraint* lhs, const btTypedConstraint* rhs) const
+    {
+        return GetConstraintIslandId(lhs) < GetConstraintIslandId(rhs);
+    }
+};
+
+/// Bullet dynamics world that solves independent simulation islands in worker threads.
+class ThreadedDynamicsWorld : public btDiscreteDynamicsWorld, public btSimulationIslandManager::IslandCallback
+{
+public:
+    /// Construct.
+    ThreadedDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* broadphase, btConstraintSolver* solver,
+        btCollisionConfiguration* configuration) :
+        btDiscreteDynamicsWorld(dispatcher, broadphase, solver, configuration),
+        workQueue_(0),
+        solverInfo_(0),
+        constraintIndex_(0)
+    {
+    }
+
+    /// Destruct.
+    virtual ~ThreadedDynamicsWorld()
+    {
+        for (unsigned i = 0; i < solvers_.Size(); ++i)
+            delete solvers_[i];
+    }
+
+    /// Gather a simulation island for solving.
+    virtual void processIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId)
+    {
+        SolverIsland island;
+        island.bodyStart_ = bodies_.Size();
+        island.manifoldStart_ = manifolds_.Size();
+        island.constraintStart_ = constraints_.Size();
+        islands_.Push(island);
+
+        bodies_.Insert(bodies_.End(), bodies, bodies + numBodies);
+        if (numManifolds)
+            manifolds_.Insert(manifolds_.End(), manifolds, manifolds + numManifolds);
+
+        // Both the islands and the sorted constraints are in ascending island order
+        unsigned numConstraints = m_sortedConstraints.size();
+        while (constraintIndex_ < numConstraints && GetConstraintIslandId(m_sortedConstraints[constraintIndex_]) < islandId)
+            ++constraintIndex_;
+        while (constraintIndex_ < numConstraints && GetConstraintIslandId(m_sortedConstraints[constraintIndex_]) == islandId)
+            constraints_.Push(m_sortedConstraints[constraintIndex_++]);
+    }
+
+    /// Work queue to use, or null to solve in the main thread.
+    WorkQueue* workQueue_;
+    /// Constraint solvers for each thread.
+    PODVector<btSequentialImpulseConstraintSolver*> solvers_;
+    /// Bodies of the gathered islands.
+    PODVector<btCollisionObject*> bodies_;
+    /// Contact manifolds of the gathered islands.
+    PODVector<btPersistentManifold*> manifolds_;
+    /// Constraints of the gathered islands.
+    PODVector<btTypedConstraint*> constraints_;
+    /// Gathered islands, followed by an end marker.
+    PODVector<SolverIsland> islands_;
+    /// Solver parameters of the current step.
+    const btContactSolverInfo* solverInfo_;
+
+protected:
+    /// Solve contacts and constraints.
+    virtual void solveConstraints(btContactSolverInfo& solverInfo);
+
+private:
+    /// Current index into the sorted constraints while gathering islands.
+    unsigned constraintIndex_;
+};
+
+void SolveIslandsWork(const WorkItem* item, unsigned threadIndex)
+{
+    ThreadedDynamicsWorld* world = reinterpret_cast<ThreadedDynamicsWorld*>(item->aux_);
+    const SolverIsland* start = reinterpret_cast<SolverIsland*>(item->start_);
+    const SolverIsland* end = reinterpret_cast<SolverIsland*>(item->end_);
+    unsigned numManifolds = end->manifoldStart_ - start->manifoldStart_;
+    unsigned numConstraints = end->constraintStart_ - start->constraintStart_;
+
+    // Islands do not share dynamic bodies, so each thread can solve its islands independently with its own solver.
+    // The debug drawer and stack allocator are not thread-safe, and not used by the sequential impulse solver
+    if (numManifolds + numConstraints)
+    {
+        world->solvers_[threadIndex]->solveGroup(&world->bodies_[start->bodyStart_], end->bodyStart_ - start->bodyStart_,
+            numManifolds ? &world->manifolds_[start->manifoldStart_] : 0, numManifolds,
+            numConstraints ? &world->constraints_[start->constraintStart_] : 0, numConstraints, *world->solverInfo_, 0, 0,
+            world->getDispatcher());
+    }
+}
+
+void ThreadedDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
+{
+    if (!workQueue_ || !workQueue_->GetNumThreads() || !m_islandManager->getSplitIslands())
+    {
+        btDiscreteDynamicsWorld::solveConstraints(solverInfo);
+        return;
+    }
+
+    unsigned numThreads = workQueue_->GetNumThreads() + 1;
+    while (solvers_.Size() < numThreads)
+        solvers_.Push(new btSequentialImpulseConstraintSolver());
+
+    m_sortedConstraints.resize(m_constraints.size());
+    for (int i = 0; i < m_constraints.size(); ++i)
+        m_sortedConstraints[i] = m_constraints[i];
+    m_sortedConstraints.quickSort(ConstraintIslandPredicate());
+
+    bodies_.Clear();
+    manifolds_.Clear();
+    constraints_.Clear();
+    islands_.Clear();
+    constraintIndex_ = 0;
+    m_islandManager->buildAndProcessIslands(getDispatcher(), this, this);
+    if (islands_.Empty())
+        return;
+
+    // Add end marker
+    SolverIsland endIsland;
+    endIsland.bodyStart_ = bodies_.Size();
+    endIsland.manifoldStart_ = manifolds_.Size();
+    endIsland.constraintStart_ = constraints_.Size();
+    islands_.Push(endIsland);
+
+    solverInfo_ = &solverInfo;
+
+    // Batch small islands together like Bullet does in single-threaded solving. Solving islands separately or together gives
+    // the same result, so the result does not depend on the number of threads
+    WorkItem item;
+    item.workFunction_ = SolveIslandsWork;
+    item.aux_ = this;
+
+    unsigned batchSize = Max(solverInfo.m_minimumSolverBatchSize, 1);
+    unsigned start = 0;
+    while (start < islands_.Size() - 1)
+    {
+        unsigned end = start + 1;
+        while (end < islands_.Size() - 1 && islands_[end].manifoldStart_ - islands_[start].manifoldStart_ +
+            islands_[end].constraintStart_ - islands_[start].constraintStart_ < batchSize)
+            ++end;
+
+        item.start_ = &islands_[start];
+        item.end_ = &islands_[end];
+        workQueue_->AddWorkItem(item);
+
+        start = end;
+    }
+
+    workQueue_->Complete(M_MAX_UNSIGNED);
+    solverInfo_ = 0;
+}
+
+/// Batched raycast or sphere cast parameters.
+struct BatchQuery
+{
+    /// Physics world.
+    PhysicsWorld* world_;
+    /// First ray of the batch.
+    const Ray* rays_;
+    /// First result of the batch.
+    PhysicsRaycastResult* results_;
+    /// Sphere radius, or zero for raycasts.
+    float radius_;
+    /// Maximum distance.
+    float maxDistance_;
+    /// Collision mask.
+    unsigned collisionMask_;
+};
+
+/// Closest hit raycast test against a single collision object.
+struct BatchRayTest
+{
+    /// Construct.
+    BatchRayTest(const btVector3& from, const btVector3& to, unsigned collisionMask) :
+        callback_(from, to),
+        from_(btQuaternion::getIdentity(), from),
+        to_(btQuaternion::getIdentity(), to),
+        extent_(0.0f, 0.0f, 0.0f)
+    {
+        callback_.m_collisionFilterGroup = (short)0xffff;
+        callback_.m_collisionFilterMask = collisionMask;
+    }
+
+    /// Test a (non-compound) collision shape.
+    void Test(btCollisionObject* object, const btCollisionShape* shape, const btTransform& transform)
+    {
+        btCollisionWorld::rayTestSingle(from_, to_, object, shape, transform, callback_);
+    }
+
+    /// Result callback.
+    btCollisionWorld::ClosestRayResultCallback callback_;
+    /// Ray start transform.
+    btTransform from_;
+    /// Ray end transform.
+    btTransform to_;
+    /// Extent to add to bounding boxes.
+    btVector3 extent_;
+};
+
+/// Closest hit swept sphere test against a single collision object.
+struct BatchSphereTest
+{
+    /// Construct.
+    BatchSphereTest(const btVector3& from, const btVector3& to, float radius, unsigned collisionMask) :
+        callback_(from, to),
+        shape_(radius),
+        from_(btQuaternion::getIdentity(), from),
+        to_(btQuaternion::getIdentity(), to)
+    {
+        callback_.m_collisionFilterGroup = (short)0xffff;
+        callback_.m_collisionFilterMask = collisionMask;
+
+        btVector3 extentMin;
+        shape_.getAabb(btTransform::getIdentity(), extentMin, extent_);
+    }
+
+    /// Test a (non-compound) collision shape.
+    void Test(btCollisionObject* object, const btCollisionShape* shape, const btTransform& transform)
+    {
+        btCollisionWorld::objectQuerySingle(&shape_, from_, to_, object, shape, transform, callback_, 0.0f);
+    }
+
+    /// Result callback.
+    btCollisionWorld::ClosestConvexResultCallback callback_;
+    /// Swept sphere shape.
+    btSphereShape shape_;
+    /// Sweep start transform.
+    btTransform from_;
+    /// Sweep end transform.
+    btTransform to_;
+    /// Extent to add to bounding boxes.
+    btVector3 extent_;
+};
+
+template <class T> void BatchTestShape(T& test, btCollisionObject* object, const btCollisionShape* shape, const btTransform& transform)
+{
+    // Test compound children directly: Bullet would temporarily replace the collision object's shape, which is not
+    // safe when several threads are querying the same object
+    if (shape->isCompound())
+    {
+        const btCompoundShape* compound = static_cast<const btCompoundShape*>(shape);
+        btVector3 localFrom = transform.invXform(test.from_.getOrigin());
+        btVector3 localTo = transform.invXform(test.to_.getOrigin());
+
+        for (int i = 0; i < compound->getNumChildShapes(); ++i)
+        {
+            const btCollisionShape* childShape = compound->getChildShape(i);
+            const btTransform& childTransform = compound->getChildTransform(i);
+
+            // Cull the child by its local bounding box first, like Bullet does through the compound shape's AABB tree
+            btVector3 aabbMin, aabbMax, normal;
+            btScalar hitFraction = test.callback_.m_closestHitFraction;
+            childShape->getAabb(childTransform, aabbMin, aabbMax);
+            if (btRayAabb(localFrom, localTo, aabbMin - test.extent_, aabbMax + test.extent_, hitFraction, normal))
+                BatchTestShape(test, object, childShape, transform * childTransform);
+        }
+    }
+    else
+        test.Test(object, shape, transform);
+}
+
+template <class T> void BatchTestBroadphase(T& test, btDbvtBroadphase* broadphase, PODVector<const btDbvtNode*>& stack)
+{
+    // Traverse the broadphase trees using a caller-owned stack, as btDbvt::rayTestInternal uses a shared stack and is not
+    // thread-safe
+    const btVector3& from = test.from_.getOrigin();
+    btVector3 direction = test.to_.getOrigin() - from;
+    btScalar length = direction.length();
+    if (length <= 0.0f)
+        return;
+    direction /= length;
+
+    btVector3 inverseDirection(
+        direction[0] == 0.0f ? BT_LARGE_FLOAT : 1.0f / direction[0],
+        direction[1] == 0.0f ? BT_LARGE_FLOAT : 1.0f / direction[1],
+        direction[2] == 0.0f ? BT_LARGE_FLOAT : 1.0f / direction[2]
+    );
+    unsigned signs[3] = { inverseDirection[0] < 0.0f, inverseDirection[1] < 0.0f, inverseDirection[2] < 0.0f };
+
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        if (!broadphase->m_sets[i].m_root)
+            continue;
+
+        stack.Clear();
+        stack.Push(broadphase->m_sets[i].m_root);
+        while (stack.Size())
+        {
+            if (test.callback_.m_closestHitFraction == 0.0f)
+                return;
+
+            const btDbvtNode* node = stack.Back();
+            stack.Pop();
+
+            btVector3 bounds[2] = { node->volume.Mins() - test.extent_, node->volume.Maxs() + test.extent_ };
+            btScalar tMin;
+            // The closest hit found so far shortens the ray
+            if (!btRayAabb2(from, inverseDirection, signs, bounds, tMin, 0.0f, test.callback_.m_closestHitFraction * length))
+                continue;
+
+            if (node->isinternal())
+            {
+                stack.Push(node->childs[0]);
+                stack.Push(node->childs[1]);
+            }
+            else
+            {
+                btBroadphaseProxy* proxy = static_cast<btBroadphaseProxy*>(node->data);
+                if (test.callback_.needsCollision(proxy))
+                {
+                    btCollisionObject* object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+                    BatchTestShape(test, object, object->getCollisionShape(), object->getWorldTransform());
+                }
+            }
+        }
+    }
+}
+
+void BatchQueryWork(const WorkItem* item, unsigned threadIndex)
+{
+    const BatchQuery& query = *(reinterpret_cast<BatchQuery*>(item->aux_));
+    btDbvtBroadphase* broadphase = static_cast<btDbvtBroadphase*>(query.world_->broadphase_);
+    PODVector<const btDbvtNode*>& stack = query.world_->batchQueryStacks_[threadIndex];
+    const Ray* start = reinterpret_cast<const Ray*>(item->start_);
+    const Ray* end = reinterpret_cast<const Ray*>(item->end_);
+
+    while (start != end)
+    {
+        const Ray& ray = *start;
+        PhysicsRaycastResult& result = query.results_[start - query.rays_];
+        btVector3 from = ToBtVector3(ray.origin_);
+        btVector3 to = ToBtVector3(ray.origin_ + query.maxDistance_ * ray.direction_);
+
+        result.body_ = 0;
+        result.position_ = Vector3::ZERO;
+        result.normal_ = Vector3::ZERO;
+        result.distance_ = M_INFINITY;
+
+        if (query.radius_ > 0.0f)
+        {
+            BatchSphereTest test(from, to, query.radius_, query.collisionMask_);
+            BatchTestBroadphase(test, broadphase, stack);
+
+            if (test.callback_.hasHit())
+            {
+                result.body_ = static_cast<RigidBody*>(test.callback_.m_hitCollisionObject->getUserPointer());
+                result.position_ = ToVector3(test.callback_.m_hitPointWorld);
+                result.normal_ = ToVector3(test.callback_.m_hitNormalWorld);
+            }
+        }
+        else
+        {
+            BatchRayTest test(from, to, query.collisionMask_);
+            BatchTestBroadphase(test, broadphase, stack);
+
+            if (test.callback_.hasHit())
+            {
+                result.body_ = static_cast<RigidBody*>(test.callback_.m_collisionObject->getUserPointer());
+                result.position_ = ToVector3(test.callback_.m_hitPointWorld);
+                result.normal_ = ToVector3(test.callback_.m_hitNormalWorld);
+            }
+        }
+
+        if (result.body_)
+            result.distance_ = (result.position_ - ray.origin_).Length();
+
+        ++start;
+    }
+}
+
 OBJECTTYPESTATIC(PhysicsWorld);
 
 PhysicsWorld::PhysicsWorld(Context* context) :
@@ -105,21 +751,26 @@ PhysicsWorld::PhysicsWorld(Context* context) :
     timeAcc_(0.0f),
     maxNetworkAngularVelocity_(DEFAULT_MAX_NETWORK_ANGULAR_VELOCITY),
     interpolation_(true),
+    multithreaded_(false),
+    deterministic_(false),
+    backgroundGeometryBuild_(false),
     applyingTransforms_(false),
     debugRenderer_(0),
     debugMode_(btIDebugDraw::DBG_DrawWireframe | btIDebugDraw::DBG_DrawConstraints | btIDebugDraw::DBG_DrawConstraintLimits)
 {
     collisionConfiguration_ = new btDefaultCollisionConfiguration();
-    collisionDispatcher_ = new btCollisionDispatcher(collisionConfiguration_);
+    collisionDispatcher_ = new ThreadedCollisionDispatcher(collisionConfiguration_);
     broadphase_ = new btDbvtBroadphase();
     solver_ = new btSequentialImpulseConstraintSolver();
-    world_ = new btDiscreteDynamicsWorld(collisionDispatcher_, broadphase_, solver_, collisionConfiguration_);
+    world_ = new ThreadedDynamicsWorld(collisionDispatcher_, broadphase_, solver_, collisionConfiguration_);
 
     world_->setGravity(ToBtVector3(DEFAULT_GRAVITY));
     world_->getDispatchInfo().m_useContinuous = true;
     world_->setDebugDrawer(this);
     world_->setInternalTickCallback(InternalPreTickCallback, static_cast<void*>(this), true);
     world_->setInternalTickCallback(InternalTickCallback, static_cast<void*>(this), false);
+
+    SetupThreading();
 }
 
 PhysicsWorld::~PhysicsWorld()
@@ -161,6 +812,9 @@ void PhysicsWorld::RegisterObject(Context* context)
     ATTRIBUTE(PhysicsWorld, VAR_INT, "Physics FPS", fps_, DEFAULT_FPS, AM_DEFAULT);
     ATTRIBUTE(PhysicsWorld, VAR_FLOAT, "Net Max Angular Vel.", maxNetworkAngularVelocity_, DEFAULT_MAX_NETWORK_ANGULAR_VELOCITY, AM_DEFAULT);
     ATTRIBUTE(PhysicsWorld, VAR_BOOL, "Interpolation", interpolation_, true, AM_FILE);
+    ACCESSOR_ATTRIBUTE(PhysicsWorld, VAR_BOOL, "Multithreaded", GetMultithreaded, SetMultithreaded, bool, false, AM_FILE);
+    ACCESSOR_ATTRIBUTE(PhysicsWorld, VAR_BOOL, "Deterministic", GetDeterministic, SetDeterministic, bool, false, AM_FILE);
+    ATTRIBUTE(PhysicsWorld, VAR_BOOL, "Background Geometry Build", backgroundGeometryBuild_, false, AM_FILE);
 }
 
 bool PhysicsWorld::isVisible(const btVector3& aabbMin, const btVector3& aabbMax)
@@ -202,10 +856,14 @@ void PhysicsWorld::Update(float timeStep)
     float internalTimeStep = 1.0f / fps_;
     delayedWorldTransforms_.Clear();
 
+    if (pendingCollisionShapes_.Size())
+        UpdatePendingCollisionShapes();
+
     if (interpolation_)
     {
         int maxSubSteps = (int)(timeStep * fps_) + 1;
         world_->stepSimulation(timeStep, maxSubSteps, internalTimeStep);
+        ApplyDelayedWorldTransforms();
     }
     else
     {
@@ -213,26 +871,10 @@ void PhysicsWorld::Update(float timeStep)
         while (timeAcc_ >= internalTimeStep)
         {
             world_->stepSimulation(internalTimeStep, 0, internalTimeStep);
+            ApplyDelayedWorldTransforms();
             timeAcc_ -= internalTimeStep;
         }
     }
-
-    // Apply delayed (parented) world transforms now
-    while (!delayedWorldTransforms_.Empty())
-    {
-        for (HashMap<RigidBody*, DelayedWorldTransform>::Iterator i = delayedWorldTransforms_.Begin();
-            i != delayedWorldTransforms_.End(); ++i)
-        {
-            const DelayedWorldTransform& transform = i->second_;
-
-            // If parent's transform has already been assigned, can proceed
-            if (!delayedWorldTransforms_.Contains(transform.parentRigidBody_))
-            {
-                transform.rigidBody_->ApplyWorldTransform(transform.worldPosition_, transform.worldRotation_);
-                delayedWorldTransforms_.Erase(i);
-            }
-        }
-    }
 }
 
 void PhysicsWorld::UpdateCollisions()
@@ -260,6 +902,23 @@ void PhysicsWorld::SetMaxNetworkAngularVelocity(float velocity)
     maxNetworkAngularVelocity_ = Clamp(velocity, 1.0f, 32767.0f);
 }
 
+void PhysicsWorld::SetMultithreaded(bool enable)
+{
+    multithreaded_ = enable;
+    SetupThreading();
+}
+
+void PhysicsWorld::SetDeterministic(bool enable)
+{
+    deterministic_ = enable;
+    SetupThreading();
+}
+
+void PhysicsWorld::SetBackgroundGeometryBuild(bool enable)
+{
+    backgroundGeometryBuild_ = enable;
+}
+
 void PhysicsWorld::Raycast(PODVector<PhysicsRaycastResult>& result, const Ray& ray, float maxDistance, unsigned collisionMask)
 {
     PROFILE(PhysicsRaycast);
@@ -341,6 +1000,22 @@ void PhysicsWorld::SphereCast(PhysicsRaycastResult& result, const Ray& ray, floa
     }
 }
 
+void PhysicsWorld::RaycastSingleBatch(PODVector<PhysicsRaycastResult>& result, const PODVector<Ray>& rays, float maxDistance,
+    unsigned collisionMask)
+{
+    PROFILE(PhysicsRaycastSingleBatch);
+
+    ProcessBatchQueries(result, rays, 0.0f, maxDistance, collisionMask);
+}
+
+void PhysicsWorld::SphereCastBatch(PODVector<PhysicsRaycastResult>& result, const PODVector<Ray>& rays, float radius,
+    float maxDistance, unsigned collisionMask)
+{
+    PROFILE(PhysicsSphereCastBatch);
+
+    ProcessBatchQueries(result, rays, radius, maxDistance, collisionMask);
+}
+
 void PhysicsWorld::GetRigidBodies(PODVector<RigidBody*>& result, const Sphere& sphere, unsigned collisionMask)
 {
     PROFILE(PhysicsSphereQuery);
@@ -409,6 +1084,15 @@ void PhysicsWorld::AddRigidBody(RigidBody* body)
 void PhysicsWorld::RemoveRigidBody(RigidBody* body)
 {
     rigidBodies_.Remove(body);
+
+    // Remove from the contacts so that they do not refer to a destroyed body
+    for (PODVector<PhysicsContact>::Iterator i = contacts_.Begin(); i != contacts_.End(); ++i)
+    {
+        if (i->bodyA_ == body)
+            i->bodyA_ = 0;
+        if (i->bodyB_ == body)
+            i->bodyB_ = 0;
+    }
 }
 
 void PhysicsWorld::AddCollisionShape(CollisionShape* shape)
@@ -419,6 +1103,13 @@ void PhysicsWorld::AddCollisionShape(CollisionShape* shape)
 void PhysicsWorld::RemoveCollisionShape(CollisionShape* shape)
 {
     collisionShapes_.Remove(shape);
+    pendingCollisionShapes_.Remove(shape);
+}
+
+void PhysicsWorld::AddPendingCollisionShape(CollisionShape* shape)
+{
+    if (!pendingCollisionShapes_.Contains(shape))
+        pendingCollisionShapes_.Push(shape);
 }
 
 void PhysicsWorld::AddConstraint(Constraint* constraint)
@@ -433,7 +1124,7 @@ void PhysicsWorld::RemoveConstraint(Constraint* constraint)
 
 void PhysicsWorld::AddDelayedWorldTransform(const DelayedWorldTransform& transform)
 {
-    delayedWorldTransforms_[transform.rigidBody_] = transform;
+    delayedWorldTransforms_.Push(transform);
 }
 
 void PhysicsWorld::DrawDebugGeometry(bool depthTest)
@@ -452,18 +1143,6 @@ void PhysicsWorld::SetDebugDepthTest(bool enable)
     debugDepthTest_ = enable;
 }
 
-void PhysicsWorld::CleanupGeometryCache()
-{
-    // Remove cached shapes whose only reference is the cache itself
-    for (HashMap<String, SharedPtr<CollisionGeometryData> >::Iterator i = geometryCache_.Begin();
-        i != geometryCache_.End();)
-    {
-        HashMap<String, SharedPtr<CollisionGeometryData> >::Iterator current = i++;
-        if (current->second_.Refs() == 1)
-            geometryCache_.Erase(current);
-    }
-}
-
 void PhysicsWorld::OnNodeSet(Node* node)
 {
     // Subscribe to the scene subsystem update, which will trigger the physics simulation step
@@ -523,6 +1202,8 @@ void PhysicsWorld::SendCollisionEvents()
     PROFILE(SendCollisionEvents);
 
     currentCollisions_.Clear();
+    contacts_.Clear();
+    contactPoints_.Clear();
     int numManifolds = collisionDispatcher_->getNumManifolds();
 
     if (numManifolds)
@@ -550,9 +1231,30 @@ void PhysicsWorld::SendCollisionEvents()
             if (!bodyA || !bodyB)
                 continue;
 
-            // Skip collision event signaling if both objects are static, or if collision event mode does not match
+            // Skip collision event signaling if both objects are static
             if (bodyA->GetMass() == 0.0f && bodyB->GetMass() == 0.0f)
                 continue;
+
+            // Record the contact points for reading without events
+            PhysicsContact contact;
+            contact.bodyA_ = bodyA;
+            contact.bodyB_ = bodyB;
+            contact.firstPoint_ = contactPoints_.Size();
+            contact.numPoints_ = numContacts;
+            contacts_.Push(contact);
+
+            for (int j = 0; j < numContacts; ++j)
+            {
+                btManifoldPoint& point = contactManifold->getContactPoint(j);
+                PhysicsContactPoint contactPoint;
+                contactPoint.position_ = ToVector3(point.m_positionWorldOnB);
+                contactPoint.normal_ = ToVector3(point.m_normalWorldOnB);
+                contactPoint.distance_ = point.m_distance1;
+                contactPoint.impulse_ = point.m_appliedImpulse;
+                contactPoints_.Push(contactPoint);
+            }
+
+            // Skip collision event signaling if collision event mode does not match
             if (bodyA->GetCollisionEventMode() == COLLISION_NEVER || bodyB->GetCollisionEventMode() == COLLISION_NEVER)
                 continue;
             if (bodyA->GetCollisionEventMode() == COLLISION_ACTIVE && bodyB->GetCollisionEventMode() == COLLISION_ACTIVE &&
@@ -592,6 +1294,17 @@ void PhysicsWorld::SendCollisionEvents()
             bool phantom = bodyA->IsPhantom() || bodyB->IsPhantom();
             bool newCollision = !previousCollisions_.Contains(i->first_);
 
+            // Build the event data only if the world or either of the nodes has subscribers for the events
+            bool hasReceivers = HasEventReceivers(E_PHYSICSCOLLISION) ||
+                nodeA->HasEventReceivers(E_NODECOLLISION) || nodeB->HasEventReceivers(E_NODECOLLISION);
+            if (newCollision && !hasReceivers)
+            {
+                hasReceivers = HasEventReceivers(E_PHYSICSCOLLISIONSTART) ||
+                    nodeA->HasEventReceivers(E_NODECOLLISIONSTART) || nodeB->HasEventReceivers(E_NODECOLLISIONSTART);
+            }
+            if (!hasReceivers)
+                continue;
+
             physicsCollisionData[PhysicsCollision::P_NODEA] = (void*)nodeA;
             physicsCollisionData[PhysicsCollision::P_NODEB] = (void*)nodeB;
             physicsCollisionData[PhysicsCollision::P_BODYA] = (void*)bodyA;
@@ -700,6 +1413,11 @@ void PhysicsWorld::SendCollisionEvents()
                 WeakPtr<Node> nodeWeakA(nodeA);
                 WeakPtr<Node> nodeWeakB(nodeB);
 
+                bool hasReceivers = HasEventReceivers(E_PHYSICSCOLLISIONEND) ||
+                    nodeA->HasEventReceivers(E_NODECOLLISIONEND) || nodeB->HasEventReceivers(E_NODECOLLISIONEND);
+                if (!hasReceivers)
+                    continue;
+
                 physicsCollisionData[PhysicsCollisionEnd::P_BODYA] = (void*)bodyA;
                 physicsCollisionData[PhysicsCollisionEnd::P_BODYB] = (void*)bodyB;
                 physicsCollisionData[PhysicsCollisionEnd::P_NODEA] = (void*)nodeA;
@@ -732,6 +1450,116 @@ void PhysicsWorld::SendCollisionEvents()
     previousCollisions_ = currentCollisions_;
 }
 
+void PhysicsWorld::ApplyDelayedWorldTransforms()
+{
+    if (delayedWorldTransforms_.Empty())
+        return;
+
+    PROFILE(ApplyWorldTransforms);
+
+    // A parented rigid body must be assigned after its parent. Sort by scene hierarchy depth if there are any
+    bool hasParented = false;
+    for (PODVector<DelayedWorldTransform>::Iterator i = delayedWorldTransforms_.Begin(); i != delayedWorldTransforms_.End(); ++i)
+    {
+        i->depth_ = 0;
+        Node* parent = i->rigidBody_->GetNode()->GetParent();
+        while (parent && parent != scene_)
+        {
+            ++i->depth_;
+            parent = parent->GetParent();
+        }
+        if (i->depth_)
+            hasParented = true;
+    }
+
+    if (hasParented)
+        Sort(delayedWorldTransforms_.Begin(), delayedWorldTransforms_.End(), CompareDelayedWorldTransforms);
+
+    for (PODVector<DelayedWorldTransform>::Iterator i = delayedWorldTransforms_.Begin(); i != delayedWorldTransforms_.End(); ++i)
+    {
+        i->rigidBody_->ApplyWorldTransform(i->worldPosition_, i->worldRotation_);
+        i->rigidBody_->MarkNetworkUpdate();
+    }
+
+    delayedWorldTransforms_.Clear();
+}
+
+void PhysicsWorld::UpdatePendingCollisionShapes()
+{
+    PROFILE(UpdatePendingCollisionShapes);
+
+    for (unsigned i = 0; i < pendingCollisionShapes_.Size();)
+    {
+        if (pendingCollisionShapes_[i]->UpdatePendingGeometry())
+            pendingCollisionShapes_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void PhysicsWorld::SetupThreading()
+{
+    WorkQueue* queue = multithreaded_ ? GetSubsystem<WorkQueue>() : 0;
+
+    // Collision detection in worker threads creates contact manifolds in a varying order, so it is skipped in deterministic
+    // mode. The simulation islands are solved independently, which does not affect the result
+    static_cast<ThreadedCollisionDispatcher*>(collisionDispatcher_)->workQueue_ = deterministic_ ? 0 : queue;
+    static_cast<ThreadedDynamicsWorld*>(world_)->workQueue_ = queue;
+}
+
+void PhysicsWorld::ProcessBatchQueries(PODVector<PhysicsRaycastResult>& result, const PODVector<Ray>& rays, float radius,
+    float maxDistance, unsigned collisionMask)
+{
+    result.Resize(rays.Size());
+    if (rays.Empty())
+        return;
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    unsigned numThreads = queue ? queue->GetNumThreads() : 0;
+    if (batchQueryStacks_.Size() < numThreads + 1)
+        batchQueryStacks_.Resize(numThreads + 1);
+
+    BatchQuery query;
+    query.world_ = this;
+    query.rays_ = &rays[0];
+    query.results_ = &result[0];
+    query.radius_ = radius;
+    query.maxDistance_ = maxDistance;
+    query.collisionMask_ = collisionMask;
+
+    WorkItem item;
+    item.workFunction_ = BatchQueryWork;
+    item.aux_ = &query;
+
+    const Ray* start = query.rays_;
+    const Ray* last = query.rays_ + rays.Size();
+
+    // Each query writes only its own result, so the work items need no merging afterward
+    if (numThreads && rays.Size() > QUERIES_PER_WORK_ITEM)
+    {
+        while (start != last)
+        {
+            const Ray* end = last;
+            if (end - start > QUERIES_PER_WORK_ITEM)
+                end = start + QUERIES_PER_WORK_ITEM;
+
+            item.start_ = const_cast<Ray*>(start);
+            item.end_ = const_cast<Ray*>(end);
+            queue->AddWorkItem(item);
+
+            start = end;
+        }
+
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+    else
+    {
+        item.start_ = const_cast<Ray*>(start);
+        item.end_ = const_cast<Ray*>(last);
+        BatchQueryWork(&item, 0);
+    }
+}
+
 void RegisterPhysicsLibrary(Context* context)
 {
     CollisionShape::RegisterObject(context);
@@ -31,6 +31,7 @@
 class btCollisionConfiguration;
 class btBroadphaseInterface;
 class btConstraintSolver;
+struct btDbvtNode;
 class btDiscreteDynamicsWorld;
 class btDispatcher;
 class btDynamicsWorld;
@@ -47,9 +48,11 @@ class Ray;
 class RigidBody;
 class Scene;
 class Serializer;
+class WorkQueue;
 class XMLElement;
 
 struct CollisionGeometryData;
+struct WorkItem;
 
 /// Physics raycast hit.
 struct PhysicsRaycastResult
@@ -69,17 +72,51 @@ struct PhysicsRaycastResult
     RigidBody* body_;
 };
 
-/// Delayed world transform assignment for parented rigidbodies.
+/// Physics contact point.
+struct PhysicsContactPoint
+{
+    /// Contact position on body B.
+    Vector3 position_;
+    /// Contact normal on body B, pointing toward body A.
+    Vector3 normal_;
+    /// Contact distance, negative when penetrating.
+    float distance_;
+    /// Impulse applied by the constraint solver.
+    float impulse_;
+};
+
+/// Physics contact manifold between two rigid bodies.
+struct PhysicsContact
+{
+    PhysicsContact() :
+        bodyA_(0),
+        bodyB_(0),
+        firstPoint_(0),
+        numPoints_(0)
+    {
+    }
+
+    /// First rigid body. Null if removed after the simulation step.
+    RigidBody* bodyA_;
+    /// Second rigid body. Null if removed after the simulation step.
+    RigidBody* bodyB_;
+    /// Index of the first contact point.
+    unsigned firstPoint_;
+    /// Number of contact points.
+    unsigned numPoints_;
+};
+
+/// Delayed world transform assignment for moved rigidbodies.
 struct DelayedWorldTransform
 {
     /// Rigid body.
     RigidBody* rigidBody_;
-    /// Parent rigid body.
-    RigidBody* parentRigidBody_;
     /// New world position.
     Vector3 worldPosition_;
     /// New world rotation.
     Quaternion worldRotation_;
+    /// Scene hierarchy depth, used to assign parents first.
+    unsigned depth_;
 };
 
 static const float DEFAULT_MAX_NETWORK_ANGULAR_VELOCITY = 100.0f;
@@ -89,6 +126,7 @@ class PhysicsWorld : public Component, public btIDebugDraw
 {
     friend void InternalPreTickCallback(btDynamicsWorld *world, btScalar timeStep);
     friend void InternalTickCallback(btDynamicsWorld *world, btScalar timeStep);
+    friend void BatchQueryWork(const WorkItem* item, unsigned threadIndex);
 
     OBJECT(PhysicsWorld);
 
@@ -129,12 +167,22 @@ public:
     void SetInterpolation(bool enable);
     /// Set maximum angular velocity for network replication.
     void SetMaxNetworkAngularVelocity(float velocity);
+    /// Set whether to use worker threads for collision detection and constraint solving. Default false.
+    void SetMultithreaded(bool enable);
+    /// Set whether results should not depend on thread timing. When enabled, collision detection runs in the main thread and only the independent simulation islands are solved in worker threads. Default false.
+    void SetDeterministic(bool enable);
+    /// Set whether to build triangle mesh geometry in worker threads. The shape is missing from its rigid body until built. Default false.
+    void SetBackgroundGeometryBuild(bool enable);
     /// Perform a physics world raycast and return all hits.
     void Raycast(PODVector<PhysicsRaycastResult>& result, const Ray& ray, float maxDistance, unsigned collisionMask = M_MAX_UNSIGNED);
     /// Perform a physics world raycast and return the closest hit.
     void RaycastSingle(PhysicsRaycastResult& result, const Ray& ray, float maxDistance, unsigned collisionMask = M_MAX_UNSIGNED);
     /// Perform a physics world swept sphere test and return the closest hit.
     void SphereCast(PhysicsRaycastResult& result, const Ray& ray, float radius, float maxDistance, unsigned collisionMask = M_MAX_UNSIGNED);
+    /// Perform physics world raycasts for a batch of rays and return the closest hit for each, in the same order. Uses worker threads if available.
+    void RaycastSingleBatch(PODVector<PhysicsRaycastResult>& result, const PODVector<Ray>& rays, float maxDistance, unsigned collisionMask = M_MAX_UNSIGNED);
+    /// Perform physics world swept sphere tests for a batch of rays and return the closest hit for each, in the same order. Uses worker threads if available.
+    void SphereCastBatch(PODVector<PhysicsRaycastResult>& result, const PODVector<Ray>& rays, float radius, float maxDistance, unsigned collisionMask = M_MAX_UNSIGNED);
     /// Return rigid bodies by a sphere query.
     void GetRigidBodies(PODVector<RigidBody*>& result, const Sphere& sphere, unsigned collisionMask = M_MAX_UNSIGNED);
     /// Return rigid bodies by a box query.
@@ -149,6 +197,16 @@ public:
     int GetFps() const { return fps_; }
     /// Return maximum angular velocity for network replication.
     float GetMaxNetworkAngularVelocity() const { return maxNetworkAngularVelocity_; }
+    /// Return whether worker threads are used for collision detection and constraint solving.
+    bool GetMultithreaded() const { return multithreaded_; }
+    /// Return whether results are independent of thread timing.
+    bool GetDeterministic() const { return deterministic_; }
+    /// Return whether triangle mesh geometry is built in worker threads.
+    bool GetBackgroundGeometryBuild() const { return backgroundGeometryBuild_; }
+    /// Return contacts between rigid bodies on the last simulation step. Unlike collision events, these are recorded regardless of the collision event mode.
+    const PODVector<PhysicsContact>& GetContacts() const { return contacts_; }
+    /// Return contact points on the last simulation step. Each contact refers to a range of these.
+    const PODVector<PhysicsContactPoint>& GetContactPoints() const { return contactPoints_; }
 
     /// Add a rigid body to keep track of. Called by RigidBody.
     void AddRigidBody(RigidBody* body);
@@ -158,6 +216,8 @@ public:
     void AddCollisionShape(CollisionShape* shape);
     /// Remove a collision shape. Called by CollisionShape.
     void RemoveCollisionShape(CollisionShape* shape);
+    /// Add a collision shape that is waiting for its geometry to be built. Called by CollisionShape.
+    void AddPendingCollisionShape(CollisionShape* shape);
     /// Add a constraint to keep track of. Called by Constraint.
     void AddConstraint(Constraint* joint);
     /// Remove a constraint. Called by Constraint.
@@ -173,10 +233,6 @@ public:
 
     /// Return the Bullet physics world.
     btDiscreteDynamicsWorld* GetWorld() { return world_; }
-    /// Clean up the geometry cache.
-    void CleanupGeometryCache();
-    /// Return the collision geometry cache.
-    HashMap<String, SharedPtr<CollisionGeometryData> >& GetGeometryCache() { return geometryCache_; }
     /// Set node dirtying to be disregarded.
     void SetApplyingTransforms(bool enable) { applyingTransforms_ = enable; }
     /// Return whether node dirtying should be disregarded.
@@ -195,6 +251,14 @@ private:
     void PostStep(float timeStep);
     /// Send accumulated collision events.
     void SendCollisionEvents();
+    /// Apply the world transforms of moved rigid bodies to their scene nodes.
+    void ApplyDelayedWorldTransforms();
+    /// Create the collision shapes whose geometry has finished building.
+    void UpdatePendingCollisionShapes();
+    /// Pass the work queue to the collision dispatcher and physics world according to the threading settings.
+    void SetupThreading();
+    /// Perform batched raycasts or sphere casts.
+    void ProcessBatchQueries(PODVector<PhysicsRaycastResult>& result, const PODVector<Ray>& rays, float radius, float maxDistance, unsigned collisionMask);
 
     /// Bullet collision configuration.
     btCollisionConfiguration* collisionConfiguration_;
@@ -218,10 +282,16 @@ private:
     HashMap<Pair<WeakPtr<RigidBody>, WeakPtr<RigidBody> >, btPersistentManifold* > currentCollisions_;
     /// Collision pairs on the previous frame. Used to check if a collision is "new." Manifolds are not guaranteed to exist anymore.
     HashMap<Pair<WeakPtr<RigidBody>, WeakPtr<RigidBody> >, btPersistentManifold* > previousCollisions_;
-    /// Delayed (parented) world transform assignments.
-    HashMap<RigidBody*, DelayedWorldTransform> delayedWorldTransforms_;
-    /// Cache for collision geometry data.
-    HashMap<String, SharedPtr<CollisionGeometryData> > geometryCache_;
+    /// Contacts on the last simulation step.
+    PODVector<PhysicsContact> contacts_;
+    /// Contact points on the last simulation step.
+    PODVector<PhysicsContactPoint> contactPoints_;
+    /// Delayed world transform assignments.
+    PODVector<DelayedWorldTransform> delayedWorldTransforms_;
+    /// Collision shapes waiting for their geometry to be built.
+    PODVector<CollisionShape*> pendingCollisionShapes_;
+    /// Broadphase traversal stacks for batched queries, one per thread.
+    Vector<PODVector<const btDbvtNode*> > batchQueryStacks_;
     /// Simulation steps per second.
     unsigned fps_;
     /// Time accumulator for non-interpolated mode.
@@ -230,6 +300,12 @@ private:
     float maxNetworkAngularVelocity_;
     /// Interpolation flag.
     bool interpolation_;
+    /// Multithreaded simulation flag.
+    bool multithreaded_;
+    /// Deterministic simulation flag.
+    bool deterministic_;
+    /// Background geometry build flag.
+    bool backgroundGeometryBuild_;
     /// Applying transforms flag.
     bool applyingTransforms_;
     /// Debug renderer.
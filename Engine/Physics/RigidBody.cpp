@@ -164,33 +164,28 @@ void RigidBody::getWorldTransform(btTransform &worldTrans) const
 
 void RigidBody::setWorldTransform(const btTransform &worldTrans)
 {
-    Vector3 newWorldPosition = ToVector3(worldTrans.getOrigin());
-    Quaternion newWorldRotation = ToQuaternion(worldTrans.getRotation());
-    RigidBody* parentRigidBody = 0;
-
     // It is possible that the RigidBody component has been kept alive via a shared pointer,
     // while its scene node has already been destroyed
     if (node_)
     {
-        // If the rigid body is parented to another rigid body, can not set the transform immediately.
-        // In that case store it to PhysicsWorld for delayed assignment
-        Node* parent = node_->GetParent();
-        if (parent && parent != GetScene())
-            parentRigidBody = parent->GetComponent<RigidBody>();
+        Vector3 newWorldPosition = ToVector3(worldTrans.getOrigin());
+        Quaternion newWorldRotation = ToQuaternion(worldTrans.getRotation());
 
-        if (!parentRigidBody)
-            ApplyWorldTransform(newWorldPosition, newWorldRotation);
-        else
-        {
-            DelayedWorldTransform delayed;
-            delayed.rigidBody_ = this;
-            delayed.parentRigidBody_ = parentRigidBody;
-            delayed.worldPosition_ = newWorldPosition;
-            delayed.worldRotation_ = newWorldRotation;
-            physicsWorld_->AddDelayedWorldTransform(delayed);
-        }
+        // Bullet synchronizes also bodies that are about to fall asleep. Skip if the scene node already has the transform.
+        // Compare against the node's current world transform instead of the last assigned one, as the node may have been
+        // moved since. A parented body is always stored, as its parent may move when the delayed transforms are applied
+        Node* parent = node_->GetParent();
+        if (!hasSmoothedTransform_ && (!parent || parent == GetScene()) &&
+            newWorldPosition.Equals(node_->GetWorldPosition()) && newWorldRotation.Equals(node_->GetWorldRotation()))
+            return;
 
-        MarkNetworkUpdate();
+        // Store to PhysicsWorld, which assigns the transforms of all moved bodies after the simulation step, so that
+        // parented rigid bodies can be assigned after their parents
+        DelayedWorldTransform delayed;
+        delayed.rigidBody_ = this;
+        delayed.worldPosition_ = newWorldPosition;
+        delayed.worldRotation_ = newWorldRotation;
+        physicsWorld_->AddDelayedWorldTransform(delayed);
     }
 }
 
@@ -30,6 +30,9 @@
 #include "PackageFile.h"
 #include "ResourceCache.h"
 #include "ResourceEvents.h"
+#include "Sort.h"
+#include "StringUtils.h"
+#include "VectorBuffer.h"
 #include "XMLFile.h"
 
 #include "DebugNew.h"
@@ -57,17 +60,40 @@ static const char* checkDirs[] = {
 };
 
 static const SharedPtr<Resource> noResource;
+static const String cacheSourceStampsName("SourceStamps.bin");
+
+/// Unused resource that may be released to satisfy a memory budget.
+struct EvictionCandidate
+{
+    /// Resource group.
+    ResourceGroup* group_;
+    /// Resource name hash.
+    StringHash nameHash_;
+    /// Time since last use in milliseconds.
+    unsigned useTimer_;
+    /// Memory use in bytes.
+    unsigned memoryUse_;
+};
+
+static bool CompareEvictionCandidates(const EvictionCandidate& lhs, const EvictionCandidate& rhs)
+{
+    return lhs.useTimer_ > rhs.useTimer_;
+}
 
 OBJECTTYPESTATIC(ResourceCache);
 
 ResourceCache::ResourceCache(Context* context) :
     Object(context),
-    autoReloadResources_(false)
+    totalMemoryBudget_(0),
+    autoReloadResources_(false),
+    cacheSourceStampsDirty_(false)
 {
+    SubscribeToEvent(E_BEGINFRAME, HANDLER(ResourceCache, HandleBeginFrame));
 }
 
 ResourceCache::~ResourceCache()
 {
+    SaveCacheSourceStamps();
 }
 
 bool ResourceCache::AddResourceDir(const String& pathName)
@@ -320,6 +346,13 @@ bool ResourceCache::ReloadResource(Resource* resource)
 void ResourceCache::SetMemoryBudget(ShortStringHash type, unsigned budget)
 {
     resourceGroups_[type].memoryBudget_ = budget;
+    UpdateResourceGroup(type);
+}
+
+void ResourceCache::SetTotalMemoryBudget(unsigned budget)
+{
+    totalMemoryBudget_ = budget;
+    CheckTotalMemoryBudget();
 }
 
 void ResourceCache::SetAutoReloadResources(bool enable)
@@ -334,19 +367,145 @@ void ResourceCache::SetAutoReloadResources(bool enable)
                 watcher->StartWatching(resourceDirs_[i], true);
                 fileWatchers_.Push(watcher);
             }
-
-            SubscribeToEvent(E_BEGINFRAME, HANDLER(ResourceCache, HandleBeginFrame));
         }
         else
-        {
-            UnsubscribeFromEvent(E_BEGINFRAME);
             fileWatchers_.Clear();
-        }
         
         autoReloadResources_ = enable;
     }
 }
 
+bool ResourceCache::SetCacheDir(const String& pathName)
+{
+    SaveCacheSourceStamps();
+    cacheSourceStamps_.Clear();
+    
+    if (pathName.Empty())
+    {
+        cacheDir_.Clear();
+        return true;
+    }
+    
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    if (!fileSystem || (!fileSystem->DirExists(pathName) && !fileSystem->CreateDir(pathName)))
+    {
+        LOGERROR("Could not open or create cache directory " + pathName);
+        return false;
+    }
+    
+    cacheDir_ = AddTrailingSlash(pathName);
+    LOGINFO("Set resource cache directory " + cacheDir_);
+    LoadCacheSourceStamps();
+    return true;
+}
+
+SharedPtr<File> ResourceCache::GetCacheFile(const String& key, unsigned checksum)
+{
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    if (cacheDir_.Empty() || !fileSystem)
+        return SharedPtr<File>();
+    
+    String fileName = GetCacheFileName(key, checksum);
+    if (!fileSystem->FileExists(fileName))
+        return SharedPtr<File>();
+    
+    SharedPtr<File> file(new File(context_, fileName));
+    if (!file->IsOpen())
+        return SharedPtr<File>();
+    
+    return file;
+}
+
+SharedPtr<File> ResourceCache::CreateCacheFile(const String& key, unsigned checksum)
+{
+    if (cacheDir_.Empty())
+        return SharedPtr<File>();
+    
+    SharedPtr<File> file(new File(context_, GetCacheFileName(key, checksum), FILE_WRITE));
+    if (!file->IsOpen())
+    {
+        LOGERROR("Could not create cache file for " + key);
+        return SharedPtr<File>();
+    }
+    
+    return file;
+}
+
+bool ResourceCache::ReadCacheSource(Deserializer& source, VectorBuffer& dest, unsigned& checksum)
+{
+    if (cacheDir_.Empty())
+        return false;
+    
+    dest.Clear();
+    
+    // Files in the resource directories are identified by name, size and modification time, so that an unchanged file
+    // does not need to be read into memory and hashed again. Files inside packages are always hashed
+    const String& name = source.GetName();
+    StringHash nameHash;
+    unsigned modifiedTime = 0;
+    if (!name.Empty())
+    {
+        bool inPackage = false;
+        for (unsigned i = 0; i < packages_.Size(); ++i)
+        {
+            if (packages_[i]->Exists(name))
+            {
+                inPackage = true;
+                break;
+            }
+        }
+        
+        FileSystem* fileSystem = GetSubsystem<FileSystem>();
+        String fileName = inPackage ? String() : GetResourceFileName(name);
+        if (fileSystem && !fileName.Empty())
+        {
+            nameHash = StringHash(name);
+            modifiedTime = fileSystem->GetLastModifiedTime(fileName);
+            HashMap<StringHash, CacheSourceStamp>::ConstIterator i = cacheSourceStamps_.Find(nameHash);
+            if (modifiedTime && i != cacheSourceStamps_.End() && i->second_.size_ == source.GetSize() &&
+                i->second_.modifiedTime_ == modifiedTime)
+            {
+                checksum = i->second_.checksum_;
+                return true;
+            }
+        }
+    }
+    
+    unsigned size = source.GetSize();
+    unsigned position = source.GetPosition();
+    if (size > position)
+        dest.SetData(source, size - position);
+    else
+    {
+        // The source does not know its size, so read until the end
+        unsigned char buffer[4096];
+        for (;;)
+        {
+            unsigned bytes = source.Read(buffer, sizeof buffer);
+            if (!bytes)
+                break;
+            dest.Write(buffer, bytes);
+        }
+        dest.Seek(0);
+    }
+    
+    checksum = 0;
+    const unsigned char* data = dest.GetData();
+    for (unsigned i = 0; i < dest.GetSize(); ++i)
+        checksum = SDBMHash(checksum, data[i]);
+    
+    if (modifiedTime)
+    {
+        CacheSourceStamp& stamp = cacheSourceStamps_[nameHash];
+        stamp.size_ = source.GetSize();
+        stamp.modifiedTime_ = modifiedTime;
+        stamp.checksum_ = checksum;
+        cacheSourceStampsDirty_ = true;
+    }
+    
+    return true;
+}
+
 SharedPtr<File> ResourceCache::GetFile(const String& nameIn)
 {
     String name = SanitateResourceName(nameIn);
@@ -512,6 +671,24 @@ unsigned ResourceCache::GetTotalMemoryUse() const
     return total;
 }
 
+unsigned ResourceCache::GetNumEvicted(ShortStringHash type) const
+{
+    HashMap<ShortStringHash, ResourceGroup>::ConstIterator i = resourceGroups_.Find(type);
+    if (i != resourceGroups_.End())
+        return i->second_.numEvicted_;
+    else
+        return 0;
+}
+
+unsigned ResourceCache::GetEvictedMemory(ShortStringHash type) const
+{
+    HashMap<ShortStringHash, ResourceGroup>::ConstIterator i = resourceGroups_.Find(type);
+    if (i != resourceGroups_.End())
+        return i->second_.evictedMemory_;
+    else
+        return 0;
+}
+
 const String& ResourceCache::GetResourceName(StringHash nameHash) const
 {
     HashMap<StringHash, String>::ConstIterator i = hashToName_.Find(nameHash);
@@ -688,48 +865,147 @@ void ResourceCache::ReleasePackageResources(PackageFile* package, bool force)
         UpdateResourceGroup(*i);
 }
 
+String ResourceCache::GetCacheFileName(const String& key, unsigned checksum) const
+{
+    // The source data checksum is part of the name, so modified source data never matches stale processed data
+    return cacheDir_ + key + "_" + ToStringHex(checksum) + ".bin";
+}
+
+void ResourceCache::LoadCacheSourceStamps()
+{
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    if (!fileSystem || !fileSystem->FileExists(cacheDir_ + cacheSourceStampsName))
+        return;
+    
+    File file(context_, cacheDir_ + cacheSourceStampsName);
+    if (!file.IsOpen() || file.ReadFileID() != "USST")
+        return;
+    
+    unsigned numStamps = file.ReadVLE();
+    for (unsigned i = 0; i < numStamps && !file.IsEof(); ++i)
+    {
+        StringHash nameHash = file.ReadStringHash();
+        CacheSourceStamp& stamp = cacheSourceStamps_[nameHash];
+        stamp.size_ = file.ReadUInt();
+        stamp.modifiedTime_ = file.ReadUInt();
+        stamp.checksum_ = file.ReadUInt();
+    }
+}
+
+void ResourceCache::SaveCacheSourceStamps()
+{
+    if (!cacheSourceStampsDirty_ || cacheDir_.Empty())
+        return;
+    
+    cacheSourceStampsDirty_ = false;
+    
+    File file(context_, cacheDir_ + cacheSourceStampsName, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        LOGERROR("Could not save resource cache source stamps");
+        return;
+    }
+    
+    file.WriteFileID("USST");
+    file.WriteVLE(cacheSourceStamps_.Size());
+    for (HashMap<StringHash, CacheSourceStamp>::ConstIterator i = cacheSourceStamps_.Begin(); i != cacheSourceStamps_.End(); ++i)
+    {
+        file.WriteStringHash(i->first_);
+        file.WriteUInt(i->second_.size_);
+        file.WriteUInt(i->second_.modifiedTime_);
+        file.WriteUInt(i->second_.checksum_);
+    }
+}
+
 void ResourceCache::UpdateResourceGroup(ShortStringHash type)
 {
     HashMap<ShortStringHash, ResourceGroup>::Iterator i = resourceGroups_.Find(type);
     if (i == resourceGroups_.End())
         return;
     
-    for (;;)
+    unsigned totalSize = 0;
+    for (HashMap<StringHash, SharedPtr<Resource> >::ConstIterator j = i->second_.resources_.Begin();
+        j != i->second_.resources_.End(); ++j)
+        totalSize += j->second_->GetMemoryUse();
+    
+    i->second_.memoryUse_ = totalSize;
+    
+    if (i->second_.memoryBudget_ && i->second_.memoryUse_ > i->second_.memoryBudget_)
+        ReleaseOldestResources(&i->second_, i->second_.memoryUse_, i->second_.memoryBudget_);
+    
+    CheckTotalMemoryBudget();
+}
+
+void ResourceCache::CheckTotalMemoryBudget()
+{
+    if (!totalMemoryBudget_)
+        return;
+    
+    unsigned totalSize = GetTotalMemoryUse();
+    if (totalSize > totalMemoryBudget_)
+        ReleaseOldestResources(0, totalSize, totalMemoryBudget_);
+}
+
+void ResourceCache::ReleaseOldestResources(ResourceGroup* group, unsigned memoryUse, unsigned budget)
+{
+    // Collect the resources that are not in use (resources in use always return a zero timer and can not be removed)
+    PODVector<EvictionCandidate> candidates;
+    
+    for (HashMap<ShortStringHash, ResourceGroup>::Iterator i = resourceGroups_.Begin(); i != resourceGroups_.End(); ++i)
     {
-        unsigned totalSize = 0;
-        unsigned oldestTimer = 0;
-        HashMap<StringHash, SharedPtr<Resource> >::Iterator oldestResource = i->second_.resources_.End();
+        if (group && group != &i->second_)
+            continue;
         
         for (HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
             j != i->second_.resources_.End(); ++j)
         {
-            totalSize += j->second_->GetMemoryUse();
             unsigned useTimer = j->second_->GetUseTimer();
-            if (useTimer > oldestTimer)
+            if (useTimer)
             {
-                oldestTimer = useTimer;
-                oldestResource = j;
+                EvictionCandidate candidate;
+                candidate.group_ = &i->second_;
+                candidate.nameHash_ = j->first_;
+                candidate.useTimer_ = useTimer;
+                candidate.memoryUse_ = j->second_->GetMemoryUse();
+                candidates.Push(candidate);
             }
         }
+    }
+    
+    if (candidates.Empty())
+        return;
+    
+    // Release least recently used first until the budget is satisfied
+    Sort(candidates.Begin(), candidates.End(), CompareEvictionCandidates);
+    
+    for (unsigned i = 0; i < candidates.Size() && memoryUse > budget; ++i)
+    {
+        const EvictionCandidate& candidate = candidates[i];
+        ResourceGroup* candidateGroup = candidate.group_;
         
-        i->second_.memoryUse_ = totalSize;
-        
-        // If memory budget defined and is exceeded, remove the oldest resource and loop again
-        // (resources in use always return a zero timer and can not be removed)
-        if (i->second_.memoryBudget_ && i->second_.memoryUse_ > i->second_.memoryBudget_ &&
-            oldestResource != i->second_.resources_.End())
-        {
-            LOGDEBUG("Resource group " + oldestResource->second_->GetTypeName() + " over memory budget, releasing resource " +
-                oldestResource->second_->GetName());
-            i->second_.resources_.Erase(oldestResource);
-        }
-        else
-            break;
+        LOGDEBUG("Resources over memory budget, releasing resource " + GetResourceName(candidate.nameHash_));
+        candidateGroup->resources_.Erase(candidate.nameHash_);
+        candidateGroup->memoryUse_ = candidateGroup->memoryUse_ > candidate.memoryUse_ ? candidateGroup->memoryUse_ -
+            candidate.memoryUse_ : 0;
+        ++candidateGroup->numEvicted_;
+        candidateGroup->evictedMemory_ += candidate.memoryUse_;
+        memoryUse = memoryUse > candidate.memoryUse_ ? memoryUse - candidate.memoryUse_ : 0;
     }
 }
 
 void ResourceCache::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
 {
+    // Resources may have gone out of use since they were stored, so check the budgets periodically
+    for (HashMap<ShortStringHash, ResourceGroup>::Iterator i = resourceGroups_.Begin(); i != resourceGroups_.End(); ++i)
+    {
+        if (i->second_.memoryBudget_ && i->second_.memoryUse_ > i->second_.memoryBudget_)
+            ReleaseOldestResources(&i->second_, i->second_.memoryUse_, i->second_.memoryBudget_);
+    }
+    CheckTotalMemoryBudget();
+    
+    // Write out checksums of newly hashed source data, so that the next run does not need to hash them again
+    SaveCacheSourceStamps();
+    
     for (unsigned i = 0; i < fileWatchers_.Size(); ++i)
     {
         String fileName;
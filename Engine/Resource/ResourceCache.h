@@ -30,6 +30,7 @@ namespace Urho3D
 
 class FileWatcher;
 class PackageFile;
+class VectorBuffer;
 
 /// Container of resources with specific type.
 struct ResourceGroup
@@ -37,7 +38,9 @@ struct ResourceGroup
     /// Construct with defaults.
     ResourceGroup() :
         memoryBudget_(0),
-        memoryUse_(0)
+        memoryUse_(0),
+        numEvicted_(0),
+        evictedMemory_(0)
     {
     }
     
@@ -45,10 +48,33 @@ struct ResourceGroup
     unsigned memoryBudget_;
     /// Current memory use.
     unsigned memoryUse_;
+    /// Number of resources released so far due to exceeding a memory budget.
+    unsigned numEvicted_;
+    /// Total memory released so far due to exceeding a memory budget.
+    unsigned evictedMemory_;
     /// Resources.
     HashMap<StringHash, SharedPtr<Resource> > resources_;
 };
 
+/// Size, modification time and checksum of a resource file's source data, used to avoid rehashing unchanged files.
+struct CacheSourceStamp
+{
+    /// Construct with defaults.
+    CacheSourceStamp() :
+        size_(0),
+        modifiedTime_(0),
+        checksum_(0)
+    {
+    }
+    
+    /// File size.
+    unsigned size_;
+    /// File modification time.
+    unsigned modifiedTime_;
+    /// Source data checksum.
+    unsigned checksum_;
+};
+
 /// %Resource cache subsystem. Loads resources on demand and stores them for later access.
 class ResourceCache : public Object
 {
@@ -86,11 +112,21 @@ public:
     bool ReloadResource(Resource* resource);
     /// Set memory budget for a specific resource type, default 0 is unlimited.
     void SetMemoryBudget(ShortStringHash type, unsigned budget);
+    /// Set memory budget for all resources combined, default 0 is unlimited.
+    void SetTotalMemoryBudget(unsigned budget);
     /// Enable or disable automatic reloading of resources as files are modified.
     void SetAutoReloadResources(bool enable);
+    /// Set directory for storing processed resource data between runs. Will be created if does not exist. Empty (default) disables. Return true if successful.
+    bool SetCacheDir(const String& pathName);
     
     /// Open and return a file from the resource load paths or from inside a package file. If not found, use a fallback search with absolute path. Return null if fails.
     SharedPtr<File> GetFile(const String& name);
+    /// Open processed resource data stored for the source data checksum for reading. Return null if not cached.
+    SharedPtr<File> GetCacheFile(const String& key, unsigned checksum);
+    /// Create a file for storing processed resource data for the source data checksum. Return null if caching disabled or fails.
+    SharedPtr<File> CreateCacheFile(const String& key, unsigned checksum);
+    /// Return a resource's source data checksum for looking up processed data. If the source is a file whose size and modification time match an earlier run, reuse the stored checksum and leave dest empty, otherwise read the rest of the source data into dest. Return false if caching is disabled.
+    bool ReadCacheSource(Deserializer& source, VectorBuffer& dest, unsigned& checksum);
     /// Return a resource by type and name. Load if not loaded yet. Return null if fails.
     Resource* GetResource(ShortStringHash type, const String& name);
     /// Return a resource by type and name. Load if not loaded yet. Return null if fails.
@@ -123,12 +159,20 @@ public:
     unsigned GetMemoryUse(ShortStringHash type) const;
     /// Return total memory use for all resources.
     unsigned GetTotalMemoryUse() const;
+    /// Return memory budget for all resources combined.
+    unsigned GetTotalMemoryBudget() const { return totalMemoryBudget_; }
+    /// Return number of resources released due to exceeding a memory budget for a resource type.
+    unsigned GetNumEvicted(ShortStringHash type) const;
+    /// Return memory released due to exceeding a memory budget for a resource type.
+    unsigned GetEvictedMemory(ShortStringHash type) const;
     /// Return resource name from hash, or empty if not found.
     const String& GetResourceName(StringHash nameHash) const;
     /// Return full absolute file name of resource if possible.
     String GetResourceFileName(const String& name) const;
     /// Return whether automatic resource reloading is enabled.
     bool GetAutoReloadResources() const { return autoReloadResources_; }
+    /// Return processed resource data directory.
+    const String& GetCacheDir() const { return cacheDir_; }
     
     /// Return either the path itself or its parent, based on which of them has recognized resource subdirectories.
     String GetPreferredResourceDir(const String& path) const;
@@ -148,9 +192,19 @@ private:
     const SharedPtr<Resource>& FindResource(StringHash nameHash);
     /// Release resources loaded from a package file.
     void ReleasePackageResources(PackageFile* package, bool force = false);
+    /// Return processed resource data file name.
+    String GetCacheFileName(const String& key, unsigned checksum) const;
+    /// Load source data stamps from the processed resource data directory.
+    void LoadCacheSourceStamps();
+    /// Save source data stamps to the processed resource data directory.
+    void SaveCacheSourceStamps();
     /// Update a resource group. Recalculate memory use and release resources if over memory budget.
     void UpdateResourceGroup(ShortStringHash type);
-    /// Handle begin frame event. Automatic resource reloads are processed here.
+    /// Release least recently used resources until under the total memory budget.
+    void CheckTotalMemoryBudget();
+    /// Release least recently used resources from one group, or from all groups if null, until the memory use is within the budget.
+    void ReleaseOldestResources(ResourceGroup* group, unsigned memoryUse, unsigned budget);
+    /// Handle begin frame event. Automatic resource reloads and memory budget checks are processed here.
     void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
     
     /// Resources by type.
@@ -161,12 +215,20 @@ private:
     Vector<SharedPtr<FileWatcher> > fileWatchers_;
     /// Package files.
     Vector<SharedPtr<PackageFile> > packages_;
+    /// Processed resource data directory.
+    String cacheDir_;
+    /// Source data stamps by resource name hash.
+    HashMap<StringHash, CacheSourceStamp> cacheSourceStamps_;
     /// Mapping of hashes to filenames.
     HashMap<StringHash, String> hashToName_;
     /// Dependent resources.
     HashMap<StringHash, HashSet<StringHash> > dependentResources_;
+    /// Memory budget for all resources combined.
+    unsigned totalMemoryBudget_;
     /// Automatic resource reloading flag.
     bool autoReloadResources_;
+    /// Source data stamps changed flag.
+    bool cacheSourceStampsDirty_;
 };
 
 template <class T> T* ResourceCache::GetResource(const String& name)
@@ -0,0 +1,388 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Precompiled.h"
+#include "Deserializer.h"
+#include "XMLFile.h"
+#include "XMLStreamReader.h"
+
+#include <cstring>
+#include <pugixml.hpp>
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+static const unsigned READ_BUFFER_SIZE = 65536;
+static const unsigned MAX_TERMINATOR_LENGTH = 8;
+
+/// Markup token types.
+enum XMLToken
+{
+    TOKEN_EOF = 0,
+    TOKEN_START,
+    TOKEN_END
+};
+
+static inline bool IsWhiteSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+XMLStreamReader::XMLStreamReader(Context* context) :
+    context_(context),
+    source_(0),
+    rootFile_(new XMLFile(context)),
+    childFile_(new XMLFile(context)),
+    buffer_(new char[READ_BUFFER_SIZE]),
+    bufferPos_(0),
+    bufferSize_(0),
+    captureStart_(0),
+    capturing_(false),
+    hasPendingChild_(false),
+    finished_(false),
+    error_(false)
+{
+}
+
+XMLStreamReader::~XMLStreamReader()
+{
+}
+
+XMLElement XMLStreamReader::ReadRoot(Deserializer& source, const String& stopAtChild)
+{
+    source_ = &source;
+    bufferPos_ = 0;
+    bufferSize_ = 0;
+    capture_.Clear();
+    pendingChild_.Clear();
+    captureStart_ = 0;
+    capturing_ = false;
+    hasPendingChild_ = false;
+    finished_ = false;
+    error_ = false;
+    
+    bool selfClosing;
+    int token = ReadToken(rootName_, selfClosing, true);
+    EndCapture();
+    if (token != TOKEN_START)
+    {
+        error_ = true;
+        return XMLElement();
+    }
+    
+    String rootText = capture_;
+    if (selfClosing)
+        finished_ = true;
+    else
+    {
+        // Collect leading children into the root element, then close it so that it can be parsed separately
+        String childName;
+        while (ReadChildText(childName))
+        {
+            if (!stopAtChild.Empty() && childName == stopAtChild)
+            {
+                pendingChild_ = capture_;
+                hasPendingChild_ = true;
+                break;
+            }
+            rootText += capture_;
+        }
+        
+        if (error_)
+            return XMLElement();
+        
+        rootText += "</" + rootName_ + ">";
+    }
+    
+    return ParseElement(rootFile_, rootText);
+}
+
+bool XMLStreamReader::ReadChildren(XMLFile* dest, unsigned maxSize)
+{
+    if (error_)
+        return false;
+    
+    String text = "<" + rootName_ + ">";
+    if (hasPendingChild_)
+    {
+        text += pendingChild_;
+        pendingChild_.Clear();
+        hasPendingChild_ = false;
+    }
+    
+    String name;
+    while (!finished_ && text.Length() < maxSize && ReadChildText(name))
+        text += capture_;
+    
+    if (error_)
+        return false;
+    
+    text += "</" + rootName_ + ">";
+    return ParseElement(dest, text).NotNull();
+}
+
+XMLElement XMLStreamReader::ReadChild()
+{
+    if (hasPendingChild_)
+    {
+        hasPendingChild_ = false;
+        return ParseElement(childFile_, pendingChild_);
+    }
+    
+    if (finished_ || error_)
+        return XMLElement();
+    
+    String name;
+    if (!ReadChildText(name))
+        return XMLElement();
+    
+    return ParseElement(childFile_, capture_);
+}
+
+int XMLStreamReader::ReadToken(String& name, bool& selfClosing, bool capture)
+{
+    char c;
+    
+    for (;;)
+    {
+        // Skip text content until the next markup
+        do
+        {
+            if (!ReadChar(c))
+                return TOKEN_EOF;
+        }
+        while (c != '<');
+        
+        if (!ReadChar(c))
+            return TOKEN_EOF;
+        
+        // Skip processing instructions, comments, CDATA sections and document type declarations
+        if (c == '?')
+        {
+            if (!SkipUntil("?>"))
+                return TOKEN_EOF;
+            continue;
+        }
+        if (c == '!')
+        {
+            char d;
+            if (!ReadChar(d))
+                return TOKEN_EOF;
+            if (d == '-')
+            {
+                if (!ReadChar(d) || !SkipUntil("-->"))
+                    return TOKEN_EOF;
+            }
+            else if (d == '[')
+            {
+                if (!SkipUntil("]]>"))
+                    return TOKEN_EOF;
+            }
+            else if (!SkipUntil(">"))
+                return TOKEN_EOF;
+            continue;
+        }
+        
+        if (c == '/')
+        {
+            name.Clear();
+            for (;;)
+            {
+                if (!ReadChar(c))
+                    return TOKEN_EOF;
+                if (c == '>')
+                    return TOKEN_END;
+                if (!IsWhiteSpace(c))
+                    name += c;
+            }
+        }
+        
+        // Start tag
+        if (capture)
+        {
+            // The first character of the name is still in the read buffer, the '<' may not be
+            capture_ = "<";
+            captureStart_ = bufferPos_ - 1;
+            capturing_ = true;
+        }
+        
+        name.Clear();
+        name += c;
+        bool inName = true;
+        char quote = 0;
+        char last = c;
+        
+        for (;;)
+        {
+            if (!ReadChar(c))
+                return TOKEN_EOF;
+            
+            if (quote)
+            {
+                // Attribute values may contain any markup characters
+                if (c == quote)
+                    quote = 0;
+            }
+            else if (c == '"' || c == '\'')
+            {
+                quote = c;
+                inName = false;
+            }
+            else if (c == '>')
+                break;
+            else if (inName)
+            {
+                if (c == '/' || IsWhiteSpace(c))
+                    inName = false;
+                else
+                    name += c;
+            }
+            
+            if (!IsWhiteSpace(c))
+                last = c;
+        }
+        
+        selfClosing = last == '/';
+        return TOKEN_START;
+    }
+}
+
+bool XMLStreamReader::ReadChildText(String& name)
+{
+    bool selfClosing;
+    int token = ReadToken(name, selfClosing, true);
+    if (token == TOKEN_END)
+    {
+        finished_ = true;
+        return false;
+    }
+    if (token == TOKEN_EOF)
+    {
+        EndCapture();
+        error_ = true;
+        return false;
+    }
+    
+    // Capture the full sub-hierarchy of the child
+    unsigned depth = selfClosing ? 0 : 1;
+    String tokenName;
+    while (depth)
+    {
+        token = ReadToken(tokenName, selfClosing, false);
+        if (token == TOKEN_EOF)
+        {
+            EndCapture();
+            error_ = true;
+            return false;
+        }
+        if (token == TOKEN_START && !selfClosing)
+            ++depth;
+        else if (token == TOKEN_END)
+            --depth;
+    }
+    
+    EndCapture();
+    return true;
+}
+
+XMLElement XMLStreamReader::ParseElement(XMLFile* file, const String& text)
+{
+    // Parse directly into the document instead of XMLFile::Load(), which logs and profiles
+    if (!file->GetDocument()->load_buffer(text.CString(), text.Length()))
+    {
+        error_ = true;
+        return XMLElement();
+    }
+    
+    return file->GetRoot();
+}
+
+bool XMLStreamReader::ReadChar(char& c)
+{
+    if (bufferPos_ >= bufferSize_)
+    {
+        if (!source_ || source_->IsEof())
+            return false;
+        
+        // Append the captured part of the buffer before it is overwritten
+        if (capturing_)
+        {
+            capture_.Append(buffer_.Get() + captureStart_, bufferSize_ - captureStart_);
+            captureStart_ = 0;
+        }
+        
+        bufferSize_ = source_->Read(buffer_.Get(), READ_BUFFER_SIZE);
+        bufferPos_ = 0;
+        if (!bufferSize_)
+            return false;
+    }
+    
+    c = buffer_[bufferPos_++];
+    return true;
+}
+
+void XMLStreamReader::EndCapture()
+{
+    if (capturing_)
+    {
+        capture_.Append(buffer_.Get() + captureStart_, bufferPos_ - captureStart_);
+        capturing_ = false;
+    }
+}
+
+bool XMLStreamReader::SkipUntil(const char* terminator)
+{
+    unsigned length = strlen(terminator);
+    if (!length || length > MAX_TERMINATOR_LENGTH)
+        return false;
+    
+    // Build the Knuth-Morris-Pratt fallback table, so that a mismatch after a partial match resumes from the longest
+    // terminator prefix that is also a suffix of the matched characters. Otherwise for example "]]]>" would not end "]]>"
+    unsigned fallback[MAX_TERMINATOR_LENGTH];
+    fallback[0] = 0;
+    unsigned prefix = 0;
+    for (unsigned i = 1; i < length; ++i)
+    {
+        while (prefix && terminator[i] != terminator[prefix])
+            prefix = fallback[prefix - 1];
+        if (terminator[i] == terminator[prefix])
+            ++prefix;
+        fallback[i] = prefix;
+    }
+    
+    unsigned matched = 0;
+    char c;
+    
+    while (ReadChar(c))
+    {
+        while (matched && c != terminator[matched])
+            matched = fallback[matched - 1];
+        if (c == terminator[matched] && ++matched == length)
+            return true;
+    }
+    
+    return false;
+}
+
+}
@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2008-2013 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "ArrayPtr.h"
+#include "RefCounted.h"
+#include "XMLElement.h"
+
+namespace Urho3D
+{
+
+class Context;
+class Deserializer;
+class XMLFile;
+
+/// Reader that parses the children of an XML document's root element one at a time or in batches, to keep memory use bounded for large files. Does not log, so it can be used in a worker thread.
+class XMLStreamReader : public RefCounted
+{
+public:
+    /// Construct.
+    XMLStreamReader(Context* context);
+    /// Destruct.
+    ~XMLStreamReader();
+    
+    /// Start reading from a stream, which must stay valid while reading. Read the root element and its leading children up to, but not including the first child with the given name. Return the root element, or null element if fails.
+    XMLElement ReadRoot(Deserializer& source, const String& stopAtChild = String::EMPTY);
+    /// Read the next child element of the root with its full sub-hierarchy. The element is valid until the next call. Return null element if no more children or on error.
+    XMLElement ReadChild();
+    /// Read the following child elements of the root with their full sub-hierarchies until their raw text exceeds the given size, and parse them into a document under an element with the root's name. The document has no children if the root already ended. Return false on error.
+    bool ReadChildren(XMLFile* dest, unsigned maxSize);
+    
+    /// Return whether the end of the root element has been reached.
+    bool IsFinished() const { return finished_; }
+    /// Return whether the data could not be read or parsed.
+    bool HasError() const { return error_; }
+    
+private:
+    /// Read the next markup token and return its type. If capture is true and the token is a start tag, begin capturing the raw text.
+    int ReadToken(String& name, bool& selfClosing, bool capture);
+    /// Read the next child element of the root as raw text into the capture buffer. Return false if root ended or on error.
+    bool ReadChildText(String& name);
+    /// Parse the raw text of an element into a document. Return the element, or null element if fails.
+    XMLElement ParseElement(XMLFile* file, const String& text);
+    /// Read the next character. Return false if the stream ended.
+    bool ReadChar(char& c);
+    /// Stop capturing raw text and append the rest of the captured characters from the read buffer.
+    void EndCapture();
+    /// Skip characters until the terminator string has been read. Return false if the stream ended.
+    bool SkipUntil(const char* terminator);
+    
+    /// Context.
+    Context* context_;
+    /// Source stream.
+    Deserializer* source_;
+    /// Document holding the root element.
+    SharedPtr<XMLFile> rootFile_;
+    /// Document holding the current child element.
+    SharedPtr<XMLFile> childFile_;
+    /// Read buffer.
+    SharedArrayPtr<char> buffer_;
+    /// Read buffer position.
+    unsigned bufferPos_;
+    /// Read buffer amount of valid data.
+    unsigned bufferSize_;
+    /// Read buffer position where the not yet appended captured text starts.
+    unsigned captureStart_;
+    /// Raw text of the element being read.
+    String capture_;
+    /// Raw text of a child that was read but not yet returned.
+    String pendingChild_;
+    /// Name of the root element.
+    String rootName_;
+    /// Capturing raw text flag.
+    bool capturing_;
+    /// Child read but not yet returned flag.
+    bool hasPendingChild_;
+    /// End of root element reached flag.
+    bool finished_;
+    /// Error flag.
+    bool error_;
+};
+
+}
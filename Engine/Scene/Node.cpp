@@ -226,7 +226,7 @@ void Node::SetName(const String& name)
     MarkNetworkUpdate();
 
     // Send change event
-    if (scene_)
+    if (scene_ && scene_->HasEventReceivers(E_NODENAMECHANGED))
     {
         using namespace NodeNameChanged;
 
@@ -537,7 +537,7 @@ void Node::AddChild(Node* node)
     node->MarkNetworkUpdate();
 
     // Send change event
-    if (scene_)
+    if (scene_ && scene_->HasEventReceivers(E_NODEADDED))
     {
         using namespace NodeAdded;
 
@@ -981,10 +981,12 @@ bool Node::Load(Deserializer& source, SceneResolver& resolver, bool readChildren
     if (!Serializable::Load(source))
         return false;
 
+    // Reuse the same buffer for all components to avoid allocating memory for each
+    VectorBuffer compBuffer;
     unsigned numComponents = source.ReadVLE();
     for (unsigned i = 0; i < numComponents; ++i)
     {
-        VectorBuffer compBuffer(source, source.ReadVLE());
+        compBuffer.SetData(source, source.ReadVLE());
         ShortStringHash compType = compBuffer.ReadShortStringHash();
         unsigned compID = compBuffer.ReadUInt();
         Component* newComponent = CreateComponent(compType,
@@ -1241,7 +1243,7 @@ void Node::AddComponent(Component* component, unsigned id, CreateMode mode)
     MarkReplicationDirty();
 
     // Send change event
-    if (scene_)
+    if (scene_ && scene_->HasEventReceivers(E_COMPONENTADDED))
     {
         using namespace ComponentAdded;
 
@@ -32,6 +32,7 @@
 #include "Scene.h"
 #include "SceneEvents.h"
 #include "SmoothedTransform.h"
+#include "VectorBuffer.h"
 #include "WorkQueue.h"
 #include "XMLFile.h"
 
@@ -48,6 +49,69 @@ static const int ASYNC_LOAD_MIN_FPS = 30;
 static const int ASYNC_LOAD_MAX_MSEC = (int)(1000.0f / ASYNC_LOAD_MIN_FPS);
 static const float DEFAULT_SMOOTHING_CONSTANT = 50.0f;
 static const float DEFAULT_SNAP_THRESHOLD = 5.0f;
+static const unsigned ASYNC_PRELOAD_PRIORITY = 1;
+static const unsigned ASYNC_XML_BATCH_SIZE = 65536;
+
+static bool ReadSceneData(Deserializer& source, VectorBuffer& dest)
+{
+    unsigned size = source.GetSize();
+    unsigned position = source.GetPosition();
+    if (size > position)
+    {
+        dest.SetData(source, size - position);
+        return dest.GetSize() == size - position;
+    }
+    else if (size)
+        dest.Clear();
+    else
+    {
+        // The size is not known beforehand, so read in blocks until the stream ends
+        unsigned char block[4096];
+        dest.Clear();
+        for (;;)
+        {
+            unsigned read = source.Read(block, sizeof block);
+            if (!read)
+                break;
+            dest.Write(block, read);
+        }
+        dest.Seek(0);
+    }
+
+    return true;
+}
+
+void PreloadSceneWork(const WorkItem* item, unsigned threadIndex)
+{
+    // Note: must not log or profile here, as this is executed in a worker thread
+    AsyncProgress* progress = reinterpret_cast<AsyncProgress*>(item->start_);
+    if (!progress->xmlReader_)
+        progress->preloadSuccess_ = ReadSceneData(*progress->file_, progress->buffer_);
+    else
+    {
+        if (!progress->rootLoaded_)
+        {
+            progress->xmlElement_ = progress->xmlReader_->ReadRoot(*progress->file_, "node");
+            progress->preloadSuccess_ = progress->xmlElement_.NotNull();
+        }
+        else
+            progress->preloadSuccess_ = progress->xmlReader_->ReadChildren(progress->nextXMLFile_, ASYNC_XML_BATCH_SIZE);
+        
+        // Publish the amount read for the progress calculation in the main thread
+        MutexLock lock(progress->fileReadMutex_);
+        progress->fileRead_ = progress->file_->GetPosition();
+    }
+}
+
+AsyncProgress::AsyncProgress() :
+    loadedNodes_(0),
+    totalNodes_(0),
+    fileRead_(0),
+    preloaded_(false),
+    preloadSuccess_(false),
+    rootLoaded_(false)
+{
+}
 
 OBJECTTYPESTATIC(Scene);
 
@@ -75,6 +139,9 @@ Scene::Scene(Context* context) :
 
 Scene::~Scene()
 {
+    // Make sure a worker thread is not still reading the file of an asynchronous load
+    StopAsyncLoading();
+    
     RemoveAllChildren();
     RemoveAllComponents();
 
@@ -123,8 +190,16 @@ bool Scene::Load(Deserializer& source, bool setInstanceDefault)
 
     Clear();
 
+    // Read the rest of the file into memory with one read, as the scene data consists of a large amount of small reads
+    VectorBuffer buffer;
+    if (!ReadSceneData(source, buffer))
+    {
+        LOGERROR("Could not read scene data from " + source.GetName());
+        return false;
+    }
+
     // Load the whole scene, then perform post-load if successfully loaded
-    if (Node::Load(source, setInstanceDefault))
+    if (Node::Load(buffer, setInstanceDefault))
     {
         FinishLoading(&source);
         return true;
@@ -189,21 +264,44 @@ bool Scene::LoadXML(Deserializer& source)
 
     StopAsyncLoading();
 
-    SharedPtr<XMLFile> xml(new XMLFile(context_));
-    if (!xml->Load(source))
+    // Read the root element with its attributes and components first, but not the child nodes
+    SharedPtr<XMLStreamReader> reader(new XMLStreamReader(context_));
+    XMLElement rootElement = reader->ReadRoot(source, "node");
+    if (!rootElement)
+    {
+        LOGERROR("Could not read XML data from " + source.GetName());
         return false;
+    }
 
     LOGINFO("Loading scene from " + source.GetName());
 
     Clear();
 
-    if (Node::LoadXML(xml->GetRoot()))
+    SceneResolver resolver;
+    resolver.AddNode(rootElement.GetInt("id"), this);
+    if (!Node::LoadXML(rootElement, resolver, false))
+        return false;
+
+    // Then read the child nodes one at a time, so that the whole document does not need to be held in memory
+    for (;;)
     {
-        FinishLoading(&source);
-        return true;
+        XMLElement childElement = reader->ReadChild();
+        if (!childElement)
+            break;
+        if (!LoadChildXML(childElement, resolver))
+            return false;
     }
-    else
+
+    if (reader->HasError())
+    {
+        LOGERROR("Could not read XML data from " + source.GetName());
         return false;
+    }
+
+    resolver.Resolve();
+    ApplyAttributes();
+    FinishLoading(&source);
+    return true;
 }
 
 bool Scene::SaveXML(Serializer& dest) const
@@ -249,19 +347,10 @@ bool Scene::LoadAsync(File* file)
 
     Clear();
 
-    // Store own old ID for resolving possible root node references
-    unsigned nodeID = file->ReadUInt();
-    resolver_.AddNode(nodeID, this);
-
-    // Load root level components first
-    if (!Node::Load(*file, resolver_, false))
-        return false;
-
-    // Then prepare for loading all root level child nodes in the async update
+    // Read the file into memory in a worker thread, then load the nodes in the async update
     asyncLoading_ = true;
     asyncProgress_.file_ = file;
-    asyncProgress_.loadedNodes_ = 0;
-    asyncProgress_.totalNodes_ = file->ReadVLE();
+    StartAsyncPreload();
 
     return true;
 }
@@ -276,49 +365,46 @@ bool Scene::LoadAsyncXML(File* file)
 
     StopAsyncLoading();
 
-    SharedPtr<XMLFile> xml(new XMLFile(context_));
-    if (!xml->Load(*file))
-        return false;
-
     LOGINFO("Loading scene from " + file->GetName());
 
     Clear();
 
-    XMLElement rootElement = xml->GetRoot();
-
-    // Store own old ID for resolving possible root node references
-    unsigned nodeID = rootElement.GetInt("id");
-    resolver_.AddNode(nodeID, this);
-
-    // Load the root level components first
-    if (!Node::LoadXML(rootElement, resolver_, false))
-        return false;
-
-    // Then prepare for loading all root level child nodes in the async update
-    XMLElement childNodeElement = rootElement.GetChild("node");
+    // Parse the root element in a worker thread, then the root-level child nodes in batches while the previous batch is
+    // being loaded in the async update. This keeps both the parsing off the main thread and the memory use bounded
     asyncLoading_ = true;
     asyncProgress_.file_ = file;
-    asyncProgress_.xmlFile_ = xml;
-    asyncProgress_.xmlElement_ = childNodeElement;
-    asyncProgress_.loadedNodes_ = 0;
-    asyncProgress_.totalNodes_ = 0;
-
-    // Count the amount of child nodes
-    while (childNodeElement)
-    {
-        ++asyncProgress_.totalNodes_;
-        childNodeElement = childNodeElement.GetNext("node");
-    }
+    asyncProgress_.xmlReader_ = new XMLStreamReader(context_);
+    asyncProgress_.xmlFile_ = new XMLFile(context_);
+    asyncProgress_.nextXMLFile_ = new XMLFile(context_);
+    StartAsyncPreload();
 
     return true;
 }
 
 void Scene::StopAsyncLoading()
 {
+    // If the worker thread is still reading the file, wait for it to finish first
+    if (asyncLoading_ && !asyncProgress_.preloaded_)
+    {
+        WorkQueue* queue = GetSubsystem<WorkQueue>();
+        if (queue)
+            queue->Complete(ASYNC_PRELOAD_PRIORITY);
+        UnsubscribeFromEvent(E_WORKITEMCOMPLETED);
+    }
+
     asyncLoading_ = false;
     asyncProgress_.file_.Reset();
+    asyncProgress_.buffer_.Clear();
+    asyncProgress_.xmlReader_.Reset();
     asyncProgress_.xmlFile_.Reset();
+    asyncProgress_.nextXMLFile_.Reset();
     asyncProgress_.xmlElement_ = XMLElement::EMPTY;
+    asyncProgress_.loadedNodes_ = 0;
+    asyncProgress_.totalNodes_ = 0;
+    asyncProgress_.fileRead_ = 0;
+    asyncProgress_.preloaded_ = false;
+    asyncProgress_.preloadSuccess_ = false;
+    asyncProgress_.rootLoaded_ = false;
     resolver_.Reset();
 }
 
@@ -491,7 +577,18 @@ Component* Scene::GetComponent(unsigned id) const
 
 float Scene::GetAsyncProgress() const
 {
-    if (!asyncLoading_ || !asyncProgress_.totalNodes_)
+    if (!asyncLoading_)
+        return 1.0f;
+    else if (!asyncProgress_.rootLoaded_)
+        return 0.0f;
+    else if (asyncProgress_.xmlReader_)
+    {
+        // The amount of nodes is not known beforehand in XML mode, so use the amount of the file read so far
+        unsigned size = asyncProgress_.file_->GetSize();
+        MutexLock lock(asyncProgress_.fileReadMutex_);
+        return size ? (float)asyncProgress_.fileRead_ / (float)size : 1.0f;
+    }
+    else if (!asyncProgress_.totalNodes_)
         return 1.0f;
     else
         return (float)asyncProgress_.loadedNodes_ / (float)asyncProgress_.totalNodes_;
@@ -833,35 +930,87 @@ void Scene::HandleUpdate(StringHash eventType, VariantMap& eventData)
         Update(eventData[P_TIMESTEP].GetFloat());
 }
 
+void Scene::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    using namespace WorkItemCompleted;
+
+    const WorkItem* item = reinterpret_cast<const WorkItem*>(eventData[P_ITEM].GetPtr());
+    if (item->workFunction_ == PreloadSceneWork && item->start_ == &asyncProgress_)
+    {
+        asyncProgress_.preloaded_ = true;
+        UnsubscribeFromEvent(E_WORKITEMCOMPLETED);
+    }
+}
+
 void Scene::UpdateAsyncLoading()
 {
+    // Wait until the worker thread has read the file
+    if (!asyncProgress_.rootLoaded_ && !asyncProgress_.preloaded_)
+        return;
+
     PROFILE(UpdateAsyncLoading);
 
+    if (!asyncProgress_.rootLoaded_ && !LoadAsyncRoot())
+    {
+        LOGERROR("Failed to load scene " + asyncProgress_.file_->GetName() + " asynchronously");
+        FailAsyncLoading();
+        return;
+    }
+
     Timer asyncLoadTimer;
 
     for (;;)
     {
-        if (asyncProgress_.loadedNodes_ >= asyncProgress_.totalNodes_)
-        {
-            FinishAsyncLoading();
-            return;
-        }
-
         // Read one child node with its full sub-hierarchy either from binary or XML
-        if (!asyncProgress_.xmlFile_)
+        if (!asyncProgress_.xmlReader_)
         {
-            unsigned nodeID = asyncProgress_.file_->ReadUInt();
+            if (asyncProgress_.loadedNodes_ >= asyncProgress_.totalNodes_)
+            {
+                FinishAsyncLoading();
+                return;
+            }
+
+            unsigned nodeID = asyncProgress_.buffer_.ReadUInt();
             Node* newNode = CreateChild(nodeID, nodeID < FIRST_LOCAL_ID ? REPLICATED : LOCAL);
             resolver_.AddNode(nodeID, newNode);
-            newNode->Load(*asyncProgress_.file_, resolver_);
+            newNode->Load(asyncProgress_.buffer_, resolver_);
         }
         else
         {
-            unsigned nodeID = asyncProgress_.xmlElement_.GetInt("id");
-            Node* newNode = CreateChild(nodeID, nodeID < FIRST_LOCAL_ID ? REPLICATED : LOCAL);
-            resolver_.AddNode(nodeID, newNode);
-            newNode->LoadXML(asyncProgress_.xmlElement_, resolver_);
-            asyncProgress_.xmlElement_ = asyncProgress_.xmlElement_.GetNext("node");
+            if (!asyncProgress_.xmlElement_)
+            {
+                // Current batch loaded, take the next batch when the worker thread has parsed it
+                if (!asyncProgress_.nextXMLFile_)
+                {
+                    FinishAsyncLoading();
+                    return;
+                }
+                if (!asyncProgress_.preloaded_)
+                    break;
+                if (!asyncProgress_.preloadSuccess_)
+                {
+                    LOGERROR("Could not read XML data from " + asyncProgress_.file_->GetName());
+                    FailAsyncLoading();
+                    return;
+                }
+
+                Swap(asyncProgress_.xmlFile_, asyncProgress_.nextXMLFile_);
+                asyncProgress_.xmlElement_ = asyncProgress_.xmlFile_->GetRoot().GetChild();
+                if (asyncProgress_.xmlReader_->IsFinished())
+                    asyncProgress_.nextXMLFile_.Reset();
+                else
+                    StartAsyncPreload();
+                continue;
+            }
+
+            XMLElement childElement = asyncProgress_.xmlElement_;
+            asyncProgress_.xmlElement_ = childElement.GetNext();
+            if (!LoadChildXML(childElement, resolver_))
+            {
+                LOGERROR("Failed to load scene " + asyncProgress_.file_->GetName() + " asynchronously");
+                FailAsyncLoading();
+                return;
+            }
         }
 
         ++asyncProgress_.loadedNodes_;
@@ -875,12 +1024,82 @@ void Scene::UpdateAsyncLoading()
 
     VariantMap eventData;
     eventData[P_SCENE] = (void*)this;
-    eventData[P_PROGRESS] = (float)asyncProgress_.loadedNodes_ / (float)asyncProgress_.totalNodes_;
+    eventData[P_PROGRESS] = GetAsyncProgress();
     eventData[P_LOADEDNODES]  = asyncProgress_.loadedNodes_;
     eventData[P_TOTALNODES]  = asyncProgress_.totalNodes_;
     SendEvent(E_ASYNCLOADPROGRESS, eventData);
 }
 
+void Scene::StartAsyncPreload()
+{
+    asyncProgress_.preloaded_ = false;
+    asyncProgress_.preloadSuccess_ = false;
+
+    // Use low priority so that the per-frame high priority work of other subsystems does not wait for the file read, but
+    // distinct from other low-priority work so that StopAsyncLoading() only has to wait for this item. The preloaded flag
+    // is set from the completion event in the main thread
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    SubscribeToEvent(queue, E_WORKITEMCOMPLETED, HANDLER(Scene, HandleWorkItemCompleted));
+
+    WorkItem item;
+    item.workFunction_ = PreloadSceneWork;
+    item.start_ = &asyncProgress_;
+    item.priority_ = ASYNC_PRELOAD_PRIORITY;
+    item.sendEvent_ = true;
+    queue->AddWorkItem(item);
+}
+
+bool Scene::LoadAsyncRoot()
+{
+    if (!asyncProgress_.preloadSuccess_)
+        return false;
+
+    if (asyncProgress_.xmlReader_)
+    {
+        // Store own old ID for resolving possible root node references, then load root level components
+        XMLElement rootElement = asyncProgress_.xmlElement_;
+        asyncProgress_.xmlElement_ = XMLElement::EMPTY;
+        resolver_.AddNode(rootElement.GetInt("id"), this);
+        if (!Node::LoadXML(rootElement, resolver_, false))
+            return false;
+
+        // Then start parsing the first batch of root level child nodes
+        asyncProgress_.rootLoaded_ = true;
+        if (asyncProgress_.xmlReader_->IsFinished())
+            asyncProgress_.nextXMLFile_.Reset();
+        else
+            StartAsyncPreload();
+        return true;
+    }
+
+    // Store own old ID for resolving possible root node references
+    unsigned nodeID = asyncProgress_.buffer_.ReadUInt();
+    resolver_.AddNode(nodeID, this);
+
+    // Load root level components first
+    if (!Node::Load(asyncProgress_.buffer_, resolver_, false))
+        return false;
+
+    // Then prepare for loading all root level child nodes in the async update
+    asyncProgress_.totalNodes_ = asyncProgress_.buffer_.ReadVLE();
+    asyncProgress_.rootLoaded_ = true;
+    return true;
+}
+
+bool Scene::LoadChildXML(const XMLElement& source, SceneResolver& resolver)
+{
+    if (source.GetName() != "node")
+    {
+        LOGWARNING("Skipping unexpected element " + source.GetName() + " after child nodes in scene XML data");
+        return true;
+    }
+
+    unsigned nodeID = source.GetInt("id");
+    Node* newNode = CreateChild(nodeID, nodeID < FIRST_LOCAL_ID ? REPLICATED : LOCAL);
+    resolver.AddNode(nodeID, newNode);
+    return newNode->LoadXML(source, resolver);
+}
+
 void Scene::FinishAsyncLoading()
 {
     resolver_.Resolve();
@@ -895,6 +1114,17 @@ void Scene::FinishAsyncLoading()
     SendEvent(E_ASYNCLOADFINISHED, eventData);
 }
 
+void Scene::FailAsyncLoading()
+{
+    StopAsyncLoading();
+
+    using namespace AsyncLoadFailed;
+
+    VariantMap eventData;
+    eventData[P_SCENE] = (void*)this;
+    SendEvent(E_ASYNCLOADFAILED, eventData);
+}
+
 void Scene::FinishLoading(Deserializer* source)
 {
     if (source)
@@ -26,7 +26,9 @@
 #include "Mutex.h"
 #include "Node.h"
 #include "SceneResolver.h"
+#include "VectorBuffer.h"
 #include "XMLElement.h"
+#include "XMLStreamReader.h"
 
 namespace Urho3D
 {
@@ -42,16 +44,35 @@ static const unsigned LAST_LOCAL_ID = 0xffffffff;
 /// Asynchronous loading progress of a scene.
 struct AsyncProgress
 {
+    /// Construct.
+    AsyncProgress();
+    
     /// File for binary mode.
     SharedPtr<File> file_;
-    /// XML file for XML mode.
+    /// Scene data read into memory in a worker thread for binary mode.
+    VectorBuffer buffer_;
+    /// Streaming XML reader for XML mode. Used by the worker thread.
+    SharedPtr<XMLStreamReader> xmlReader_;
+    /// Batch of root-level child nodes being loaded in XML mode.
     SharedPtr<XMLFile> xmlFile_;
-    /// Current XML element for XML mode.
+    /// Batch of root-level child nodes being parsed in a worker thread in XML mode. Null when no more batches.
+    SharedPtr<XMLFile> nextXMLFile_;
+    /// Next root-level child node to load in XML mode.
     XMLElement xmlElement_;
     /// Loaded root-level nodes.
     unsigned loadedNodes_;
-    /// Total root-level nodes.
+    /// Total root-level nodes. Not known beforehand in XML mode.
     unsigned totalNodes_;
+    /// Amount of the file read so far by the worker thread in XML mode.
+    unsigned fileRead_;
+    /// Mutex for the amount of the file read, as the file position must not be accessed while the worker thread reads.
+    mutable Mutex fileReadMutex_;
+    /// Worker thread finished reading the file or parsing the XML data flag. Set in the main thread when the work item completes.
+    bool preloaded_;
+    /// Worker thread reading and parsing success flag.
+    bool preloadSuccess_;
+    /// Root-level components loaded flag.
+    bool rootLoaded_;
 };
 
 /// Root scene node, represents the whole scene.
@@ -79,13 +100,13 @@ public:
     /// Add a replication state that is tracking this scene.
     virtual void AddReplicationState(NodeReplicationState* state);
 
-    /// Load from an XML file. Return true if successful.
+    /// Load from an XML file. Root-level child nodes are read from the file one at a time to limit memory use. Return true if successful.
     bool LoadXML(Deserializer& source);
     /// Save to an XML file. Return true if successful.
     bool SaveXML(Serializer& dest) const;
-    /// Load from a binary file asynchronously. Return true if started successfully.
+    /// Load from a binary file asynchronously. The file is read in a worker thread, then nodes are created in the scene update. Return true if started successfully.
     bool LoadAsync(File* file);
-    /// Load from an XML file asynchronously. Return true if started successfully.
+    /// Load from an XML file asynchronously. The XML data is read and parsed in a worker thread in batches of root-level child nodes, and the nodes are created in the scene update. Return true if started successfully.
     bool LoadAsyncXML(File* file);
     /// Stop asynchronous loading.
     void StopAsyncLoading();
@@ -185,10 +206,20 @@ public:
 private:
     /// Handle the logic update event to update the scene, if active.
     void HandleUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle a work item completing. Marks the file of an asynchronous binary load read.
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
     /// Update asynchronous loading.
     void UpdateAsyncLoading();
+    /// Queue the file of an asynchronous binary load to be read, or the next part of an asynchronous XML load to be parsed, in a worker thread.
+    void StartAsyncPreload();
+    /// Load root-level components after the worker thread has read the file and prepare for loading the child nodes. Return true if successful.
+    bool LoadAsyncRoot();
     /// Finish asynchronous loading.
     void FinishAsyncLoading();
+    /// Stop asynchronous loading after an error and send the failure event.
+    void FailAsyncLoading();
+    /// Load a root-level child node from XML. Return true if successful.
+    bool LoadChildXML(const XMLElement& source, SceneResolver& resolver);
     /// Finish loading. Sets the scene filename and checksum.
     void FinishLoading(Deserializer* source);
     /// Finish saving. Sets the scene filename and checksum.
@@ -87,6 +87,12 @@ EVENT(E_ASYNCLOADFINISHED, AsyncLoadFinished)
     PARAM(P_SCENE, Scene);                  // Scene pointer
 };
 
+/// Asynchronous scene loading failed.
+EVENT(E_ASYNCLOADFAILED, AsyncLoadFailed)
+{
+    PARAM(P_SCENE, Scene);                  // Scene pointer
+};
+
 /// A child node has been added to a parent node.
 EVENT(E_NODEADDED, NodeAdded)
 {
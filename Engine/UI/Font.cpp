@@ -44,6 +44,7 @@ namespace Urho3D
 
 static const int MIN_POINT_SIZE = 1;
 static const int MAX_POINT_SIZE = 96;
+static const unsigned FONT_CACHE_VERSION = 1;
 
 /// FreeType library subsystem.
 class FreeTypeLibrary : public Object
@@ -144,6 +145,8 @@ OBJECTTYPESTATIC(Font);
 Font::Font(Context* context) :
     Resource(context),
     fontDataSize_(0),
+    fontDataChecksum_(0),
+    fontDataChecksumValid_(false),
     fontType_(FONT_NONE)
 {
 }
@@ -180,7 +183,9 @@ bool Font::Load(Deserializer& source)
         fontData_.Reset();
         return false;
     }
-
+    
+    fontDataChecksumValid_ = false;
+    
     String ext = GetExtension(GetName()).ToLower();
     if (ext == ".ttf")
         fontType_ = FONT_TTF;
@@ -354,6 +359,11 @@ const FontFace* Font::GetFaceTTF(int pointSize)
         return 0;
     }
     
+    // Rendering and measuring kerning of all glyphs is expensive, so check first for a face stored on an earlier run
+    const FontFace* cachedFace = GetCachedFaceTTF(pointSize);
+    if (cachedFace)
+        return cachedFace;
+    
     error = FT_New_Memory_Face(library, &fontData_[0], fontDataSize_, 0, &face);
     if (error)
     {
@@ -561,12 +571,169 @@ const FontFace* Font::GetFaceTTF(int pointSize)
     }
     
     FT_Done_Face(face);
+    
+    StoreCachedFaceTTF(newFace, images);
+    
+    SetMemoryUse(GetMemoryUse() + totalTextureSize);
+    faces_[pointSize] = newFace;
+    return newFace;
+}
+
+const FontFace* Font::GetCachedFaceTTF(int pointSize)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (cache->GetCacheDir().Empty())
+        return 0;
+    
+    // Calculate the font data checksum on first use, so that it is not needed when caching is disabled
+    if (!fontDataChecksumValid_)
+    {
+        fontDataChecksum_ = 0;
+        for (unsigned i = 0; i < fontDataSize_; ++i)
+            fontDataChecksum_ = SDBMHash(fontDataChecksum_, fontData_[i]);
+        fontDataChecksumValid_ = true;
+    }
+    
+    SharedPtr<File> file = cache->GetCacheFile("Font_" + String(pointSize), fontDataChecksum_);
+    if (!file)
+        return 0;
+    
+    PROFILE(LoadCachedFontFace);
+    
+    if (file->ReadFileID() != "UFFC" || file->ReadUInt() != FONT_CACHE_VERSION || file->ReadUInt() != fontDataSize_)
+    {
+        LOGWARNING("Ignoring mismatching cached font face for " + GetName());
+        return 0;
+    }
+    
+    SharedPtr<FontFace> newFace(new FontFace());
+    newFace->pointSize_ = file->ReadInt();
+    newFace->rowHeight_ = file->ReadInt();
+    newFace->hasKerning_ = file->ReadBool();
+    
+    unsigned numMappings = file->ReadUInt();
+    for (unsigned i = 0; i < numMappings; ++i)
+    {
+        unsigned charCode = file->ReadUInt();
+        newFace->glyphMapping_[charCode] = file->ReadUInt();
+    }
+    
+    unsigned numGlyphs = file->ReadUInt();
+    newFace->glyphs_.Resize(numGlyphs);
+    for (unsigned i = 0; i < numGlyphs; ++i)
+    {
+        FontGlyph& glyph = newFace->glyphs_[i];
+        glyph.x_ = file->ReadShort();
+        glyph.y_ = file->ReadShort();
+        glyph.width_ = file->ReadShort();
+        glyph.height_ = file->ReadShort();
+        glyph.offsetX_ = file->ReadShort();
+        glyph.offsetY_ = file->ReadShort();
+        glyph.advanceX_ = file->ReadShort();
+        glyph.page_ = file->ReadUInt();
+        
+        unsigned numKernings = file->ReadUInt();
+        for (unsigned j = 0; j < numKernings; ++j)
+        {
+            unsigned next = file->ReadUInt();
+            glyph.kerning_[next] = file->ReadShort();
+        }
+    }
+    
+    unsigned totalTextureSize = 0;
+    unsigned numPages = file->ReadUInt();
+    for (unsigned i = 0; i < numPages; ++i)
+    {
+        int texWidth = file->ReadInt();
+        int texHeight = file->ReadInt();
+        
+        SharedPtr<Image> image(new Image(context_));
+        image->SetSize(texWidth, texHeight, 1);
+        if (file->Read(image->GetData(), texWidth * texHeight) != (unsigned)(texWidth * texHeight))
+        {
+            LOGWARNING("Truncated cached font face for " + GetName());
+            return 0;
+        }
         
+        SharedPtr<Texture> texture = LoadFaceTexture(image);
+        if (!texture)
+            return 0;
+        newFace->textures_.Push(texture);
+        totalTextureSize += texWidth * texHeight;
+    }
+    
     SetMemoryUse(GetMemoryUse() + totalTextureSize);
     faces_[pointSize] = newFace;
     return newFace;
 }
 
+void Font::StoreCachedFaceTTF(const FontFace* fontFace, const Vector<SharedPtr<Image> >& images)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (!fontDataChecksumValid_)
+        return;
+    
+    SharedPtr<File> file = cache->CreateCacheFile("Font_" + String(fontFace->pointSize_), fontDataChecksum_);
+    if (!file)
+        return;
+    
+    PROFILE(StoreCachedFontFace);
+    
+    file->WriteFileID("UFFC");
+    file->WriteUInt(FONT_CACHE_VERSION);
+    file->WriteUInt(fontDataSize_);
+    file->WriteInt(fontFace->pointSize_);
+    file->WriteInt(fontFace->rowHeight_);
+    file->WriteBool(fontFace->hasKerning_);
+    
+    file->WriteUInt(fontFace->glyphMapping_.Size());
+    for (HashMap<unsigned, unsigned>::ConstIterator i = fontFace->glyphMapping_.Begin(); i != fontFace->glyphMapping_.End(); ++i)
+    {
+        file->WriteUInt(i->first_);
+        file->WriteUInt(i->second_);
+    }
+    
+    file->WriteUInt(fontFace->glyphs_.Size());
+    for (unsigned i = 0; i < fontFace->glyphs_.Size(); ++i)
+    {
+        const FontGlyph& glyph = fontFace->glyphs_[i];
+        file->WriteShort(glyph.x_);
+        file->WriteShort(glyph.y_);
+        file->WriteShort(glyph.width_);
+        file->WriteShort(glyph.height_);
+        file->WriteShort(glyph.offsetX_);
+        file->WriteShort(glyph.offsetY_);
+        file->WriteShort(glyph.advanceX_);
+        file->WriteUInt(glyph.page_);
+        
+        // Only store nonzero kerning amounts, as missing pairs return zero kerning anyway
+        unsigned numKernings = 0;
+        for (HashMap<unsigned, unsigned>::ConstIterator j = glyph.kerning_.Begin(); j != glyph.kerning_.End(); ++j)
+        {
+            if ((short)j->second_)
+                ++numKernings;
+        }
+        file->WriteUInt(numKernings);
+        for (HashMap<unsigned, unsigned>::ConstIterator j = glyph.kerning_.Begin(); j != glyph.kerning_.End(); ++j)
+        {
+            if ((short)j->second_)
+            {
+                file->WriteUInt(j->first_);
+                file->WriteShort((short)j->second_);
+            }
+        }
+    }
+    
+    file->WriteUInt(images.Size());
+    for (unsigned i = 0; i < images.Size(); ++i)
+    {
+        Image* image = images[i];
+        file->WriteInt(image->GetWidth());
+        file->WriteInt(image->GetHeight());
+        file->Write(image->GetData(), image->GetWidth() * image->GetHeight());
+    }
+}
+
 const FontFace* Font::GetFaceBitmap(int pointSize)
 {
     SharedPtr<XMLFile> xmlReader(new XMLFile(context_));
@@ -125,6 +125,10 @@ public:
 private:
     /// Return True-type font face. Called internally. Return null on error.
     const FontFace* GetFaceTTF(int pointSize);
+    /// Return True-type font face from the processed resource data cache. Called internally. Return null if not cached.
+    const FontFace* GetCachedFaceTTF(int pointSize);
+    /// Store True-type font face and its rendered images to the processed resource data cache. Called internally.
+    void StoreCachedFaceTTF(const FontFace* fontFace, const Vector<SharedPtr<Image> >& images);
     /// Return bitmap font face. Called internally. Return null on error.
     const FontFace* GetFaceBitmap(int pointSize);
     /// Convert graphics format to number of components.
@@ -144,6 +148,10 @@ private:
     SharedArrayPtr<unsigned char> fontData_;
     /// Size of font data.
     unsigned fontDataSize_;
+    /// Checksum of font data.
+    unsigned fontDataChecksum_;
+    /// Font data checksum calculated flag.
+    bool fontDataChecksumValid_;
     /// Font type.
     FONT_TYPE fontType_;
 };
@@ -350,7 +350,9 @@ void btConvexConvexAlgorithm ::processCollision (btCollisionObject* body0,btColl
 	
 	btGjkPairDetector::ClosestPointInput input;
 
-	btGjkPairDetector	gjkPairDetector(min0,min1,m_simplexSolver,m_pdSolver);
+	// Urho3D: use a local simplex solver instead of the shared one, so that collision pairs can be processed in several threads
+	btVoronoiSimplexSolver simplexSolver;
+	btGjkPairDetector	gjkPairDetector(min0,min1,&simplexSolver,m_pdSolver);
 	//TODO: if (dispatchInfo.m_useContinuous)
 	gjkPairDetector.setMinkowskiA(min0);
 	gjkPairDetector.setMinkowskiB(min1);
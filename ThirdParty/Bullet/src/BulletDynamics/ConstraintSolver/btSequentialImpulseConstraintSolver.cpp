@@ -1265,10 +1265,13 @@ void	btSequentialImpulseConstraintSolver::reset()
 	m_btSeed2 = 0;
 }
 
+// Urho3D: construct the fixed body at file scope, as function-local static initialization is not thread-safe on all
+// compilers, and the solver may be used from several threads. It is constructed with zero mass, so its mass properties
+// do not need to be reassigned on each access
+static btRigidBody s_fixed(0, 0,0);
+
 btRigidBody& btSequentialImpulseConstraintSolver::getFixedBody()
 {
-	static btRigidBody s_fixed(0, 0,0);
-	s_fixed.setMassProps(btScalar(0.),btVector3(btScalar(0.),btScalar(0.),btScalar(0.)));
 	return s_fixed;
 }
 
@@ -103,6 +103,8 @@ bool saveBinary_ = false;
 bool createZone_ = true;
 bool noAnimations_ = false;
 bool noMaterials_ = false;
+bool compressAnimations_ = false;
+float animationError_ = DEFAULT_ANIMATION_POSITION_ERROR;
 
 HashSet<aiAnimation*> allAnimations_;
 PODVector<aiAnimation*> sceneAnimations_;
@@ -192,6 +194,7 @@ void Run(const Vector<String>& arguments)
             "\n"
             "Options:\n"
             "-b    Save scene in binary format, default format is XML\n"
+            "-cX   Compress animations with maximum error X. Default 0.001\n"
             "-h    Generate hard instead of smooth normals if input file has no normals\n"
             "-i    Use local ID's for scene nodes\n"
             "-na   Do not output animations\n"
@@ -245,6 +248,12 @@ void Run(const Vector<String>& arguments)
                 saveBinary_ = true;
                 break;
                 
+            case 'c':
+                compressAnimations_ = true;
+                if (!parameter.Empty())
+                    animationError_ = ToFloat(parameter);
+                break;
+                
             case 'h':
                 flags &= ~aiProcess_GenSmoothNormals;
                 flags |= aiProcess_GenNormals;
@@ -1027,6 +1036,8 @@ void BuildAndSaveAnimations(OutModel* model)
         }
         
         outAnim->SetTracks(tracks);
+        if (compressAnimations_)
+            outAnim->Compress(animationError_, animationError_);
         
         File outFile(context_);
         if (!outFile.Open(animOutName, FILE_WRITE))